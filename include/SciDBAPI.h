@@ -41,6 +41,7 @@
 #define SCIDBAPI_H_
 
 #include <stdint.h>
+#include <map>
 #include <queue>
 
 #include <query/QueryID.h>
@@ -61,7 +62,7 @@ class QueryResult
 {
 public:
     QueryResult()
-    : selective(false), autoCommit(false),
+    : memoryReservation(0), selective(false), autoCommit(false),
       requiresExclusiveArrayAccess(false), executionTime(0)
     {
     }
@@ -70,6 +71,10 @@ public:
     ~QueryResult();
 #endif
 
+    // Query request fields
+    uint64_t memoryReservation; // Memory the query needs, in MiB, 0 to leave it to the server
+    std::map<std::string, std::string> parameters; // Literal values of the $name parameters, by name
+
     // Query result fields
     QueryID queryID;
     bool selective;
@@ -135,7 +140,8 @@ public:
 
     /**
      * Prepare a query string. Throws exception if an error occurred.
-     * @param queryString a string with query on scidb language.
+     * @param queryString a string with query on scidb language, in which every $name
+     * that queryResult.parameters has a value for is replaced with that literal.
      * @param queryResult a reference to QueryResult structure with description of query execution result.
      * @param connection is handle to connection returned by connect method.
      */
@@ -334,5 +334,48 @@ public:
     virtual DelegateArrayIterator* createArrayIterator(AttributeID id) const;
 };
 
+/**
+ * The empty bitmap and the payload of a chunk in RLE format, materializing the
+ * chunk if it is not, pinned as long as this lives. A chunk of an array without
+ * empty bitmap has all its cells.
+ */
+class RLEChunkData
+{
+public:
+    explicit RLEChunkData(ConstChunk const& chunk);
+
+    ConstChunk const& getChunk() const
+    {
+        return *_chunk;
+    }
+
+    ConstRLEEmptyBitmap const& getBitmap() const
+    {
+        return *_bitmap;
+    }
+
+    /**
+     * @return the payload, or NULL for the empty bitmap attribute
+     */
+    ConstRLEPayload const* getPayload() const
+    {
+        return _payload.get();
+    }
+
+    /**
+     * Make @param result the chunk of attribute @param attrID of @param array
+     * at the position of this chunk with just the cells of @param cells, which
+     * must be a subset of getBitmap() with the same physical positions, as its
+     * cuts and intersections are. Runs of cells are copied a segment at a time.
+     */
+    void select(ConstRLEEmptyBitmap const& cells, Array const& array, AttributeID attrID, MemChunk& result) const;
+
+private:
+    ConstChunk const* _chunk;
+    PinBuffer _pin;
+    std::shared_ptr<ConstRLEEmptyBitmap> _bitmap;
+    std::unique_ptr<ConstRLEPayload> _payload;
+};
+
 } //namespace
 #endif /* DELEGATE_ARRAY_H_ */
@@ -35,6 +35,7 @@
 #include <map>
 #include <assert.h>
 #include <memory>
+#include <atomic>
 #include <boost/shared_array.hpp>
 #include <query/Query.h>
 #include <util/FileIO.h>
@@ -42,15 +43,45 @@
 #include <util/CoordinatesMapper.h>
 #include <array/Tile.h>
 #include <util/DataStore.h>
+#include <util/Event.h>
+#include <util/Job.h>
+#include <util/JobQueue.h>
+#include <util/ThreadPool.h>
+#include <array/Compressor.h>
 
 namespace scidb
 {
     /**
      * Structure to share mem chunks.
+     *
+     * Chunks that are not pinned are kept on an LRU. Once the memory used by all
+     * the chunks goes above the high watermark a background spill writer starts
+     * evicting (and optionally compressing) LRU chunks until the usage drops to the
+     * low watermark. Threads that push the usage over the hard threshold evict
+     * synchronously. In both cases the disk I/O is done without holding _mutex;
+     * a chunk with I/O in flight is flagged (LruMemChunk::_ioInProgress) and anyone
+     * wanting to pin or delete it waits on _ioComplete.
      */
     class SharedMemCache
     {
     private:
+        /**
+         * The background job which drains the LRU down to the low watermark.
+         */
+        class SpillJob : public Job
+        {
+        private:
+            SharedMemCache& _cache;
+
+        public:
+            SpillJob(SharedMemCache& cache):
+                Job(std::shared_ptr<Query>()),
+                _cache(cache)
+            {}
+
+            virtual void run();
+        };
+
         // The LRU of LruMemChunk objects.
         MemChunkLru _theLru;
 
@@ -60,10 +91,83 @@ namespace scidb
         size_t _swapNum;
         size_t _loadsNum;
         size_t _dropsNum;
+        uint64_t _spilledSize;      // bytes handed to the datastores (after compression)
+        uint64_t _spilledRawSize;   // bytes of the spilled chunks before compression
         uint64_t _genCount;
         DataStores _datastores;
+
+        // Compressor applied to the chunks being spilled (CompressorFactory index)
+        int _spillCompressionMethod;
+
+        // Signalled whenever a spill or a load of some chunk completes
+        Event _ioComplete;
+
+        // Background spill writer
+        Event _spillNeeded;
+        bool _spillRequested;
+        bool _spillerRunning;
+        std::shared_ptr<JobQueue> _spillQueue;
+        std::shared_ptr<ThreadPool> _spillThreadPool;
+        std::shared_ptr<SpillJob> _spillJob;
+
         static SharedMemCache _sharedMemCache;
 
+        /// Percentage of the threshold above which the background writer is woken up
+        static const uint64_t SPILL_HIGH_WATERMARK_PCT = 90;
+        /// Percentage of the threshold down to which the LRU is drained
+        static const uint64_t SPILL_LOW_WATERMARK_PCT = 75;
+
+        uint64_t getHighWatermark() const
+        {
+            return _usedMemThreshold / 100 * SPILL_HIGH_WATERMARK_PCT;
+        }
+
+        uint64_t getLowWatermark() const
+        {
+            return _usedMemThreshold / 100 * SPILL_LOW_WATERMARK_PCT;
+        }
+
+        /**
+         * @return the usage an eviction brings the cache down to: the low watermark
+         * when the background writer runs, the threshold otherwise.
+         */
+        uint64_t getSpillTarget() const
+        {
+            return _spillerRunning ? getLowWatermark() : _usedMemThreshold;
+        }
+
+        /**
+         * Evict chunks from the LRU until _usedMemSize drops to targetSize.
+         * Must be called with _mutex held exactly once by the calling thread;
+         * the mutex is released while the victims are compressed and written.
+         */
+        void spill(uint64_t targetSize);
+
+        /**
+         * Compress (if configured) and write one victim to its array's datastore.
+         * Called without _mutex.
+         * @return the number of bytes written
+         */
+        size_t writeVictim(LruMemChunk& victim, std::shared_ptr<DataStore> const& ds);
+
+        /**
+         * Read (and decompress) a chunk previously written by writeVictim.
+         * Called without _mutex; the chunk buffer must already be allocated.
+         */
+        void readChunk(LruMemChunk& chunk, std::shared_ptr<DataStore> const& ds);
+
+        /**
+         * Block until no I/O is in flight for the chunk. Must be called with _mutex held.
+         */
+        void waitForChunkIo(LruMemChunk& chunk);
+
+        /**
+         * Wake up the background writer if the usage is above the high watermark,
+         * evict synchronously if it is above the threshold.
+         * Must be called with _mutex held.
+         */
+        void checkMemUsage();
+
     public:
         SharedMemCache();
         void pinChunk(LruMemChunk& chunk);
@@ -99,13 +203,43 @@ namespace scidb
             return _dropsNum;
         }
 
+        /**
+         * @return the number of bytes written to the datastores by the spill
+         */
+        uint64_t getSpilledSize() const {
+            return _spilledSize;
+        }
+
+        /**
+         * @return the uncompressed size of the chunks written by the spill
+         */
+        uint64_t getSpilledRawSize() const {
+            return _spilledRawSize;
+        }
+
         /**
          * Initialize the datastores used for the temporary disk storage needed
-         * by mem arrays.
+         * by mem arrays and start the background spill writer.
          * @param memThreshold size of the in-memory cache
          * @param basePath directory where datastores for spilled data will live
+         * @param compressionMethod the compressor applied to spilled chunks
+         */
+        void initSharedMemCache(uint64_t memThreshold,
+                                const char* basePath,
+                                int compressionMethod = CompressorFactory::NO_COMPRESSION);
+
+        /**
+         * Start the background spill writer.
+         */
+        void startSpiller();
+
+        /**
+         * Stop the background spill writer and its thread. Until it is
+         * restarted the threads crossing the threshold evict synchronously.
+         * Must be called on shutdown, while logging is still available: the
+         * static instance does not stop the writer when it is destroyed.
          */
-        void initSharedMemCache(uint64_t memThreshold, const char* basePath);
+        void stopSpiller();
 
         /**
          * Update the memory threshold.
@@ -191,9 +325,20 @@ namespace scidb
         void swapOut();
         void pinChunk(LruMemChunk& chunk);
         void unpinChunk(LruMemChunk& chunk);
+
+        /**
+         * Credit the spills done by SharedMemCache on behalf of this array
+         * to the statistics of the query.
+         */
+        void reportSpills(Query& query);
+
         std::shared_ptr<DataStore> _datastore;
         std::map<Address, LruMemChunk> _chunks;
         Mutex _mutex;
+
+        // Spills not yet reported to the query (updated by SharedMemCache)
+        std::atomic<uint64_t> _spilledSize;
+        std::atomic<uint64_t> _spilledChunks;
     private:
         MemArray(const MemArray&);
     };
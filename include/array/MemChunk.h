@@ -325,6 +325,18 @@ namespace scidb
          */
         size_t       _dsAlloc;
 
+        /**
+         * The number of bytes of the chunk image in the datastore. It is smaller than
+         * the chunk size if the chunk was compressed when it was spilled.
+         */
+        size_t       _dsSize;
+
+        /**
+         * True while the chunk is being written to or read from the datastore
+         * without SharedMemCache::_mutex held.
+         */
+        bool         _ioInProgress;
+
         /**
          * The size of the chunk the last time we pinned or unPinned it. If you follow proper prodecure, the chunk size should
          * only change at unPin time; hence the name.
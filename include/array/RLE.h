@@ -29,6 +29,7 @@
 #include <system/Exceptions.h>
 #include <util/arena/Map.h>
 
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <boost/utility.hpp>
@@ -40,6 +41,7 @@
 namespace scidb
 {
 const uint64_t RLE_EMPTY_BITMAP_MAGIC = 0xEEEEAAAA00EEBAACLL;
+const uint64_t RLE_EMPTY_BITMAP_SPARSE_MAGIC = 0xEEEEAAAA00EEBAADLL;
 const uint64_t RLE_PAYLOAD_MAGIC      = 0xDDDDAAAA000EAAACLL;
 
 class ConstChunk;
@@ -75,19 +77,38 @@ public:
     };
 
     // This structure must use platform independent data types with fixed size.
+    //
+    // A packed bitmap is a Header followed by one of two bodies, told apart
+    // by the magic:
+    //  - RLE_EMPTY_BITMAP_MAGIC: the array of _nSegs Segments, which the
+    //    bitmap then points into directly;
+    //  - RLE_EMPTY_BITMAP_SPARSE_MAGIC: for each segment, the gap from the
+    //    end of the previous one and the length, as LEB128 varints.  The
+    //    _pPositions are implicit: segment i starts at payload position
+    //    sum(length[0..i-1]).  Used for scattered cells, where it is several
+    //    times smaller; the segments are unpacked on load.
     struct Header {
         uint64_t _magic;
         uint64_t _nSegs;
         uint64_t _nNonEmptyElements;
     };
 
+    /**
+     * The sparse body is used only if it is at least this many times
+     * smaller than the Segment array.
+     */
+    static const size_t SPARSE_PACKING_RATIO = 4;
+
   protected:
-    // Pointers are to memory not owned by this object.
+    // Pointers are to memory not owned by this object, unless they point
+    // into _unpacked.
     size_t _nSegs;
     Segment const* _seg;
     uint64_t _nNonEmptyElements;
     ConstChunk const* _chunk;
     bool _chunkPinned;
+    std::vector<Segment> _unpacked;   // segments of a sparse packed bitmap
+    mutable size_t _packedSize;       // result of packedSize(), 0 if unknown
 
     /**
      * Default constructor
@@ -98,8 +119,21 @@ public:
         , _nNonEmptyElements(0)
         , _chunk(NULL)
         , _chunkPinned(false)
+        , _packedSize(0)
     {}
 
+    /**
+     * Point this bitmap at a packed bitmap, unpacking it if needed.
+     * @return true if the bitmap refers to src, false if it was unpacked
+     */
+    bool unpack(char const* src);
+
+    /**
+     * @return the size of the sparse body for this bitmap, or 0 if the
+     * segments' payload positions are not implied by their lengths
+     */
+    size_t sparseBodySize() const;
+
   public:
 
     size_t getValueIndex(position_t pos) const {
@@ -148,6 +182,34 @@ public:
         return r;
     }
 
+    /**
+     * Find segment of non-empty elements with position greater or equal than
+     * specified, searching forward from segment 'from' with a galloping
+     * search.  Much cheaper than findSegment(pos) when successive probes
+     * arrive in increasing order, as they do when joining or filtering.
+     */
+    size_t findSegment(position_t pos, size_t from) const {
+        if (from > _nSegs || (from > 0 && _seg[from-1]._lPosition + _seg[from-1]._length > pos)) {
+            return findSegment(pos);
+        }
+        size_t l = from, probe = from, step = 1;
+        while (probe < _nSegs && _seg[probe]._lPosition + _seg[probe]._length <= pos) {
+            l = probe + 1;
+            probe += step;
+            step <<= 1;
+        }
+        size_t r = std::min(probe, _nSegs);
+        while (l < r) {
+            size_t m = (l + r) >> 1;
+            if (_seg[m]._lPosition + _seg[m]._length <= pos) {
+                l = m + 1;
+            } else {
+                r = m;
+            }
+        }
+        return r;
+    }
+
     /**
      * Method to be called to save bitmap in chunk body
      */
@@ -156,9 +218,15 @@ public:
     /**
      * Get size needed to pack bitmap (used to dermine size of chunk)
      */
-    size_t packedSize() const
+    size_t packedSize() const;
+
+    /**
+     * Check whether src starts with the magic of a packed bitmap
+     */
+    static bool isPacked(char const* src)
     {
-        return sizeof(Header) + _nSegs*sizeof(Segment);
+        uint64_t magic = reinterpret_cast<Header const*>(src)->_magic;
+        return magic == RLE_EMPTY_BITMAP_MAGIC || magic == RLE_EMPTY_BITMAP_SPARSE_MAGIC;
     }
 
     /**
@@ -168,6 +236,15 @@ public:
 
     ConstRLEEmptyBitmap(ConstChunk const& chunk);
 
+    /**
+     * Copy a bitmap. The copy holds its own segments, as those of 'other'
+     * may be in its _unpacked buffer, in a derived class, or in a chunk that
+     * it alone keeps pinned.
+     */
+    ConstRLEEmptyBitmap(ConstRLEEmptyBitmap const& other);
+
+    ConstRLEEmptyBitmap& operator=(ConstRLEEmptyBitmap const& other);
+
     virtual ~ConstRLEEmptyBitmap();
 
     std::ostream& getInfo(std::ostream& stream, bool verbose=false) const;
@@ -180,23 +257,25 @@ public:
         size_t _currSeg;
         Segment const* _cs;
         position_t _currLPos;
+        size_t _hint;       // where the last setPosition() search ended
 
         bool const_end() const { return _currSeg >= _bm->nSegments(); }
 
       public:
         iterator(ConstRLEEmptyBitmap const* bm):
-        _bm(bm), _currSeg(0), _cs(NULL), _currLPos(-1)
+        _bm(bm), _currSeg(0), _cs(NULL), _currLPos(-1), _hint(0)
         {
             reset();
         }
 
         iterator():
-        _bm(NULL), _currSeg(0), _cs(NULL), _currLPos(-1)
+        _bm(NULL), _currSeg(0), _cs(NULL), _currLPos(-1), _hint(0)
         {}
 
         void reset()
         {
             _currSeg = 0;
+            _hint = 0;
             if(!end())
             {
                 _cs = &_bm->getSegment(_currSeg);
@@ -223,7 +302,8 @@ public:
 
         bool setPosition(position_t lPos)
         {
-            _currSeg = _bm->findSegment(lPos);
+            _currSeg = _bm->findSegment(lPos, _hint);
+            _hint = _currSeg;
             if (end() || _bm->getSegment(_currSeg)._lPosition > lPos)
             {
                 _currSeg = _bm->nSegments();
@@ -355,6 +435,20 @@ public:
             Coordinates const& upperOrigin,
             Coordinates const& lowerResult,
             Coordinates const& upperResult) const;
+
+    /**
+     * @return bitmap of the cells set in both this bitmap and @param other,
+     * with the physical positions of this bitmap.
+     */
+    std::shared_ptr<RLEEmptyBitmap> intersect(ConstRLEEmptyBitmap const& other) const;
+
+    /**
+     * @return bitmap of the cells set in this bitmap or in @param other, with
+     * the physical positions of this bitmap where it has the cell, else with
+     * those of @param other.  Both must select cells of the same payload, as
+     * the cuts of one bitmap do.
+     */
+    std::shared_ptr<RLEEmptyBitmap> unite(ConstRLEEmptyBitmap const& other) const;
 };
 
 std::ostream& operator<<(std::ostream& stream, ConstRLEEmptyBitmap const& map);
@@ -381,6 +475,7 @@ class RLEEmptyBitmap : public ConstRLEEmptyBitmap
         _seg = NULL;
         _nSegs = 0;
         _nNonEmptyElements = 0;
+        _packedSize = 0;
     }
 
     void addSegment(Segment const& segm)
@@ -395,6 +490,7 @@ class RLEEmptyBitmap : public ConstRLEEmptyBitmap
         _seg = &_container[0];
         _nNonEmptyElements += segm._length;
         _nSegs++;
+        _packedSize = 0;
     }
 
     void addPositionPair(position_t const& lPosition, position_t const& pPosition)
@@ -405,6 +501,7 @@ class RLEEmptyBitmap : public ConstRLEEmptyBitmap
             _container[_nSegs-1]._pPosition + _container[_nSegs-1]._length == pPosition)
         {
             _container[_nSegs-1]._length++;
+            _packedSize = 0;
         }
         else
         {
@@ -421,6 +518,7 @@ class RLEEmptyBitmap : public ConstRLEEmptyBitmap
         if (static_cast<ConstRLEEmptyBitmap*>(this) != &other) {
             _nSegs = other.nSegments();
             _nNonEmptyElements = other._nNonEmptyElements;
+            _packedSize = other._packedSize;
             _container.resize(_nSegs);
             if (_container.empty()) {
                 _seg = NULL;
@@ -443,6 +541,7 @@ class RLEEmptyBitmap : public ConstRLEEmptyBitmap
         if (this != &other) {
             _nSegs = other._nSegs;
             _nNonEmptyElements = other._nNonEmptyElements;
+            _packedSize = other._packedSize;
             _container = other._container;
             _seg = _container.empty() ? NULL : &_container[0];
         }
@@ -193,6 +193,19 @@ public:
         return false;
     }
 
+    /**
+     * Set the constant arguments that follow the input attribute in the call,
+     * as in approxquantile(x, 0.9).  Most aggregates take none.
+     * @param parameters the values of the arguments, in order
+     * @throws UserException if the aggregate does not accept them
+     */
+    virtual void setParameters(std::vector<double> const& parameters)
+    {
+        if (!parameters.empty()) {
+            throw USER_EXCEPTION(SCIDB_SE_SYNTAX, SCIDB_LE_WRONG_AGGREGATE_ARGUMENTS_COUNT);
+        }
+    }
+
     virtual void initializeState(Value& state) = 0;
 
     /**
@@ -242,6 +255,46 @@ public:
         }
     }
 
+    /**
+     * Initialize the state if not already, then accumulate the values at the physical positions [from, from+count)
+     * of a chunk payload, as calling accumulateIfNeeded() on each of them in turn would.
+     * Derived classes override this with typed loops over the segments of the payload.
+     * @param dstState   a destination state.
+     * @param payload    the payload of a chunk.
+     * @param from       the position of the first value.
+     * @param count      the number of values.
+     */
+    virtual void accumulatePayload(Value& dstState, ConstRLEPayload const& payload, position_t from, size_t count)
+    {
+        if (! isStateInitialized(dstState)) {
+            initializeState(dstState);
+            assert(isStateInitialized(dstState));
+        }
+
+        Value val;
+        position_t const end = from + count;
+        for (size_t i = payload.findSegment(from), n = payload.nSegments(); i < n; i++)
+        {
+            size_t vLen;
+            const RLEPayload::Segment& v = payload.getSegment(i, vLen);
+            if (position_t(v.pPosition()) >= end)
+                break;
+            position_t const lo = std::max(from, position_t(v.pPosition()));
+            position_t const hi = std::min(end, position_t(v.pPosition() + vLen));
+            for (position_t p = lo; p < hi; p++)
+            {
+                if (v.null()) {
+                    val.setNull(safe_static_cast<Value::reason>(v.valueIndex()));
+                } else {
+                    payload.getValueByIndex(val, v.same() ? v.valueIndex() : v.valueIndex() + (p - v.pPosition()));
+                }
+                if (isAccumulatable(val)) {
+                    accumulate(dstState, val);
+                }
+            }
+        }
+    }
+
     /**
      * Initialize the state if not already, then merge a source state into a destination state, if the source state is ready to merge from.
      * @param dstState  the destination state, which MUST have been initialized.
@@ -354,6 +407,37 @@ public:
         }
     }
 
+    virtual void accumulatePayload(Value& state, ConstRLEPayload const& payload, position_t from, size_t count)
+    {
+        if (! isStateInitialized(state)) {
+            initializeState(state);
+            assert(isStateInitialized(state));
+        }
+
+        State& s = state.get<State>();
+        position_t const end = from + count;
+
+        for (size_t i = payload.findSegment(from), n = payload.nSegments(); i < n; i++)
+        {
+            size_t vLen;
+            const RLEPayload::Segment& v = payload.getSegment(i, vLen);
+            if (position_t(v.pPosition()) >= end)
+                break;
+            if (v.null())
+                continue;
+            position_t const lo = std::max(from, position_t(v.pPosition()));
+            position_t const hi = std::min(end, position_t(v.pPosition() + vLen));
+            if (v.same()) {
+                Agg::multAggregate(s, getPayloadValue<T>(&payload, v.valueIndex()), hi - lo);
+            } else {
+                const size_t first = v.valueIndex() + (lo - v.pPosition());
+                for (size_t j = first, last = first + (hi - lo); j < last; j++) {
+                    Agg::aggregate(s, getPayloadValue<T>(&payload, j));
+                }
+            }
+        }
+    }
+
     void finalResult(Value& dstValue, Value const& srcState)
     {
         dstValue.setSize(sizeof(TR));
@@ -505,6 +589,41 @@ public:
         }
     }
 
+    virtual void accumulatePayload(Value& state, ConstRLEPayload const& payload, position_t from, size_t count)
+    {
+        if (! isStateInitialized(state)) {
+            initializeState(state);
+            assert(isStateInitialized(state));
+        }
+
+        position_t const end = from + count;
+
+        for (size_t i = payload.findSegment(from), n = payload.nSegments(); i < n; i++)
+        {
+            size_t vLen;
+            const RLEPayload::Segment& v = payload.getSegment(i, vLen);
+            if (position_t(v.pPosition()) >= end)
+                break;
+            if (v.null())
+                continue;
+            position_t const lo = std::max(from, position_t(v.pPosition()));
+            position_t const hi = std::min(end, position_t(v.pPosition() + vLen));
+            const size_t first = v.same() ? v.valueIndex() : v.valueIndex() + (lo - v.pPosition());
+            if (! isMergeable(state)) {
+                state.setSize(sizeof(State));
+                Agg::init(state.get<State>(), getPayloadValue<T>(&payload, first));
+            }
+            State& s = state.get<State>();
+            if (v.same()) {
+                Agg::multAggregate(s, getPayloadValue<T>(&payload, first), hi - lo);
+            } else {
+                for (size_t j = first, last = first + (hi - lo); j < last; j++) {
+                    Agg::aggregate(s, getPayloadValue<T>(&payload, j));
+                }
+            }
+        }
+    }
+
     void finalResult(Value& dstValue, Value const& srcState)
     {
         dstValue.setSize(sizeof(TR));
@@ -118,7 +118,7 @@ class Expression
 {
 friend class ExpressionContext;
 public:
-    Expression(): _compiled(false), _tileMode(false),
+    Expression(): _compiled(false), _tileMode(false), _deterministic(true),
         _tempValuesNumber(0), _eargs(1), _props(1)
     {
     }
@@ -208,6 +208,15 @@ public:
         return _props.size() > 0 && (_props[0].isConst || _props[0].isConstantFunction);
     }
 
+    /**
+     * @return false if the expression calls a function, such as random(),
+     * that may return different results for the same arguments; only known
+     * on the instance that compiled the expression
+     */
+    bool isDeterministic() const {
+        return _deterministic;
+    }
+
     const std::vector<BindInfo>& getBindings() const {
         return _bindings;
     }
@@ -225,6 +234,7 @@ private:
     bool _nullable;
     bool _constant; // doesn't depend on input data
     bool _tileMode;
+    bool _deterministic; // not serialized
     size_t _tempValuesNumber;
 
     /**
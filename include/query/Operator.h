@@ -46,6 +46,7 @@
 #include <boost/format.hpp>
 #include <boost/serialization/serialization.hpp>
 #include <boost/serialization/string.hpp> // needed for serialization of string parameter
+#include <boost/serialization/vector.hpp> // needed for serialization of aggregate call parameters
 #include <unordered_map>
 
 #include <array/Array.h>
@@ -751,11 +752,13 @@ public:
             const std::shared_ptr<ParsingContext>& parsingContext,
             const std::string& aggregateName,
             std::shared_ptr <OperatorParam> const& inputAttribute,
-            const std::string& alias):
+            const std::string& alias,
+            const std::vector<double>& parameters = std::vector<double>()):
         OperatorParam(PARAM_AGGREGATE_CALL, parsingContext),
         _aggregateName(aggregateName),
         _inputAttribute(inputAttribute),
-        _alias(alias)
+        _alias(alias),
+        _parameters(parameters)
     {}
 
     std::string const& getAggregateName() const
@@ -778,10 +781,19 @@ public:
         return _alias;
     }
 
+    /**
+     * @return the constant arguments that follow the input attribute
+     */
+    std::vector<double> const& getParameters() const
+    {
+        return _parameters;
+    }
+
 private:
     std::string _aggregateName;
     std::shared_ptr <OperatorParam> _inputAttribute;
     std::string _alias;
+    std::vector<double> _parameters;
 
 public:
     template<class Archive>
@@ -803,6 +815,7 @@ public:
         }
 
         ar & _alias;
+        ar & _parameters;
     }
 
     /**
@@ -2046,6 +2059,25 @@ public:
         return PhysicalBoundaries::createFromFullSchema(_schema);
     }
 
+    /**
+     *  [Optimizer API] Estimate the memory the operator needs on each instance.
+     *  The admission controller reserves the sum of the estimates of the plan,
+     *  so operators that hold much of their input in memory at once, such as
+     *  sort, should override this; the default of 0 means "nothing beyond the
+     *  default reservation".
+     *  @param sourceBoundaries the boundaries of the inputs, in the order of sourceSchemas
+     *  @param sourceSchemas shapes of all arrays that will given as inputs
+     *  @param nInstances the number of instances the query runs on
+     *  @return the estimate in bytes
+     */
+    virtual uint64_t getMemoryEstimate(
+            std::vector<PhysicalBoundaries> const& sourceBoundaries,
+            std::vector<ArrayDesc> const& sourceSchemas,
+            size_t nInstances) const
+    {
+        return 0;
+    }
+
     /**
      *  [Optimizer API] Determine if the operator requires redimensioning/repartitioning of its inputs.
      *
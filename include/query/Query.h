@@ -57,13 +57,17 @@ class Array;
 class LogicalPlan;
 class MessageDesc;
 class PhysicalPlan;
+class AdmissionController;
 class ProcGrid;
+class QueryResultCapture;
 class RemoteArray;
 class RemoteMergedArray;
 class ReplicationContext;
 class Session;
 class Warning;
 
+namespace arena { class LimitedArena; }
+
 const size_t MAX_BARRIERS = 2;
 
 /**
@@ -176,6 +180,7 @@ private:
     }
 
     friend class ServerMessageHandleJob;
+    friend class AdmissionController;
 
     std::shared_ptr<OperatorContext> _operatorContext;
 
@@ -350,6 +355,17 @@ private:
      */
     std::shared_ptr<RemoteMergedArray> _mergedArray;
 
+    /**
+     * Collects the result for the QueryResultCache as the client fetches it
+     */
+    std::shared_ptr<QueryResultCapture> _resultCapture;
+
+    /**
+     * True if the result was found in the QueryResultCache,
+     * in which case the query never reached the other instances
+     */
+    bool _resultFromCache;
+
     /**
      * Time of query creation;
      */
@@ -389,6 +405,21 @@ private:
      */
      arena::ArenaPtr _arena;
 
+    /**
+     * The parent of _arena, through which the query's memory reservation is
+     * enforced once the query has been admitted; unlimited until then.
+     */
+    std::shared_ptr<arena::LimitedArena> _reservedArena;
+
+    /**
+     * Admission control state, see AdmissionController: the bytes reserved
+     * for this query on this instance, whether it is waiting for admission,
+     * and how long it has waited.
+     */
+    std::atomic<uint64_t> _memoryReservation;
+    std::atomic<bool>     _admissionQueued;
+    std::atomic<uint64_t> _admissionWaitMsecs;
+
     /**
      *  A pointer to the session object used with this query
      */
@@ -567,6 +598,31 @@ public:
         return _arena;
     }
 
+    /**
+     * @return the memory reserved for this query on this instance, in bytes,
+     * or 0 if it has no reservation
+     */
+    uint64_t getMemoryReservation() const
+    {
+        return _memoryReservation;
+    }
+
+    /**
+     * @return true if the query is waiting for admission
+     */
+    bool isAdmissionQueued() const
+    {
+        return _admissionQueued;
+    }
+
+    /**
+     * @return the time the query spent waiting for admission, in milliseconds
+     */
+    uint64_t getAdmissionWaitMsecs() const
+    {
+        return _admissionWaitMsecs;
+    }
+
     /**
      *  Return true if the query completed successfully and was committed.
      */
@@ -677,6 +733,30 @@ public:
         _mergedArray = array;
     }
 
+    std::shared_ptr<QueryResultCapture> getResultCapture()
+    {
+        ScopedMutexLock cs(errorMutex);
+        return _resultCapture;
+    }
+
+    /**
+     * Start collecting the result for the QueryResultCache with 'capture',
+     * which also receives the warnings posted so far and from now on
+     */
+    void setResultCapture(const std::shared_ptr<QueryResultCapture>& capture);
+
+    bool isResultFromCache() const
+    {
+        ScopedMutexLock cs(errorMutex);
+        return _resultFromCache;
+    }
+
+    void setResultFromCache()
+    {
+        ScopedMutexLock cs(errorMutex);
+        _resultFromCache = true;
+    }
+
     Statistics statistics;
 
     /**
@@ -695,6 +775,12 @@ public:
     std::shared_ptr<SystemCatalog::LockDesc>
     requestLock(std::shared_ptr<SystemCatalog::LockDesc>& lock);
 
+    /**
+     * @return the qualified names of the arrays for which a lock of at least
+     *         'mode' has been requested
+     */
+    std::vector<std::string> getLockedArrays(SystemCatalog::LockDesc::LockMode mode) const;
+
     void addPhysicalPlan(std::shared_ptr<PhysicalPlan> physicalPlan)
     {
         _physicalPlans.push_back(physicalPlan);
@@ -1201,6 +1287,7 @@ private:
     Mutex _mutex;
     QueueMap _inboundQueues;
     std::weak_ptr<Query> _query;
+    std::vector<boost::function<void()> > _pendingReplicas;
     static ReplicationManager* _replicationMngr;
 
 public:
@@ -1235,6 +1322,13 @@ public:
      */
     void replicationSync(ArrayID arrId);
 
+    /**
+     * Remember a replica that is being sent in the background,
+     * to check in replicationSync() that it was sent
+     * @param waiter waits for the replica to be sent and throws if it was not
+     */
+    void addPendingReplica(const boost::function<void()>& waiter);
+
     /**
      * Acknowledge processing of the last replication job from this instance on sourceId
      * @param sourceId instance ID where the replicas originated on this instance
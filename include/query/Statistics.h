@@ -64,6 +64,8 @@ public:
     volatile uint64_t writtenChunks; /**< A number of written chunks to disk */
     volatile uint64_t readSize; /**< A number of read bytes from disk */
     volatile  uint64_t readChunks; /**< A number of read chunks from disk */
+    volatile uint64_t spilledSize; /**< A number of bytes of temporary chunks spilled to disk */
+    volatile uint64_t spilledChunks; /**< A number of temporary chunks spilled to disk */
 
     // cache
     volatile uint64_t pinnedSize;  /**< A number of pinned bytes */
@@ -76,6 +78,7 @@ public:
     Statistics(): executionTime(0),
         sentSize(0), sentMessages(0), receivedSize(0), receivedMessages(0),
         writtenSize(0), writtenChunks(0), readSize(0), readChunks(0),
+        spilledSize(0), spilledChunks(0),
         pinnedSize(0), pinnedChunks(0),
         allocatedSize(0), allocatedChunks(0)
     {
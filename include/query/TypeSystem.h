@@ -32,6 +32,7 @@
 #include <util/PointerRange.h>                           // For PointerRange
 #include <util/PluginObjects.h>                          // For PluginObjects
 #include <util/arena/Malloc.h>                           // For malloc() etc.
+#include <util/arena/PoolArena.h>                        // For getValuePool()
 #include <array/RLE.h>                                   // For RLEPayload
 #include <query/Value.h>                                 // For Value
 
@@ -545,7 +546,7 @@ inline void* Value::setSize(size_t n)
         {
             if (large(_size))                            // ....got allocation?
             {
-                _data = realloc(_data,n);                // .....reallocate it
+                _data = realloc(_data,_size,n);          // .....reallocate it
             }
             else                                         // ....no allocation
             {
@@ -772,54 +773,36 @@ inline size_t Value::getFootprint(size_t n)
 }
 
 /**
- *  Check the call to calloc() and throw an exception if out of memory.
+ *  Allocate 'n' zeroed bytes from the value pool, which throws an exception if
+ *  out of memory.
  */
 inline void* Value::calloc(size_t n)
 {
     assert(large(n));                                    // Data must be large
 
-    void* p = arena::calloc(n,1);                        // Delegate to calloc
-
-    if (p == 0)                                          // Allocation failed?
-    {
-        fail(SCIDB_LE_NO_MEMORY_FOR_VALUE);              // ...throw exception
-    }
-
-    return p;                                            // The new allocation
+    return memset(arena::getValuePool().malloc(n),0,n);  // Allocate and zero
 }
 
 /**
- *  Check the call to malloc() and throw an exception if out of memory.
+ *  Allocate 'n' bytes from the value pool, which throws an exception if out of
+ *  memory.
  */
 inline void* Value::malloc(size_t n)
 {
     assert(large(n));                                    // Data must be large
 
-    void* p = arena::malloc(n);                          // Delegate to malloc
-
-    if (p == 0)                                          // Allocation failed?
-    {
-        fail(SCIDB_LE_NO_MEMORY_FOR_VALUE);              // ...throw exception
-    }
-
-    return p;                                            // The new allocation
+    return arena::getValuePool().malloc(n);              // Delegate to pool
 }
 
 /**
- *  Check the call to realloc() and throw an exception if out of memory.
+ *  Resize the allocation of 'o' bytes at 'p' to 'n' bytes within the value
+ *  pool, which throws an exception if out of memory.
  */
-inline void* Value::realloc(void* p,size_t n)
+inline void* Value::realloc(void* p,size_t o,size_t n)
 {
-    assert(large(n) && p!=0);                            // Data must be large
-
-    void* v = arena::realloc(p,n);                       // Delegate to realloc
-
-    if (v == 0)                                          // Allocation failed?
-    {
-        fail(SCIDB_LE_NO_MEMORY_FOR_VALUE);              // ...throw exception
-    }
+    assert(large(n) && large(o) && p!=0);                // Data must be large
 
-    return v;                                            // The new allocation
+    return arena::getValuePool().reallocate(p,o,n);      // Delegate to pool
 }
 
 /**
@@ -834,7 +817,7 @@ inline void Value::reset()
 {
     if (large(_size))                                    // Has an allocation?
     {
-        arena::free(_data);                              // ...so free it now
+        arena::getValuePool().free(_data,_size);         // ...so free it now
     }
 }
 #pragma GCC diagnostic pop
@@ -119,6 +119,13 @@ public:                   // Output support
                     /// Given type and Value, return correctly formatted string.
                     std::string format(TypeId const& typeId, Value const& v) const;
 
+                    /**
+                     * Append the formatted Value to 'out', as format() returns it
+                     * but without building a string of its own, for the writers of
+                     * many values.
+                     */
+                    void format(TypeId const& typeId, Value const& v, std::string& out) const;
+
                     /**
                      * Set precision for TID_DOUBLE values, returning previous precision.
                      * @param p precision to set, if < 0 restore default
@@ -135,8 +142,8 @@ public:                   // Output support
                     std::string _options;
                     std::string _nullRepr;
                     std::string _nanRepr;
-                    void        quoteCstr(std::stringstream&, const char *) const;
-            static  void        tsvChar(std::stringstream&, char);
+                    void        quoteCstr(std::string&, const char *) const;
+            static  void        tsvChar(std::string&, char);
             };
 private:
             static  Formatter   s_defaultFormatter;
@@ -208,9 +215,9 @@ private:                  // Implementation
 private:                  // Implementation
     static  bool              small      (size_t n)      {return n<=sizeof(_data);}
     static  bool              large      (size_t n)      {return n> sizeof(_data);}
-    static  void*             calloc     (size_t);       // Wraps calloc()
-    static  void*             malloc     (size_t);       // Wraps malloc()
-    static  void*             realloc    (void*,size_t); // Wraps realloc()
+    static  void*             calloc     (size_t);       // From value pool
+    static  void*             malloc     (size_t);       // From value pool
+    static  void*             realloc    (void*,size_t,size_t);
     static  void              fail       (int);          // Throw exception
 
 private:                  // Representation
@@ -141,7 +141,17 @@ enum
     CONFIG_SKIP_CHUNKMAP_INTEGRITY_CHECK,
     CONFIG_ONLINE,
     CONFIG_OLD_OR_NEW_WINDOW,
-    CONFIG_AUTOCHUNK_MAX_SYNTHETIC_INTERVAL
+    CONFIG_AUTOCHUNK_MAX_SYNTHETIC_INTERVAL,
+    CONFIG_MEM_ARRAY_SPILL_COMPRESSION,
+    CONFIG_DATASTORE_COMPACTION_THRESHOLD,
+    CONFIG_CHUNKMAP_RECOVERY_THREADS,
+    CONFIG_ADMISSION_MEMORY_POOL,
+    CONFIG_QUERY_MEMORY_RESERVATION,
+    CONFIG_REPLICATION_BATCH_SIZE,
+    CONFIG_REPLICATION_WINDOW,
+    CONFIG_RESULT_CACHE_SIZE,
+    CONFIG_PLAN_CACHE_SIZE,
+    CONFIG_CHUNK_POOL_SIZE
 };
 
 enum RepartAlgorithm
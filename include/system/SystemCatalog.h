@@ -36,6 +36,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <list>
 #include <assert.h>
 #include <memory>
@@ -489,6 +490,19 @@ public:
      */
     std::shared_ptr<ArrayDesc> getArrayDesc(const ArrayID id);
 
+    /**
+     * Returns the metadata of several arrays, and the ids of their oldest
+     * versions, looked up together in a single catalog transaction.
+     * Arrays that do not exist are left out of both results.
+     * @param[in] ids array identifiers
+     * @param[out] descs Array descriptors of the arrays found, by ID
+     * @param[out] oldestVersions array id of the oldest version of each array
+     *             found, or 0 if it has no versions
+     */
+    void getArrayDescs(const std::set<ArrayID>& ids,
+                       std::map<ArrayID, std::shared_ptr<ArrayDesc> >& descs,
+                       std::map<ArrayID, ArrayID>& oldestVersions);
+
     /**
      * Get the Universal array id (UAID) and version Id (vid) given an arrayName and arrayId
      * @param[in] arrayName Array name
@@ -792,6 +806,11 @@ private:  // Methods
 
 
     std::shared_ptr<ArrayDesc> _getArrayDesc(const ArrayID id);
+    std::shared_ptr<ArrayDesc> _getArrayDesc(const ArrayID id,
+                                             pqxx::basic_transaction* tr);
+    void _getArrayDescs(const std::set<ArrayID>& ids,
+                        std::map<ArrayID, std::shared_ptr<ArrayDesc> >& descs,
+                        std::map<ArrayID, ArrayID>& oldestVersions);
     bool _deleteArrayByName(const std::string &array_name);
     bool _deleteArrayVersions(const std::string &array_name, const VersionID array_version);
     void _deleteArrayById(const ArrayID id);
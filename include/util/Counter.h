@@ -57,6 +57,7 @@ namespace scidb
             MemArrayChunkWrite = 0,
             MemArrayChunkRead,
             MemArrayCleanSwap,
+            AdmissionWait,
             LastCounter             // This entry must be last!
         };
 
@@ -111,6 +112,7 @@ namespace scidb
                 _names[MemArrayChunkWrite] = "MemArrayChunkWrite";
                 _names[MemArrayChunkRead] = "MemArrayChunkRead";
                 _names[MemArrayCleanSwap] = "MemArrayCleanSwap";
+                _names[AdmissionWait] = "AdmissionWait";
             }
 
     private:
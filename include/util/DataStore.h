@@ -34,6 +34,7 @@
 #include <dirent.h>
 #include <map>
 #include <set>
+#include <vector>
 #include <util/FileIO.h>
 #include <util/Mutex.h>
 #include <boost/function.hpp>
@@ -72,6 +73,18 @@ public:
      */
     off_t allocateSpace(size_t requestedSize, size_t& allocatedSize);
 
+    /**
+     * Find space for the chunk of indicated size in an existing free
+     * extent that lies entirely below the given offset.  Used to relocate
+     * chunks towards the start of the file when compacting it.
+     * @param requestedSize minimum required size
+     * @param limit the allocation must end at or before this offset
+     * @param allocatedSize actual allocated size
+     * @returns offset of the allocation, or -1 if no free extent fits
+     * @throws SystemException on error
+     */
+    off_t allocateSpaceBelow(size_t requestedSize, off_t limit, size_t& allocatedSize);
+
     /**
      * Write bytes to the DataStore, to a location that is already
      * allocated
@@ -103,13 +116,24 @@ public:
 
     /**
      * Mark chunk as free both in the free lists and on
-     * disk
+     * disk.  The space is only given back to the file system
+     * by the next call to releaseFreedSpace()
      * @param off Location of chunk to free
      * @param allocated Allocated size of chunk in file
      * @throws SystemException on error
      */
     void freeChunk(off_t off, size_t allocated);
 
+    /**
+     * Give the space of the chunks freed so far back to the file
+     * system: truncate a free tail and punch holes in the freed
+     * extents that are still free.  The caller must first make sure
+     * that nothing on disk refers to those chunks any more, as the
+     * data is destroyed
+     * @throws SystemException on error
+     */
+    void releaseFreedSpace();
+
     /**
      * Return the size of the data store
      * @param filesize Out param size of the store in bytes
@@ -120,6 +144,14 @@ public:
                   blkcnt_t& fileblocks,
                   off_t& filefree) const;
 
+    /**
+     * Return fragmentation information about the free space
+     * @param nextents Out param number of free extents in the file
+     * @param largest Out param size in bytes of the largest free extent
+     */
+    void getFreeExtentStats(size_t& nextents,
+                            size_t& largest) const;
+
     /**
      * Return the guid
      */
@@ -158,10 +190,32 @@ public:
 private:
     friend class DataStores;
 
+    /* Allocations are multiples of the granule, which is also the unit
+       in which space is returned to the file system.  Up to the linear
+       limit every multiple of the granule is a size class; above it there
+       are SIZE_CLASSES_PER_DOUBLING classes between powers of two, which
+       bounds the padding of an allocation at 1/8 of its size.
+     */
+    static const size_t ALLOC_GRANULE = 4096;
+    static const size_t SIZE_CLASS_LINEAR_LIMIT = 64 * 1024;
+    static const size_t SIZE_CLASSES_PER_DOUBLING = 8;
+
+    /* Freed regions at least this large are punched out of the file
+     */
+    static const size_t PUNCH_HOLE_MIN_SIZE = 64 * 1024;
+
     /* Round up size_t value to next power of two
      */
     static size_t roundUpPowerOf2(size_t size);
 
+    /* Round up size_t value to the next allocation size class
+     */
+    static size_t roundUpSizeClass(size_t size);
+
+    /* Return the allocation size needed to hold a chunk of the requested size
+     */
+    size_t getRequiredSize(size_t requestedSize);
+
     /* Persist free lists to disk
        @pre caller has locked the DataStore
        @throws system exception on error
@@ -193,14 +247,29 @@ private:
     void removeOnClose()
         { _file->removeOnClose(); }
 
-    /* Iterate the free lists and find a free chunk of the requested size
+    /* Find the best fitting free extent for a chunk of the requested size,
+       splitting off and keeping the remainder
        @pre caller has locked the DataStore
      */
     off_t searchFreelist(size_t request);
 
-    /* Add block to free list and try to consolidate buddy blocks
+    /* Add region to the free lists, merging it with any free extents it
+       overlaps or abuts
+     */
+    void addToFreelist(size_t size, off_t off);
+
+    /* Insert / remove a free extent in both the size and offset indexes
      */
-    void addToFreelist(size_t bucket, off_t off);
+    void insertFreeExtent(off_t off, size_t size);
+    void removeFreeExtent(off_t off, size_t size);
+
+    /* Truncate the file if it ends in a free extent
+     */
+    void releaseTail();
+
+    /* Return the aligned interior of a freed region to the file system
+     */
+    void punchHole(off_t off, size_t size);
 
     /* Verify the freelist, but with lock already held
      */
@@ -214,19 +283,20 @@ private:
      */
     void calcLargestFreeChunk();
 
-    /* Check whether any parent blocks are on the freelist
-     */
-    bool isParentBlockFree(off_t off, size_t size);
-
     /* Dump the free list to the log for debug
      */
     void dumpFreelist();
 
     /* Free lists for data store
-       power-of-two ---->  set of offsets
+       extent size ---->  set of offsets
      */
     typedef std::map< size_t, std::set<off_t> > DataStoreFreelists;
 
+    /* Free extents of the data store
+       offset ---->  extent size
+     */
+    typedef std::map< off_t, size_t > DataStoreExtents;
+
     /* Header that prepends all chunks on disk
      */
     class DiskChunkHeader
@@ -286,11 +356,14 @@ private:
     Guid                       _guid;             // unique id for this store
     File::FilePtr              _file;             // handle for data file
     mutable DataStoreFreelists _freelists;        // free blocks in the data file
+    DataStoreExtents           _freeExtents;      // the same blocks, by offset
     uint64_t                   _frees;            // counter used to track calls to free
     size_t                     _largestFreeChunk; // size of the biggest chunk in free list
     size_t                     _allocatedSize;    // size of the store including free blks
     bool                       _dirty;            // unflushed data is present
     bool                       _fldirty;          // fl data differs from fl data on-disk
+    bool                       _punchHoles;       // file system supports hole punching
+    std::vector<std::pair<off_t, size_t> > _freed; // extents freed since the last release
 };
 
 
@@ -384,9 +457,11 @@ public:
 
     /**
      * Flush all DataStore objects
+     * @param releaseFreedSpace also give the space freed in each store back
+     *        to the file system, see DataStore::releaseFreedSpace()
      * @throws user exception on error
      */
-    void flushAllDataStores();
+    void flushAllDataStores(bool releaseFreedSpace = false);
 
     /**
      * Clear all datastore files from the basepath
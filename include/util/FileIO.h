@@ -244,6 +244,16 @@ namespace scidb
          */
         int ftruncate(off_t len);
 
+        /**
+         * Deallocate a range of the file, keeping its size (restarting
+         * after signal interrupt if necessary)
+         * @param offs start of the range
+         * @param len length of the range
+         * @return 0 on success or -1 (errno is EOPNOTSUPP if the file
+         *         system cannot punch holes)
+         */
+        int punchHole(off_t offs, off_t len);
+
         /**
          * Set an advisory lock on the file (restarting after signal intr)
          * @param flc file lock structure pointer
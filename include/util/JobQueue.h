@@ -31,8 +31,10 @@
 #ifndef JOBQUEUE_H_
 #define JOBQUEUE_H_
 
-#include <list>
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <vector>
 
 #include <util/Job.h>
 #include <util/Mutex.h>
@@ -42,21 +44,78 @@
 namespace scidb
 {
 
+/**
+ * The queue of jobs executed by one or more ThreadPools.
+ *
+ * Jobs pushed by the pool threads themselves go to a per-worker deque, so
+ * that a fan-out of many small jobs does not make all workers contend on
+ * a single lock. Jobs pushed by any other thread go to a shared injection
+ * lane, and high priority jobs to a shared lane that is always checked
+ * first. An idle worker takes work from the high priority lane, its own
+ * deque, the injection lane, and finally steals from the other workers.
+ */
 class JobQueue
 {
+public:
+    /// Per-worker counters, see getWorkerStats()
+    struct WorkerStats
+    {
+        uint64_t popped;   ///< jobs taken from the queue
+        uint64_t stolen;   ///< jobs taken from another worker's deque
+        uint64_t idle;     ///< times the worker found the queue empty and slept
+    };
+
 private:
-    std::list< std::shared_ptr<Job> > _queue;
-    Mutex _queueMutex;
-    Semaphore _queueSemaphore;
+    struct Worker
+    {
+        Mutex mutex;
+        std::deque< std::shared_ptr<Job> > jobs;
+        std::atomic<size_t> size;  // lets thieves skip empty deques without locking
+        std::atomic<uint64_t> popped;
+        std::atomic<uint64_t> stolen;
+        std::atomic<uint64_t> idle;
+
+        Worker() : size(0), popped(0), stolen(0), idle(0) {}
+    };
+
+    /// Workers beyond this number just use the shared lanes
+    static const size_t MAX_WORKERS = 256;
+
+    /// A worker checks the shared lane before its own deque every so many jobs,
+    /// so that jobs injected from outside are not starved by a busy worker.
+    static const size_t SHARED_LANE_INTERVAL = 32;
+
+    std::unique_ptr<Worker> _workers[MAX_WORKERS];
+    std::atomic<size_t> _nWorkers;
+    Mutex _registerMutex;
+
+    std::deque< std::shared_ptr<Job> > _highPriorityQueue;
+    std::deque< std::shared_ptr<Job> > _queue;
+    std::atomic<size_t> _sharedSize;  // jobs in both shared lanes
+    Mutex _queueMutex;                // protects the shared lanes
+
+    std::atomic<size_t> _size;
+    Semaphore _queueSemaphore;        // one unit per queued job
+
+    Worker* getLocalWorker() const;
+    bool popShared(std::shared_ptr<Job>& job, bool highPriorityOnly);
+    bool popLocal(Worker& worker, std::shared_ptr<Job>& job);
+    bool steal(Worker* self, std::shared_ptr<Job>& job);
 
 public:
     JobQueue();
 
     size_t getSize() const
     {
-        return _queue.size();
+        return _size;
     }
 
+    /**
+     * Make the calling thread a worker of this queue. Jobs it pushes are
+     * then kept in its own deque. Called by the ThreadPool threads.
+     */
+    void registerWorker();
+
     /// Add new job to the end of queue
     void pushJob(std::shared_ptr<Job> job);
 
@@ -68,6 +127,11 @@ public:
      * If there is next element the method waits
      */
     std::shared_ptr<Job> popJob();
+
+    /**
+     * @param stats [out] the counters of every registered worker
+     */
+    void getWorkerStats(std::vector<WorkerStats>& stats) const;
 };
 
 } // namespace
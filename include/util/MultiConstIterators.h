@@ -132,6 +132,30 @@ public:
      */
     void getIDsAtMinPosition(std::vector<size_t>& IDs);
 
+    /**
+     * Move the inputIters that are before a given position to that position or beyond,
+     * leaving the other inputIters alone.
+     * @param newPos   the position to reach or exceed.
+     * @param advance  a functor called with each inputIter before newPos, which must move it to newPos or beyond.
+     */
+    template<class Advance>
+    void advanceToAtLeast(Coordinates const& newPos, Advance& advance)
+    {
+        std::vector<size_t> IDs;
+        while (!_coordinatesAndIDs.empty() && coordinatesCompare(_coordinatesAndIDs.begin()->_coord, newPos) < 0) {
+            IDs.push_back(_coordinatesAndIDs.begin()->_ID);
+            _coordinatesAndIDs.erase(_coordinatesAndIDs.begin());
+        }
+        for (std::vector<size_t>::const_iterator it = IDs.begin(); it != IDs.end(); ++it) {
+            std::shared_ptr<ConstIterator>& inputIter = _inputIters[ *it ];
+            advance(*inputIter);
+            if (! inputIter->end()) {
+                assert(coordinatesCompare(inputIter->getPosition(), newPos) >= 0);
+                _coordinatesAndIDs.insert(CoordinatesAndID(inputIter->getPosition(), *it));
+            }
+        }
+    }
+
     /**
      * true if ALL the input iterators have ended.
      */
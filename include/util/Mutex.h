@@ -159,6 +159,26 @@ public:
 	}
 };
 
+/***
+ * RAII class for temporarily releasing a Mutex held by the current thread,
+ * e.g. around disk I/O. The mutex must be held exactly once (it is recursive).
+ */
+class ScopedMutexUnlock
+{
+private:
+	Mutex& _mutex;
+public:
+	ScopedMutexUnlock(Mutex& mutex): _mutex(mutex)
+	{
+		_mutex.checkForDeadlock();
+		_mutex.unlock();
+	}
+	~ScopedMutexUnlock()
+	{
+		_mutex.lock();
+	}
+};
+
 
 } //namespace
 
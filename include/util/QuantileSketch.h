@@ -0,0 +1,365 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * QuantileSketch.h
+ *
+ *      Description: Mergeable sketch for approximate quantiles and ranks
+ */
+
+#ifndef QUANTILE_SKETCH_H_
+#define QUANTILE_SKETCH_H_
+
+/*
+ * We use here the KLL sketch by Z. Karnin, K. Lang, E. Liberty (2016),
+ * "Optimal Quantile Approximation in Streams", https://arxiv.org/abs/1603.05346,
+ * in the lazy form of its reference implementation.
+ */
+
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <utility>
+#include <vector>
+
+namespace scidb
+{
+
+/**
+ * A sketch of a stream of doubles from which any quantile, or the rank of
+ * any value, can be estimated, and which can be merged with the sketch of
+ * another stream.  With the default k of 200 the rank error is well under
+ * 1% of the number of values, whatever that number is, for a few hundred items.
+ *
+ * The items are kept in levels: an item of level h stands for 2^h values of
+ * the stream.  When the sketch is full, the lowest level over its capacity
+ * is sorted and every other item of it moves one level up.
+ *
+ * The sketch lives in a buffer owned by the caller, so that it can be kept
+ * as the state of an aggregate: a Header followed by the items.  The levels
+ * are stored top level first, so that the new values land at the end.  The
+ * caller grows the buffer (preserving its content) whenever isFull() says
+ * so, or before a merge.
+ */
+class QuantileSketch
+{
+public:
+    static const uint32_t DEFAULT_K = 200;
+    static const uint32_t MAX_LEVELS = 64;
+    static const uint32_t MIN_WIDTH = 8;     // smallest level capacity
+    static const uint32_t INITIAL_CAPACITY = 16;
+
+    struct Header
+    {
+        uint32_t k;
+        uint32_t nLevels;
+        uint32_t size;      // items held
+        uint32_t capacity;  // items the buffer has room for
+        uint32_t maxSize;   // the sketch compacts when size reaches it
+        uint32_t reserved;
+        uint64_t count;     // values seen
+        uint64_t random;    // state of the coin flips of the compactions
+        double   min;
+        double   max;
+        uint32_t levelSize[MAX_LEVELS];
+    };
+
+    /// View the sketch in 'buf', which init() has set up
+    explicit QuantileSketch(void const* buf)
+    : _hdr(static_cast<Header*>(const_cast<void*>(buf))),
+      _items(reinterpret_cast<double*>(_hdr + 1))
+    {
+        assert(_hdr->nLevels > 0 && _hdr->nLevels <= MAX_LEVELS);
+    }
+
+    /// @return the size of a buffer for 'capacity' items
+    static size_t getBytes(size_t capacity)
+    {
+        return sizeof(Header) + capacity * sizeof(double);
+    }
+
+    /// Set up an empty sketch in the 'bytes' of 'buf'
+    static void init(void* buf, size_t bytes, uint32_t k = DEFAULT_K)
+    {
+        assert(bytes >= getBytes(1));
+        Header* hdr = static_cast<Header*>(buf);
+        memset(hdr, 0, sizeof(Header));
+        hdr->k = k < MIN_WIDTH ? uint32_t(MIN_WIDTH) : k;
+        hdr->nLevels = 1;
+        hdr->capacity = static_cast<uint32_t>((bytes - sizeof(Header)) / sizeof(double));
+        hdr->maxSize = getLevelCapacity(hdr->k, 1, 0);
+        hdr->random = 0x5C1DB;
+    }
+
+    /// Record that the buffer has grown to 'bytes'
+    void setBytes(size_t bytes)
+    {
+        assert(bytes >= getBytes(_hdr->size));
+        _hdr->capacity = static_cast<uint32_t>((bytes - sizeof(Header)) / sizeof(double));
+    }
+
+    /// @return the number of items held
+    size_t getSize() const
+    {
+        return _hdr->size;
+    }
+
+    /// @return the number of items the buffer has room for
+    size_t getCapacity() const
+    {
+        return _hdr->capacity;
+    }
+
+    /// @return the number of values seen, by this sketch and those merged into it
+    uint64_t getCount() const
+    {
+        return _hdr->count;
+    }
+
+    /// @return true if the buffer must grow before the next update()
+    bool isFull() const
+    {
+        return _hdr->size >= _hdr->capacity;
+    }
+
+    /// @return the size the buffer must have before 'other' is merged in
+    size_t getBytesToMerge(QuantileSketch const& other) const
+    {
+        return getBytes(_hdr->size + other._hdr->size);
+    }
+
+    /// Add a value; the buffer must not be full, and the value not a NaN
+    void update(double v)
+    {
+        assert(!isFull());
+        assert(v == v);
+        if (_hdr->count == 0) {
+            _hdr->min = _hdr->max = v;
+        } else {
+            _hdr->min = std::min(_hdr->min, v);
+            _hdr->max = std::max(_hdr->max, v);
+        }
+        ++_hdr->count;
+        _items[_hdr->size++] = v;
+        ++_hdr->levelSize[0];
+        while (_hdr->size >= _hdr->maxSize) {
+            compress();
+        }
+    }
+
+    /// Add the values of 'other'; the buffer must have getBytesToMerge(other) bytes
+    void merge(QuantileSketch const& other)
+    {
+        assert(_hdr != other._hdr);
+        Header const& src = *other._hdr;
+        if (src.count == 0) {
+            return;
+        }
+        assert(_hdr->capacity >= _hdr->size + src.size);
+        if (_hdr->count == 0) {
+            _hdr->min = src.min;
+            _hdr->max = src.max;
+        } else {
+            _hdr->min = std::min(_hdr->min, src.min);
+            _hdr->max = std::max(_hdr->max, src.max);
+        }
+        _hdr->count += src.count;
+
+        while (_hdr->nLevels < src.nLevels) {
+            grow();
+        }
+        // Append each level of 'other' to the same level here, top level first,
+        // so that only the items of the levels below have to move
+        for (uint32_t h = src.nLevels; h-- > 0; ) {
+            size_t const m = src.levelSize[h];
+            if (m == 0) {
+                continue;
+            }
+            size_t const end = getOffset(h) + _hdr->levelSize[h];
+            memmove(_items + end + m, _items + end, (_hdr->size - end) * sizeof(double));
+            memcpy(_items + end, other._items + other.getOffset(h), m * sizeof(double));
+            _hdr->levelSize[h] += static_cast<uint32_t>(m);
+            _hdr->size += static_cast<uint32_t>(m);
+        }
+        while (_hdr->size >= _hdr->maxSize) {
+            compress();
+        }
+    }
+
+    /**
+     * @return an estimate of the q-quantile of the values, 0 <= q <= 1:
+     * the smallest value with at least q * getCount() values up to it
+     */
+    double getQuantile(double q) const
+    {
+        assert(_hdr->count > 0);
+        if (q <= 0) {
+            return _hdr->min;
+        }
+        if (q >= 1) {
+            return _hdr->max;
+        }
+        std::vector<std::pair<double, uint64_t> > weighted;
+        weighted.reserve(_hdr->size);
+        for (uint32_t h = 0, offset = 0; h < _hdr->nLevels; ++h) {
+            uint32_t const level = _hdr->nLevels - 1 - h; // top level first
+            for (uint32_t i = 0; i < _hdr->levelSize[level]; ++i) {
+                weighted.push_back(std::make_pair(_items[offset + i], uint64_t(1) << level));
+            }
+            offset += _hdr->levelSize[level];
+        }
+        std::sort(weighted.begin(), weighted.end());
+
+        double const target = q * static_cast<double>(_hdr->count);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < weighted.size(); ++i) {
+            seen += weighted[i].second;
+            if (static_cast<double>(seen) >= target) {
+                return weighted[i].first;
+            }
+        }
+        return _hdr->max;
+    }
+
+    /// @return an estimate of the number of values less than or equal to v
+    uint64_t getRank(double v) const
+    {
+        if (_hdr->count == 0 || v < _hdr->min) {
+            return 0;
+        }
+        if (v >= _hdr->max) {
+            return _hdr->count;
+        }
+        uint64_t rank = 0;
+        for (uint32_t h = 0, offset = 0; h < _hdr->nLevels; ++h) {
+            uint32_t const level = _hdr->nLevels - 1 - h;
+            uint64_t n = 0;
+            for (uint32_t i = 0; i < _hdr->levelSize[level]; ++i) {
+                n += (_items[offset + i] <= v);
+            }
+            rank += n << level;
+            offset += _hdr->levelSize[level];
+        }
+        return std::min(rank, _hdr->count);
+    }
+
+private:
+    /// @return the capacity of 'level' in a sketch of 'nLevels' levels
+    static uint32_t getLevelCapacity(uint32_t k, uint32_t nLevels, uint32_t level)
+    {
+        // (2/3)^depth, for every depth a sketch can have
+        static std::vector<double> const scale = makeScale();
+        assert(level < nLevels);
+        double const c = ceil(k * scale[nLevels - 1 - level]);
+        return c < MIN_WIDTH ? uint32_t(MIN_WIDTH) : static_cast<uint32_t>(c);
+    }
+
+    static std::vector<double> makeScale()
+    {
+        std::vector<double> scale(MAX_LEVELS);
+        for (uint32_t d = 0; d < MAX_LEVELS; ++d) {
+            scale[d] = pow(2.0 / 3.0, static_cast<double>(d));
+        }
+        return scale;
+    }
+
+    /// @return the position of the first item of 'level'
+    size_t getOffset(uint32_t level) const
+    {
+        size_t offset = 0;
+        for (uint32_t h = level + 1; h < _hdr->nLevels; ++h) {
+            offset += _hdr->levelSize[h];
+        }
+        return offset;
+    }
+
+    /// Add an empty top level, which goes in front of the others
+    void grow()
+    {
+        assert(_hdr->nLevels < MAX_LEVELS);
+        _hdr->levelSize[_hdr->nLevels++] = 0;
+        uint32_t maxSize = 0;
+        for (uint32_t h = 0; h < _hdr->nLevels; ++h) {
+            maxSize += getLevelCapacity(_hdr->k, _hdr->nLevels, h);
+        }
+        _hdr->maxSize = maxSize;
+    }
+
+    /// @return a fair coin flip
+    bool flip()
+    {
+        uint64_t x = _hdr->random;
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        _hdr->random = x;
+        return (x >> 32) & 1;
+    }
+
+    /**
+     * Compact the lowest level that is at or over its capacity: sort it and
+     * move every other item of it, starting at random, one level up.  With an
+     * odd number of items the smallest one stays behind.
+     */
+    void compress()
+    {
+        uint32_t h = 0;
+        while (_hdr->levelSize[h] < getLevelCapacity(_hdr->k, _hdr->nLevels, h)) {
+            ++h;
+            assert(h < _hdr->nLevels);
+        }
+        if (h + 1 == _hdr->nLevels) {
+            grow();
+        }
+        size_t const offset = getOffset(h);
+        size_t const s = _hdr->levelSize[h];
+        double* const level = _items + offset;
+        std::sort(level, level + s);
+
+        size_t const odd = s % 2;
+        size_t const pairs = s / 2;
+        double const smallest = level[0];
+        size_t const first = odd + (flip() ? 1 : 0);
+        // The survivors go to the front, where they join the level above
+        for (size_t i = 0; i < pairs; ++i) {
+            level[i] = level[first + 2 * i];
+        }
+        if (odd) {
+            level[pairs] = smallest;
+        }
+        size_t const tail = _hdr->size - (offset + s);
+        memmove(level + pairs + odd, level + s, tail * sizeof(double));
+
+        _hdr->levelSize[h + 1] += static_cast<uint32_t>(pairs);
+        _hdr->levelSize[h] = static_cast<uint32_t>(odd);
+        _hdr->size -= static_cast<uint32_t>(pairs);
+    }
+
+    Header* _hdr;
+    double* _items;
+};
+
+} // namespace scidb
+
+#endif /* QUANTILE_SKETCH_H_ */
@@ -31,6 +31,7 @@
 #define SPATIALTYPE_H_
 
 #include <vector>
+#include <utility>
 #include <assert.h>
 #include <array/RLE.h>
 
@@ -174,7 +175,7 @@ public:
      * Every newly added SpatialRange object will have numDims dimensions.
      */
     SpatialRanges(size_t numDims)
-    : _numDims(numDims)
+    : _numDims(numDims), _indexedSize(0), _numLeafNodes(0)
     {}
 
     /**
@@ -208,6 +209,86 @@ public:
      * @param[inout] hint  the index to look first; will be changed to the index in _ranges (successful search), or -1.
      */
     bool findOneThatContains(SpatialRange const& queryRange, size_t& hint) const;
+
+    /**
+     * Append to another SpatialRanges object all the stored ranges that intersect a query range.
+     * E.g. with the range of a chunk as the query range, the cells of the chunk only need to be
+     * looked up in the result, rather than in all the stored ranges.
+     * @param queryRange  the query range.
+     * @param[out] result  the SpatialRanges object to append to.
+     */
+    void findAllThatIntersect(SpatialRange const& queryRange, SpatialRanges& result) const;
+
+    /**
+     * Bulk-load an R-tree over the stored ranges, which the find methods use from then on
+     * instead of scanning all the ranges.
+     * The ranges are packed with Sort-Tile-Recursive, and are reordered in _ranges along the way.
+     * @note Call it after the last range is added. Until it is called again, a range added
+     *       after it is only found through a linear scan.
+     */
+    void buildIndex();
+
+private:
+    /**
+     * How many children an R-tree node has, except for the last node of a level.
+     */
+    static const size_t NODE_SIZE = 16;
+
+    /**
+     * The deepest R-tree a search can descend, which NODE_SIZE^MAX_DEPTH ranges would not fill.
+     */
+    static const size_t MAX_DEPTH = 16;
+
+    /**
+     * The number of ranges the R-tree was built over; 0 if there is no R-tree.
+     */
+    size_t _indexedSize;
+
+    /**
+     * The bounding boxes of the R-tree nodes: for every node, the _numDims low coordinates
+     * followed by the _numDims high coordinates.
+     * The leaf nodes come first, then the nodes of every upper level, and the root is the last.
+     */
+    std::vector<Coordinate> _nodeBounds;
+
+    /**
+     * For every R-tree node, the first and one past the last of its children, which are
+     * indices in _ranges for a leaf node, and node indices otherwise.
+     */
+    std::vector<std::pair<size_t, size_t> > _nodeChildren;
+
+    /**
+     * The number of leaf nodes.
+     */
+    size_t _numLeafNodes;
+
+    /**
+     * @return whether the R-tree is up to date with _ranges.
+     */
+    bool isIndexed() const
+    {
+        return _indexedSize != 0 && _indexedSize == _ranges.size();
+    }
+
+    /**
+     * Sort the ranges in [begin, end) by the centers of dimension dim, cut them into slabs, and
+     * sort every slab the same way by the next dimension.
+     */
+    void sortTiles(size_t begin, size_t end, size_t dim);
+
+    /**
+     * Append an R-tree node over the children in [begin, end).
+     */
+    void addNode(size_t begin, size_t end, bool isLeaf);
+
+    /**
+     * Descend the R-tree into the nodes that may hold a range intersecting (or, if 'containing',
+     * containing) the box [low, high], and call visit() with the index of every such range until
+     * it returns true.
+     * @return whether visit() returned true.
+     */
+    template<class Visitor>
+    bool search(Coordinate const* low, Coordinate const* high, bool containing, Visitor& visit) const;
 };
 
 }
@@ -49,6 +49,10 @@ namespace scidb { namespace arena {
  *              is still available by calling available(),  and can also catch
  *              the exception if they attempt to allocate beyond this limit.
  *
+ *              The limit can later be changed with setLimit(), which is how
+ *              a query's memory reservation is applied to its arena once the
+ *              query has been admitted.
+ *
  *              Alternatively, one can also write:
  *  @code
  *                  b = newArena(Options("B").limited(a,1*GB));
@@ -86,6 +90,7 @@ class LimitedArena : public Arena
 
  public:                   // Operations
     virtual void              reset();
+            void              setLimit(size_t);
 
  public:                   // Implementation
     virtual void*             doMalloc(size_t);
@@ -96,7 +101,7 @@ class LimitedArena : public Arena
 
  protected:                // Representation
        std::string      const _name;                     // The arena name
-            size_t      const _limit;                    // The preset limit
+            size_t            _limit;                    // The preset limit
             ArenaPtr    const _parent;                   // The parent arena
             size_t            _available;                // Bytes available
             size_t            _allocated;                // Bytes allocated
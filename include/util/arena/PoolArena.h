@@ -0,0 +1,132 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef UTIL_ARENA_POOL_ARENA_H_
+#define UTIL_ARENA_POOL_ARENA_H_
+
+/****************************************************************************/
+
+#include <atomic>                                        // For atomic
+#include <memory>                                        // For unique_ptr
+#include <string>                                        // For string
+#include <util/Arena.h>                                  // For Arena
+
+/****************************************************************************/
+namespace scidb { namespace arena {
+/****************************************************************************/
+/**
+ *  @brief      A recycling %arena that keeps the blocks it is given back in
+ *              size classes, for reuse by the next allocation of the class.
+ *
+ *  @details    Class PoolArena rounds each request up to one of a set of size
+ *              classes - four to each power of two, so that less than a fifth
+ *              of any but the smallest block is wasted - and allocates it from
+ *              its parent the first time. Blocks returned with doFree() are
+ *              then kept on a free list of their class rather than handed back
+ *              to the parent, and satisfy the next request of the same class
+ *              without ever going near the system allocator.
+ *
+ *              The free lists are split into stripes, each with its own mutex,
+ *              and every thread frees to, and first allocates from, a stripe
+ *              of its own, so that threads seldom contend. A thread finding
+ *              its own stripe empty takes a block from the other stripes, and
+ *              only then from the parent. The stripes are not tied to the NUMA
+ *              nodes of the machine.
+ *
+ *              The blocks held on the free lists are bounded by a cache limit,
+ *              shared equally among the stripes: a block freed to a stripe that
+ *              already holds its share is released to the parent at once. The
+ *              counters of the pool are kept by stripe too, and summed when
+ *              read. Requests larger than o.pagesize() bypass the pool, and are
+ *              reallocated in place by the system allocator when the parent is
+ *              the root %arena. For example:
+ *  @code
+ *                  PoolArena p(Options("P").pagesize(1*MiB),64*MiB);
+ *  @endcode
+ *              creates a pool 'p' of blocks of at most a mebibyte that holds
+ *              on to at most 64 MiB of them when they are not in use.
+ *
+ *              The pool only needs the size of a block when it is returned, so
+ *              clients that know it call malloc() and free() directly, saving
+ *              the header that allocate() and recycle() would put on it.
+ */
+class PoolArena : public Arena
+{
+ public:                   // Construction
+                              PoolArena(const Options&,size_t cacheLimit);
+    virtual                  ~PoolArena();
+
+ public:                   // Attributes
+    virtual name_t            name()               const {return _name.c_str();}
+    virtual ArenaPtr          parent()             const {return _parent;}
+    virtual size_t            allocated()          const;
+    virtual size_t            peakusage()          const;
+    virtual size_t            allocations()        const;
+    virtual features_t        features()           const;
+    virtual void              insert(std::ostream&)const;
+            size_t            cacheLimit()         const {return _cacheLimit.load();}
+            size_t            cached()             const;
+            size_t            hits()               const;
+            size_t            misses()             const;
+            size_t            released()           const;
+
+ public:                   // Operations
+    virtual void              reset();
+            void              setCacheLimit(size_t);
+            void*             reallocate(void*,size_t,size_t);
+
+ public:                   // Implementation
+    virtual void*             doMalloc(size_t);
+    virtual void              doFree  (void*,size_t);
+
+ protected:                // Implementation
+    struct                    Stripe;                    // A set of lists
+    static  size_t            classOf(size_t);           // Size to class
+    static  size_t            sizeOf (size_t);           // Class to size
+            Stripe&           stripe()             const;// This thread's
+            size_t            sum(std::atomic<size_t> Stripe::*) const;
+            void              sample();                  // Update the peak
+            void*             take   (size_t);           // Take from lists
+            void              trim   (size_t);           // Release to limit
+            bool              consistent()         const;
+
+ protected:                // Representation
+       std::string      const _name;                     // The arena name
+            ArenaPtr    const _parent;                   // The parent arena
+            size_t      const _maxBlock;                 // The largest class
+            size_t      const _nClasses;                 // Number of classes
+  std::unique_ptr<Stripe[]>   _stripes;                  // The free lists
+  std::unique_ptr<std::atomic<size_t>[]> _counts;        // Blocks per class
+       std::atomic<size_t>    _cacheLimit;               // Most bytes cached
+       std::atomic<size_t>    _peakusage;                // High water mark
+};
+
+/****************************************************************************/
+
+PoolArena&                    getChunkPool();            // Chunk buffers
+PoolArena&                    getValuePool();            // Value var-parts
+
+/****************************************************************************/
+}}
+/****************************************************************************/
+#endif
+/****************************************************************************/
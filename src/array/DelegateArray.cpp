@@ -722,4 +722,88 @@ void MaterializedArray::materialize(const std::shared_ptr<Query>& query,
         return new MaterializedArray::ArrayIterator(*(MaterializedArray*)this, id, inputArray->getConstIterator(id), _format);
     }
 
+
+    //
+    // RLE chunk data
+    //
+
+    RLEChunkData::RLEChunkData(ConstChunk const& chunk)
+    : _chunk(chunk.isMaterialized() ? &chunk : chunk.materialize()),
+      _pin(*_chunk)
+    {
+        char* data = static_cast<char*>(_chunk->getData());
+        if (_chunk->getAttributeDesc().isEmptyIndicator()) {
+            _bitmap = std::make_shared<ConstRLEEmptyBitmap>(data);
+            return;
+        }
+        _payload.reset(new ConstRLEPayload(data));
+        if (_payload->packedSize() < _chunk->getSize()) {
+            // The empty bitmap is attached to the payload
+            _bitmap = std::make_shared<ConstRLEEmptyBitmap>(data + _payload->packedSize());
+        } else {
+            _bitmap = _chunk->getEmptyBitmap();
+        }
+        if (!_bitmap) {
+            if (_chunk->getArrayDesc().getEmptyBitmapAttribute() != NULL) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "getEmptyBitmap";
+            }
+            _bitmap = std::make_shared<RLEEmptyBitmap>(
+                static_cast<position_t>(_chunk->getNumberOfElements(true)));
+        }
+    }
+
+    void RLEChunkData::select(ConstRLEEmptyBitmap const& cells,
+                              Array const& array,
+                              AttributeID attrID,
+                              MemChunk& result) const
+    {
+        AttributeDesc const& attr = array.getArrayDesc().getAttributes()[attrID];
+        bool const isBitmap = attr.isEmptyIndicator();
+        assert(isBitmap || _payload);
+
+        std::shared_ptr<RLEEmptyBitmap> bitmap = std::make_shared<RLEEmptyBitmap>();
+        bitmap->reserve(cells.nSegments());
+        RLEPayload payload(TypeLibrary::getType(attr.getType()));
+        std::unique_ptr<RLEPayload::append_iterator> appender;
+        ConstRLEPayload::iterator values;
+        if (!isBitmap) {
+            appender.reset(new RLEPayload::append_iterator(&payload));
+            values = ConstRLEPayload::iterator(_payload.get());
+        }
+
+        // The payload is gathered in the order of the cells, which renumbers them
+        position_t pPosition = 0;
+        for (size_t i = 0, n = cells.nSegments(); i < n; ++i) {
+            ConstRLEEmptyBitmap::Segment segment = cells.getSegment(i);
+            if (appender) {
+                if (!values.setPosition(segment._pPosition)) {
+                    throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+                }
+                uint64_t remaining = segment._length;
+                while (remaining != 0) {
+                    remaining -= appender->add(values, remaining);
+                }
+            }
+            segment._pPosition = pPosition;
+            bitmap->addSegment(segment);
+            pPosition += segment._length;
+        }
+
+        Address addr(attrID, _chunk->getFirstPosition(false));
+        result.initialize(&array, &array.getArrayDesc(), addr, _chunk->getCompressionMethod());
+        if (isBitmap) {
+            result.allocate(bitmap->packedSize());
+            bitmap->pack(static_cast<char*>(result.getData()));
+        } else {
+            appender->flush();
+            result.allocate(payload.packedSize() + bitmap->packedSize());
+            payload.pack(static_cast<char*>(result.getData()));
+            bitmap->pack(static_cast<char*>(result.getData()) + payload.packedSize());
+            result.setEmptyBitmap(bitmap);
+        }
+        if (!array.getArrayDesc().hasOverlap()) {
+            result.setCount(bitmap->count());
+        }
+    }
+
 }
@@ -61,14 +61,18 @@ namespace scidb
     //
 
     MemArray::MemArray(ArrayDesc const& arr, std::shared_ptr<Query> const& query)
-    : desc(arr)
+    : desc(arr),
+      _spilledSize(0),
+      _spilledChunks(0)
     {
         _query=query;
         initLRU();
     }
 
     MemArray::MemArray(const std::shared_ptr<Array>& input, std::shared_ptr<Query> const& query, bool vertical)
-    : desc(input->getArrayDesc())
+    : desc(input->getArrayDesc()),
+      _spilledSize(0),
+      _spilledChunks(0)
     {
         _query=query;
         initLRU();
@@ -78,6 +82,10 @@ namespace scidb
     MemArray::~MemArray()
     {
         SharedMemCache::getInstance().cleanupArray(*this);
+        std::shared_ptr<Query> query(_query.lock());
+        if (query) {
+            reportSpills(*query);
+        }
     }
 
     void MemArray::initLRU()
@@ -91,8 +99,18 @@ namespace scidb
                           << ",  accessCount is " << chunk._accessCount
                           << "Array="<<(void*)this << ",  name '" << chunk.arrayDesc->getName());
         }
-        Query::getValidQueryPtr(_query);
+        std::shared_ptr<Query> query(Query::getValidQueryPtr(_query));
         SharedMemCache::getInstance().pinChunk(chunk);
+        reportSpills(*query);
+    }
+
+    void MemArray::reportSpills(Query& query)
+    {
+        uint64_t chunks = _spilledChunks.exchange(0);
+        if (chunks != 0) {
+            query.statistics.spilledChunks += chunks;
+            query.statistics.spilledSize += _spilledSize.exchange(0);
+        }
     }
 
     void MemArray::unpinChunk(LruMemChunk& chunk)
@@ -166,18 +184,88 @@ namespace scidb
         _swapNum(0),
         _loadsNum(0),
         _dropsNum(0),
-        _genCount(0)
+        _spilledSize(0),
+        _spilledRawSize(0),
+        _genCount(0),
+        _spillCompressionMethod(CompressorFactory::NO_COMPRESSION),
+        _spillRequested(false),
+        _spillerRunning(false)
     {
     }
 
     /* Initialize the datastores used for the temporary disk storage needed
-       by mem arrays.
+       by mem arrays and start the background spill writer.
      */
-    void SharedMemCache::initSharedMemCache(uint64_t memThreshold, const char* basePath)
+    void SharedMemCache::initSharedMemCache(uint64_t memThreshold,
+                                            const char* basePath,
+                                            int compressionMethod)
     {
         _usedMemThreshold = memThreshold;
+        _spillCompressionMethod = compressionMethod;
         _datastores.initDataStores(basePath);
         _datastores.clearAllDataStores();
+        startSpiller();
+    }
+
+    void SharedMemCache::startSpiller()
+    {
+        ScopedMutexLock cs(_mutex);
+        if (_spillerRunning) {
+            return;
+        }
+        _spillerRunning = true;
+        _spillRequested = false;
+        if (!_spillThreadPool) {
+            _spillQueue = std::make_shared<JobQueue>();
+            _spillThreadPool = std::make_shared<ThreadPool>(1, _spillQueue);
+            _spillThreadPool->start();
+        }
+        _spillJob = std::make_shared<SpillJob>(*this);
+        _spillQueue->pushJob(_spillJob);
+    }
+
+    void SharedMemCache::stopSpiller()
+    {
+        std::shared_ptr<SpillJob> job;
+        std::shared_ptr<ThreadPool> threadPool;
+        {
+            ScopedMutexLock cs(_mutex);
+            if (!_spillerRunning) {
+                return;
+            }
+            _spillerRunning = false;
+            _spillNeeded.signal();
+            job.swap(_spillJob);
+            threadPool.swap(_spillThreadPool);
+            _spillQueue.reset();
+        }
+        if (!job->wait()) {
+            LOG4CXX_ERROR(logger, "SharedMemCache: error stopping the spill writer");
+        }
+        threadPool->stop();
+    }
+
+    /* Main loop of the background spill writer
+     */
+    void SharedMemCache::SpillJob::run()
+    {
+        ScopedMutexLock cs(_cache._mutex);
+        while (true) {
+            Event::ErrorChecker noopEc;
+            while (_cache._spillerRunning && !_cache._spillRequested) {
+                _cache._spillNeeded.wait(_cache._mutex, noopEc);
+            }
+            if (!_cache._spillerRunning) {
+                return;
+            }
+            _cache._spillRequested = false;
+            try {
+                _cache.spill(_cache.getLowWatermark());
+            } catch (Exception const& e) {
+                // The victim stays in memory; the next unpin will retry
+                LOG4CXX_ERROR(logger, "SharedMemCache: background spill failed: " << e.what());
+            }
+        }
     }
 
     /*
@@ -188,27 +276,64 @@ namespace scidb
      *  If a chunk is pinned, it could be accessed, or modified. We know nothing about its real "size". We only know "_sizeAtLastUnPin".
      *  _usedMemSize is the sum of the sizes of all the pinned chunks AND all the chunks on the LRU.
      * -AP 1/30/13
+     *
+     *  A chunk being spilled is neither on the LRU nor pinned, and its size is no longer in _usedMemSize.
+     *  A chunk being loaded is pinned and its size is already in _usedMemSize.
+     *  In both cases _ioInProgress is set and _mutex is not held while the data moves.
      */
 
+    void SharedMemCache::waitForChunkIo(LruMemChunk& chunk)
+    {
+        // this function must be called under _mutex lock
+        Event::ErrorChecker noopEc;
+        while (chunk._ioInProgress) {
+            _ioComplete.wait(_mutex, noopEc);
+        }
+    }
+
     void SharedMemCache::pinChunk(LruMemChunk &chunk)
     {
         ScopedMutexLock cs(_mutex);
+        waitForChunkIo(chunk);
         if (chunk._accessCount++ == 0) {
             chunk._sizeAtLastUnPin = chunk.size;  //mostly redundant. just in case someone is doing something clever
             if (chunk.getConstData() == NULL) {
-                if (_usedMemSize > _usedMemThreshold) {
-                    swapOut();
+                // Other threads pinning this chunk must wait until its data is back
+                chunk._ioInProgress = (chunk.size != 0);
+                try {
+                    if (_usedMemSize > _usedMemThreshold) {
+                        spill(getSpillTarget());
+                    }
+                    if (chunk.size != 0) {
+                        assert(chunk._dsOffset >= 0);
+                        const MemArray* array = (const MemArray*)chunk.array;
+                        assert(array->_datastore);
+                        std::shared_ptr<DataStore> ds = array->_datastore;
+                        chunk.reallocate(chunk.size);
+                        assert(chunk.getConstData());
+                        _usedMemSize += chunk.size;
+                        try {
+                            ScopedMutexUnlock unlock(_mutex);
+                            readChunk(chunk, ds);
+                        } catch (...) {
+                            _usedMemSize -= chunk.size;
+                            chunk.free();
+                            throw;
+                        }
+                        ++_loadsNum;
+                        chunk.markClean();
+                    }
+                } catch (...) {
+                    --chunk._accessCount;
+                    if (chunk._ioInProgress) {
+                        chunk._ioInProgress = false;
+                        _ioComplete.signal();
+                    }
+                    throw;
                 }
-                if (chunk.size != 0) {
-                    assert(chunk._dsOffset >= 0);
-                    chunk.reallocate(chunk.size);
-                    assert(chunk.getConstData());
-                    const MemArray* array = (const MemArray*)chunk.array;
-                    assert(array->_datastore);
-                    ++_loadsNum;
-                    _usedMemSize += chunk.size;
-                    array->_datastore->readData(chunk._dsOffset, chunk.getData(), chunk.size);
-                    chunk.markClean();
+                if (chunk._ioInProgress) {
+                    chunk._ioInProgress = false;
+                    _ioComplete.signal();
                 }
             } else {
                 assert(!chunk.isEmpty());
@@ -237,17 +362,38 @@ namespace scidb
                 chunk._sizeAtLastUnPin = chunk.size;
                 assert(chunk.isEmpty());
                 chunk.pushToLru();
-                if (_usedMemSize > _usedMemThreshold) {
-                    swapOut();
-                }
+                checkMemUsage();
             }
         }
     }
 
+    void SharedMemCache::checkMemUsage()
+    {
+        // this function must be called under _mutex lock
+        if (_usedMemSize > _usedMemThreshold || !_spillerRunning) {
+            // The writer is not keeping up (or not running): the caller pays
+            try {
+                spill(getSpillTarget());
+            } catch (Exception const& e) {
+                // unpin must not fail, the chunk simply stays in memory
+                LOG4CXX_ERROR(logger, "SharedMemCache: spill failed: " << e.what());
+            }
+        } else if (_usedMemSize > getHighWatermark() && !_spillRequested) {
+            _spillRequested = true;
+            _spillNeeded.signal();
+        }
+    }
+
     void SharedMemCache::swapOut()
+    {
+        ScopedMutexLock cs(_mutex);
+        spill(_usedMemThreshold);
+    }
+
+    void SharedMemCache::spill(uint64_t targetSize)
     {
         // this function must be called under _mutex lock
-        while (!_theLru.empty() && _usedMemSize > _usedMemThreshold) {
+        while (!_theLru.empty() && _usedMemSize > targetSize) {
 
             LruMemChunk* victim = NULL;
             bool popped = _theLru.pop(victim);
@@ -256,42 +402,100 @@ namespace scidb
             assert(victim->_accessCount == 0);
             assert(victim->getConstData() != NULL);
             assert(!victim->isEmpty());
+            assert(!victim->_ioInProgress);
             victim->prune();
             _usedMemSize -= victim->size; //victim is not pinned, so the size is correct
-            if (victim->isDirty())
-            {
-                MemArray* array = (MemArray*)victim->array;
-                if (!array->_datastore) {
-                    array->_datastore = _datastores.getDataStore(_genCount++);
-                }
-                size_t overhead = array->_datastore->getOverhead();
-                if (victim->_dsOffset < 0 || (victim->_dsAlloc - overhead < victim->size)) {
-                    if (victim->_dsOffset >= 0)
-                    {
-                        LOG4CXX_TRACE(logger, "SharedMemCache::swapOut : freeing chunk at offset " <<
-                                      victim->_dsOffset);
-                        array->_datastore->freeChunk(victim->_dsOffset, victim->_dsAlloc);
-                    }
-                    victim->_dsOffset = array->_datastore->allocateSpace(victim->size, victim->_dsAlloc);
-                }
-                array->_datastore->writeData(victim->_dsOffset,
-                                             victim->getData(),
-                                             victim->size,
-                                             victim->_dsAlloc);
-                ++_swapNum;
-            }
-            else
+            if (!victim->isDirty())
             {
                 ++_dropsNum;
+                victim->free();
+                continue;
             }
+
+            MemArray* array = (MemArray*)victim->array;
+            if (!array->_datastore) {
+                array->_datastore = _datastores.getDataStore(_genCount++);
+            }
+            std::shared_ptr<DataStore> ds = array->_datastore;
+            size_t written = 0;
+            victim->_ioInProgress = true;
+            try {
+                ScopedMutexUnlock unlock(_mutex);
+                written = writeVictim(*victim, ds);
+            } catch (...) {
+                // the data is still intact, put the chunk back
+                victim->_ioInProgress = false;
+                _usedMemSize += victim->size;
+                victim->pushToLru();
+                _ioComplete.signal();
+                throw;
+            }
+            victim->_ioInProgress = false;
             victim->free();
+            ++_swapNum;
+            _spilledSize += written;
+            _spilledRawSize += victim->size;
+            array->_spilledSize += written;
+            ++array->_spilledChunks;
+            _ioComplete.signal();
         }
         SCIDB_ASSERT(sizeCoherent());
     }
 
+    size_t SharedMemCache::writeVictim(LruMemChunk& victim, std::shared_ptr<DataStore> const& ds)
+    {
+        // this function is called without _mutex, the victim is guarded by _ioInProgress
+        char const* image = static_cast<char const*>(victim.getConstData());
+        size_t imageSize = victim.size;
+        std::vector<char> compressed;
+        if (_spillCompressionMethod != CompressorFactory::NO_COMPRESSION) {
+            compressed.resize(victim.size);
+            Compressor* compressor = CompressorFactory::getInstance().getCompressors()[_spillCompressionMethod];
+            size_t compressedSize = compressor->compress(&compressed[0], victim, victim.size);
+            if (compressedSize < victim.size) {
+                image = &compressed[0];
+                imageSize = compressedSize;
+            }
+        }
+
+        size_t overhead = ds->getOverhead();
+        if (victim._dsOffset < 0 || (victim._dsAlloc - overhead < imageSize)) {
+            if (victim._dsOffset >= 0)
+            {
+                LOG4CXX_TRACE(logger, "SharedMemCache::writeVictim : freeing chunk at offset " <<
+                              victim._dsOffset);
+                ds->freeChunk(victim._dsOffset, victim._dsAlloc);
+                ds->releaseFreedSpace();
+            }
+            victim._dsOffset = ds->allocateSpace(imageSize, victim._dsAlloc);
+        }
+        ds->writeData(victim._dsOffset,
+                      image,
+                      imageSize,
+                      victim._dsAlloc);
+        victim._dsSize = imageSize;
+        return imageSize;
+    }
+
+    void SharedMemCache::readChunk(LruMemChunk& chunk, std::shared_ptr<DataStore> const& ds)
+    {
+        // this function is called without _mutex, the chunk is guarded by _ioInProgress
+        if (chunk._dsSize == chunk.size) {
+            ds->readData(chunk._dsOffset, chunk.getData(), chunk.size);
+            return;
+        }
+        std::vector<char> compressed(chunk._dsSize);
+        ds->readData(chunk._dsOffset, &compressed[0], chunk._dsSize);
+        Compressor* compressor = CompressorFactory::getInstance().getCompressors()[_spillCompressionMethod];
+        if (compressor->decompress(&compressed[0], chunk._dsSize, chunk) != chunk.size) {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+        }
+    }
+
     void SharedMemCache::deleteChunk(LruMemChunk &chunk)
     {
         ScopedMutexLock cs(_mutex);
+        waitForChunkIo(chunk);
         assert(chunk._accessCount == 0);
         chunk.removeFromLru();
     }
@@ -303,6 +507,7 @@ namespace scidb
              i != array._chunks.end(); i++)
         {
             LruMemChunk &chunk = i->second;
+            waitForChunkIo(chunk);
             if (chunk.getConstData() != NULL) {
                 //chunk could be pinned or just on the LRU.
                 _usedMemSize -= chunk._sizeAtLastUnPin;
@@ -411,7 +616,7 @@ namespace scidb
         curr = _array._chunks.find(addr);
         positioned = true;
         if (curr != last) {
-            currChunk = &_array._chunks[addr];
+            currChunk = &curr->second;
             return true;
         } else {
             return false;
@@ -34,6 +34,7 @@
 #include <util/Platform.h>
 #include <array/MemArray.h>
 #include <system/Exceptions.h>
+#include <util/arena/PoolArena.h>
 
 #ifndef SCIDB_CLIENT
 #include <system/Config.h>
@@ -225,11 +226,9 @@ namespace scidb
     void MemChunk::reallocate(size_t newSize)
     {
         assert(newSize>0);
-        void* tmp = ::realloc(data, newSize);
-        if (!tmp) {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_NO_MEMORY, SCIDB_LE_CANT_REALLOCATE_MEMORY);
-        }
-        data = tmp;
+        // The chunk pool throws when out of memory, and keeps freed buffers
+        // for the next chunk of the same size class
+        data = arena::getChunkPool().reallocate(data, size, newSize);
         size = newSize;
     }
 
@@ -238,7 +237,9 @@ namespace scidb
         if (isDebug() && data) {
             memset(data, 0, size);
         }
-        ::free(data);
+        if (data) {
+            arena::getChunkPool().free(data, size);
+        }
         data = NULL;
     }
 
@@ -369,6 +370,8 @@ namespace scidb
     {
         _dsOffset = -1;
         _dsAlloc = 0;
+        _dsSize = 0;
+        _ioInProgress = false;
         _accessCount = 0;
         _sizeAtLastUnPin = 0;
     }
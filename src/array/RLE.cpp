@@ -39,17 +39,127 @@ namespace scidb
         uint64_t* magic = static_cast<uint64_t*>(chunk.getData());
 
         SCIDB_ASSERT(magic != 0);
-        SCIDB_ASSERT(*magic == (chunk.getAttributeDesc().isEmptyIndicator() ?
-                          RLE_EMPTY_BITMAP_MAGIC :
-                          RLE_PAYLOAD_MAGIC));
+        SCIDB_ASSERT(chunk.getAttributeDesc().isEmptyIndicator() ?
+                     ConstRLEEmptyBitmap::isPacked(reinterpret_cast<char const*>(magic)) :
+                     *magic == RLE_PAYLOAD_MAGIC);
+    }
+
+    namespace {
+
+    /// @return the number of bytes of the LEB128 encoding of v
+    inline size_t varintSize(uint64_t v)
+    {
+        size_t n = 1;
+        while (v >= 0x80) {
+            v >>= 7;
+            ++n;
+        }
+        return n;
+    }
+
+    /// Write the LEB128 encoding of v at dst, return the end of it
+    inline char* putVarint(char* dst, uint64_t v)
+    {
+        while (v >= 0x80) {
+            *dst++ = static_cast<char>(v | 0x80);
+            v >>= 7;
+        }
+        *dst++ = static_cast<char>(v);
+        return dst;
+    }
+
+    /// Read a LEB128 encoded value at src into v, return the end of it
+    inline char const* getVarint(char const* src, uint64_t& v)
+    {
+        v = 0;
+        for (unsigned shift = 0; ; shift += 7) {
+            uint8_t b = static_cast<uint8_t>(*src++);
+            v |= uint64_t(b & 0x7F) << shift;
+            if (!(b & 0x80)) {
+                return src;
+            }
+        }
+    }
+
+    } // namespace
+
+    size_t ConstRLEEmptyBitmap::sparseBodySize() const
+    {
+        size_t size = 0;
+        position_t end = 0;
+        position_t rank = 0;
+        for (size_t i = 0; i < _nSegs; ++i) {
+            Segment const& s = _seg[i];
+            if (s._pPosition != rank || s._lPosition < end || s._length < 0) {
+                return 0;
+            }
+            size += varintSize(s._lPosition - end) + varintSize(s._length);
+            end = s._lPosition + s._length;
+            rank += s._length;
+        }
+        return size;
+    }
+
+    size_t ConstRLEEmptyBitmap::packedSize() const
+    {
+        if (_packedSize == 0) {
+            size_t const segsSize = _nSegs*sizeof(Segment);
+            size_t const sparseSize = sparseBodySize();
+            _packedSize = sizeof(Header) +
+                ((sparseSize != 0 && sparseSize*SPARSE_PACKING_RATIO <= segsSize) ? sparseSize : segsSize);
+        }
+        return _packedSize;
     }
 
     void ConstRLEEmptyBitmap::pack(char* dst) const {
         Header* hdr = (Header*)dst;
-        hdr->_magic = RLE_EMPTY_BITMAP_MAGIC;
         hdr->_nSegs = _nSegs;
         hdr->_nNonEmptyElements = _nNonEmptyElements;
-        memcpy(hdr+1, _seg, _nSegs*sizeof(Segment));
+        if (packedSize() == sizeof(Header) + _nSegs*sizeof(Segment)) {
+            hdr->_magic = RLE_EMPTY_BITMAP_MAGIC;
+            memcpy(hdr+1, _seg, _nSegs*sizeof(Segment));
+        } else {
+            hdr->_magic = RLE_EMPTY_BITMAP_SPARSE_MAGIC;
+            char* p = reinterpret_cast<char*>(hdr+1);
+            position_t end = 0;
+            for (size_t i = 0; i < _nSegs; ++i) {
+                p = putVarint(p, _seg[i]._lPosition - end);
+                p = putVarint(p, _seg[i]._length);
+                end = _seg[i]._lPosition + _seg[i]._length;
+            }
+            assert(p == dst + packedSize());
+        }
+    }
+
+    bool ConstRLEEmptyBitmap::unpack(char const* src)
+    {
+        Header const* hdr = (Header const*)src;
+        assert(isPacked(src));
+        _nSegs = hdr->_nSegs;
+        _nNonEmptyElements = hdr->_nNonEmptyElements;
+        if (hdr->_magic == RLE_EMPTY_BITMAP_MAGIC) {
+            _seg = (Segment const*)(hdr+1);
+            return true;
+        }
+
+        _unpacked.resize(_nSegs);
+        char const* p = reinterpret_cast<char const*>(hdr+1);
+        position_t end = 0;
+        position_t rank = 0;
+        for (size_t i = 0; i < _nSegs; ++i) {
+            uint64_t gap, length;
+            p = getVarint(p, gap);
+            p = getVarint(p, length);
+            Segment& s = _unpacked[i];
+            s._lPosition = end + gap;
+            s._length = length;
+            s._pPosition = rank;
+            end = s._lPosition + s._length;
+            rank += s._length;
+        }
+        _seg = _unpacked.empty() ? NULL : &_unpacked[0];
+        _packedSize = p - src;
+        return false;
     }
 
     ConstRLEEmptyBitmap::~ConstRLEEmptyBitmap()
@@ -59,17 +169,47 @@ namespace scidb
         }
     }
 
+    ConstRLEEmptyBitmap::ConstRLEEmptyBitmap(ConstRLEEmptyBitmap const& other)
+        : _nSegs(0)
+        , _seg(NULL)
+        , _nNonEmptyElements(0)
+        , _chunk(NULL)
+        , _chunkPinned(false)
+        , _packedSize(0)
+    {
+        *this = other;
+    }
+
+    ConstRLEEmptyBitmap& ConstRLEEmptyBitmap::operator=(ConstRLEEmptyBitmap const& other)
+    {
+        if (this != &other) {
+            if (_chunk && _chunkPinned) {
+                _chunk->unPin();
+            }
+            _chunk = NULL;
+            _chunkPinned = false;
+            _unpacked.assign(other._seg, other._seg + other._nSegs);
+            _nSegs = other._nSegs;
+            _seg = _unpacked.empty() ? NULL : &_unpacked[0];
+            _nNonEmptyElements = other._nNonEmptyElements;
+            _packedSize = other._packedSize;
+        }
+        return *this;
+    }
+
     ConstRLEEmptyBitmap::ConstRLEEmptyBitmap(ConstChunk const& bitmapChunk) : _chunk(NULL)
     {
         _chunkPinned = bitmapChunk.pin();
+        _packedSize = 0;
         char const* src = (char const*)bitmapChunk.getConstData();
         if (src != NULL) {
-            Header const* hdr = (Header const*)src;
-            assert(hdr->_magic == RLE_EMPTY_BITMAP_MAGIC);
-            _nSegs = hdr->_nSegs;
-            _nNonEmptyElements = hdr->_nNonEmptyElements;
-            _seg = (Segment const*)(hdr+1);
-            _chunk = &bitmapChunk;
+            if (unpack(src)) {
+                _chunk = &bitmapChunk;
+            } else if (_chunkPinned) {
+                // The segments were copied out, the chunk need not stay pinned
+                bitmapChunk.unPin();
+                _chunkPinned = false;
+            }
         } else {
             _nSegs = 0;
             _nNonEmptyElements = 0;
@@ -79,14 +219,10 @@ namespace scidb
     }
 
 
-    ConstRLEEmptyBitmap::ConstRLEEmptyBitmap(char const* src) : _chunk(NULL)
+    ConstRLEEmptyBitmap::ConstRLEEmptyBitmap(char const* src) : _chunk(NULL), _chunkPinned(false), _packedSize(0)
     {
         if (src != NULL) {
-            Header* hdr = (Header*)src;
-            assert(hdr->_magic == RLE_EMPTY_BITMAP_MAGIC);
-            _nSegs = hdr->_nSegs;
-            _nNonEmptyElements = hdr->_nNonEmptyElements;
-            _seg = (Segment*)(hdr+1);
+            unpack(src);
         } else {
             _nSegs = 0;
             _nNonEmptyElements = 0;
@@ -608,6 +744,98 @@ namespace scidb
         return replicator.result();
     }
 
+    /**
+     * Add the 'length' cells at 'lPosition' and 'pPosition' to 'segments',
+     * extending the last segment if they follow it.
+     */
+    static void addCells(vector<ConstRLEEmptyBitmap::Segment>& segments,
+                         position_t lPosition,
+                         position_t pPosition,
+                         position_t length)
+    {
+        if (!segments.empty() &&
+            segments.back()._lPosition + segments.back()._length == lPosition &&
+            segments.back()._pPosition + segments.back()._length == pPosition) {
+            segments.back()._length += length;
+        } else {
+            ConstRLEEmptyBitmap::Segment segment;
+            segment._lPosition = lPosition;
+            segment._pPosition = pPosition;
+            segment._length = length;
+            segments.push_back(segment);
+        }
+    }
+
+    static std::shared_ptr<RLEEmptyBitmap> makeBitmap(vector<ConstRLEEmptyBitmap::Segment> const& segments)
+    {
+        std::shared_ptr<RLEEmptyBitmap> result = std::make_shared<RLEEmptyBitmap>();
+        result->reserve(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            result->addSegment(segments[i]);
+        }
+        return result;
+    }
+
+    std::shared_ptr<RLEEmptyBitmap> ConstRLEEmptyBitmap::intersect(ConstRLEEmptyBitmap const& other) const
+    {
+        vector<Segment> segments;
+        segments.reserve(std::max(_nSegs, other._nSegs));
+        size_t i = 0, j = 0;
+        while (i < _nSegs && j < other._nSegs) {
+            Segment const& mine = _seg[i];
+            Segment const& theirs = other._seg[j];
+            position_t const myEnd = mine._lPosition + mine._length;
+            position_t const theirEnd = theirs._lPosition + theirs._length;
+            position_t const start = std::max(mine._lPosition, theirs._lPosition);
+            position_t const end = std::min(myEnd, theirEnd);
+            if (start < end) {
+                addCells(segments, start, mine._pPosition + start - mine._lPosition, end - start);
+            }
+            if (myEnd <= theirEnd) {
+                i += 1;
+            }
+            if (theirEnd <= myEnd) {
+                j += 1;
+            }
+        }
+        return makeBitmap(segments);
+    }
+
+    std::shared_ptr<RLEEmptyBitmap> ConstRLEEmptyBitmap::unite(ConstRLEEmptyBitmap const& other) const
+    {
+        vector<Segment> segments;
+        segments.reserve(_nSegs + other._nSegs);
+        size_t i = 0, j = 0;
+        position_t done = 0; // the cells before are in segments
+        while (i < _nSegs || j < other._nSegs) {
+            if (i < _nSegs && _seg[i]._lPosition + _seg[i]._length <= done) {
+                i += 1;
+                continue;
+            }
+            if (j < other._nSegs && other._seg[j]._lPosition + other._seg[j]._length <= done) {
+                j += 1;
+                continue;
+            }
+            position_t const myStart = i < _nSegs ? std::max(_seg[i]._lPosition, done) : 0;
+            position_t const theirStart = j < other._nSegs ? std::max(other._seg[j]._lPosition, done) : 0;
+            if (i < _nSegs && (j == other._nSegs || myStart <= theirStart)) {
+                Segment const& mine = _seg[i];
+                done = mine._lPosition + mine._length;
+                addCells(segments, myStart, mine._pPosition + myStart - mine._lPosition, done - myStart);
+                i += 1;
+            } else {
+                Segment const& theirs = other._seg[j];
+                position_t end = theirs._lPosition + theirs._length;
+                if (i < _nSegs) {
+                    end = std::min(end, myStart);
+                }
+                addCells(segments, theirStart, theirs._pPosition + theirStart - theirs._lPosition, end - theirStart);
+                done = end;
+            }
+        }
+        return makeBitmap(segments);
+    }
+
     RLEEmptyBitmap::RLEEmptyBitmap(ValueMap& vm, bool all)
     {
         Segment segm;
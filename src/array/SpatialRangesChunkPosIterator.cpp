@@ -34,6 +34,24 @@ using namespace boost;
 
 namespace scidb
 {
+namespace
+{
+/**
+ * Moves a RegionCoordinatesIterator to a position or beyond.
+ */
+struct AdvanceRawIterator
+{
+    Coordinates const& _newPos;
+
+    AdvanceRawIterator(Coordinates const& newPos) : _newPos(newPos) {}
+
+    void operator()(ConstIterator& rawIterator)
+    {
+        static_cast<RegionCoordinatesIterator&>(rawIterator).advanceToAtLeast(_newPos);
+    }
+};
+}
+
 SpatialRangesChunkPosIterator::SpatialRangesChunkPosIterator(std::shared_ptr<SpatialRanges> const& spatialRanges, ArrayDesc const& schema)
 : _numRanges(spatialRanges->_ranges.size()),
   _spatialRanges(spatialRanges),
@@ -107,18 +125,10 @@ bool SpatialRangesChunkPosIterator::advancePositionToAtLeast(Coordinates const&
         return false;
     }
 
-    // TO-DO: An optimization may be possible here.
-    // That is, call operator++() once, and return if the new position reaches newPos.
-    // If someone wants to explore the optimization, some performance study may be performed.
-    // --- Note from Donghui Z. 8/14/2014.
-
-    for (size_t i=0; i<_numRanges; ++i) {
-        if (!_rawIterators[i]) continue;
-        dynamic_pointer_cast<RegionCoordinatesIterator>(_rawIterators[i])->advanceToAtLeast(newPos);
-    }
-
-    // Note: the code below does not compile with make_shared.
-    _wrapperIterator = std::shared_ptr<MultiConstIterators>(new MultiConstIterators(_rawIterators));
+    // Only the rawIterators still before newPos move, so with many ranges, skipping ahead
+    // costs in proportion to the ranges left behind rather than to all of them.
+    AdvanceRawIterator advance(newPos);
+    _wrapperIterator->advanceToAtLeast(newPos, advance);
     return true;
 }
 
@@ -200,9 +200,11 @@ public:
         LOG4CXX_DEBUG(logger, "MemArray UnitTest Attempt [type=" << type << "][start=" << start << "][end=" << end <<
                       "][chunkInterval=" << chunkInterval << "][threshold=" << threshold << "]");
 
-        // Set the memarray threshold
+        // Set the memarray threshold; swaps and loads are only deterministic
+        // when the spill is done synchronously
         uint64_t currentThreshold = SharedMemCache::getInstance().getMemThreshold();
         SharedMemCache::getInstance().setMemThreshold(threshold * MiB);
+        SharedMemCache::getInstance().stopSpiller();
 
         try
         {
@@ -278,10 +280,12 @@ public:
         catch (...)
         {
             SharedMemCache::getInstance().setMemThreshold(currentThreshold);
+            SharedMemCache::getInstance().startSpiller();
             throw;
         }
 
         SharedMemCache::getInstance().setMemThreshold(currentThreshold);
+        SharedMemCache::getInstance().startSpiller();
 
         LOG4CXX_DEBUG(logger, "MemArray UnitTest Success [type=" << type << "][start=" <<
                       start << "][end=" << end << "][chunkInterval=" << chunkInterval <<
@@ -367,6 +367,16 @@ public:
         }
     }
 
+    void setParameters(QueryResult const& queryResult, std::shared_ptr<scidb_msg::Query> const& record) const
+    {
+        for (std::map<std::string, std::string>::const_iterator i = queryResult.parameters.begin();
+             i != queryResult.parameters.end(); ++i) {
+            scidb_msg::Query_Parameter* parameter = record->add_parameters();
+            parameter->set_name(i->first);
+            parameter->set_value(i->second);
+        }
+    }
+
     void prepareQuery(const std::string& queryString, bool afl, const std::string&, QueryResult& queryResult, void* connection) const
     {
         StatisticsScope sScope;
@@ -377,6 +387,7 @@ public:
         std::string programOptions;
         fillProgramOptions(programOptions);
         queryMessage->getRecord<scidb_msg::Query>()->set_program_options(programOptions);
+        setParameters(queryResult, queryMessage->getRecord<scidb_msg::Query>());
 
         LOG4CXX_TRACE(logger, "Send " << (afl ? "AFL" : "AQL") << " for preparation " << queryString);
 
@@ -427,6 +438,8 @@ public:
         std::string programOptions;
         fillProgramOptions(programOptions);
         queryMessage->getRecord<scidb_msg::Query>()->set_program_options(programOptions);
+        queryMessage->getRecord<scidb_msg::Query>()->set_memory_reservation(queryResult.memoryReservation);
+        setParameters(queryResult, queryMessage->getRecord<scidb_msg::Query>());
         queryMessage->setQueryID(queryResult.queryID);
 
         if (!queryResult.queryID.isValid()) {
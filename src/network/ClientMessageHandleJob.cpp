@@ -42,6 +42,7 @@
 
 #include <system/Exceptions.h>
 #include <system/Warnings.h>
+#include <query/PreparedPlanCache.h>
 #include <query/QueryProcessor.h>
 #include <network/NetworkManager.h>
 #include <network/MessageUtils.h>
@@ -116,6 +117,15 @@ string ClientMessageHandleJob::getProgramOptions(std::string const& programOptio
     return ip.str();
 }
 
+void ClientMessageHandleJob::getQueryParameters(scidb::QueryResult& queryResult) const
+{
+    std::shared_ptr<scidb_msg::Query> record = _messageDesc->getRecord<scidb_msg::Query>();
+    queryResult.parameters.clear();
+    for (int i = 0; i < record->parameters_size(); ++i) {
+        queryResult.parameters[record->parameters(i).name()] = record->parameters(i).value();
+    }
+}
+
 void
 ClientMessageHandleJob::executeSerially(std::shared_ptr<WorkQueue>& serialQueue,
                                         std::weak_ptr<WorkQueue>& initialQueue,
@@ -255,6 +265,16 @@ ClientMessageHandleJob::fetchChunk()
         }
 
         std::shared_ptr<MessageDesc> chunkMsg;
+        std::shared_ptr<CachedResultArray> cachedArray = std::dynamic_pointer_cast<CachedResultArray>(fetchArray);
+        if (cachedArray != NULL) {
+            // The chunks are sent as they were compressed for the first client
+            populateCachedClientChunk(arrayName, attributeId,
+                                      cachedArray->nextCachedChunk(attributeId), chunkMsg);
+            _query->validate();
+            _connection->sendMessage(chunkMsg);
+            return;
+        }
+
         std::shared_ptr< ConstArrayIterator> iter = fetchArray->getConstIterator(attributeId);
         if (!iter->end()) {
             const ConstChunk* chunk = &iter->getChunk();
@@ -391,6 +411,10 @@ void ClientMessageHandleJob::populateClientChunk(const std::string& arrayName,
         for (size_t i = 0; i < coordinates.size(); i++) {
             chunkRecord->add_coordinates(coordinates[i]);
         }
+        std::shared_ptr<QueryResultCapture> capture = _query->getResultCapture();
+        if (capture) {
+            capture->add(attributeId, coordinates, chunkRecord->count(), buffer);
+        }
     }
     else
     {
@@ -402,6 +426,10 @@ void ClientMessageHandleJob::populateClientChunk(const std::string& arrayName,
                       <<", arrayName= "<< arrayName
                       <<", attId="<< attributeId
                       <<", queryID="<<_query->getQueryID());
+        std::shared_ptr<QueryResultCapture> capture = _query->getResultCapture();
+        if (capture) {
+            capture->add(attributeId, Coordinates(), 0, std::shared_ptr<CompressedBuffer>());
+        }
     }
 
     if (_query->getWarnings().size())
@@ -423,6 +451,38 @@ void ClientMessageHandleJob::populateClientChunk(const std::string& arrayName,
     }
 }
 
+void ClientMessageHandleJob::populateCachedClientChunk(const std::string& arrayName,
+                                                       AttributeID attributeId,
+                                                       const QueryResultCache::Chunk* chunk,
+                                                       std::shared_ptr<MessageDesc>& chunkMsg)
+{
+    std::shared_ptr<scidb_msg::Chunk> chunkRecord;
+    if (chunk)
+    {
+        chunkMsg = std::make_shared<MessageDesc>(mtChunk, chunk->buffer);
+        chunkRecord = chunkMsg->getRecord<scidb_msg::Chunk>();
+        chunkRecord->set_eof(false);
+        chunkRecord->set_compression_method(chunk->buffer->getCompressionMethod());
+        chunkRecord->set_attribute_id(attributeId);
+        chunkRecord->set_decompressed_size(chunk->buffer->getDecompressedSize());
+        chunkRecord->set_count(chunk->count);
+        for (size_t i = 0; i < chunk->coordinates.size(); i++) {
+            chunkRecord->add_coordinates(chunk->coordinates[i]);
+        }
+    }
+    else
+    {
+        chunkMsg = std::make_shared<MessageDesc>(mtChunk);
+        chunkRecord = chunkMsg->getRecord<scidb_msg::Chunk>();
+        chunkRecord->set_eof(true);
+        LOG4CXX_DEBUG(logger, "ClientMessageHandleJob::populateCachedClientChunk: "
+                      << "Prepared EOF message of cached arrayName= " << arrayName
+                      << ", attId=" << attributeId
+                      << ", queryID=" << _query->getQueryID());
+    }
+    chunkMsg->setQueryID(_query->getQueryID());
+}
+
 void ClientMessageHandleJob::prepareClientQuery()
 {
     std::shared_ptr<Query> nullPtr;
@@ -445,6 +505,7 @@ void ClientMessageHandleJob::prepareClientQuery()
         const string queryString = record->query();
         bool afl = record->afl();
         const string programOptions = record->program_options();
+        getQueryParameters(queryResult);
 
         SCIDB_ASSERT(queryResult.queryID.isValid());
         try
@@ -618,6 +679,7 @@ void ClientMessageHandleJob::executeClientQuery()
         const string queryString = record->query();
         bool afl = record->afl();
         queryResult.queryID = _messageDesc->getQueryID();
+        getQueryParameters(queryResult);
 
         if (!queryResult.queryID.isValid()) {
             // make a query object
@@ -656,9 +718,10 @@ void ClientMessageHandleJob::executeClientQuery()
         }
         SCIDB_ASSERT(queryResult.queryID.isValid());
         std::shared_ptr<Query> query = Query::getQueryByID(queryResult.queryID);
-        SCIDB_ASSERT(query->queryString == queryString);
+        SCIDB_ASSERT(query->queryString == bindQueryParameters(queryString, queryResult.parameters));
         Query::setQueryPerThread(query);
 
+        queryResult.memoryReservation = record->memory_reservation();
         scidb.executeQuery(queryString, afl, queryResult);
 
         postExecuteQueryInternal(queryResult, query);
@@ -698,8 +761,9 @@ void ClientMessageHandleJob::retryExecuteQuery(scidb::QueryResult& queryResult)
         }
         SCIDB_ASSERT(queryResult.queryID.isValid());
         std::shared_ptr<Query> query = Query::getQueryByID(queryResult.queryID);
-        SCIDB_ASSERT(query->queryString == queryString);
+        SCIDB_ASSERT(query->queryString == bindQueryParameters(queryString, queryResult.parameters));
 
+        queryResult.memoryReservation = record->memory_reservation();
         scidb.executeQuery(queryString, afl, queryResult);
 
         postExecuteQueryInternal(queryResult, query);
@@ -41,6 +41,7 @@
 #include <util/Job.h>
 #include <network/proto/scidb_msg.pb.h>
 #include <array/Metadata.h>
+#include <query/QueryResultCache.h>
 #include "Connection.h"
 #include "MessageHandleJob.h"
 #include <usr_namespace/SecurityCommunicator.h>
@@ -82,6 +83,12 @@ class ClientMessageHandleJob : public MessageHandleJob
 
     std::string getProgramOptions(const std::string &programOptions) const;
 
+    /**
+     * Copy the values of the query parameters from the client message
+     * into queryResult.parameters
+     */
+    void getQueryParameters(scidb::QueryResult& queryResult) const;
+
     /**
      * Retrieve the combined user-name stored in the
      * session as a string.
@@ -141,6 +148,11 @@ class ClientMessageHandleJob : public MessageHandleJob
                              AttributeID attributeId,
                              const ConstChunk* chunk,
                              std::shared_ptr<MessageDesc>& chunkMsg);
+    /// Helper to construct an mtChunk message for the client from a cached result
+    void populateCachedClientChunk(const std::string& arrayName,
+                                   AttributeID attributeId,
+                                   const QueryResultCache::Chunk* chunk,
+                                   std::shared_ptr<MessageDesc>& chunkMsg);
     /**
      * Used to re-schedule fetchMergedChunk()
      */
@@ -33,6 +33,7 @@
 #include <network/NetworkManager.h>
 
 #include <array/DBArray.h>
+#include <query/AdmissionController.h>
 #include <query/Operator.h>
 #include <query/PullSGContext.h>
 #include <query/Query.h>
@@ -637,6 +638,9 @@ void ServerMessageHandleJob::handlePreparePhysicalPlan()
     queryProcessor->parsePhysical(physicalPlan, _query);
     LOG4CXX_DEBUG(logger,  funcName << "Physical plan was parsed")
 
+    // The coordinator has admitted the query: take its reservation as given
+    AdmissionController::getInstance()->reserve(_query, ppMsg->memory_reservation());
+
     handleExecutePhysicalPlan();
 }
 
@@ -770,23 +774,62 @@ void ServerMessageHandleJob::handleReplicaChunk()
         return;
     }
 
-    const int compMethod = chunkRecord->compression_method();
-    const size_t decompressedSize = chunkRecord->decompressed_size();
-    const AttributeID attributeID = chunkRecord->attribute_id();
-    const size_t count = chunkRecord->count();
-    Coordinates coordinates;
-    for (int i = 0; i < chunkRecord->coordinates_size(); i++) {
-        coordinates.push_back(chunkRecord->coordinates(i));
-    }
-
     std::shared_ptr<Array> dbArr = replicationCtx->getPersistentArray(arrId);
     assert(dbArr);
 
-    if(chunkRecord->tombstone())
+    if (chunkRecord->batch_size() == 0) {
+        Coordinates coordinates(chunkRecord->coordinates().begin(), chunkRecord->coordinates().end());
+        std::shared_ptr<CompressedBuffer> compressedBuffer =
+            dynamic_pointer_cast<CompressedBuffer>(_messageDesc->getBinary());
+        writeReplica(dbArr, chunkRecord->attribute_id(), coordinates, chunkRecord->tombstone(),
+                     chunkRecord->compression_method(), chunkRecord->decompressed_size(),
+                     chunkRecord->count(), compressedBuffer);
+        return;
+    }
+
+    // a batch: the binary holds the data of the replicas one after the other
+    std::shared_ptr<SharedBuffer> binary = _messageDesc->getBinary();
+    const char* data = binary ? static_cast<const char*>(binary->getData()) : NULL;
+    const size_t binarySize = binary ? binary->getSize() : 0;
+    size_t offset = 0;
+    for (int i = 0; i < chunkRecord->batch_size(); ++i) {
+        const scidb_msg::Chunk_Replica& replica = chunkRecord->batch(i);
+        const size_t size = replica.size();
+        if (offset + size > binarySize) {
+            stringstream ss;
+            ss << "Replica batch overruns its data by " << (offset + size - binarySize)
+               << " bytes from InstanceID="<<_messageDesc->getSourceInstanceID()
+               << " for QueryID="<<_query->getQueryID();
+            throw (SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNKNOWN_ERROR) << ss.str());
+        }
+        std::shared_ptr<CompressedBuffer> compressedBuffer;
+        if (size > 0) {
+            compressedBuffer = std::make_shared<CompressedBuffer>();
+            compressedBuffer->allocate(size);
+            memcpy(compressedBuffer->getData(), data + offset, size);
+            offset += size;
+        }
+        Coordinates coordinates(replica.coordinates().begin(), replica.coordinates().end());
+        writeReplica(dbArr, replica.attribute_id(), coordinates, replica.tombstone(),
+                     replica.compression_method(), replica.decompressed_size(),
+                     replica.count(), compressedBuffer);
+    }
+}
+
+void ServerMessageHandleJob::writeReplica(const std::shared_ptr<Array>& dbArr,
+                                          AttributeID attributeID,
+                                          const Coordinates& coordinates,
+                                          bool tombstone,
+                                          int compMethod,
+                                          size_t decompressedSize,
+                                          size_t count,
+                                          const std::shared_ptr<CompressedBuffer>& compressedBuffer)
+{
+    if(tombstone)
     { // tombstone record
         StorageManager::getInstance().removeLocalChunkVersion(dbArr->getArrayDesc(), coordinates, _query);
     }
-    else if (decompressedSize <= 0)
+    else if (decompressedSize <= 0 || !compressedBuffer)
     { // what used to be clone of replica
         assert(false);
         stringstream ss;
@@ -798,8 +841,6 @@ void ServerMessageHandleJob::handleReplicaChunk()
     else
     { // regular chunk
         std::shared_ptr<ArrayIterator> outputIter = dbArr->getIterator(attributeID);
-        std::shared_ptr<CompressedBuffer> compressedBuffer =
-            dynamic_pointer_cast<CompressedBuffer>(_messageDesc->getBinary());
         compressedBuffer->setCompressionMethod(compMethod);
         compressedBuffer->setDecompressedSize(decompressedSize);
         Chunk& outChunk = outputIter->newChunk(coordinates);
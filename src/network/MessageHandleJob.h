@@ -147,6 +147,15 @@ namespace scidb
         void handleBufferSend();
         void handleReplicaSyncResponse();
         void handleReplicaChunk();
+        /// write one replica received from another instance into dbArr
+        void writeReplica(const std::shared_ptr<Array>& dbArr,
+                          AttributeID attributeID,
+                          const Coordinates& coordinates,
+                          bool tombstone,
+                          int compMethod,
+                          size_t decompressedSize,
+                          size_t count,
+                          const std::shared_ptr<CompressedBuffer>& compressedBuffer);
         void handleInstanceStatus();
         void handleResourcesFileExists();
         void handleInvalidMessage();
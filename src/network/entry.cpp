@@ -27,14 +27,18 @@
  *      Author: roman.simakov@gmail.com
  */
 
+#include <query/AdmissionController.h>
 #include <query/FunctionLibrary.h>
 #include <query/OperatorLibrary.h>
+#include <query/PreparedPlanCache.h>
+#include <query/QueryResultCache.h>
 
 #include <log4cxx/logger.h>
 #include <log4cxx/basicconfigurator.h>
 #include <log4cxx/propertyconfigurator.h>
 #include <log4cxx/helpers/exception.h>
 
+#include <algorithm>
 #include <memory>
 #include <boost/asio.hpp>
 #include <boost/io/ios_state.hpp>
@@ -57,6 +61,7 @@
 #include "system/Config.h"
 #include "util/JobQueue.h"
 #include "util/ThreadPool.h"
+#include <array/Compressor.h>
 #include "system/Constants.h"
 #include "query/QueryProcessor.h"
 #include "util/PluginManager.h"
@@ -64,6 +69,7 @@
 #include "query/Parser.h"
 #include <util/InjectedError.h>
 #include <util/Utility.h>
+#include <util/arena/PoolArena.h>
 #include <smgr/io/ReplicationManager.h>
 #include <system/Utils.h>
 
@@ -212,8 +218,33 @@ void runSciDB()
    const size_t memThreshold = Config::getInstance()->getOption<size_t>(CONFIG_MEM_ARRAY_THRESHOLD);
    string memArrayBasePath = tmpDir + "/memarray";
 
-   SharedMemCache::getInstance().initSharedMemCache(memThreshold * MiB,
-                                                    memArrayBasePath.c_str());
+   const string spillCompressorName = cfg->getOption<string>(CONFIG_MEM_ARRAY_SPILL_COMPRESSION);
+   int spillCompressionMethod = -1;
+   if (spillCompressorName == "none") {
+       spillCompressionMethod = CompressorFactory::NO_COMPRESSION;
+   } else {
+       const vector<Compressor*>& compressors = CompressorFactory::getInstance().getCompressors();
+       for (size_t i = 0; i < compressors.size(); ++i) {
+           if (spillCompressorName == compressors[i]->getName()) {
+               spillCompressionMethod = safe_static_cast<int>(i);
+               break;
+           }
+       }
+   }
+   if (spillCompressionMethod < 0) {
+       throw USER_EXCEPTION(SCIDB_SE_CONFIG, SCIDB_LE_COMPRESSOR_DOESNT_EXIST) << spillCompressorName;
+   }
+
+   // The chunk buffers cached for reuse are not in any MemArray, so they are
+   // counted against the threshold by leaving them out of the cache's share
+   const size_t chunkPool = std::min(cfg->getOption<size_t>(CONFIG_CHUNK_POOL_SIZE), memThreshold / 2);
+   SharedMemCache::getInstance().initSharedMemCache((memThreshold - chunkPool) * MiB,
+                                                    memArrayBasePath.c_str(),
+                                                    spillCompressionMethod);
+   arena::getChunkPool().setCacheLimit(chunkPool * MiB);
+   AdmissionController::getInstance()->init();
+   QueryResultCache::getInstance()->init();
+   PreparedPlanCache::getInstance()->init();
 
    int largeMemLimit = cfg->getOption<int>(CONFIG_LARGE_MEMALLOC_LIMIT);
    if (largeMemLimit>0 && (0==mallopt(M_MMAP_MAX, largeMemLimit))) {
@@ -288,6 +319,7 @@ void runSciDB()
       if (messagesThreadPool) {
          messagesThreadPool->stop();
       }
+      SharedMemCache::getInstance().stopSpiller();
       StorageManager::getInstance().close();
       ReplicationManager::getInstance()->stop();
    }
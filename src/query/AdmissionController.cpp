@@ -0,0 +1,228 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/**
+ * @file AdmissionController.cpp
+ *
+ * @brief Admission of queries against a per-instance memory pool
+ */
+
+#include <query/AdmissionController.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/bind.hpp>
+#include <log4cxx/logger.h>
+
+#include <array/MemArray.h>
+#include <query/QueryPlan.h>
+#include <system/Config.h>
+#include <system/Constants.h>
+#include <util/Counter.h>
+#include <util/Timing.h>
+#include <util/arena/LimitedArena.h>
+
+using namespace std;
+
+namespace scidb
+{
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.qproc.admission"));
+
+namespace
+{
+    /// Two slabs of the query arena: anything less fails on the first allocation
+    const uint64_t MIN_RESERVATION = 128 * MiB;
+
+    uint64_t saturatingAdd(uint64_t a, uint64_t b)
+    {
+        return std::numeric_limits<uint64_t>::max() - a < b ?
+            std::numeric_limits<uint64_t>::max() : a + b;
+    }
+
+    /// @return the sum of the memory estimates of the operators of the subtree at 'node'
+    uint64_t estimateMemory(PhysNodePtr const& node, size_t nInstances)
+    {
+        uint64_t total = 0;
+        vector<PhysicalBoundaries> boundaries;
+        vector<PhysNodePtr>& children = node->getChildren();
+        for (size_t i = 0; i < children.size(); ++i) {
+            boundaries.push_back(children[i]->getBoundaries());
+            total = saturatingAdd(total, estimateMemory(children[i], nInstances));
+        }
+        return saturatingAdd(total, node->getPhysicalOperator()->getMemoryEstimate(
+                                 boundaries, node->getChildSchemas(), nInstances));
+    }
+}
+
+AdmissionController::AdmissionController()
+    : _pool(0),
+      _reserved(0),
+      _defaultReservation(MIN_RESERVATION),
+      _baseMemThreshold(0)
+{
+}
+
+void AdmissionController::init()
+{
+    Config* cfg = Config::getInstance();
+    int const pool = cfg->getOption<int>(CONFIG_ADMISSION_MEMORY_POOL);
+    int const maxMemory = cfg->getOption<int>(CONFIG_MAX_MEMORY_LIMIT);
+
+    ScopedMutexLock cs(_mutex);
+    if (pool > 0) {
+        _pool = uint64_t(pool) * MiB;
+    } else if (pool < 0 && maxMemory > 0) {
+        _pool = uint64_t(maxMemory) * MiB / 4 * 3;
+    } else {
+        _pool = 0;
+    }
+    _defaultReservation = std::max<uint64_t>(
+        cfg->getOption<size_t>(CONFIG_QUERY_MEMORY_RESERVATION) * MiB, MIN_RESERVATION);
+    _baseMemThreshold = SharedMemCache::getInstance().getMemThreshold();
+
+    if (_pool) {
+        LOG4CXX_INFO(logger, "Admission control: pool of " << _pool / MiB
+                     << " MiB, default reservation of " << _defaultReservation / MiB << " MiB");
+    } else {
+        LOG4CXX_INFO(logger, "Admission control is disabled");
+    }
+}
+
+uint64_t AdmissionController::getReservation(uint64_t declared,
+                                             PhysPlanPtr const& plan,
+                                             size_t nInstances) const
+{
+    if (!isEnabled()) {
+        return 0;
+    }
+    uint64_t bytes = 0;
+    if (declared) {
+        bytes = declared > std::numeric_limits<uint64_t>::max() / MiB ?
+            std::numeric_limits<uint64_t>::max() : declared * MiB;
+    } else {
+        bytes = _defaultReservation;
+        if (plan && plan->getRoot()) {
+            bytes = std::max(bytes, estimateMemory(plan->getRoot(), nInstances));
+        }
+    }
+    // A query larger than the whole pool runs alone rather than never
+    return std::min(std::max(bytes, MIN_RESERVATION), _pool);
+}
+
+void AdmissionController::admit(std::shared_ptr<Query> const& query, uint64_t bytes)
+{
+    if (bytes == 0 || query->getMemoryReservation() != 0) {
+        return;
+    }
+    QueryID const queryID = query->getQueryID();
+
+    ScopedMutexLock cs(_mutex);
+    if (_queue.empty() && _reserved + bytes <= _pool) {
+        grant(*query, bytes);
+        return;
+    }
+
+    LOG4CXX_DEBUG(logger, "Query " << queryID << " waits for " << bytes / MiB
+                  << " MiB; " << _reserved / MiB << " of " << _pool / MiB
+                  << " MiB reserved, " << _queue.size() << " queries ahead");
+    _queue.push_back(queryID);
+    query->_admissionQueued = true;
+
+    ElapsedMilliSeconds waited;
+    try {
+        Counter counter(CounterState::AdmissionWait, true);
+        Event::ErrorChecker ec = boost::bind(&Query::validate, query);
+        while (_queue.front() != queryID || _reserved + bytes > _pool) {
+            _event.wait(_mutex, ec);
+        }
+    } catch (...) {
+        _queue.erase(std::find(_queue.begin(), _queue.end(), queryID));
+        query->_admissionQueued = false;
+        query->_admissionWaitMsecs = waited.elapsed();
+        _event.signal();
+        throw;
+    }
+
+    _queue.pop_front();
+    query->_admissionQueued = false;
+    query->_admissionWaitMsecs = waited.elapsed();
+    grant(*query, bytes);
+
+    // The next query in line may fit too
+    _event.signal();
+
+    LOG4CXX_DEBUG(logger, "Query " << queryID << " admitted after "
+                  << query->getAdmissionWaitMsecs() << " ms");
+}
+
+void AdmissionController::reserve(std::shared_ptr<Query> const& query, uint64_t bytes)
+{
+    if (bytes == 0 || query->getMemoryReservation() != 0) {
+        return;
+    }
+    ScopedMutexLock cs(_mutex);
+    grant(*query, bytes);
+}
+
+void AdmissionController::release(Query& query)
+{
+    uint64_t const bytes = query._memoryReservation.exchange(0);
+    if (bytes == 0) {
+        return;
+    }
+    ScopedMutexLock cs(_mutex);
+    _reserved -= std::min(bytes, _reserved);
+    adjustMemThreshold();
+    _event.signal();
+}
+
+size_t AdmissionController::getQueueDepth() const
+{
+    ScopedMutexLock cs(_mutex);
+    return _queue.size();
+}
+
+void AdmissionController::grant(Query& query, uint64_t bytes)
+{
+    _reserved += bytes;
+    query._memoryReservation = bytes;
+    if (query._reservedArena) {
+        query._reservedArena->setLimit(bytes);
+    }
+    adjustMemThreshold();
+}
+
+void AdmissionController::adjustMemThreshold()
+{
+    if (_pool == 0 || _baseMemThreshold == 0) {
+        return;
+    }
+    // The in-memory arrays get what is left of the pool, but never less
+    // than a quarter of their configured threshold
+    uint64_t const unreserved = _pool > _reserved ? _pool - _reserved : 0;
+    SharedMemCache::getInstance().setMemThreshold(
+        std::max(_baseMemThreshold / 4, std::min(_baseMemThreshold, unreserved)));
+}
+
+} // namespace scidb
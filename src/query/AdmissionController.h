@@ -0,0 +1,127 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/**
+ * @file AdmissionController.h
+ *
+ * @brief Admission of queries against a per-instance memory pool
+ */
+
+#ifndef ADMISSION_CONTROLLER_H_
+#define ADMISSION_CONTROLLER_H_
+
+#include <deque>
+#include <memory>
+
+#include <query/Query.h>
+#include <query/QueryPlanFwd.h>
+#include <util/Event.h>
+#include <util/Mutex.h>
+#include <util/Singleton.h>
+
+namespace scidb
+{
+
+/**
+ * Gives every query a memory reservation from a pool of the instance's memory
+ * before it executes, and makes queries that do not fit wait, in arrival
+ * order, until enough of the pool has been released.
+ *
+ * A reservation is either declared by the client or estimated from the
+ * physical plan (see PhysicalOperator::getMemoryEstimate), and is never less
+ * than the configured default. Once granted it becomes the limit of the
+ * query's arena, and the spill threshold of the SharedMemCache is lowered so
+ * that the in-memory arrays and the reservations together fit in the pool.
+ *
+ * Only the coordinator queues a query: the workers take the reservation the
+ * coordinator sends with the physical plan as given, since a worker that
+ * waited could hold up queries already admitted elsewhere.
+ */
+class AdmissionController : public Singleton<AdmissionController>
+{
+public:
+    AdmissionController();
+
+    /**
+     * Size the pool from the configuration and record the configured
+     * SharedMemCache threshold; called once on startup, after the cache has
+     * been initialized.
+     */
+    void init();
+
+    /**
+     * @return true if queries are admitted against a pool
+     */
+    bool isEnabled() const
+    {
+        return _pool != 0;
+    }
+
+    /**
+     * @return the reservation, in bytes, of a query that declares 'declared'
+     * MiB (0 if it declares nothing) and is to run the physical plan 'plan';
+     * 0 if admission control is disabled
+     */
+    uint64_t getReservation(uint64_t declared, PhysPlanPtr const& plan, size_t nInstances) const;
+
+    /**
+     * Wait until 'bytes' of the pool are available to 'query', and every query
+     * that arrived before it has been admitted, then reserve them.
+     * @throws the error of the query if it is cancelled while waiting
+     */
+    void admit(std::shared_ptr<Query> const& query, uint64_t bytes);
+
+    /**
+     * Reserve 'bytes' for 'query' without waiting, even if the pool is
+     * exhausted; used on the workers.
+     */
+    void reserve(std::shared_ptr<Query> const& query, uint64_t bytes);
+
+    /**
+     * Return the reservation of 'query', if any, to the pool.
+     */
+    void release(Query& query);
+
+    /**
+     * @return the number of queries waiting for admission
+     */
+    size_t getQueueDepth() const;
+
+private:
+    /// Account for 'bytes' more of the pool and apply them to 'query'; _mutex is held
+    void grant(Query& query, uint64_t bytes);
+
+    /// Set the SharedMemCache threshold from the unreserved part of the pool; _mutex is held
+    void adjustMemThreshold();
+
+    Mutex mutable        _mutex;
+    Event                _event;            // signalled whenever the pool or the queue changes
+    std::deque<QueryID>  _queue;            // waiting queries, in arrival order
+    uint64_t             _pool;             // bytes available for reservations, 0 if disabled
+    uint64_t             _reserved;         // bytes reserved by running queries
+    uint64_t             _defaultReservation;
+    uint64_t             _baseMemThreshold; // the configured SharedMemCache threshold
+};
+
+} // namespace scidb
+
+#endif /* ADMISSION_CONTROLLER_H_ */
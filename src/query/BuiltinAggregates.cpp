@@ -34,6 +34,7 @@
 #include <query/FunctionLibrary.h>
 #include <query/Expression.h>
 #include <query/TileFunctions.h>
+#include <util/QuantileSketch.h>
 
 using namespace std;
 
@@ -293,6 +294,33 @@ public:
         }
     }
 
+    void accumulatePayload(Value& state, ConstRLEPayload const& payload, position_t from, size_t count)
+    {
+        if (! isStateInitialized(state)) {
+            initializeState(state);
+            assert(isStateInitialized(state));
+        }
+
+        if (!ignoreNulls()) {
+            *state.getData<uint64_t>() += count;
+            return;
+        }
+
+        position_t const end = from + count;
+        for (size_t i = payload.findSegment(from), n = payload.nSegments(); i < n; i++)
+        {
+            size_t vLen;
+            const RLEPayload::Segment& v = payload.getSegment(i, vLen);
+            if (position_t(v.pPosition()) >= end)
+                break;
+            if (!v.null())
+            {
+                *state.getData<uint64_t>() += std::min(end, position_t(v.pPosition() + vLen))
+                                            - std::max(from, position_t(v.pPosition()));
+            }
+        }
+    }
+
     void overrideCount(Value& state, uint64_t newCount)
     {
         *state.getData<uint64_t>() = newCount;
@@ -444,6 +472,185 @@ public:
     }
 };
 
+/**
+ * This class implements ApproxQuantile and ApproxRank, which estimate a
+ * quantile of the values, or the number of values up to a given one, from a
+ * QuantileSketch kept as the state.  Unlike quantile() and rank(), which sort
+ * and redistribute every value, the states are small and merge like those of
+ * any other aggregate.
+ */
+template <typename T>
+class QuantileSketchAggregate : public Aggregate
+{
+public:
+    enum Kind
+    {
+        QUANTILE,   // approxquantile(x [, q]): the q-quantile of x, the median by default
+        RANK        // approxrank(x, v): the number of values of x less than or equal to v
+    };
+
+private:
+    Kind   _kind;
+    double _parameter;
+
+    static char const* getKindName(Kind kind)
+    {
+        return kind == QUANTILE ? "approxquantile" : "approxrank";
+    }
+
+    /// Make room in 'state' for at least 'capacity' items
+    static void reserve(Value& state, size_t capacity)
+    {
+        QuantileSketch sketch(state.data());
+        size_t newCapacity = sketch.getCapacity();
+        while (newCapacity < capacity) {
+            newCapacity *= 2;
+        }
+        if (newCapacity != sketch.getCapacity()) {
+            size_t const bytes = QuantileSketch::getBytes(newCapacity);
+            QuantileSketch(state.setSize(bytes)).setBytes(bytes);
+        }
+    }
+
+    /// Add 'count' occurrences of 'v' to the sketch in 'state'
+    static void update(Value& state, T v, size_t count)
+    {
+        double const d = static_cast<double>(v);
+        if (d != d) {
+            return; // NaN has no rank
+        }
+        for (size_t i = 0; i < count; ++i) {
+            QuantileSketch sketch(state.data());
+            if (sketch.isFull()) {
+                reserve(state, sketch.getCapacity() + 1);
+                QuantileSketch(state.data()).update(d);
+            } else {
+                sketch.update(d);
+            }
+        }
+    }
+
+protected:
+    virtual void accumulate(Value& dstState, Value const& srcValue)
+    {
+        assert(isStateInitialized(dstState));
+        assert(isAccumulatable(srcValue));
+
+        update(dstState, srcValue.get<T>(), 1);
+    }
+
+    virtual void merge(Value& dstState, Value const& srcState)
+    {
+        assert(isStateInitialized(dstState));
+        assert(isMergeable(srcState));
+
+        QuantileSketch const src(srcState.data());
+        reserve(dstState, QuantileSketch(dstState.data()).getSize() + src.getSize());
+        QuantileSketch(dstState.data()).merge(src);
+    }
+
+public:
+    QuantileSketchAggregate(Kind kind, Type const& aggregateType, double parameter = 0.5)
+    : Aggregate(getKindName(kind), aggregateType,
+                TypeLibrary::getType(kind == QUANTILE ? TID_DOUBLE : TID_UINT64)),
+      _kind(kind),
+      _parameter(parameter)
+    {}
+
+    virtual bool ignoreNulls() const
+    {
+        return true;
+    }
+
+    virtual Type getStateType() const
+    {
+        return TypeLibrary::getType(TID_BINARY);
+    }
+
+    virtual AggregatePtr clone() const
+    {
+        return AggregatePtr(new QuantileSketchAggregate(_kind, getAggregateType(), _parameter));
+    }
+
+    virtual AggregatePtr clone(Type const& aggregateType) const
+    {
+        return AggregatePtr(new QuantileSketchAggregate(_kind, aggregateType, _parameter));
+    }
+
+    virtual void setParameters(std::vector<double> const& parameters)
+    {
+        if (_kind == QUANTILE) {
+            if (parameters.size() > 1) {
+                throw USER_EXCEPTION(SCIDB_SE_SYNTAX, SCIDB_LE_WRONG_AGGREGATE_ARGUMENTS_COUNT);
+            }
+            if (!parameters.empty()) {
+                if (!(parameters[0] >= 0 && parameters[0] <= 1)) {
+                    throw USER_EXCEPTION(SCIDB_SE_SYNTAX, SCIDB_LE_WRONG_OPERATOR_ARGUMENT2)
+                        << "a quantile between 0 and 1";
+                }
+                _parameter = parameters[0];
+            }
+        } else {
+            if (parameters.size() != 1) {
+                throw USER_EXCEPTION(SCIDB_SE_SYNTAX, SCIDB_LE_WRONG_AGGREGATE_ARGUMENTS_COUNT);
+            }
+            _parameter = parameters[0];
+        }
+    }
+
+    virtual void initializeState(Value& state)
+    {
+        size_t const bytes = QuantileSketch::getBytes(QuantileSketch::INITIAL_CAPACITY);
+        QuantileSketch::init(state.setSize(bytes), bytes);
+    }
+
+    virtual void accumulateIfNeeded(Value& state, ConstRLEPayload const* tile)
+    {
+        if (! isStateInitialized(state)) {
+            initializeState(state);
+            assert(isStateInitialized(state));
+        }
+
+        for (size_t i = 0, n = tile->nSegments(); i < n; i++)
+        {
+            size_t vLen;
+            const RLEPayload::Segment& v = tile->getSegment(i, vLen);
+            if (v.null())
+                continue;
+            if (v.same()) {
+                update(state, getPayloadValue<T>(tile, v.valueIndex()), vLen);
+            } else {
+                const size_t end = v.valueIndex() + vLen;
+                for (size_t j = v.valueIndex(); j < end; j++) {
+                    update(state, getPayloadValue<T>(tile, j), 1);
+                }
+            }
+        }
+    }
+
+    virtual void finalResult(Value& dstValue, Value const& srcState)
+    {
+        if (! isMergeable(srcState))
+        {
+            if (_kind == QUANTILE) {
+                dstValue.setNull();
+            } else {
+                dstValue.setUint64(0);
+            }
+            return;
+        }
+
+        QuantileSketch const sketch(srcState.data());
+        if (_kind == RANK) {
+            dstValue.setUint64(sketch.getRank(_parameter));
+        } else if (sketch.getCount() == 0) {
+            dstValue.setNull();
+        } else {
+            dstValue.setDouble(sketch.getQuantile(_parameter));
+        }
+    }
+};
+
 /**
  * This class implements MaxRepeatCount.
  */
@@ -633,6 +840,30 @@ AggregateLibrary::AggregateLibrary()
     /** ApproxDC **/
     addAggregate(make_shared<ApproxDCAggregate>());
 
+    /** ApproxQuantile **/
+    addAggregate(make_shared<QuantileSketchAggregate<int8_t> >(QuantileSketchAggregate<int8_t>::QUANTILE, TypeLibrary::getType(TID_INT8)));
+    addAggregate(make_shared<QuantileSketchAggregate<int16_t> >(QuantileSketchAggregate<int16_t>::QUANTILE, TypeLibrary::getType(TID_INT16)));
+    addAggregate(make_shared<QuantileSketchAggregate<int32_t> >(QuantileSketchAggregate<int32_t>::QUANTILE, TypeLibrary::getType(TID_INT32)));
+    addAggregate(make_shared<QuantileSketchAggregate<int64_t> >(QuantileSketchAggregate<int64_t>::QUANTILE, TypeLibrary::getType(TID_INT64)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint8_t> >(QuantileSketchAggregate<uint8_t>::QUANTILE, TypeLibrary::getType(TID_UINT8)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint16_t> >(QuantileSketchAggregate<uint16_t>::QUANTILE, TypeLibrary::getType(TID_UINT16)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint32_t> >(QuantileSketchAggregate<uint32_t>::QUANTILE, TypeLibrary::getType(TID_UINT32)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint64_t> >(QuantileSketchAggregate<uint64_t>::QUANTILE, TypeLibrary::getType(TID_UINT64)));
+    addAggregate(make_shared<QuantileSketchAggregate<float> >(QuantileSketchAggregate<float>::QUANTILE, TypeLibrary::getType(TID_FLOAT)));
+    addAggregate(make_shared<QuantileSketchAggregate<double> >(QuantileSketchAggregate<double>::QUANTILE, TypeLibrary::getType(TID_DOUBLE)));
+
+    /** ApproxRank **/
+    addAggregate(make_shared<QuantileSketchAggregate<int8_t> >(QuantileSketchAggregate<int8_t>::RANK, TypeLibrary::getType(TID_INT8)));
+    addAggregate(make_shared<QuantileSketchAggregate<int16_t> >(QuantileSketchAggregate<int16_t>::RANK, TypeLibrary::getType(TID_INT16)));
+    addAggregate(make_shared<QuantileSketchAggregate<int32_t> >(QuantileSketchAggregate<int32_t>::RANK, TypeLibrary::getType(TID_INT32)));
+    addAggregate(make_shared<QuantileSketchAggregate<int64_t> >(QuantileSketchAggregate<int64_t>::RANK, TypeLibrary::getType(TID_INT64)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint8_t> >(QuantileSketchAggregate<uint8_t>::RANK, TypeLibrary::getType(TID_UINT8)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint16_t> >(QuantileSketchAggregate<uint16_t>::RANK, TypeLibrary::getType(TID_UINT16)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint32_t> >(QuantileSketchAggregate<uint32_t>::RANK, TypeLibrary::getType(TID_UINT32)));
+    addAggregate(make_shared<QuantileSketchAggregate<uint64_t> >(QuantileSketchAggregate<uint64_t>::RANK, TypeLibrary::getType(TID_UINT64)));
+    addAggregate(make_shared<QuantileSketchAggregate<float> >(QuantileSketchAggregate<float>::RANK, TypeLibrary::getType(TID_FLOAT)));
+    addAggregate(make_shared<QuantileSketchAggregate<double> >(QuantileSketchAggregate<double>::RANK, TypeLibrary::getType(TID_DOUBLE)));
+
     /** MaxRepeatCount **/
     addAggregate(make_shared<MaxRepeatCountAggregate>());
 }
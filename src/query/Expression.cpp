@@ -127,6 +127,7 @@ void Expression::compile(std::shared_ptr<LogicalExpression> expr,
         _outputSchema = outputSchema;
         _nullable = false;
         _constant = true;
+        _deterministic = true;
         _resultType = internalCompile(expr, query, tile, 0, 0, false).type;
         if (_resultType != expectedType && expectedType != TID_VOID) {
             ConversionCost cost = EXPLICIT_CONVERSION_COST;
@@ -554,6 +555,7 @@ Expression::internalCompile(std::shared_ptr<LogicalExpression> expr,
                 swapArguments(f.argIndex);
             }
             _props[resultIndex].isConstantFunction = functionDesc.isDeterministic() && argumentsAreConst;
+            _deterministic = _deterministic && functionDesc.isDeterministic();
             /**
              * TODO: here it would be useful to set isConst and notNull
                          * flags for result arg prop. Also here we can evaluate function
@@ -768,6 +770,7 @@ void Expression::clear()
     _bindings.clear();
     _compiled = false;
     _constant = false;
+    _deterministic = true;
     _contextNo.clear();
     _eargs.resize(1);
     _functions.clear();
@@ -188,6 +188,17 @@ void OperatorParamAggregateCall::toString(std::ostream &out, int indent) const
         out << prefix(' ');
         out << "alias " << _alias << "\n";
     }
+
+    if (!_parameters.empty())
+    {
+        out << prefix(' ');
+        out << "parameters";
+        for (size_t i = 0; i < _parameters.size(); ++i)
+        {
+            out << " " << _parameters[i];
+        }
+        out << "\n";
+    }
 }
 
 void OperatorParamAsterisk::toString(std::ostream &out, int indent) const
@@ -953,6 +964,23 @@ void syncSG(const std::shared_ptr<Query>& query)
     LOG4CXX_DEBUG(logger, "syncSG: returning");
 }
 
+/**
+ * Pass the constant arguments of an aggregate call to the aggregate,
+ * reporting any objection of it at the call.
+ */
+static void setAggregateParameters(AggregatePtr const& agg,
+                                   std::shared_ptr<OperatorParamAggregateCall> const& aggregateCall)
+{
+    try
+    {
+        agg->setParameters(aggregateCall->getParameters());
+    }
+    catch (const UserException &e)
+    {
+        throw CONV_TO_USER_QUERY_EXCEPTION(e, aggregateCall->getParsingContext());
+    }
+}
+
 AggregatePtr resolveAggregate(std::shared_ptr <OperatorParamAggregateCall>const& aggregateCall,
                               Attributes const& inputAttributes,
                               AttributeID* inputAttributeID,
@@ -965,6 +993,7 @@ AggregatePtr resolveAggregate(std::shared_ptr <OperatorParamAggregateCall>const&
         if (PARAM_ASTERISK == acParam->getParamType())
         {
             AggregatePtr agg = AggregateLibrary::getInstance()->createAggregate( aggregateCall->getAggregateName(), TypeLibrary::getType(TID_VOID));
+            setAggregateParameters(agg, aggregateCall);
 
             if (inputAttributeID)
             {
@@ -983,6 +1012,7 @@ AggregatePtr resolveAggregate(std::shared_ptr <OperatorParamAggregateCall>const&
             AttributeDesc const& inputAttr = inputAttributes[ref->getObjectNo()];
             Type const& inputType = TypeLibrary::getType(inputAttr.getType());
             AggregatePtr agg = AggregateLibrary::getInstance()->createAggregate( aggregateCall->getAggregateName(), inputType);
+            setAggregateParameters(agg, aggregateCall);
 
             if (inputAttributeID)
             {
@@ -0,0 +1,353 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/**
+ * @file PreparedPlanCache.cpp
+ *
+ * @brief Cache of the physical plans of read-only queries on the coordinator,
+ * and the binding of query parameters
+ */
+
+#include <query/PreparedPlanCache.h>
+
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+
+#include <log4cxx/logger.h>
+
+#include <query/Expression.h>
+#include <query/Operator.h>
+#include <query/QueryPlan.h>
+#include <system/Cluster.h>
+#include <system/Config.h>
+#include <system/Exceptions.h>
+
+using namespace std;
+
+namespace scidb
+{
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.qproc.plancache"));
+
+namespace
+{
+    /**
+     * @return true if the subtree at 'node' does not depend on anything but
+     * the arrays it scans, so that it can run again as deserialized
+     */
+    bool isReusable(PhysNodePtr const& node)
+    {
+        PhysOpPtr const op = node->getPhysicalOperator();
+        string const& name = op->getLogicalName();
+        if (node->getChildren().empty() && name != "scan" && name != "build") {
+            // list(), show(), input(), and the like
+            return false;
+        }
+
+        // Whether an expression is deterministic is only known where it was compiled
+        PhysicalOperator::Parameters const& params = op->getParameters();
+        for (size_t i = 0; i < params.size(); ++i) {
+            if (params[i]->getParamType() == PARAM_PHYSICAL_EXPRESSION) {
+                std::shared_ptr<Expression> expr =
+                    ((std::shared_ptr<OperatorParamPhysicalExpression>&)params[i])->getExpression();
+                if (!expr->isDeterministic()) {
+                    return false;
+                }
+            }
+        }
+
+        vector<PhysNodePtr>& children = node->getChildren();
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (!isReusable(children[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool isIdentifierStart(char c)
+    {
+        return isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+    }
+
+    bool isIdentifierPart(char c)
+    {
+        return isIdentifierStart(c) || isdigit(static_cast<unsigned char>(c));
+    }
+
+    /**
+     * @return the position just past the string literal that starts at 'pos'
+     * of 'text', or npos if it is not terminated
+     */
+    size_t skipString(string const& text, size_t pos)
+    {
+        assert(text[pos] == '\'');
+        for (size_t i = pos + 1; i < text.size(); ++i) {
+            if (text[i] == '\\') {
+                ++i;
+            } else if (text[i] == '\'') {
+                return i + 1;
+            }
+        }
+        return string::npos;
+    }
+
+    /**
+     * @return true if 'value' is a single literal of the query languages
+     */
+    bool isLiteral(string const& value)
+    {
+        if (value.empty()) {
+            return false;
+        }
+        string lower(value);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (lower == "true" || lower == "false" || lower == "null") {
+            return true;
+        }
+
+        size_t const start = value[0] == 'L' ? 1 : 0;
+        if (value[start] == '\'') {
+            return skipString(value, start) == value.size();
+        }
+
+        // A number, with an optional sign and exponent
+        size_t i = value[0] == '-' ? 1 : 0;
+        size_t digits = 0;
+        for (; i < value.size() && isdigit(static_cast<unsigned char>(value[i])); ++i, ++digits) ;
+        if (i < value.size() && value[i] == '.') {
+            for (++i; i < value.size() && isdigit(static_cast<unsigned char>(value[i])); ++i, ++digits) ;
+        }
+        if (digits == 0) {
+            return false;
+        }
+        if (i < value.size() && (value[i] == 'e' || value[i] == 'E')) {
+            ++i;
+            if (i < value.size() && (value[i] == '-' || value[i] == '+')) {
+                ++i;
+            }
+            size_t const mark = i;
+            for (; i < value.size() && isdigit(static_cast<unsigned char>(value[i])); ++i) ;
+            if (i == mark) {
+                return false;
+            }
+        }
+        return i == value.size();
+    }
+}
+
+PreparedPlanCache::PreparedPlanCache()
+    : _limit(0)
+{
+}
+
+void PreparedPlanCache::init()
+{
+    size_t const size = Config::getInstance()->getOption<size_t>(CONFIG_PLAN_CACHE_SIZE);
+
+    if (!resize(size)) {
+        return;
+    }
+    if (size) {
+        LOG4CXX_INFO(logger, "Plan cache of " << size << " plans");
+    } else {
+        LOG4CXX_INFO(logger, "Plan cache is disabled");
+    }
+}
+
+bool PreparedPlanCache::resize(size_t plans)
+{
+    ScopedMutexLock cs(_mutex);
+    if (_limit == plans) {
+        return false;
+    }
+    _limit = plans;
+    while (_lru.size() > _limit) {
+        erase(--_lru.end());
+    }
+    return true;
+}
+
+string PreparedPlanCache::getKey(std::shared_ptr<Query> const& query, bool afl) const
+{
+    if (!isEnabled()) {
+        return string();
+    }
+    std::shared_ptr<LogicalQueryPlanNode> root =
+        query->logicalPlan ? query->logicalPlan->getRoot() : std::shared_ptr<LogicalQueryPlanNode>();
+    if (!root || root->isDdl() ||
+        !query->getLockedArrays(SystemCatalog::LockDesc::WR).empty()) {
+        return string();
+    }
+
+    std::shared_ptr<const InstanceLiveness> liveness = query->getCoordinatorLiveness();
+    vector<string> const arrays = query->getLockedArrays(SystemCatalog::LockDesc::RD);
+    vector<pair<string, ArrayID> > catalogVersions;
+    catalogVersions.reserve(arrays.size());
+    for (size_t i = 0; i < arrays.size(); ++i) {
+        string namespaceName;
+        string arrayName;
+        ArrayDesc::splitQualifiedArrayName(arrays[i], namespaceName, arrayName);
+        catalogVersions.push_back(make_pair(arrays[i], query->getCatalogVersion(namespaceName, arrayName)));
+    }
+    bool const tileMode = Config::getInstance()->getOption<int>(CONFIG_TILE_SIZE) > 1;
+    return makeKey(afl, liveness->getMembershipId(), liveness->getVersion(), tileMode,
+                   catalogVersions, query->queryString);
+}
+
+string PreparedPlanCache::makeKey(bool afl,
+                                  MembershipID membershipId,
+                                  uint64_t livenessVersion,
+                                  bool tileMode,
+                                  vector<pair<string, ArrayID> > const& catalogVersions,
+                                  string const& queryString)
+{
+    ostringstream key;
+    key << (afl ? "afl " : "aql ") << membershipId << '.' << livenessVersion
+        << (tileMode ? " tile;" : " cell;");
+    for (size_t i = 0; i < catalogVersions.size(); ++i) {
+        key << catalogVersions[i].first << '@' << catalogVersions[i].second << ';';
+    }
+    key << queryString;
+    return key.str();
+}
+
+PreparedPlanCache::EntryPtr PreparedPlanCache::lookup(string const& key)
+{
+    ScopedMutexLock cs(_mutex);
+    unordered_map<string, Entries::iterator>::iterator i = _index.find(key);
+    if (i == _index.end()) {
+        return EntryPtr();
+    }
+    _lru.splice(_lru.begin(), _lru, i->second);
+    return *i->second;
+}
+
+void PreparedPlanCache::insert(string const& key,
+                               std::shared_ptr<Query> const& query,
+                               string const& plan,
+                               uint64_t reservation)
+{
+    PhysPlanPtr physicalPlan = query->getCurrentPhysicalPlan();
+    if (!physicalPlan || !physicalPlan->getRoot() || physicalPlan->isDdl() ||
+        !isReusable(physicalPlan->getRoot())) {
+        return;
+    }
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>();
+    entry->plan = plan;
+    entry->reservation = reservation;
+    entry->arrays = query->getLockedArrays(SystemCatalog::LockDesc::RD);
+    entry->key = key;
+    insert(entry);
+}
+
+bool PreparedPlanCache::insert(std::shared_ptr<Entry> const& entry)
+{
+    ScopedMutexLock cs(_mutex);
+    if (_limit == 0 || _index.count(entry->key)) {
+        return false;
+    }
+    while (_lru.size() >= _limit) {
+        assert(!_lru.empty());
+        erase(--_lru.end());
+    }
+    _lru.push_front(entry);
+    _index[entry->key] = _lru.begin();
+    LOG4CXX_DEBUG(logger, "Cached a plan, " << _lru.size() << " plans in the cache");
+    return true;
+}
+
+void PreparedPlanCache::invalidate(string const& qualifiedName)
+{
+    ScopedMutexLock cs(_mutex);
+    for (Entries::iterator i = _lru.begin(); i != _lru.end(); ) {
+        Entries::iterator const pos = i++;
+        vector<string> const& arrays = (*pos)->arrays;
+        if (std::find(arrays.begin(), arrays.end(), qualifiedName) != arrays.end()) {
+            erase(pos);
+        }
+    }
+}
+
+void PreparedPlanCache::clear()
+{
+    ScopedMutexLock cs(_mutex);
+    _index.clear();
+    _lru.clear();
+}
+
+void PreparedPlanCache::erase(Entries::iterator pos)
+{
+    _index.erase((*pos)->key);
+    _lru.erase(pos);
+}
+
+string bindQueryParameters(string const& queryString,
+                           map<string, string> const& parameters)
+{
+    if (parameters.empty()) {
+        return queryString;
+    }
+
+    string bound;
+    bound.reserve(queryString.size());
+    size_t const n = queryString.size();
+    size_t i = 0;
+    while (i < n) {
+        char const c = queryString[i];
+        size_t end = i + 1;
+        if (c == '\'') {
+            end = skipString(queryString, i);
+        } else if (c == '"') {
+            end = queryString.find('"', i + 1);
+            end = end == string::npos ? end : end + 1;
+        } else if (queryString.compare(i, 2, "--") == 0 || queryString.compare(i, 2, "//") == 0) {
+            end = queryString.find('\n', i);
+        } else if (queryString.compare(i, 2, "/*") == 0) {
+            end = queryString.find("*/", i + 2);
+            end = end == string::npos ? end : end + 2;
+        } else if (isIdentifierStart(c)) {
+            for (; end < n && isIdentifierPart(queryString[end]); ++end) ;
+            if (c == '$') {
+                map<string, string>::const_iterator const p =
+                    parameters.find(queryString.substr(i + 1, end - i - 1));
+                if (p != parameters.end()) {
+                    if (!isLiteral(p->second)) {
+                        throw USER_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_ILLEGAL_OPERATION)
+                            << "the value of the query parameter $" + p->first + " is not a literal";
+                    }
+                    bound += p->second;
+                    i = end;
+                    continue;
+                }
+            }
+        }
+        // The rest of an unterminated literal or comment is left to the parser
+        end = std::min(end, n);
+        bound.append(queryString, i, end - i);
+        i = end;
+    }
+    return bound;
+}
+
+} // namespace scidb
@@ -0,0 +1,180 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/**
+ * @file PreparedPlanCache.h
+ *
+ * @brief Cache of the physical plans of read-only queries on the coordinator,
+ * and the binding of query parameters
+ */
+
+#ifndef PREPARED_PLAN_CACHE_H_
+#define PREPARED_PLAN_CACHE_H_
+
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <query/Query.h>
+#include <query/QueryPlanFwd.h>
+#include <util/Mutex.h>
+#include <util/Singleton.h>
+
+namespace scidb
+{
+
+/**
+ * Keeps the optimized physical plans of read-only queries, so that the next
+ * query with the same text over the same catalog state is not optimized
+ * again: it takes the plan as the other instances do, by deserializing it.
+ *
+ * The key of a plan is the query text, once its parameters are bound, preceded
+ * by the liveness of the cluster, by whether the optimizer plans in tile mode,
+ * and by the catalog version of every array the query has locked.  Any change
+ * of the schema or of the versions of an array gives it a new catalog version,
+ * so that a key can never find a stale plan; the entries of an updated array
+ * are dropped at commit only to return their memory early.  As the operators
+ * may read other options while they are planned, _setopt() drops every plan.
+ *
+ * Only the plans that scan or build all their inputs, and whose expressions
+ * are deterministic, are cached.  The entries are kept in LRU order, at most
+ * CONFIG_PLAN_CACHE_SIZE of them, which also disables the cache when 0.
+ */
+class PreparedPlanCache : public Singleton<PreparedPlanCache>
+{
+public:
+    /// A plan, which is immutable once in the cache
+    struct Entry
+    {
+        Entry() : reservation(0) {}
+
+        std::string              plan;          // serialized as sent to the other instances
+        uint64_t                 reservation;   // admission estimate of the plan, in bytes
+        std::vector<std::string> arrays;        // qualified names of the arrays locked
+        std::string              key;
+    };
+    typedef std::shared_ptr<Entry const> EntryPtr;
+
+    PreparedPlanCache();
+
+    /**
+     * Size the cache from the configuration; called on startup and before
+     * every query, as _setopt() may change the size.
+     */
+    void init();
+
+    /**
+     * Set the most plans kept to 'plans', evicting the least recently used
+     * plans that no longer fit; 0 disables the cache
+     * @return false if the cache already had that size
+     */
+    bool resize(size_t plans);
+
+    /**
+     * @return true if plans are cached
+     */
+    bool isEnabled() const
+    {
+        return _limit != 0;
+    }
+
+    /**
+     * @return the key of the plan of 'query', which must be prepared and hold
+     * its locks, or an empty string if the plan cannot be cached
+     */
+    std::string getKey(std::shared_ptr<Query> const& query, bool afl) const;
+
+    /**
+     * @return the key of the plan of 'queryString', in AFL if 'afl', on the
+     * cluster membership 'membershipId' at liveness 'livenessVersion', planned
+     * in tile mode if 'tileMode', that locks the arrays of 'catalogVersions',
+     * by qualified name
+     */
+    static std::string makeKey(bool afl,
+                               MembershipID membershipId,
+                               uint64_t livenessVersion,
+                               bool tileMode,
+                               std::vector<std::pair<std::string, ArrayID> > const& catalogVersions,
+                               std::string const& queryString);
+
+    /**
+     * @return the plan with 'key', if cached, which becomes the most recently used
+     */
+    EntryPtr lookup(std::string const& key);
+
+    /**
+     * Cache 'plan', the current physical plan of 'query' as serialized, under
+     * 'key', unless the plan cannot be reused; evicts the least recently used
+     * plan to make room.
+     * @param reservation the admission estimate of the plan, in bytes
+     */
+    void insert(std::string const& key,
+                std::shared_ptr<Query> const& query,
+                std::string const& plan,
+                uint64_t reservation);
+
+    /**
+     * Cache 'entry', evicting the least recently used plan to make room
+     * @return false if a plan with the same key is already cached
+     */
+    bool insert(std::shared_ptr<Entry> const& entry);
+
+    /**
+     * Drop the plans that lock the array 'qualifiedName'
+     */
+    void invalidate(std::string const& qualifiedName);
+
+    /**
+     * Drop every plan, as when the configuration the plans were made under
+     * changes
+     */
+    void clear();
+
+private:
+    typedef std::list<std::shared_ptr<Entry const> > Entries;
+
+    /// Remove the entry at 'pos'; _mutex is held
+    void erase(Entries::iterator pos);
+
+    Mutex mutable                                        _mutex;
+    Entries                                              _lru;     // most recently used first
+    std::unordered_map<std::string, Entries::iterator>   _index;
+    size_t                                               _limit;   // 0 if disabled
+};
+
+/**
+ * @return 'queryString' with every $name token outside of the string literals,
+ * quoted names and comments, for which 'parameters' has a value under 'name',
+ * replaced with that value
+ * @throw USER_EXCEPTION if a value used is not a single literal: a number,
+ * a quoted string, true, false or null
+ */
+std::string bindQueryParameters(std::string const& queryString,
+                                std::map<std::string, std::string> const& parameters);
+
+} // namespace scidb
+
+#endif /* PREPARED_PLAN_CACHE_H_ */
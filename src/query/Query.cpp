@@ -40,8 +40,11 @@
 
 
 #include <array/DBArray.h>
+#include <query/AdmissionController.h>
 #include <query/Query.h>
+#include <query/PreparedPlanCache.h>
 #include <query/QueryPlan.h>
+#include <query/QueryResultCache.h>
 //#include <query/QueryProcessor.h>
 #include <query/RemoteArray.h>
 #include <malloc.h>
@@ -62,6 +65,7 @@
 #include <smgr/io/ReplicationManager.h>
 #include <smgr/io/Storage.h>
 
+#include <util/arena/LimitedArena.h>
 #include <util/iqsort.h>
 #include <util/LockManager.h>
 #ifndef SCIDB_CLIENT
@@ -197,10 +201,14 @@ Query::Query(const QueryID& queryID):
     _error(SYSTEM_EXCEPTION_SPTR(SCIDB_E_NO_ERROR, SCIDB_E_NO_ERROR)),
     _completionStatus(INIT),
     _commitState(UNKNOWN),
+    _resultFromCache(false),
     _creationTime(time(NULL)),
     _useCounter(0),
     _doesExclusiveArrayAccess(false),
     _procGrid(NULL),
+    _memoryReservation(0),
+    _admissionQueued(false),
+    _admissionWaitMsecs(0),
     _isAutoCommit(false),
     _usecElapsedStart(int64_t(perfTimeGetElapsed()*1.0e6))
 {
@@ -245,12 +253,16 @@ void Query::init(InstanceID coordID,
       supports recycling but also suballocates all of the blocks it hands out
       from large - currently 64 MiB - slabs that are given back to the system
       en masse no later than when the query completes;  the hope here is that
-      this reduces the overall fragmentation of the system heap...*/
+      this reduces the overall fragmentation of the system heap... The slabs
+      come from a limited arena whose limit the AdmissionController sets from
+      the query's memory reservation.*/
       {
           assert(_arena == 0);
           stringstream ss ;
           ss << "query "<<_queryID;
-          _arena = newArena(Options(ss.str().c_str()).lea(arena::getArena(),64*MiB));
+          _reservedArena = std::make_shared<arena::LimitedArena>(
+              Options(ss.str().c_str()).limited(arena::getArena(),arena::unlimited));
+          _arena = newArena(Options(ss.str().c_str()).lea(_reservedArena,64*MiB));
       }
 
       assert(!_coordinatorLiveness);
@@ -330,7 +342,8 @@ void Query::init(InstanceID coordID,
 void Query::broadcastCommitFinalizer(const std::shared_ptr<Query>& q)
 {
     assert(q);
-    if (q->wasCommitted()) {
+    // A result from the cache was computed by no other instance
+    if (q->wasCommitted() && !q->isResultFromCache()) {
         std::shared_ptr<MessageDesc>  msg(makeCommitMessage(q->getQueryID()));
         NetworkManager::getInstance()->broadcastPhysical(msg);
     }
@@ -522,6 +535,20 @@ Query::requestLock(std::shared_ptr<SystemCatalog::LockDesc>& requestedLock)
     return (*(res.first));
 }
 
+vector<string> Query::getLockedArrays(SystemCatalog::LockDesc::LockMode mode) const
+{
+    vector<string> names;
+    ScopedMutexLock cs(errorMutex, PTCW_MUT_OTHER);
+    for (SystemCatalog::QueryLocks::const_iterator i = _requestedLocks.begin();
+         i != _requestedLocks.end(); ++i) {
+        if ((*i)->getLockMode() >= mode) {
+            names.push_back(ArrayDesc::makeQualifiedArrayName((*i)->getNamespaceName(),
+                                                              (*i)->getArrayName()));
+        }
+    }
+    return names;
+}
+
 void Query::handleError(const std::shared_ptr<Exception>& unwindException)
 {
     assert(unwindException);
@@ -697,6 +724,24 @@ void Query::handleCommit()
     }
     assert(queryId != INVALID_QUERY_ID);
     invokeFinalizers(finalizersOnStack);
+
+    // The cached results and plans that read the updated arrays can never be found again
+    if (isCoordinator()) {
+        QueryResultCache* cache = QueryResultCache::getInstance();
+        PreparedPlanCache* planCache = PreparedPlanCache::getInstance();
+        if (cache->isEnabled() || planCache->isEnabled()) {
+            vector<string> const updated = getLockedArrays(SystemCatalog::LockDesc::WR);
+            for (size_t i = 0; i < updated.size(); ++i) {
+                cache->invalidate(updated[i]);
+                planCache->invalidate(updated[i]);
+            }
+        }
+        // The client has completed the query; its result is kept if it was drained
+        std::shared_ptr<QueryResultCapture> capture = getResultCapture();
+        if (capture) {
+            capture->finish();
+        }
+    }
 }
 
 void Query::handleComplete()
@@ -1041,6 +1086,8 @@ void dumpMemoryUsage(const QueryID queryId)
                       <<", MemChunks were swapped out: " << SharedMemCache::getInstance().getSwapNum()
                       <<", MemChunks were loaded: " << SharedMemCache::getInstance().getLoadsNum()
                       <<", MemChunks were dropped: " << SharedMemCache::getInstance().getDropsNum()
+                      <<", MemChunks spilled (raw/written bytes): " << SharedMemCache::getInstance().getSpilledRawSize()
+                      <<"/" << SharedMemCache::getInstance().getSpilledSize()
                       <<", number of mallocs: " << (mstats ? mstats[0] : 0)
                       <<", number of frees: "   << (mstats ? mstats[1] : 0));
     }
@@ -1052,11 +1099,14 @@ void Query::destroy()
 
     freeQuery(getQueryID());
 
+    AdmissionController::getInstance()->release(*this);
+
     // Any members explicitly destroyed in this method
     // should have an atomic query validating getter method
     // (and setter ?)
     std::shared_ptr<Array> resultArray;
     std::shared_ptr<RemoteMergedArray> mergedArray;
+    std::shared_ptr<QueryResultCapture> resultCapture;
     std::shared_ptr<WorkQueue> bufferQueue;
     std::shared_ptr<WorkQueue> errQueue;
     std::shared_ptr<WorkQueue> opQueue;
@@ -1084,6 +1134,7 @@ void Query::destroy()
         _currentResultArray.swap(resultArray);
 
         _mergedArray.swap(mergedArray);
+        _resultCapture.swap(resultCapture);
     }
     if (bufferQueue) { bufferQueue->stop(); }
     if (errQueue)    { errQueue->stop(); }
@@ -1231,6 +1282,23 @@ void Query::postWarning(const Warning& warn)
 {
     ScopedMutexLock lock(_warningsMutex, PTCW_MUT_OTHER);
     _warnings.push_back(warn);
+    std::shared_ptr<QueryResultCapture> capture = getResultCapture();
+    if (capture) {
+        capture->addWarning(warn);
+    }
+}
+
+void Query::setResultCapture(const std::shared_ptr<QueryResultCapture>& capture)
+{
+    // _warningsMutex keeps a warning from being posted between the two
+    ScopedMutexLock lock(_warningsMutex, PTCW_MUT_OTHER);
+    {
+        ScopedMutexLock cs(errorMutex, PTCW_MUT_OTHER);
+        _resultCapture = capture;
+    }
+    for (size_t i = 0; capture && i < _warnings.size(); ++i) {
+        capture->addWarning(_warnings[i]);
+    }
 }
 
 std::vector<Warning> Query::getWarnings()
@@ -1991,6 +2059,17 @@ void ReplicationContext::replicationSync(ArrayID arrId)
         assert(item->validate(false));
     }
 
+    // The replicas queued ahead of the eofs have been sent by now;
+    // raise the first error any of them ran into
+    vector<boost::function<void()> > pendingReplicas;
+    {
+        ScopedMutexLock cs(_mutex, PTCW_MUT_OTHER);
+        pendingReplicas.swap(_pendingReplicas);
+    }
+    for (size_t i=0; i<pendingReplicas.size(); ++i) {
+        pendingReplicas[i]();
+    }
+
     QueueInfoPtr qInfo;
     {
         ScopedMutexLock cs(_mutex, PTCW_MUT_OTHER);
@@ -2005,6 +2084,13 @@ void ReplicationContext::replicationSync(ArrayID arrId)
     qInfo->getSemaphore().enter(replicasVec.size(), ec, PTCW_REP);
 }
 
+void ReplicationContext::addPendingReplica(const boost::function<void()>& waiter)
+{
+    assert(waiter);
+    ScopedMutexLock cs(_mutex, PTCW_MUT_OTHER);
+    _pendingReplicas.push_back(waiter);
+}
+
 void ReplicationContext::replicationAck(InstanceID sourceId, ArrayID arrId)
 {
     assert(arrId > 0);
@@ -0,0 +1,304 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/**
+ * @file QueryResultCache.cpp
+ *
+ * @brief Cache of the results of read-only queries on the coordinator
+ */
+
+#include <query/QueryResultCache.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <log4cxx/logger.h>
+
+#include <array/MemArray.h>
+#include <query/Expression.h>
+#include <query/Operator.h>
+#include <query/QueryPlan.h>
+#include <query/Serialize.h>
+#include <system/Config.h>
+#include <system/Constants.h>
+
+using namespace std;
+
+namespace scidb
+{
+
+static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.qproc.resultcache"));
+
+namespace
+{
+    /**
+     * @return true if the result of the subtree at 'node' depends only on the
+     * array versions it scans, which are appended to 'versions'
+     */
+    bool isCacheable(PhysNodePtr const& node, ostream& versions)
+    {
+        PhysOpPtr const op = node->getPhysicalOperator();
+        string const& name = op->getLogicalName();
+        if (node->getChildren().empty()) {
+            if (name == "scan") {
+                if (!QueryResultCache::appendScannedArray(op->getSchema(), versions)) {
+                    return false;
+                }
+            } else if (name != "build") {
+                // list(), input(), and the like read something other than array versions
+                return false;
+            }
+        } else if (name == "bernoulli" || name == "sample") {
+            return false;
+        }
+
+        PhysicalOperator::Parameters const& params = op->getParameters();
+        for (size_t i = 0; i < params.size(); ++i) {
+            if (params[i]->getParamType() == PARAM_PHYSICAL_EXPRESSION) {
+                std::shared_ptr<Expression> expr =
+                    ((std::shared_ptr<OperatorParamPhysicalExpression>&)params[i])->getExpression();
+                if (!expr->isDeterministic()) {
+                    return false;
+                }
+            }
+        }
+
+        vector<PhysNodePtr>& children = node->getChildren();
+        for (size_t i = 0; i < children.size(); ++i) {
+            if (!isCacheable(children[i], versions)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+QueryResultCache::QueryResultCache()
+    : _limit(0),
+      _bytes(0)
+{
+}
+
+void QueryResultCache::init()
+{
+    size_t const size = Config::getInstance()->getOption<size_t>(CONFIG_RESULT_CACHE_SIZE);
+
+    if (!resize(size * MiB)) {
+        return;
+    }
+    if (size) {
+        LOG4CXX_INFO(logger, "Result cache of " << size << " MiB");
+    } else {
+        LOG4CXX_INFO(logger, "Result cache is disabled");
+    }
+}
+
+bool QueryResultCache::resize(size_t bytes)
+{
+    ScopedMutexLock cs(_mutex);
+    if (_limit == bytes) {
+        return false;
+    }
+    _limit = bytes;
+    makeRoom(0);
+    return true;
+}
+
+bool QueryResultCache::appendScannedArray(ArrayDesc const& schema, ostream& key)
+{
+    if (schema.isTransient()) {
+        return false;
+    }
+    key << schema.getUAId() << '@' << schema.getId()
+        << '.' << schema.getVersionId() << ';';
+    return true;
+}
+
+string QueryResultCache::getKey(std::shared_ptr<Query> const& query) const
+{
+    if (!isEnabled()) {
+        return string();
+    }
+    PhysPlanPtr plan = query->getCurrentPhysicalPlan();
+    if (!plan || !plan->getRoot() || plan->isDdl() ||
+        !query->getLockedArrays(SystemCatalog::LockDesc::WR).empty()) {
+        return string();
+    }
+    ostringstream key;
+    if (!isCacheable(plan->getRoot(), key)) {
+        return string();
+    }
+    key << serializePhysicalPlan(plan);
+    return key.str();
+}
+
+QueryResultCache::EntryPtr QueryResultCache::lookup(string const& key)
+{
+    ScopedMutexLock cs(_mutex);
+    unordered_map<string, Entries::iterator>::iterator i = _index.find(key);
+    if (i == _index.end()) {
+        return EntryPtr();
+    }
+    _lru.splice(_lru.begin(), _lru, i->second);
+    return *i->second;
+}
+
+std::shared_ptr<QueryResultCapture> QueryResultCache::startCapture(string const& key,
+                                                                  std::shared_ptr<Query> const& query,
+                                                                  ArrayDesc const& desc)
+{
+    std::shared_ptr<Entry> entry = std::make_shared<Entry>(desc);
+    entry->key = key;
+    entry->arrays = query->getLockedArrays(SystemCatalog::LockDesc::RD);
+    return std::make_shared<QueryResultCapture>(entry, getMaxEntryBytes());
+}
+
+bool QueryResultCache::insert(std::shared_ptr<Entry> const& entry)
+{
+    ScopedMutexLock cs(_mutex);
+    if (entry->bytes > _limit || _index.count(entry->key)) {
+        return false;
+    }
+    makeRoom(entry->bytes);
+    _lru.push_front(entry);
+    _index[entry->key] = _lru.begin();
+    _bytes += entry->bytes;
+    LOG4CXX_DEBUG(logger, "Cached a result of " << entry->bytes << " bytes, "
+                  << _lru.size() << " results of " << _bytes << " bytes in the cache");
+    return true;
+}
+
+void QueryResultCache::invalidate(string const& qualifiedName)
+{
+    ScopedMutexLock cs(_mutex);
+    for (Entries::iterator i = _lru.begin(); i != _lru.end(); ) {
+        Entries::iterator const pos = i++;
+        vector<string> const& arrays = (*pos)->arrays;
+        if (std::find(arrays.begin(), arrays.end(), qualifiedName) != arrays.end()) {
+            erase(pos);
+        }
+    }
+}
+
+void QueryResultCache::erase(Entries::iterator pos)
+{
+    _bytes -= (*pos)->bytes;
+    _index.erase((*pos)->key);
+    _lru.erase(pos);
+}
+
+void QueryResultCache::makeRoom(size_t bytes)
+{
+    while (!_lru.empty() && _bytes + bytes > _limit) {
+        erase(--_lru.end());
+    }
+}
+
+QueryResultCapture::QueryResultCapture(std::shared_ptr<QueryResultCache::Entry> const& entry,
+                                       size_t maxBytes)
+    : _entry(entry),
+      _drained(entry->desc.getAttributes().size(), false),
+      _maxBytes(maxBytes)
+{
+}
+
+void QueryResultCapture::add(AttributeID attId,
+                             Coordinates const& coordinates,
+                             uint64_t count,
+                             std::shared_ptr<CompressedBuffer> const& buffer)
+{
+    ScopedMutexLock cs(_mutex);
+    if (!_entry || attId >= _drained.size() || _drained[attId]) {
+        return;
+    }
+    if (buffer) {
+        QueryResultCache::Chunk chunk;
+        chunk.coordinates = coordinates;
+        chunk.count = count;
+        chunk.buffer = buffer;
+        _entry->chunks[attId].push_back(chunk);
+        _entry->bytes += buffer->getSize() + sizeof(chunk);
+        if (_entry->bytes > _maxBytes) {
+            LOG4CXX_TRACE(logger, "Result is too large to be cached");
+            _entry.reset();
+        }
+    } else {
+        _drained[attId] = true;
+    }
+}
+
+void QueryResultCapture::addWarning(Warning const& warning)
+{
+    ScopedMutexLock cs(_mutex);
+    if (_entry) {
+        _entry->warnings.push_back(warning);
+    }
+}
+
+bool QueryResultCapture::finish()
+{
+    std::shared_ptr<QueryResultCache::Entry> entry;
+    {
+        ScopedMutexLock cs(_mutex);
+        entry.swap(_entry);
+        if (!entry || std::find(_drained.begin(), _drained.end(), false) != _drained.end()) {
+            LOG4CXX_TRACE(logger, "Result was not fetched completely and is not cached");
+            return false;
+        }
+    }
+    return QueryResultCache::getInstance()->insert(entry);
+}
+
+bool QueryResultCapture::isDrained() const
+{
+    ScopedMutexLock cs(_mutex);
+    return std::find(_drained.begin(), _drained.end(), false) == _drained.end();
+}
+
+CachedResultArray::CachedResultArray(QueryResultCache::EntryPtr const& entry)
+    : StreamArray(entry->desc, false),
+      _entry(entry),
+      _next(entry->chunks.size(), 0)
+{
+}
+
+QueryResultCache::Chunk const* CachedResultArray::nextCachedChunk(AttributeID attId)
+{
+    assert(attId < _next.size());
+    vector<QueryResultCache::Chunk> const& chunks = _entry->chunks[attId];
+    return _next[attId] < chunks.size() ? &chunks[_next[attId]++] : NULL;
+}
+
+ConstChunk const* CachedResultArray::nextChunk(AttributeID attId, MemChunk& chunk)
+{
+    QueryResultCache::Chunk const* cached = nextCachedChunk(attId);
+    if (!cached) {
+        return NULL;
+    }
+    Address addr(attId, cached->coordinates);
+    chunk.initialize(this, &desc, addr, cached->buffer->getCompressionMethod());
+    chunk.setCount(cached->count);
+    chunk.decompress(*cached->buffer);
+    return &chunk;
+}
+
+} // namespace scidb
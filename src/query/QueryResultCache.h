@@ -0,0 +1,245 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/**
+ * @file QueryResultCache.h
+ *
+ * @brief Cache of the results of read-only queries on the coordinator
+ */
+
+#ifndef QUERY_RESULT_CACHE_H_
+#define QUERY_RESULT_CACHE_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <array/Array.h>
+#include <array/Metadata.h>
+#include <array/StreamArray.h>
+#include <query/Query.h>
+#include <query/QueryPlanFwd.h>
+#include <system/Warnings.h>
+#include <util/Mutex.h>
+#include <util/Singleton.h>
+
+namespace scidb
+{
+
+class QueryResultCapture;
+
+/**
+ * Keeps the results of read-only queries, as the compressed chunks that were
+ * sent to the client, so that the next query with the same physical plan over
+ * the same array versions is answered by the coordinator alone.
+ *
+ * The key of a result is the serialized physical plan, preceded by the
+ * versioned id of every array the plan scans.  A commit creates a new version
+ * of the arrays it updates, so that a key can never find a stale result; the
+ * entries that read an updated array are dropped at commit only to return
+ * their memory early.  Temporary arrays are updated in place and the results
+ * that read them are never cached.
+ *
+ * The entries are kept in LRU order within the configured size
+ * (CONFIG_RESULT_CACHE_SIZE MiB), which also disables the cache when 0.
+ */
+class QueryResultCache : public Singleton<QueryResultCache>
+{
+public:
+    /// A chunk of a result as sent to the client
+    struct Chunk
+    {
+        Coordinates                       coordinates;
+        uint64_t                          count;
+        std::shared_ptr<CompressedBuffer> buffer;
+    };
+
+    /// A result, which is immutable once in the cache
+    struct Entry
+    {
+        Entry(ArrayDesc const& desc) : desc(desc), chunks(desc.getAttributes().size()), bytes(0) {}
+
+        ArrayDesc                        desc;
+        std::vector<std::vector<Chunk> > chunks;   // per attribute
+        std::vector<Warning>             warnings; // posted while the result was computed
+        std::vector<std::string>         arrays;   // qualified names of the arrays read
+        std::string                      key;
+        size_t                           bytes;
+    };
+    typedef std::shared_ptr<Entry const> EntryPtr;
+
+    QueryResultCache();
+
+    /**
+     * Size the cache from the configuration; called on startup and before
+     * every query, as _setopt() may change the size.
+     */
+    void init();
+
+    /**
+     * Set the size of the cache to 'bytes', evicting the least recently used
+     * results that no longer fit; 0 disables the cache
+     * @return false if the cache already had that size
+     */
+    bool resize(size_t bytes);
+
+    /**
+     * @return true if results are cached
+     */
+    bool isEnabled() const
+    {
+        return _limit != 0;
+    }
+
+    /**
+     * @return the key of the result of the current physical plan of 'query',
+     * or an empty string if the result cannot be cached
+     */
+    std::string getKey(std::shared_ptr<Query> const& query) const;
+
+    /**
+     * Append the versioned id of the scanned array 'schema' to the key 'key'
+     * @return false if the results that read 'schema' cannot be cached
+     */
+    static bool appendScannedArray(ArrayDesc const& schema, std::ostream& key);
+
+    /**
+     * @return the result with 'key', if cached, which becomes the most recently used
+     */
+    EntryPtr lookup(std::string const& key);
+
+    /**
+     * @return a capture of the result of 'query', of schema 'desc', that
+     * inserts it under 'key' if the client fetches all of it
+     */
+    std::shared_ptr<QueryResultCapture> startCapture(std::string const& key,
+                                                     std::shared_ptr<Query> const& query,
+                                                     ArrayDesc const& desc);
+
+    /**
+     * Cache 'entry', evicting the least recently used results to make room
+     * @return false if 'entry' is larger than the cache or already in it
+     */
+    bool insert(std::shared_ptr<Entry> const& entry);
+
+    /**
+     * Drop the results that read the array 'qualifiedName'
+     */
+    void invalidate(std::string const& qualifiedName);
+
+    /**
+     * @return the largest result that is worth capturing
+     */
+    size_t getMaxEntryBytes() const
+    {
+        return _limit / 4;
+    }
+
+private:
+    typedef std::list<std::shared_ptr<Entry const> > Entries;
+
+    /// Remove the entry at 'pos'; _mutex is held
+    void erase(Entries::iterator pos);
+
+    /// Evict the least recently used entries until 'bytes' more fit; _mutex is held
+    void makeRoom(size_t bytes);
+
+    Mutex mutable                                        _mutex;
+    Entries                                              _lru;     // most recently used first
+    std::unordered_map<std::string, Entries::iterator>   _index;
+    size_t                                               _limit;   // 0 if disabled
+    size_t                                               _bytes;
+};
+
+/**
+ * Collects the chunks and the warnings of a result as the client fetches
+ * them.  The result is cached when the client completes the query, provided
+ * that it fetched every attribute up to its end: a client that stopped short
+ * of the end of any attribute leaves chunks unseen, and nothing is cached.
+ * A result that outgrows QueryResultCache::getMaxEntryBytes() is abandoned.
+ */
+class QueryResultCapture
+{
+public:
+    QueryResultCapture(std::shared_ptr<QueryResultCache::Entry> const& entry, size_t maxBytes);
+
+    /**
+     * Record the next chunk of attribute 'attId', or its end if 'buffer' is NULL
+     */
+    void add(AttributeID attId,
+             Coordinates const& coordinates,
+             uint64_t count,
+             std::shared_ptr<CompressedBuffer> const& buffer);
+
+    /**
+     * Record a warning of the query, to be posted again to the queries that
+     * find the result in the cache
+     */
+    void addWarning(Warning const& warning);
+
+    /**
+     * Called when the client has completed the query: cache the result if the
+     * client fetched all of it
+     * @return true if the result was inserted in the cache
+     */
+    bool finish();
+
+    /**
+     * @return true if the client has fetched every attribute up to its end
+     */
+    bool isDrained() const;
+
+private:
+    Mutex mutable                             _mutex;
+    std::shared_ptr<QueryResultCache::Entry>  _entry;   // NULL once finished or abandoned
+    std::vector<bool>                         _drained; // per attribute
+    size_t                                    _maxBytes;
+};
+
+/**
+ * The result of a query that was found in the cache.  The client messages are
+ * built from the cached chunks directly, see nextCachedChunk(); the array can
+ * also be iterated as any other stream.
+ */
+class CachedResultArray : public StreamArray
+{
+public:
+    CachedResultArray(QueryResultCache::EntryPtr const& entry);
+
+    /**
+     * @return the next chunk of attribute 'attId', or NULL at the end
+     */
+    QueryResultCache::Chunk const* nextCachedChunk(AttributeID attId);
+
+protected:
+    virtual ConstChunk const* nextChunk(AttributeID attId, MemChunk& chunk);
+
+private:
+    QueryResultCache::EntryPtr _entry;
+    std::vector<size_t>        _next;   // per attribute
+};
+
+} // namespace scidb
+
+#endif /* QUERY_RESULT_CACHE_H_ */
@@ -81,6 +81,7 @@ std::ostream& writeStatistics(std::ostream& os, const Statistics& s, size_t tab)
         tabStr << "Recieved " << printSize(s.receivedSize) << printSizeUnit(s.receivedSize) << " (" << s.receivedMessages << " messages)" << endl <<
         tabStr << "Written " << printSize(s.writtenSize) << printSizeUnit(s.writtenSize) << " (" << s.writtenChunks << " chunks)" << endl <<
         tabStr << "Read " << printSize(s.readSize) << printSizeUnit(s.readSize) << " (" << s.readChunks << " chunks)" << endl <<
+        tabStr << "Spilled " << printSize(s.spilledSize) << printSizeUnit(s.spilledSize) << " (" << s.spilledChunks << " chunks)" << endl <<
         tabStr << "Pinned " << printSize(s.pinnedSize) << printSizeUnit(s.pinnedSize) << " (" << s.pinnedChunks << " chunks)" << endl <<
         tabStr << "Allocated " << printSize(s.allocatedSize) << printSizeUnit(s.allocatedSize) << " (" << s.allocatedChunks << " chunks)" << endl;
 
@@ -418,15 +418,61 @@ int Value::Formatter::setPrecision(int p)
 }
 
 
+namespace {
+
+/** Append the decimal digits of 'u' to 'out', with a leading minus sign if 'negative'. */
+void appendDecimal(string& out, uint64_t u, bool negative)
+{
+    char buf[24];
+    char* end = buf + sizeof(buf);
+    char* p = end;
+    do {
+        *--p = static_cast<char>('0' + u % 10);
+        u /= 10;
+    } while (u != 0);
+    if (negative) {
+        *--p = '-';
+    }
+    out.append(p, end - p);
+}
+
+void appendSigned(string& out, int64_t v)
+{
+    // Negate in unsigned arithmetic, so that INT64_MIN does not overflow
+    appendDecimal(out, v < 0 ? 0 - static_cast<uint64_t>(v) : static_cast<uint64_t>(v), v < 0);
+}
+
+void appendUnsigned(string& out, uint64_t v)
+{
+    appendDecimal(out, v, false);
+}
+
+/** Append 'v' as an ostream of precision 'precision' prints it. */
+void appendReal(string& out, double v, int precision)
+{
+    char buf[64];
+    int n = snprintf(buf, sizeof(buf), "%.*g", precision, v);
+    if (n < static_cast<int>(sizeof(buf))) {
+        out.append(buf, n);
+    } else {
+        // Only a precision of more digits than a double has
+        vector<char> big(n + 1);
+        snprintf(&big[0], big.size(), "%.*g", precision, v);
+        out.append(&big[0], n);
+    }
+}
+
+} // namespace
+
 /** Emit TSV representation of a character. */
-void Value::Formatter::tsvChar(stringstream& ss, char ch)
+void Value::Formatter::tsvChar(string& out, char ch)
 {
     switch (ch) {
-    case '\t':  ss << "\\t";    break;
-    case '\n':  ss << "\\n";    break;
-    case '\r':  ss << "\\r";    break;
-    case '\\':  ss << "\\\\";   break;
-    default:    ss << ch;      break;
+    case '\t':  out += "\\t";    break;
+    case '\n':  out += "\\n";    break;
+    case '\r':  out += "\\r";    break;
+    case '\\':  out += "\\\\";   break;
+    default:    out += ch;       break;
     }
 }
 
@@ -437,19 +483,20 @@ void Value::Formatter::tsvChar(stringstream& ss, char ch)
  * we've historically been doing it... for CSV and for the "SciDB text"
  * family of formats.
  */
-void Value::Formatter::quoteCstr(stringstream& ss, const char *s) const
+void Value::Formatter::quoteCstr(string& out, const char *s) const
 {
-    ss << _quote;
+    out += _quote;
     while (char c = *s++) {
         if (c == _quote) {
-            ss << '\\' << c;
+            out += '\\';
+            out += c;
         } else if (c == '\\') {
-            ss << "\\\\";
+            out += "\\\\";
         } else {
-            ss << c;
+            out += c;
         }
     }
-    ss << _quote;
+    out += _quote;
 }
 
 /**
@@ -459,9 +506,15 @@ void Value::Formatter::quoteCstr(stringstream& ss, const char *s) const
  *       use this for a UDT it needs to do a lookup to try and find a UDF.
  */
 string Value::Formatter::format(TypeId const& type, Value const& value) const
+{
+    string out;
+    format(type, value, out);
+    return out;
+}
+
+void Value::Formatter::format(TypeId const& type, Value const& value, string& out) const
 {
     static const string TSV_ESCAPED("\t\r\n\\");
-    stringstream ss;
 
     /*
     ** Start with the most common ones, and do the least common ones
@@ -469,78 +522,74 @@ string Value::Formatter::format(TypeId const& type, Value const& value) const
     */
     if ( value.isNull() ) {
         if (value.getMissingReason() == 0) {
-            ss << _nullRepr;
+            out += _nullRepr;
         } else {
-            // This needs to be cast to integer so that the character
-            // value will not be output to ss.
             // e.g. ?34 not ?" (since ASCII 34 is the " character)
-            ss << '?' << static_cast<int>(value.getMissingReason());
+            out += '?';
+            appendSigned(out, value.getMissingReason());
         }
     } else if ( TID_DOUBLE == type ) {
         double val = value.get<double>();
         if (std::isnan(val)) {
-            ss << _nanRepr;
+            out += _nanRepr;
         }
         else {
-            ss.precision(_precision);
-            ss << val;
+            appendReal(out, val, _precision);
         }
     } else if ( TID_INT64 == type ) {
-        ss << value.get<int64_t>();
+        appendSigned(out, value.get<int64_t>());
     } else if ( TID_INT32 == type ) {
-        ss << value.get<int32_t>();
+        appendSigned(out, value.get<int32_t>());
     } else if ( TID_STRING == type ) {
         char const* str = value.getString();
         if (str == NULL) {
-            ss << _nullRepr;
+            out += _nullRepr;
         } else if (_tsv) {
-            string raw(str);
-            if (raw.find_first_of(TSV_ESCAPED) == string::npos) {
-                ss << raw;
+            if (strpbrk(str, TSV_ESCAPED.c_str()) == NULL) {
+                out += str;
             } else {
                 for (const char* cp = str; *cp; ++cp) {
-                    tsvChar(ss, *cp);
+                    tsvChar(out, *cp);
                 }
             }
         } else {
             // CSV and the SciDB text family of formats handle strings the same way.
-            quoteCstr(ss, str);
+            quoteCstr(out, str);
         }
     } else if ( TID_CHAR == type ) {
         const char ch = value.get<char>();
         if (_tsv) {
-            tsvChar(ss, ch);
+            tsvChar(out, ch);
         } else {
-            ss << '\'';
+            out += '\'';
             if (ch == '\0') {
-                ss << "\\0";
+                out += "\\0";
             } else if (ch == '\n') {
-                ss << "\\n";
+                out += "\\n";
             } else if (ch == '\r') {
-                ss << "\\r";
+                out += "\\r";
             } else if (ch == '\t') {
-                ss << "\\t";
+                out += "\\t";
             } else if (ch == '\f') {
-                ss << "\\f";
+                out += "\\f";
             } else {
                 if (ch == '\'' || ch == '\\') {
-                    ss << '\\';
+                    out += '\\';
                 }
-                ss << ch;
+                out += ch;
             }
-            ss << '\'';
+            out += '\'';
         }
     } else if ( TID_FLOAT == type ) {
         float val = value.get<float>();
         if (std::isnan(val)) {
-            ss << _nanRepr;
+            out += _nanRepr;
         }
         else {
-            ss.precision(_precision);
-            ss << val;
+            appendReal(out, val, _precision);
         }
     } else if (( TID_BOOL == type ) || ( TID_INDICATOR == type )) {
-        ss << boolalpha << value.get<bool>();
+        out += value.get<bool>() ? "true" : "false";
     } else if ( TID_DATETIME == type ) {
 
         char buf[STRFTIME_BUF_LEN];
@@ -550,10 +599,12 @@ string Value::Formatter::format(TypeId const& type, Value const& value) const
         gmtime_r(&dt, &tm);
         strftime(buf, sizeof(buf), DEFAULT_STRFTIME_FORMAT, &tm);
         if (_tsv) {
-            ss << buf;
+            out += buf;
         } else {
             // No quote marks in a timestamp so no need for quoteCstr().
-            ss << _quote << buf << _quote;
+            out += _quote;
+            out += buf;
+            out += _quote;
         }
 
     } else if ( TID_DATETIMETZ == type) {
@@ -574,30 +625,32 @@ string Value::Formatter::format(TypeId const& type, Value const& value) const
                 (int32_t) aoffset/3600,
                 (int32_t) (aoffset%3600)/60);
         if (_tsv) {
-            ss << buf;
+            out += buf;
         } else {
             // No quote marks in a timestamp so no need for quoteCstr().
-            ss << _quote << buf << _quote;
+            out += _quote;
+            out += buf;
+            out += _quote;
         }
     } else if ( TID_INT8 == type ) {
-        ss << static_cast<int>(value.get<int8_t>());
+        appendSigned(out, value.get<int8_t>());
     } else if ( TID_INT16 == type ) {
-        ss << value.get<int16_t>();
+        appendSigned(out, value.get<int16_t>());
     } else if ( TID_UINT8 == type ) {
-        ss << static_cast<int>(value.get<uint8_t>());
+        appendUnsigned(out, value.get<uint8_t>());
     } else if ( TID_UINT16 == type ) {
-        ss << value.get<uint16_t>();
+        appendUnsigned(out, value.get<uint16_t>());
     } else if ( TID_UINT32 == type ) {
-        ss << value.get<uint32_t>();
+        appendUnsigned(out, value.get<uint32_t>());
     } else if ( TID_UINT64 == type ) {
-        ss << value.get<uint64_t>();
+        appendUnsigned(out, value.get<uint64_t>());
     } else if ( TID_VOID == type ) {
-        ss << "<void>";
+        out += "<void>";
     } else  {
-        ss << "<" << type << ">";
+        out += '<';
+        out += type;
+        out += '>';
     }
-
-    return ss.str();
 }
 
 inline char mStringToMonth(const char* s)
@@ -38,8 +38,11 @@
 #include <network/Connection.h>
 #include <network/MessageUtils.h>
 #include <network/NetworkManager.h>
+#include <query/AdmissionController.h>
+#include <query/PreparedPlanCache.h>
 #include <query/QueryPlan.h>
 #include <query/QueryProcessor.h>
+#include <query/QueryResultCache.h>
 #include <query/Serialize.h>
 #include <query/optimizer/Optimizer.h>
 #include <system/Cluster.h>
@@ -125,8 +128,11 @@ class SciDBExecutor: public scidb::SciDB
             throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNREACHABLE_CODE) << "SciDBExecutor::prepareQuery";
         }
 
+        // Substitute the values of the parameters of a prepared statement
+        const std::string boundQueryString = bindQueryParameters(queryString, queryResult.parameters);
+
         // Query string must be of reasonable length!
-        size_t querySize = queryString.size();
+        size_t querySize = boundQueryString.size();
         size_t maxSize = Config::getInstance()->getOption<size_t>(CONFIG_QUERY_MAX_SIZE);
         if (querySize > maxSize) {
             throw SYSTEM_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_QUERY_TOO_BIG) << querySize << maxSize;
@@ -139,7 +145,7 @@ class SciDBExecutor: public scidb::SciDB
         // Create local query object, tie it to our session!
         std::shared_ptr<QueryProcessor> queryProcessor = QueryProcessor::create();
         std::shared_ptr<Query> query = queryProcessor->createQuery(
-            queryString,
+            boundQueryString,
             queryResult.queryID,
             scidb_connection->getSession());
         ASSERT_EXCEPTION(
@@ -156,7 +162,7 @@ class SciDBExecutor: public scidb::SciDB
         StatisticsScope sScope(&query->statistics);
         LOG4CXX_DEBUG(logger, "Parsing query(" << query->getQueryID() << "): "
             << " user_id=" << query->getSession()->getUser().getId()
-            << " " << queryString << "");
+            << " " << boundQueryString << "");
 
         try {
             prepareQueryBeforeLocking(query, queryProcessor, afl, programOptions);
@@ -248,6 +254,21 @@ class SciDBExecutor: public scidb::SciDB
         LOG4CXX_DEBUG(logger, "The query is prepared");
    }
 
+    /**
+     * Make the plan of 'entry' the current physical plan of 'query', in place
+     * of the one the optimizer would make of the logical plan
+     * @return true
+     */
+    bool usePreparedPlan(PreparedPlanCache::EntryPtr const& entry,
+                         std::shared_ptr<QueryProcessor>& queryProcessor,
+                         std::shared_ptr<Query>& query) const
+    {
+        queryProcessor->parsePhysical(entry->plan, query);
+        query->logicalPlan->setRoot(std::shared_ptr<LogicalQueryPlanNode>());
+        LOG4CXX_DEBUG(logger, "The plan of the query is in the cache");
+        return true;
+    }
+
     void executeQuery(const std::string& queryString, bool afl, QueryResult& queryResult, void* connection) const
     {
         const clock_t startClock = clock();
@@ -268,10 +289,25 @@ class SciDBExecutor: public scidb::SciDB
         queryResult.explainLogical = planString.str();
         // Note: Optimization will be performed while execution
         std::shared_ptr<Optimizer> optimizer =  Optimizer::create();
+        QueryResultCache* cache = QueryResultCache::getInstance();
+        cache->init();
+        std::string cacheKey;
+        PreparedPlanCache* planCache = PreparedPlanCache::getInstance();
+        planCache->init();
+        PreparedPlanCache::EntryPtr prepared;
+        std::string planKey;
+        size_t nPlans = 0;
         try {
             query->start();
 
-            while (queryProcessor->optimize(optimizer, query))
+            // A read-only query with the same text over the same catalog as one
+            // optimized before takes its plan from the cache instead
+            planKey = planCache->getKey(query, afl);
+            prepared = planKey.empty() ? PreparedPlanCache::EntryPtr() : planCache->lookup(planKey);
+
+            while ((nPlans == 0 && prepared) ?
+                   usePreparedPlan(prepared, queryProcessor, query) :
+                   queryProcessor->optimize(optimizer, query))
             {
                 LOG4CXX_DEBUG(logger, "Query is optimized");
 
@@ -285,6 +321,37 @@ class SciDBExecutor: public scidb::SciDB
                     LOG4CXX_DEBUG(logger, "\n" + planString.str());
                 }
 
+                // A read-only query over the same array versions as one answered
+                // before takes its result from the cache, without the other instances
+                if (++nPlans == 1 && cache->isEnabled()) {
+                    cacheKey = cache->getKey(query);
+                    QueryResultCache::EntryPtr const entry =
+                        cacheKey.empty() ? QueryResultCache::EntryPtr() : cache->lookup(cacheKey);
+                    if (entry) {
+                        std::ostringstream planString;
+                        query->getCurrentPhysicalPlan()->toString(planString);
+                        query->statistics.explainPhysical += planString.str() + ";";
+                        query->setCurrentResultArray(std::make_shared<CachedResultArray>(entry));
+                        query->setResultFromCache();
+                        for (size_t i = 0; i < entry->warnings.size(); ++i) {
+                            query->postWarning(entry->warnings[i]);
+                        }
+                        LOG4CXX_DEBUG(logger, "The result of the query is in the cache");
+                        break;
+                    }
+                }
+
+                // Reserve the memory of the query before any part of it runs;
+                // a query that does not fit in the pool waits here
+                AdmissionController* admission = AdmissionController::getInstance();
+                if (admission->isEnabled() && query->getMemoryReservation() == 0) {
+                    admission->admit(query, (prepared && queryResult.memoryReservation == 0) ?
+                                     prepared->reservation :
+                                     admission->getReservation(queryResult.memoryReservation,
+                                                               query->getCurrentPhysicalPlan(),
+                                                               query->getInstancesCount()));
+                }
+
                 // Execution of single part of physical plan
                 queryProcessor->preSingleExecute(query);
                 NetworkManager* networkManager = NetworkManager::getInstance();
@@ -296,7 +363,14 @@ class SciDBExecutor: public scidb::SciDB
                     query->statistics.explainPhysical += planString.str() + ";";
 
                     // Serialize physical plan and sending it out
-                    const string physicalPlan = serializePhysicalPlan(query->getCurrentPhysicalPlan());
+                    const string physicalPlan = (nPlans == 1 && prepared) ?
+                        prepared->plan : serializePhysicalPlan(query->getCurrentPhysicalPlan());
+                    if (nPlans == 1 && !prepared && !planKey.empty()) {
+                        planCache->insert(planKey, query, physicalPlan,
+                                          admission->isEnabled() ?
+                                          admission->getReservation(0, query->getCurrentPhysicalPlan(),
+                                                                    query->getInstancesCount()) : 0);
+                    }
                     LOG4CXX_DEBUG(logger, "The query plan is: " << planString.str());
                     LOG4CXX_DEBUG(logger, "The serialized form of the physical plan: queryID="
                                   << queryResult.queryID << ", physicalPlan='" << physicalPlan << "'");
@@ -311,6 +385,7 @@ class SciDBExecutor: public scidb::SciDB
                     Cluster* cluster = Cluster::getInstance();
                     assert(cluster);
                     preparePhysicalPlanRecord->set_cluster_uuid(cluster->getUuid());
+                    preparePhysicalPlanRecord->set_memory_reservation(query->getMemoryReservation());
                     networkManager->broadcastLogical(preparePhysicalPlanMsg);
                     LOG4CXX_DEBUG(logger, "Prepare physical plan was sent out");
                     LOG4CXX_DEBUG(logger, "Waiting confirmation about preparing physical plan in queryID from "
@@ -336,6 +411,11 @@ class SciDBExecutor: public scidb::SciDB
 
                 queryProcessor->postSingleExecute(query);
             }
+
+            std::shared_ptr<Array> resultArray = query->getCurrentResultArray();
+            if (!cacheKey.empty() && nPlans == 1 && resultArray && !query->isResultFromCache()) {
+                query->setResultCapture(cache->startCapture(cacheKey, query, resultArray->getArrayDesc()));
+            }
             query->done();
         } catch (const Exception& e) {
             query->done(e.copy());
@@ -450,8 +450,7 @@ class AggregatePartitioningOperator : public PhysicalOperator
              i < n;
              i++)
         {
-            if (_schema.getEmptyBitmapAttribute() == NULL
-                || _schema.getEmptyBitmapAttribute()->getId() != i)
+            if (_aggs[i])
             {
                 Value defaultNull;
                 defaultNull.setNull(0);
@@ -1142,12 +1141,53 @@ class AggregatePartitioningOperator : public PhysicalOperator
         AutochunkFixer af(getControlCookie());
         af.fix(_schema, inputArrays);
 
-        ArrayDesc const& inArrayDesc = inputArrays[0]->getArrayDesc();
-        initializeOperator(inArrayDesc);
+        initializeOperator(inputArrays[0]->getArrayDesc());
 
+        std::shared_ptr<Array> inputArray = ensureRandomAccess(inputArrays[0], query);
+        std::shared_ptr<Array> mergedArray = aggregateStates(inputArray, query);
+
+        _schema.setDistribution(mergedArray->getArrayDesc().getDistribution());
+        _schema.setResidency(mergedArray->getArrayDesc().getResidency());
+
+        SCIDB_ASSERT(_schema.getDistribution()->checkCompatibility(defaultPartitioning()));
+        SCIDB_ASSERT(_schema.getResidency()->isEqual(query->getDefaultArrayResidency()));
+
+        std::shared_ptr<Array> finalResultArray (std::make_shared<FinalResultArray>(
+                                                _schema, mergedArray, _aggs, _schema.getEmptyBitmapAttribute()));
+        if (_tileMode)
+        {
+            return std::make_shared<MaterializedArray>(finalResultArray, query, MaterializedArray::RLEFormat);
+        }
+        return finalResultArray;
+    }
+
+  protected:
+    /**
+     * Aggregate all the grouped mappings of the random access 'inputArray' into
+     * 'stateArray' a whole input chunk at a time, for operators that can map a
+     * chunk to its groups without visiting every cell.
+     * @return false to have aggregateStates() fall back to the cell by cell
+     * paths, which is all the default does
+     */
+    virtual bool aggregateGroupedChunks(MemArray& stateArray,
+                                        std::shared_ptr<Array>& inputArray,
+                                        std::shared_ptr<Query> const& query)
+    {
+        return false;
+    }
+
+    /**
+     * Aggregate the random access 'inputArray' into the states of the groups,
+     * merged across the instances: the result is in the default partitioning,
+     * with the attributes of createStateDesc().  initializeOperator() must have
+     * been called.
+     */
+    std::shared_ptr<Array>
+    aggregateStates(std::shared_ptr<Array>& inputArray, std::shared_ptr<Query> const& query)
+    {
+        ArrayDesc const& inArrayDesc = inputArray->getArrayDesc();
         ArrayDesc stateDesc = createStateDesc();
         std::shared_ptr<MemArray> stateArray (std::make_shared<MemArray>(stateDesc,query));
-        std::shared_ptr<Array> inputArray = ensureRandomAccess(inputArrays[0], query);
 
         if (_schema.getSize()==1)
         {
@@ -1173,7 +1213,7 @@ class AggregatePartitioningOperator : public PhysicalOperator
                 }
             }
         }
-        else
+        else if (!aggregateGroupedChunks(*stateArray, inputArray, query))
         {
             for (size_t i=0, n=_ioMappings.size(); i<n; i++)
             {
@@ -1201,20 +1241,7 @@ class AggregatePartitioningOperator : public PhysicalOperator
                                                                         query,
                                                                         _aggs);
         stateArray.reset();
-
-        _schema.setDistribution(mergedArray->getArrayDesc().getDistribution());
-        _schema.setResidency(mergedArray->getArrayDesc().getResidency());
-
-        SCIDB_ASSERT(_schema.getDistribution()->checkCompatibility(defaultPartitioning()));
-        SCIDB_ASSERT(_schema.getResidency()->isEqual(query->getDefaultArrayResidency()));
-
-        std::shared_ptr<Array> finalResultArray (std::make_shared<FinalResultArray>(
-                                                _schema, mergedArray, _aggs, _schema.getEmptyBitmapAttribute()));
-        if (_tileMode)
-        {
-            return std::make_shared<MaterializedArray>(finalResultArray, query, MaterializedArray::RLEFormat);
-        }
-        return finalResultArray;
+        return mergedArray;
     }
 };
 
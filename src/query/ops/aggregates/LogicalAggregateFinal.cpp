@@ -0,0 +1,144 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * LogicalAggregateFinal.cpp
+ *
+ *      Description: aggregate_final(), the aggregates of the states kept by aggregate_state()
+ */
+
+#include <query/Operator.h>
+#include <query/Aggregate.h>
+#include <system/Exceptions.h>
+
+namespace scidb {
+
+using namespace std;
+
+/**
+ * @brief The operator: aggregate_final().
+ *
+ * @par Synopsis:
+ *   aggregate_final( viewArray, srcArray {, AGGREGATE_CALL}+ )
+ *
+ * @par Summary:
+ *   Turns the aggregate states of a view stored by aggregate_state() into the values of the
+ *   aggregates, which are what aggregate() returns for the same calls over srcArray.
+ *
+ * @par Input:
+ *   - viewArray: the states, as aggregate_state(srcArray, ...) has stored them.
+ *   - srcArray: the array the states are computed from, which only gives the types of the
+ *     aggregated attributes; it is not read.
+ *   - the aggregate calls that viewArray was computed with, in the same order.
+ *
+ * @par Output array:
+ *        <
+ *   <br>   The aggregate calls' resultNames.
+ *   <br> >
+ *   <br> [
+ *   <br>   The dimensions of viewArray.
+ *   <br> ]
+ *
+ * @par Notes:
+ *   - The groups that aggregate_state() has uninitialized, as they no longer have any cell,
+ *     are not in the output.
+ */
+class LogicalAggregateFinal: public LogicalOperator
+{
+public:
+    LogicalAggregateFinal(const std::string& logicalName, const std::string& alias):
+        LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT()
+        ADD_PARAM_INPUT()
+        ADD_PARAM_VARIES()
+    }
+
+    std::vector<std::shared_ptr<OperatorParamPlaceholder> >
+    nextVaryParamPlaceholder(const std::vector< ArrayDesc> &schemas)
+    {
+        std::vector<std::shared_ptr<OperatorParamPlaceholder> > res;
+        if (!_parameters.empty())
+        {
+            res.push_back(END_OF_VARIES_PARAMS());
+        }
+        res.push_back(PARAM_AGGREGATE_CALL());
+        return res;
+    }
+
+    ArrayDesc inferSchema(vector< ArrayDesc> schemas, std::shared_ptr< Query> query)
+    {
+        assert(schemas.size() == 2);
+        ArrayDesc const& view = schemas[0];
+        ArrayDesc const& input = schemas[1];
+        Attributes const& viewAttrs = view.getAttributes();
+
+        ArrayDesc outSchema(view.getName(), Attributes(), view.getDimensions(),
+                            view.getDistribution(),
+                            view.getResidency());
+
+        for (size_t i = 0; i < _parameters.size(); ++i)
+        {
+            std::shared_ptr<OperatorParamAggregateCall> const& call =
+                (std::shared_ptr<OperatorParamAggregateCall> const&) _parameters[i];
+            std::shared_ptr<OperatorParam> const& attr = call->getInputAttribute();
+            if (attr->getParamType() == PARAM_ATTRIBUTE_REF &&
+                ((std::shared_ptr<OperatorParamReference> const&) attr)->getInputNo() != 1)
+            {
+                throw USER_QUERY_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION,
+                                           attr->getParsingContext())
+                    << "aggregate_final() aggregates the attributes of its second input";
+            }
+
+            string outputName;
+            AggregatePtr agg = resolveAggregate(call, input.getAttributes(), NULL, &outputName);
+            AttributeID const id = safe_static_cast<AttributeID>(outSchema.getAttributes().size());
+            if (id >= viewAttrs.size() ||
+                viewAttrs[id].getName() != outputName ||
+                viewAttrs[id].getType() != agg->getStateType().typeId())
+            {
+                throw USER_QUERY_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION,
+                                           call->getParsingContext())
+                    << "the view does not hold the states of these aggregate calls of aggregate_final()";
+            }
+            outSchema.addAttribute(AttributeDesc(id,
+                                                 outputName,
+                                                 agg->getResultType().typeId(),
+                                                 AttributeDesc::IS_NULLABLE,
+                                                 0));
+        }
+
+        if (view.getEmptyBitmapAttribute())
+        {
+            outSchema.addAttribute(AttributeDesc(safe_static_cast<AttributeID>(outSchema.getAttributes().size()),
+                                                 DEFAULT_EMPTY_TAG_ATTRIBUTE_NAME,
+                                                 TID_INDICATOR,
+                                                 AttributeDesc::IS_EMPTY_INDICATOR,
+                                                 0));
+        }
+        return outSchema;
+    }
+};
+
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalAggregateFinal, "aggregate_final")
+
+}  // namespace scidb
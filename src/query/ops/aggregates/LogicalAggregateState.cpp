@@ -0,0 +1,312 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * LogicalAggregateState.cpp
+ *
+ *      Description: aggregate_state(), the aggregate states of an array,
+ *                   kept up to date incrementally in a view array
+ */
+
+#include <query/Operator.h>
+#include <query/Aggregate.h>
+#include <system/Exceptions.h>
+#include <usr_namespace/NamespacesCommunicator.h>
+
+namespace scidb {
+
+using namespace std;
+
+/**
+ * @brief The operator: aggregate_state().
+ *
+ * @par Synopsis:
+ *   aggregate_state( srcArray {, AGGREGATE_CALL}+ {, groupbyDim}* )
+ *   <br> aggregate_state( srcArray, viewArray {, AGGREGATE_CALL}+ )
+ *
+ * @par Summary:
+ *   Computes the states of the aggregates over groups of cells of a stored array, as
+ *   aggregate() does before it turns them into values.  The states are stored in a view array,
+ *   which aggregate_final() reads as aggregate() would have returned it, and which is kept up
+ *   to date by merging in the states of the chunks written in the later versions of srcArray:
+ *   <br> store(aggregate_state(A, sum(x), count(*), d1), V)
+ *   <br> insert(aggregate_state(A, V, sum(x), count(*)), V)
+ *   <br> aggregate_final(V, A, sum(x), count(*))
+ *
+ * @par Input:
+ *   - srcArray: a stored array.
+ *   - viewArray: the view to refresh, which the first form has stored with the same aggregate
+ *     calls; its dimensions are the groupbyDims.
+ *   - 1 or more aggregate calls, as in aggregate(), which must not be order-sensitive.
+ *   - 0 or more dimensions that together determine the grouping criteria, as in aggregate().
+ *
+ * @par Output array:
+ *        <
+ *   <br>   The aggregate calls' resultNames, of the binary state types of the aggregates.
+ *   <br>   source_id: the versioned id of srcArray that the states are up to date with.
+ *   <br> >
+ *   <br> [
+ *   <br>   The groupbyDims, with the chunk sizes of srcArray, or 'i' if no groupbyDim is provided.
+ *   <br> ]
+ *
+ * @par Notes:
+ *   - When refreshing, only the groups of the chunks of viewArray that cover a chunk of srcArray
+ *     written since the last refresh are in the output.  If such a source chunk replaced an
+ *     older one, the states of the whole view chunk are recomputed; otherwise the new states
+ *     are merged into those in viewArray.  A group that no longer has any cell gets the
+ *     uninitialized states, which aggregate_final() leaves out.
+ *   - The view must have the default distribution.
+ */
+class LogicalAggregateState: public LogicalOperator
+{
+public:
+    LogicalAggregateState(const std::string& logicalName, const std::string& alias):
+        LogicalOperator(logicalName, alias)
+    {
+        ADD_PARAM_INPUT()
+        ADD_PARAM_VARIES()
+    }
+
+    std::vector<std::shared_ptr<OperatorParamPlaceholder> >
+    nextVaryParamPlaceholder(const std::vector< ArrayDesc> &schemas)
+    {
+        std::vector<std::shared_ptr<OperatorParamPlaceholder> > res;
+
+        if (_parameters.empty())
+        {
+            // The view to refresh, or the first aggregate call
+            res.push_back(PARAM_SCHEMA());
+            res.push_back(PARAM_AGGREGATE_CALL());
+            return res;
+        }
+        OperatorParamType const last = _parameters.back()->getParamType();
+        if (last == PARAM_SCHEMA)
+        {
+            res.push_back(PARAM_AGGREGATE_CALL());
+            return res;
+        }
+
+        res.push_back(END_OF_VARIES_PARAMS());
+        if (last == PARAM_AGGREGATE_CALL)
+        {
+            res.push_back(PARAM_AGGREGATE_CALL());
+            if (_parameters[0]->getParamType() != PARAM_SCHEMA)
+            {
+                // The view has the dimensions already
+                res.push_back(PARAM_IN_DIMENSION_NAME());
+            }
+        }
+        else
+        {
+            res.push_back(PARAM_IN_DIMENSION_NAME());
+        }
+        return res;
+    }
+
+    ArrayDesc inferSchema(vector< ArrayDesc> schemas, std::shared_ptr< Query> query)
+    {
+        assert(schemas.size() == 1);
+        ArrayDesc const& input = schemas[0];
+        Dimensions const& inputDims = input.getDimensions();
+
+        ArrayDesc const* view = NULL;
+        if (!_parameters.empty() && _parameters[0]->getParamType() == PARAM_SCHEMA)
+        {
+            resolveView(query);
+            view = &((std::shared_ptr<OperatorParamSchema>&)_parameters[0])->getSchema();
+        }
+
+        // The chunks of the output have the shape of those of the input, so
+        // that every chunk of the input falls in a single chunk of the output
+        Dimensions outDims;
+        if (view)
+        {
+            if (view->getEmptyBitmapAttribute())
+            {
+                Dimensions const& viewDims = view->getDimensions();
+                for (size_t i = 0; i < viewDims.size(); ++i)
+                {
+                    addDimension(inputDims, outDims, viewDims[i].getBaseName(), string());
+                }
+            }
+        }
+        else
+        {
+            for (size_t i = 0; i < _parameters.size(); ++i)
+            {
+                if (_parameters[i]->getParamType() == PARAM_DIMENSION_REF)
+                {
+                    std::shared_ptr<OperatorParamReference> const& reference =
+                        (std::shared_ptr<OperatorParamReference> const&) _parameters[i];
+                    addDimension(inputDims, outDims, reference->getObjectName(), reference->getArrayName());
+                }
+            }
+        }
+
+        bool const grand = outDims.empty();
+        if (grand)
+        {
+            outDims.push_back(DimensionDesc("i", 0, 0, 0, 0, 1, 0));
+        }
+
+        ArrayDesc outSchema(input.getName(), Attributes(), outDims,
+                            defaultPartitioning(),
+                            query->getDefaultArrayResidency());
+
+        for (size_t i = 0; i < _parameters.size(); ++i)
+        {
+            if (_parameters[i]->getParamType() == PARAM_AGGREGATE_CALL)
+            {
+                string outputName;
+                AggregatePtr agg = resolveAggregate((std::shared_ptr<OperatorParamAggregateCall>&) _parameters[i],
+                                                    input.getAttributes(), NULL, &outputName);
+                if (agg->isOrderSensitive())
+                {
+                    throw USER_EXCEPTION(SCIDB_SE_OPERATOR, SCIDB_LE_AGGREGATION_ORDER_MISMATCH) << agg->getName();
+                }
+                outSchema.addAttribute(AttributeDesc(safe_static_cast<AttributeID>(outSchema.getAttributes().size()),
+                                                     outputName,
+                                                     agg->getStateType().typeId(),
+                                                     AttributeDesc::IS_NULLABLE,
+                                                     0));
+            }
+        }
+        outSchema.addAttribute(AttributeDesc(safe_static_cast<AttributeID>(outSchema.getAttributes().size()),
+                                             "source_id",
+                                             TID_INT64,
+                                             0,
+                                             0));
+        if (!grand)
+        {
+            outSchema.addAttribute(AttributeDesc(safe_static_cast<AttributeID>(outSchema.getAttributes().size()),
+                                                 DEFAULT_EMPTY_TAG_ATTRIBUTE_NAME,
+                                                 TID_INDICATOR,
+                                                 AttributeDesc::IS_EMPTY_INDICATOR,
+                                                 0));
+        }
+
+        if (view)
+        {
+            checkView(*view, outSchema);
+        }
+        return outSchema;
+    }
+
+private:
+    void addDimension(Dimensions const& inputDims,
+                      Dimensions& outDims,
+                      string const& dimName,
+                      string const& dimAlias)
+    {
+        for (size_t j = 0, n = inputDims.size(); j < n; j++)
+        {
+            if (inputDims[j].hasNameAndAlias(dimName, dimAlias))
+            {
+                if (inputDims[j].isAutochunked())
+                {
+                    throw USER_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION)
+                        << "aggregate_state() needs the chunk sizes of its input";
+                }
+                outDims.push_back(DimensionDesc(inputDims[j].getBaseName(),
+                                                inputDims[j].getNamesAndAliases(),
+                                                inputDims[j].getStartMin(),
+                                                inputDims[j].getCurrStart(),
+                                                inputDims[j].getCurrEnd(),
+                                                inputDims[j].getEndMax(),
+                                                inputDims[j].getRawChunkInterval(),
+                                                0));
+                return;
+            }
+        }
+        throw SYSTEM_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_DIMENSION_NOT_EXIST)
+            << dimName << "aggregate_state input" << inputDims;
+    }
+
+    /**
+     * Replace the view parameter with the schema of the latest version of
+     * the view as of the start of the query, so that the physical operator
+     * reads the states this query is going to update.
+     */
+    void resolveView(std::shared_ptr<Query> const& query)
+    {
+        std::shared_ptr<OperatorParamSchema>& param = (std::shared_ptr<OperatorParamSchema>&)_parameters[0];
+        string const& viewName = param->getSchema().getName();
+        if (viewName.empty())
+        {
+            throw USER_QUERY_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION,
+                                       param->getParsingContext())
+                << "aggregate_state() needs the name of a stored view";
+        }
+
+        string namespaceName;
+        string arrayName;
+        query->getNamespaceArrayNames(viewName, namespaceName, arrayName);
+        arrayName = ArrayDesc::makeUnversionedName(arrayName);
+
+        ArrayDesc view;
+        ArrayID catalogVersion = query->getCatalogVersion(namespaceName, arrayName);
+        scidb::namespaces::Communicator::getArrayDesc(namespaceName, arrayName, catalogVersion, LAST_VERSION, view);
+        view.setNamespaceName(namespaceName);
+        if (view.isTransient())
+        {
+            throw USER_QUERY_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION,
+                                       param->getParsingContext())
+                << "aggregate_state() needs a view that is not a temporary array";
+        }
+        _parameters[0] = std::make_shared<OperatorParamSchema>(param->getParsingContext(), view);
+    }
+
+    /**
+     * Check that the output can be inserted into the view: the same attributes,
+     * and the same chunks.
+     */
+    void checkView(ArrayDesc const& view, ArrayDesc const& outSchema)
+    {
+        Attributes const& viewAttrs = view.getAttributes();
+        Attributes const& outAttrs = outSchema.getAttributes();
+        bool conforms = viewAttrs.size() == outAttrs.size() &&
+            view.getDimensions().size() == outSchema.getDimensions().size();
+        for (size_t i = 0; conforms && i < outAttrs.size(); ++i)
+        {
+            conforms = viewAttrs[i].getName() == outAttrs[i].getName() &&
+                viewAttrs[i].getType() == outAttrs[i].getType();
+        }
+        for (size_t i = 0; conforms && i < outSchema.getDimensions().size(); ++i)
+        {
+            DimensionDesc const& v = view.getDimensions()[i];
+            DimensionDesc const& o = outSchema.getDimensions()[i];
+            conforms = v.getStartMin() == o.getStartMin() &&
+                v.getRawChunkInterval() == o.getRawChunkInterval() &&
+                v.getChunkOverlap() == 0;
+        }
+        if (!conforms)
+        {
+            throw USER_QUERY_EXCEPTION(SCIDB_SE_INFER_SCHEMA, SCIDB_LE_ILLEGAL_OPERATION,
+                                       _parameters[0]->getParsingContext())
+                << "the view does not hold the states of these aggregate calls of aggregate_state()";
+        }
+    }
+};
+
+DECLARE_LOGICAL_OPERATOR_FACTORY(LogicalAggregateState, "aggregate_state")
+
+}  // namespace scidb
@@ -0,0 +1,145 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * PhysicalAggregateFinal.cpp
+ *
+ *      Description: aggregate_final(), the aggregates of the states kept by aggregate_state()
+ */
+
+#include <array/MemArray.h>
+#include <query/Aggregate.h>
+#include <query/Operator.h>
+
+using namespace std;
+
+namespace scidb
+{
+
+class PhysicalAggregateFinal: public PhysicalOperator
+{
+  public:
+    PhysicalAggregateFinal(const string& logicalName,
+                           const string& physicalName,
+                           const Parameters& parameters,
+                           const ArrayDesc& schema)
+        : PhysicalOperator(logicalName, physicalName, parameters, schema)
+    { }
+
+    /**
+     * The view is read one chunk at a time, and the cells of the groups that
+     * aggregate_state() has uninitialized are left out, so that the output is
+     * materialized rather than delegated.
+     */
+    std::shared_ptr<Array>
+    execute(std::vector< std::shared_ptr<Array> >& inputArrays, std::shared_ptr<Query> query)
+    {
+        std::shared_ptr<Array> view = inputArrays[0];
+        ArrayDesc const& input = inputArrays[1]->getArrayDesc();
+
+        vector<AggregatePtr> aggs;
+        for (size_t i = 0; i < _parameters.size(); ++i)
+        {
+            aggs.push_back(resolveAggregate((std::shared_ptr<OperatorParamAggregateCall>&) _parameters[i],
+                                            input.getAttributes()));
+        }
+        bool const grand = !_schema.getEmptyBitmapAttribute();
+        size_t const nAggs = aggs.size();
+
+        std::shared_ptr<MemArray> output(std::make_shared<MemArray>(_schema, query));
+        vector<std::shared_ptr<ConstArrayIterator> > viewIters(nAggs);
+        vector<std::shared_ptr<ArrayIterator> > outIters(nAggs);
+        for (AttributeID i = 0; i < nAggs; ++i)
+        {
+            viewIters[i] = view->getConstIterator(i);
+            outIters[i] = output->getIterator(i);
+        }
+
+        vector<std::shared_ptr<ConstChunkIterator> > stateIters(nAggs);
+        vector<std::shared_ptr<ChunkIterator> > resultIters(nAggs);
+        vector<Value> results;
+        for (size_t i = 0; i < nAggs; ++i)
+        {
+            results.push_back(Value(aggs[i]->getResultType()));
+        }
+        for (; !viewIters[0]->end(); ++(*viewIters[0]))
+        {
+            Coordinates const& pos = viewIters[0]->getPosition();
+            int mode = ChunkIterator::SEQUENTIAL_WRITE;
+            for (AttributeID i = 0; i < nAggs; ++i)
+            {
+                if (i != 0 && !viewIters[i]->setPosition(pos))
+                {
+                    throw SYSTEM_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+                }
+                stateIters[i] = viewIters[i]->getChunk().getConstIterator();
+                resultIters[i].reset();
+            }
+
+            for (; !stateIters[0]->end(); ++(*stateIters[0]))
+            {
+                Coordinates const& cell = stateIters[0]->getPosition();
+                Value const& first = stateIters[0]->getItem();
+                if (!grand && first.isNull() && first.getMissingReason() == 0)
+                {
+                    // The group is gone
+                    continue;
+                }
+                for (AttributeID i = 0; i < nAggs; ++i)
+                {
+                    if (i != 0 && !stateIters[i]->setPosition(cell))
+                    {
+                        throw SYSTEM_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+                    }
+                    aggs[i]->finalResult(results[i], stateIters[i]->getItem());
+                }
+                for (AttributeID i = 0; i < nAggs; ++i)
+                {
+                    if (!resultIters[i])
+                    {
+                        resultIters[i] = outIters[i]->newChunk(pos).getIterator(query, mode);
+                        mode |= ChunkIterator::NO_EMPTY_CHECK;
+                    }
+                    if (!resultIters[i]->setPosition(cell))
+                    {
+                        throw SYSTEM_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+                    }
+                    resultIters[i]->writeItem(results[i]);
+                }
+            }
+
+            for (AttributeID i = 0; i < nAggs; ++i)
+            {
+                if (resultIters[i])
+                {
+                    resultIters[i]->flush();
+                    resultIters[i].reset();
+                }
+            }
+        }
+        return output;
+    }
+};
+
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalAggregateFinal, "aggregate_final", "physical_aggregate_final")
+
+}  // namespace scidb
@@ -0,0 +1,461 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * PhysicalAggregateState.cpp
+ *
+ *      Description: aggregate_state(), the aggregate states of an array,
+ *                   kept up to date incrementally in a view array
+ */
+
+#include <map>
+
+#include <array/DBArray.h>
+#include <smgr/io/Storage.h>
+#include <system/SystemCatalog.h>
+#include <util/Network.h>
+
+#include "Aggregator.h"
+
+using namespace std;
+
+namespace scidb
+{
+
+namespace
+{
+    /**
+     * The chunks of the input array at the given positions
+     */
+    class ChunkSubsetArray : public DelegateArray
+    {
+        class ArrayIterator : public DelegateArrayIterator
+        {
+        public:
+            ArrayIterator(ChunkSubsetArray const& array, AttributeID attrID,
+                          std::shared_ptr<ConstArrayIterator> inputIterator)
+                : DelegateArrayIterator(array, attrID, inputIterator),
+                  _chunks(array._chunks)
+            {
+                skip();
+            }
+
+            virtual void operator ++()
+            {
+                DelegateArrayIterator::operator ++();
+                skip();
+            }
+
+            virtual bool setPosition(Coordinates const& pos)
+            {
+                chunkInitialized = false;
+                Coordinates chunkPos(pos);
+                array.getArrayDesc().getChunkPositionFor(chunkPos);
+                return _chunks.count(chunkPos) && inputIterator->setPosition(pos);
+            }
+
+            virtual void reset()
+            {
+                DelegateArrayIterator::reset();
+                skip();
+            }
+
+        private:
+            void skip()
+            {
+                while (!inputIterator->end() && !_chunks.count(inputIterator->getPosition())) {
+                    ++(*inputIterator);
+                }
+            }
+
+            CoordinateSet const& _chunks;
+        };
+
+    public:
+        ChunkSubsetArray(std::shared_ptr<Array> const& input, CoordinateSet const& chunks)
+            : DelegateArray(input->getArrayDesc(), input, true),
+              _chunks(chunks)
+        {}
+
+        virtual DelegateArrayIterator* createArrayIterator(AttributeID attrID) const
+        {
+            return new ArrayIterator(*this, attrID, inputArray->getConstIterator(attrID));
+        }
+
+    private:
+        CoordinateSet _chunks;
+    };
+
+    /// @return true if 'state' has been initialized, as Aggregate::isStateInitialized() tells
+    bool isInitialized(Value const& state)
+    {
+        return state.getMissingReason() != 0;
+    }
+
+    /// Send 'buf' to every other instance, and return what they sent
+    vector<std::shared_ptr<SharedBuffer> > allToAll(std::shared_ptr<SharedBuffer> const& buf,
+                                                    std::shared_ptr<Query>& query)
+    {
+        InstanceID const myInstanceId = query->getInstanceID();
+        for (InstanceID i = 0; i < query->getInstancesCount(); ++i) {
+            if (i != myInstanceId) {
+                BufSend(i, buf, query);
+            }
+        }
+        vector<std::shared_ptr<SharedBuffer> > received;
+        for (InstanceID i = 0; i < query->getInstancesCount(); ++i) {
+            if (i != myInstanceId) {
+                received.push_back(BufReceive(i, query));
+            }
+        }
+        return received;
+    }
+}
+
+class PhysicalAggregateState: public AggregatePartitioningOperator
+{
+  private:
+    typedef std::map<Coordinates, vector<Value>, CoordinatesLess> Cells;
+
+    DimensionGrouping _grouping;
+    size_t            _nAggs;
+
+  public:
+    PhysicalAggregateState(const string& logicalName,
+                           const string& physicalName,
+                           const Parameters& parameters,
+                           const ArrayDesc& schema)
+        : AggregatePartitioningOperator(logicalName, physicalName, parameters, schema),
+          _nAggs(0)
+    { }
+
+    virtual void initializeOperator(ArrayDesc const& inputSchema)
+    {
+        AggregatePartitioningOperator::initializeOperator(inputSchema);
+        for (size_t i = 0; i < _parameters.size(); ++i) {
+            _nAggs += (_parameters[i]->getParamType() == PARAM_AGGREGATE_CALL);
+        }
+
+        // The output dimensions are input dimensions by name, see LogicalAggregateState
+        Dimensions groupBy;
+        if (_schema.getEmptyBitmapAttribute()) {
+            Dimensions const& inputDims = inputSchema.getDimensions();
+            Dimensions const& outputDims = _schema.getDimensions();
+            for (size_t i = 0; i < outputDims.size(); ++i) {
+                for (size_t j = 0; j < inputDims.size(); ++j) {
+                    if (inputDims[j].getBaseName() == outputDims[i].getBaseName()) {
+                        groupBy.push_back(inputDims[j]);
+                        break;
+                    }
+                }
+            }
+        }
+        _grouping = DimensionGrouping(inputSchema.getDimensions(), groupBy);
+    }
+
+    virtual void transformCoordinates(CoordinateCRange inPos,CoordinateRange outPos)
+    {
+        assert(!outPos.empty());
+        _grouping.reduceToGroup(inPos,outPos);
+    }
+
+    std::shared_ptr<Array>
+    execute(std::vector< std::shared_ptr<Array> >& inputArrays, std::shared_ptr<Query> query)
+    {
+        ArrayDesc const& srcDesc = inputArrays[0]->getArrayDesc();
+        if (!std::dynamic_pointer_cast<DBArray>(inputArrays[0]) || srcDesc.getId() == srcDesc.getUAId()) {
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_ILLEGAL_OPERATION)
+                << "aggregate_state() needs a stored array as its input";
+        }
+        initializeOperator(srcDesc);
+
+        ArrayDesc const* view = NULL;
+        if (_parameters[0]->getParamType() == PARAM_SCHEMA) {
+            view = &((std::shared_ptr<OperatorParamSchema>&)_parameters[0])->getSchema();
+            if (!view->getDistribution()->checkCompatibility(defaultPartitioning()) ||
+                !view->getResidency()->isEqual(query->getDefaultArrayResidency())) {
+                throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_ILLEGAL_OPERATION)
+                    << "aggregate_state() needs a view in the default distribution";
+            }
+        }
+
+        std::shared_ptr<Array> viewArray;
+        ArrayID since = 0;
+        if (view && view->getId() != view->getUAId()) {
+            viewArray = DBArray::newDBArray(*view, query);
+            since = getRefreshedVersion(viewArray, query);
+        }
+        if (since > srcDesc.getId()) {
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_ILLEGAL_OPERATION)
+                << "the view of aggregate_state() is newer than its input";
+        }
+
+        std::shared_ptr<Array> inputArray = inputArrays[0];
+        CoordinateSet recompute;
+        CoordinateSet append;
+        if (since != 0) {
+            CoordinateSet sourceChunks;
+            findChangedChunks(srcDesc, since, recompute, append, sourceChunks, query);
+            if (recompute.empty() && append.empty()) {
+                return std::make_shared<MemArray>(_schema, query);
+            }
+            inputArray = std::make_shared<ChunkSubsetArray>(inputArray, sourceChunks);
+        }
+        inputArray = ensureRandomAccess(inputArray, query);
+        std::shared_ptr<Array> mergedArray = aggregateStates(inputArray, query);
+
+        if (since == 0) {
+            std::shared_ptr<ConstArrayIterator> it = mergedArray->getConstIterator(0);
+            for (; !it->end(); ++(*it)) {
+                append.insert(it->getPosition());
+            }
+        }
+        return writeStates(mergedArray, viewArray, recompute, append, srcDesc.getId(), query);
+    }
+
+  private:
+    /**
+     * @return the versioned id of the input the view was last refreshed
+     * from, the largest source_id in the view
+     */
+    ArrayID getRefreshedVersion(std::shared_ptr<Array> const& viewArray, std::shared_ptr<Query>& query)
+    {
+        int64_t since = 0;
+        std::shared_ptr<ConstArrayIterator> it =
+            viewArray->getConstIterator(safe_static_cast<AttributeID>(_nAggs));
+        for (; !it->end(); ++(*it)) {
+            std::shared_ptr<ConstChunkIterator> ci = it->getChunk().getConstIterator();
+            for (; !ci->end(); ++(*ci)) {
+                since = std::max(since, ci->getItem().getInt64());
+            }
+        }
+
+        std::shared_ptr<SharedBuffer> buf(std::make_shared<MemoryBuffer>(&since, sizeof(since)));
+        vector<std::shared_ptr<SharedBuffer> > received = allToAll(buf, query);
+        for (size_t i = 0; i < received.size(); ++i) {
+            since = std::max(since, *static_cast<int64_t const*>(received[i]->getData()));
+        }
+        return since;
+    }
+
+    Coordinates getViewChunk(Coordinates const& sourceChunk)
+    {
+        return _grouping.reduceToGroup(sourceChunk);
+    }
+
+    /**
+     * Find the chunks of the view to update since the version 'since' of the
+     * source: the chunks that only gained source chunks are appended to, the
+     * others are recomputed.  Return the positions of the local source chunks
+     * to aggregate for them in 'sourceChunks'.
+     */
+    void findChangedChunks(ArrayDesc const& srcDesc,
+                           ArrayID since,
+                           CoordinateSet& recompute,
+                           CoordinateSet& append,
+                           CoordinateSet& sourceChunks,
+                           std::shared_ptr<Query>& query)
+    {
+        std::shared_ptr<ArrayDesc> prevDesc = SystemCatalog::getInstance()->getArrayDesc(since);
+        if (prevDesc->getUAId() != srcDesc.getUAId()) {
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_ILLEGAL_OPERATION)
+                << "the view of aggregate_state() was not computed from its input";
+        }
+
+        Storage& storage = StorageManager::getInstance();
+        vector<pair<Coordinates, bool> > local;   // and whether written since
+        StorageAddress addr;
+        while (storage.findNextChunk(srcDesc, query, addr)) {
+            bool const fresh = addr.arrId > since;
+            local.push_back(make_pair(addr.coords, fresh));
+            if (fresh) {
+                StorageAddress prev(since, 0, addr.coords);
+                if (storage.findChunk(*prevDesc, query, prev)) {
+                    recompute.insert(getViewChunk(addr.coords));
+                } else {
+                    append.insert(getViewChunk(addr.coords));
+                }
+            }
+        }
+        // The chunks that were removed since
+        addr = StorageAddress();
+        while (storage.findNextChunk(*prevDesc, query, addr)) {
+            StorageAddress current(srcDesc.getId(), 0, addr.coords);
+            if (!storage.findChunk(srcDesc, query, current)) {
+                recompute.insert(getViewChunk(addr.coords));
+            }
+        }
+
+        exchangeChunks(recompute, append, query);
+
+        for (size_t i = 0; i < local.size(); ++i) {
+            Coordinates const viewChunk = getViewChunk(local[i].first);
+            if (recompute.count(viewChunk) || (local[i].second && append.count(viewChunk))) {
+                sourceChunks.insert(local[i].first);
+            }
+        }
+        LOG4CXX_DEBUG(aggLogger, "aggregate_state() since " << since << ": recomputing "
+                      << recompute.size() << " and appending to " << append.size()
+                      << " view chunks from " << sourceChunks.size() << " of "
+                      << local.size() << " local source chunks");
+    }
+
+    /**
+     * Make the view chunks to update the same on all instances; a chunk
+     * recomputed anywhere is recomputed everywhere.
+     */
+    void exchangeChunks(CoordinateSet& recompute, CoordinateSet& append, std::shared_ptr<Query>& query)
+    {
+        size_t const nCoords = (recompute.size() + append.size()) * _outDims;
+        std::shared_ptr<SharedBuffer> buf(std::make_shared<MemoryBuffer>(
+            static_cast<void*>(NULL), 2 * sizeof(uint64_t) + nCoords * sizeof(Coordinate)));
+        uint64_t* hdr = static_cast<uint64_t*>(buf->getData());
+        hdr[0] = recompute.size();
+        hdr[1] = append.size();
+        Coordinate* coords = reinterpret_cast<Coordinate*>(hdr + 2);
+        for (CoordinateSet::const_iterator i = recompute.begin(); i != recompute.end(); ++i) {
+            coords = std::copy(i->begin(), i->end(), coords);
+        }
+        for (CoordinateSet::const_iterator i = append.begin(); i != append.end(); ++i) {
+            coords = std::copy(i->begin(), i->end(), coords);
+        }
+
+        vector<std::shared_ptr<SharedBuffer> > received = allToAll(buf, query);
+        for (size_t i = 0; i < received.size(); ++i) {
+            uint64_t const* rhdr = static_cast<uint64_t const*>(received[i]->getData());
+            Coordinate const* rcoords = reinterpret_cast<Coordinate const*>(rhdr + 2);
+            for (uint64_t j = 0; j < rhdr[0] + rhdr[1]; ++j, rcoords += _outDims) {
+                Coordinates const pos(rcoords, rcoords + _outDims);
+                (j < rhdr[0] ? recompute : append).insert(pos);
+            }
+        }
+        for (CoordinateSet::const_iterator i = recompute.begin(); i != recompute.end(); ++i) {
+            append.erase(*i);
+        }
+    }
+
+    /**
+     * Read the states of the cells of 'array' in its chunk at 'pos' into 'cells';
+     * a cell whose first state is uninitialized is not a group.
+     */
+    void readStates(std::shared_ptr<Array> const& array, Coordinates const& pos, Cells& cells)
+    {
+        for (AttributeID i = 0; i < _nAggs; ++i) {
+            std::shared_ptr<ConstArrayIterator> it = array->getConstIterator(i);
+            if (!it->setPosition(pos)) {
+                return;
+            }
+            std::shared_ptr<ConstChunkIterator> ci = it->getChunk().getConstIterator();
+            for (; !ci->end(); ++(*ci)) {
+                Value const& state = ci->getItem();
+                if (i == 0) {
+                    if (isInitialized(state)) {
+                        cells[ci->getPosition()].resize(_nAggs);
+                        cells[ci->getPosition()][0] = state;
+                    }
+                } else {
+                    Cells::iterator c = cells.find(ci->getPosition());
+                    if (c != cells.end()) {
+                        c->second[i] = state;
+                    }
+                }
+            }
+        }
+    }
+
+    /**
+     * Bring in the states of the view at 'pos': merge them into the new ones
+     * of the chunks appended to, and uninitialize the groups that are gone
+     * from the chunks recomputed.
+     */
+    void mergeView(std::shared_ptr<Array> const& viewArray, Coordinates const& pos, bool recompute, Cells& cells)
+    {
+        Value tombstone;
+        tombstone.setNull(0);
+        for (AttributeID i = 0; i < _nAggs; ++i) {
+            std::shared_ptr<ConstArrayIterator> it = viewArray->getConstIterator(i);
+            if (!it->setPosition(pos)) {
+                return;
+            }
+            std::shared_ptr<ConstChunkIterator> ci = it->getChunk().getConstIterator();
+            for (; !ci->end(); ++(*ci)) {
+                Value const& state = ci->getItem();
+                Cells::iterator c = cells.find(ci->getPosition());
+                if (c != cells.end()) {
+                    if (!recompute) {
+                        _aggs[i]->mergeIfNeeded(c->second[i], state);
+                    }
+                } else if (recompute && i == 0 && isInitialized(state)) {
+                    cells[ci->getPosition()] = vector<Value>(_nAggs, tombstone);
+                }
+            }
+        }
+    }
+
+    std::shared_ptr<Array> writeStates(std::shared_ptr<Array> const& mergedArray,
+                                       std::shared_ptr<Array> const& viewArray,
+                                       CoordinateSet const& recompute,
+                                       CoordinateSet const& append,
+                                       ArrayID sourceId,
+                                       std::shared_ptr<Query> const& query)
+    {
+        std::shared_ptr<MemArray> output(std::make_shared<MemArray>(_schema, query));
+        vector<std::shared_ptr<ArrayIterator> > outIters(_nAggs + 1);
+        for (AttributeID i = 0; i < outIters.size(); ++i) {
+            outIters[i] = output->getIterator(i);
+        }
+        Value source;
+        source.setInt64(sourceId);
+
+        CoordinateSet const* const updated[] = { &recompute, &append };
+        for (size_t u = 0; u < 2; ++u) {
+            for (CoordinateSet::const_iterator p = updated[u]->begin(); p != updated[u]->end(); ++p) {
+                Cells cells;
+                readStates(mergedArray, *p, cells);
+                if (viewArray) {
+                    mergeView(viewArray, *p, u == 0, cells);
+                }
+                if (cells.empty()) {
+                    continue;
+                }
+
+                int mode = ChunkIterator::SEQUENTIAL_WRITE;
+                for (AttributeID i = 0; i < outIters.size(); ++i) {
+                    std::shared_ptr<ChunkIterator> ci = outIters[i]->newChunk(*p).getIterator(query, mode);
+                    mode |= ChunkIterator::NO_EMPTY_CHECK;
+                    for (Cells::const_iterator c = cells.begin(); c != cells.end(); ++c) {
+                        if (!ci->setPosition(c->first)) {
+                            throw SYSTEM_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+                        }
+                        ci->writeItem(i < _nAggs ? c->second[i] : source);
+                    }
+                    ci->flush();
+                }
+            }
+        }
+        return output;
+    }
+};
+
+DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalAggregateState, "aggregate_state", "physical_aggregate_state")
+
+}  // namespace scidb
@@ -27,6 +27,7 @@
  *              Donghui Zhang
  */
 
+#include <algorithm>
 #include <memory>
 #include <boost/foreach.hpp>
 #include <unordered_map>
@@ -34,6 +35,8 @@
 #include <array/StreamArray.h>
 #include <util/CoordinatesToKey.h>
 #include <query/Operator.h>
+#include <system/Config.h>
+#include <util/Job.h>
 #include <util/SchemaUtils.h>
 
 using namespace std;
@@ -99,23 +102,31 @@ public:
         : _aggregate(aggregate), _tempValue(_aggregate->getResultType())
         {}
 
+        /**
+         * Copy the states of another object, to be accumulated into with a different aggregate object
+         * of the same aggregate function.
+         */
+        HashOfAggregateStates(HashOfAggregateStates const& other, AggregatePtr const& aggregate)
+        : _hash(other._hash), _aggregate(aggregate), _tempValue(_aggregate->getResultType())
+        {}
+
         /**
          * Accumulate a value, or merge a state, into a cell.
          * @param[in] pos       a cell position; note that it is the caller's responsibility to change the coordinate in the aggregate dimension
          * @param[in] v         a value or state to accumulate into the structure
          * @param[in] isState   whether v is a state
+         * @return the updated state of the cell
          *
          */
-        void accumulateOrMerge(Coordinates const& pos, Value const& v, bool isState)
+        Value const& accumulateOrMerge(Coordinates const& pos, Value const& v, bool isState)
         {
+            // Existing cells are updated in place, without copying the key or the state.
             Coords2Value::iterator it = _hash.find(pos);
-            Value state(_aggregate->getStateType());
             if (it == _hash.end()) {
-                _aggregate->initializeState(state);
-            }
-            else {
-                state = it->second;
+                it = _hash.insert(std::make_pair(pos, Value(_aggregate->getStateType()))).first;
+                _aggregate->initializeState(it->second);
             }
+            Value& state = it->second;
 
             if (isState) {
                 _aggregate->mergeIfNeeded(state, v);
@@ -123,7 +134,7 @@ public:
             else {
                 _aggregate->accumulateIfNeeded(state, v);
             }
-            _hash[pos] = state;
+            return state;
         }
 
         /**
@@ -136,8 +147,8 @@ public:
          */
         Value const& accumulateOrMergeAndReturnFinalResult(Coordinates const& pos, Value const& v, bool isState)
         {
-            accumulateOrMerge(pos, v, isState);
-            _aggregate->finalResult(_tempValue, _hash[pos]);
+            Value const& state = accumulateOrMerge(pos, v, isState);
+            _aggregate->finalResult(_tempValue, state);
             return _tempValue;
         }
 
@@ -213,6 +224,11 @@ public:
         }
     };
 
+    /**
+     * For every output attribute, the states of the cells before a chunk along the aggrDim.
+     */
+    typedef vector<std::shared_ptr<HashOfAggregateStates> > Carries;
+
     /**
      * The variables passed from execute() to sub-routines, in addition to those in CommonVariablesInExecute.
      */
@@ -220,28 +236,125 @@ public:
     {
         size_t _numAggrs;                    /// number of aggregate functions == _aggregates.size() == _inputAttrIDs.size() == number of output attributues
         size_t _aggrDim;                     /// the dimension to aggregate on
+        size_t _nJobs;                       /// the number of jobs each parallel pass is split into
         vector<AggregatePtr> _aggregates;    /// the aggregates, one per output attribute
         vector<AttributeID> _inputAttrIDs;   /// the attributes in the input array, to compute aggregates on
+        vector<Coordinates> _localChunkPos;  /// the chunkPos of every local chunk of the input array
         std::shared_ptr<Array> _localEdges;       /// the local edges, i.e. the aggregation state built using data in each local chunk
         std::shared_ptr<Array> _allEdges;         /// local edges from all instances put together
-        std::shared_ptr<MapOfVectorsOfChunkPos> _mapOfVectorsInRemoteEdges;  /// MapOfVectorsOfChunkPos in the remote edges, i.e. in _allEdges but not in _localEdges
+        std::shared_ptr<MapOfVectorsOfChunkPos> _mapOfVectorsInAllEdges;     /// MapOfVectorsOfChunkPos in _allEdges
         std::shared_ptr<MapOfVectorsOfChunkPos> _mapOfVectorsInInputArray;   /// MapOfVectorsOfChunkPos in the input array
-        std::shared_ptr<CoordinatesToKey> _cellPosToKey;                     /// a tool to turn a cell position to a key, by replacing the coordinate in the aggrDim with 0
+        unordered_map<Coordinates, Carries, CoordinatesHash> _carries;       /// the carries into every local chunk of the input array
     };
 
     /**
-     * Build the local edges.
+     * A job that runs one of the two parallel passes over the local chunks of the input array:
+     * the id-th chunk, the (id+nJobs)-th chunk, and so on.
+     * A job has its own aggregates and iterators, so the jobs share nothing they modify.
+     */
+    class CumulateJob : public Job
+    {
+    public:
+        enum Pass
+        {
+            BUILD_LOCAL_EDGES,   /// build the local edges of the chunks
+            CUMULATE             /// generate the output chunks, starting from the carries into them
+        };
+
+    private:
+        PhysicalCumulate& _op;
+        Pass _pass;
+        size_t _id;
+        CommonVariablesInExecute const& _commonVars;
+        MyVariablesInExecute const& _myVars;
+        vector<AggregatePtr> _aggregates;
+
+    public:
+        /**
+         * @note The aggregates are resolved here rather than in run(), so that the aggregate library is only used
+         *       by the thread of the query.
+         */
+        CumulateJob(PhysicalCumulate& op, Pass pass, size_t id,
+                    CommonVariablesInExecute const& commonVars, MyVariablesInExecute const& myVars)
+        : Job(commonVars._query),
+          _op(op),
+          _pass(pass),
+          _id(id),
+          _commonVars(commonVars),
+          _myVars(myVars)
+        {
+            _op.resolveAggregates(commonVars, _aggregates, NULL);
+        }
+
+    protected:
+        virtual void run()
+        {
+            AttributeID aggrsCount = safe_static_cast<AttributeID>(_myVars._numAggrs);
+            vector<std::shared_ptr<ConstArrayIterator> > inputArrayIters(aggrsCount);
+            vector<std::shared_ptr<ArrayIterator> > outputArrayIters(aggrsCount);
+            std::shared_ptr<Array> const& outputArray =
+                _pass == BUILD_LOCAL_EDGES ? _myVars._localEdges : _commonVars._output._array;
+            for (AttributeID i = 0; i < aggrsCount; ++i) {
+                inputArrayIters[i] = _commonVars._input._array->getConstIterator(_myVars._inputAttrIDs[i]);
+                outputArrayIters[i] = outputArray->getIterator(i);
+            }
+
+            for (size_t i = _id; i < _myVars._localChunkPos.size(); i += _myVars._nJobs) {
+                Query::validateQueryPtr(_query);
+                Coordinates const& chunkPos = _myVars._localChunkPos[i];
+                if (_pass == BUILD_LOCAL_EDGES) {
+                    _op.buildLocalEdge(_commonVars, _myVars, chunkPos, _aggregates, inputArrayIters, outputArrayIters);
+                }
+                else {
+                    _op.cumulateChunk(_commonVars, _myVars, chunkPos, _aggregates, inputArrayIters, outputArrayIters);
+                }
+            }
+        }
+    };
+
+    /**
+     * Resolve the aggregate calls.
+     * @param[in]  commonVars    variables in CommonVariablesInExecute
+     * @param[out] aggregates    the aggregates, one per output attribute
+     * @param[out] inputAttrIDs  if not NULL, the attributes in the input array to scan, one per output attribute
+     */
+    void resolveAggregates(CommonVariablesInExecute const& commonVars,
+                           vector<AggregatePtr>& aggregates,
+                           vector<AttributeID>* inputAttrIDs)
+    {
+        size_t numAggrs = commonVars._output._attrsWithoutET.size();
+        aggregates.resize(numAggrs);
+        if (inputAttrIDs) {
+            inputAttrIDs->resize(numAggrs);
+        }
+
+        for (size_t i = 0; i<numAggrs; i++) {
+            assert( _parameters[i]->getParamType() == PARAM_AGGREGATE_CALL );
+
+            AttributeID inputAttrID = INVALID_ATTRIBUTE_ID;
+            aggregates[i] = resolveAggregate(
+                    (std::shared_ptr <OperatorParamAggregateCall> const&) _parameters[i],
+                    commonVars._input._attrsWithoutET,
+                    &inputAttrID,
+                    0);
+
+            // If an aggregate has a star, such as count(*), inputAttrID will be -1.
+            // We should replace with 0, so that we know which attribute in the input array to scan.
+            //
+            if (inputAttrIDs) {
+                (*inputAttrIDs)[i] = (inputAttrID == INVALID_ATTRIBUTE_ID ? 0 : inputAttrID);
+            }
+        }
+    }
+
+    /**
+     * Create the array of the local edges.
      * @param[in] commonVars  variables in CommonVariablesInExecute
      * @param[in] myVars      variables in MyVariablesInExecute
-     * @return what should be assigned to myVars._localEdges
-     *
-     * @pre The variables in MyVariablesInExecute, before the one to be generated in this routine, should already be assigned.
-     * @note chunks at the end of the aggrDim do not need to have its local edge built, because such local edges won't be used.
+     * @return what should be assigned to myVars._localEdges, before it is filled by the BUILD_LOCAL_EDGES jobs
      */
-    std::shared_ptr<MemArray> buildLocalEdges(CommonVariablesInExecute const& commonVars, MyVariablesInExecute const& myVars)
+    std::shared_ptr<MemArray> createLocalEdges(CommonVariablesInExecute const& commonVars, MyVariablesInExecute const& myVars)
     {
-        // Create an array.
-        //
         Attributes attrsEdge(myVars._numAggrs);
         AttributeID aggrsCount = safe_static_cast<AttributeID>(myVars._numAggrs);
         for (AttributeID i=0; i < aggrsCount; ++i) {
@@ -254,7 +367,7 @@ public:
                     );
         }
 
-        std::shared_ptr<MemArray> localEdges = make_shared<MemArray>(
+        return make_shared<MemArray>(
             ArrayDesc(commonVars._output._schema.getName(),
                       addEmptyTagAttribute(attrsEdge),
                       commonVars._output._dims,
@@ -262,161 +375,142 @@ public:
                       commonVars._output._schema.getResidency() ),
             commonVars._query
             );
+    }
 
-        // Fill in data.
+    /**
+     * Build the local edge of one input chunk, i.e. the aggregate states of every 'vector' of cells in the chunk
+     * along the aggrDim, and write it to the local edges at the chunk's chunkPos.
+     *
+     * @param[in] commonVars        variables in CommonVariablesInExecute
+     * @param[in] myVars            variables in MyVariablesInExecute
+     * @param[in] inputChunkPos     the chunkPos of the input chunk
+     * @param[in] aggregates        the aggregates of the calling job
+     * @param[in] inputArrayIters   the calling job's iterators of the input array, one per output attribute
+     * @param[in] localEdgesIters   the calling job's iterators of the local edges, one per output attribute
+     *
+     * @note chunks at the end of the aggrDim do not need to have its local edge built, because such local edges won't be used.
+     */
+    void buildLocalEdge(CommonVariablesInExecute const& commonVars,
+                        MyVariablesInExecute const& myVars,
+                        Coordinates const& inputChunkPos,
+                        vector<AggregatePtr> const& aggregates,
+                        vector<std::shared_ptr<ConstArrayIterator> > const& inputArrayIters,
+                        vector<std::shared_ptr<ArrayIterator> > const& localEdgesIters)
+    {
+        // skip, if this chunk is at the end of the aggrDim
         //
-        for (AttributeID outputAttr = 0; outputAttr < myVars._numAggrs; ++outputAttr) {
-            std::shared_ptr<ConstArrayIterator> inputArrayIter = commonVars._input._array->getConstIterator(myVars._inputAttrIDs[outputAttr]);
-            std::shared_ptr<ArrayIterator> localEdgesArrayIter = localEdges->getIterator(outputAttr);
-
-            while (!inputArrayIter->end()) {
-                Coordinates const& inputChunkPos = inputArrayIter->getPosition();
-
-                // skip, if this chunk is at the end of the aggrDim
-                //
-                if (inputChunkPos[myVars._aggrDim] + commonVars._input._dims[myVars._aggrDim].getChunkInterval() > commonVars._input._dims[myVars._aggrDim].getEndMax()) {
-                    ++(*inputArrayIter);
-                    continue;
-                }
-
-                ConstChunk const& inputChunk = inputArrayIter->getChunk();
-                std::shared_ptr<ConstChunkIterator> inputChunkIter = inputChunk.getConstIterator();
-
-                // an object to convert a cell Coordinates to a key, i.e. by replacing the coordinate in aggrDim with that in chunkPos
-                //
-                CoordinatesToKey coordsToKey;
-                coordsToKey.addKeyConstraint(myVars._aggrDim, inputChunkPos[myVars._aggrDim]);
-
-                // Fill an EdgeVector with aggregate states of all cells in the chunk
-                //
-                HashOfAggregateStates edgeVector(myVars._aggregates[outputAttr]);
-
-                while (!inputChunkIter->end()) {
-                    Value const& v = inputChunkIter->getItem();
-                    Coordinates const& cellPos = inputChunkIter->getPosition();
-                    edgeVector.accumulateOrMerge(coordsToKey.toKey(cellPos), v, false);  // false = not state
-
-                    ++(*inputChunkIter);
-                }
+        DimensionDesc const& aggrDimDesc = commonVars._input._dims[myVars._aggrDim];
+        if (inputChunkPos[myVars._aggrDim] + aggrDimDesc.getChunkInterval() > aggrDimDesc.getEndMax()) {
+            return;
+        }
 
-                // Generate a chunk in localEdges, at inputArray's chunkPos.
-                //
-                Chunk& chunk = localEdgesArrayIter->newChunk(inputChunkPos);
+        // an object to convert a cell Coordinates to a key, i.e. by replacing the coordinate in aggrDim with that in chunkPos
+        //
+        CoordinatesToKey coordsToKey;
+        coordsToKey.addKeyConstraint(myVars._aggrDim, inputChunkPos[myVars._aggrDim]);
 
-                int iterMode = ChunkIterator::SEQUENTIAL_WRITE;
-                if (outputAttr != 0) {
-                    iterMode |= ChunkIterator::NO_EMPTY_CHECK;
-                }
-                std::shared_ptr<ChunkIterator> localEdgesChunkIter = chunk.getIterator(commonVars._query, iterMode);
+        for (AttributeID outputAttr = 0; outputAttr < myVars._numAggrs; ++outputAttr) {
+            bool mustSucceed = inputArrayIters[outputAttr]->setPosition(inputChunkPos);
+            SCIDB_ASSERT(mustSucceed);
+            std::shared_ptr<ConstChunkIterator> inputChunkIter = inputArrayIters[outputAttr]->getChunk().getConstIterator();
 
-                std::map<Coordinates, Value> tempMap;
-                for (Coords2Value::iterator it = edgeVector.getHash().begin(); it != edgeVector.getHash().end(); ++it ) {
-                    tempMap[it->first] = it->second;
-                }
+            // Fill an EdgeVector with aggregate states of all cells in the chunk
+            //
+            HashOfAggregateStates edgeVector(aggregates[outputAttr]);
 
-                for (std::map<Coordinates, Value>::iterator it = tempMap.begin(); it != tempMap.end(); ++it ) {
-                    Coordinates const& pos = it->first;
-                    Value const& v = it->second;
-                    bool mustSucceed = localEdgesChunkIter->setPosition(pos);
-                    SCIDB_ASSERT(mustSucceed);
-                    localEdgesChunkIter->writeItem(v);
-                }
-                localEdgesChunkIter->flush();
-                localEdgesChunkIter.reset();
+            while (!inputChunkIter->end()) {
+                Value const& v = inputChunkIter->getItem();
+                Coordinates const& cellPos = inputChunkIter->getPosition();
+                edgeVector.accumulateOrMerge(coordsToKey.toKey(cellPos), v, false);  // false = not state
 
-                ++(*inputArrayIter);
-            } // while (!inputArrayIter->end())
-        } // for (AttributeID outputAttr = 0; outputAttr < myVars._numAggrs; ++outputAttr)
+                ++(*inputChunkIter);
+            }
 
-        return localEdges;
-    }
+            // Generate a chunk in localEdges, at inputArray's chunkPos.
+            //
+            Chunk& chunk = localEdgesIters[outputAttr]->newChunk(inputChunkPos);
 
-    /**
-     * Build a MapOfVectorsOfChunkPos for all chunkPos in the remote edges.
-     *
-     * @param[in] commonVars  variables in CommonVariablesInExecute
-     * @param[in] myVars      variables in MyVariablesInExecute
-     * @return what should be assigned to myVars._mapOfVectorsInRemoteEdges
-     *
-     * @pre The variables in MyVariablesInExecute, before the one to be generated in this routine, should already be assigned.
-     */
-    std::shared_ptr<MapOfVectorsOfChunkPos> buildMapOfVectorsInRemoteEdges(CommonVariablesInExecute const& commonVars, MyVariablesInExecute const& myVars)
-    {
-        std::shared_ptr<MapOfVectorsOfChunkPos> mapOfVectorsInRemoteEdges = make_shared<MapOfVectorsOfChunkPos>(myVars._aggrDim);
-        std::shared_ptr<ConstArrayIterator> localEdgesArrayIter = myVars._localEdges->getConstIterator(0);
+            int iterMode = ChunkIterator::SEQUENTIAL_WRITE;
+            if (outputAttr != 0) {
+                iterMode |= ChunkIterator::NO_EMPTY_CHECK;
+            }
+            std::shared_ptr<ChunkIterator> localEdgesChunkIter = chunk.getIterator(commonVars._query, iterMode);
 
-        std::shared_ptr<CoordinateSet> chunkPosAllEdges = myVars._allEdges->findChunkPositions();
+            std::map<Coordinates, Value> tempMap;
+            for (Coords2Value::iterator it = edgeVector.getHash().begin(); it != edgeVector.getHash().end(); ++it ) {
+                tempMap[it->first] = it->second;
+            }
 
-        for (CoordinateSet::const_iterator itSet=chunkPosAllEdges->begin(); itSet!=chunkPosAllEdges->end(); ++itSet) {
-            // only push if this is a remote chunk
-            if (!localEdgesArrayIter->setPosition(*itSet)) {
-                mapOfVectorsInRemoteEdges->append(*itSet);
+            for (std::map<Coordinates, Value>::iterator it = tempMap.begin(); it != tempMap.end(); ++it ) {
+                Coordinates const& pos = it->first;
+                Value const& v = it->second;
+                mustSucceed = localEdgesChunkIter->setPosition(pos);
+                SCIDB_ASSERT(mustSucceed);
+                localEdgesChunkIter->writeItem(v);
             }
+            localEdgesChunkIter->flush();
         }
-
-        return mapOfVectorsInRemoteEdges;
     }
 
     /**
-     * Build a MapOfVectorsOfChunkPos for all chunkPos in the input array.
+     * Build a MapOfVectorsOfChunkPos for all chunkPos in an array.
      *
-     * @param[in] commonVars  variables in CommonVariablesInExecute
-     * @param[in] myVars      variables in MyVariablesInExecute
-     * @return what should be assigned to myVars._mapOfVectorsInInputArray
-     *
-     * @pre The variables in MyVariablesInExecute, before the one to be generated in this routine, should already be assigned.
+     * @param[in] myVars  variables in MyVariablesInExecute
+     * @param[in] array   the array
+     * @return what should be assigned to myVars._mapOfVectorsInAllEdges or myVars._mapOfVectorsInInputArray
      */
-    std::shared_ptr<MapOfVectorsOfChunkPos> buildMapOfVectorsInInputArray(CommonVariablesInExecute const& commonVars, MyVariablesInExecute const& myVars)
+    std::shared_ptr<MapOfVectorsOfChunkPos> buildMapOfVectors(MyVariablesInExecute const& myVars, std::shared_ptr<Array> const& array)
     {
-        std::shared_ptr<MapOfVectorsOfChunkPos> mapOfVectorsInInputArray = make_shared<MapOfVectorsOfChunkPos>(myVars._aggrDim);
-        std::shared_ptr<CoordinateSet> chunkPosInputArray = commonVars._input._array->findChunkPositions();
+        std::shared_ptr<MapOfVectorsOfChunkPos> mapOfVectors = make_shared<MapOfVectorsOfChunkPos>(myVars._aggrDim);
+        std::shared_ptr<CoordinateSet> chunkPos = array->findChunkPositions();
 
-        for (CoordinateSet::const_iterator itSet=chunkPosInputArray->begin(); itSet!=chunkPosInputArray->end(); ++itSet) {
-            mapOfVectorsInInputArray->append(*itSet);
+        for (CoordinateSet::const_iterator itSet=chunkPos->begin(); itSet!=chunkPos->end(); ++itSet) {
+            mapOfVectors->append(*itSet);
         }
 
-        return mapOfVectorsInInputArray;
+        return mapOfVectors;
     }
 
     /**
-     * doCumulate: the real work to generate cumulate() result.
+     * Compute the carries into the local chunks of the input array, i.e. prefix-combine the edges of all instances
+     * along the aggrDim.
+     * The edges only hold one state per 'vector' of cells per chunk, so this sequential pass is cheap compared to the
+     * passes over the cells.
      *
      * @param[in] commonVars  variables in CommonVariablesInExecute
      * @param[in] myVars      variables in MyVariablesInExecute
+     * @param[out] carries    what should be assigned to myVars._carries
      */
-    void doCumulate(CommonVariablesInExecute const& commonVars, MyVariablesInExecute const& myVars)
+    void buildCarries(CommonVariablesInExecute const& commonVars,
+                      MyVariablesInExecute const& myVars,
+                      unordered_map<Coordinates, Carries, CoordinatesHash>& carries)
     {
-        // one attribute at a time in the outputArray
+        // A utility object that turns each cellPos to a 'key', i.e. by turning the coordinate in aggrDim to 0.
         //
+        CoordinatesToKey cellPosToKey;
+        cellPosToKey.addKeyConstraint(myVars._aggrDim, 0);
+
         for (AttributeID outputAttr = 0; outputAttr < myVars._numAggrs; outputAttr++) {
-            // array iterators
-            //
-            AttributeID inputAttr = myVars._inputAttrIDs[outputAttr];
-            std::shared_ptr<ConstArrayIterator> inputArrayIter = commonVars._input._array->getConstIterator(inputAttr);
-            std::shared_ptr<ConstArrayIterator> remoteEdgesArrayIter = myVars._allEdges->getConstIterator(outputAttr);
-            std::shared_ptr<ArrayIterator> outputArrayIter = commonVars._output._array->getIterator(outputAttr);
+            std::shared_ptr<ConstArrayIterator> allEdgesArrayIter = myVars._allEdges->getConstIterator(outputAttr);
 
             // for every vector of input chunks
             //
-            // Reminder:
-            // typedef unordered_map<Key=Coordinates, std::shared_ptr<VectorOfChunkPos> > MapOfVectorsOfChunkPos::KeyToVectorOfChunkPos;
-            //
             for (MapOfVectorsOfChunkPos::KeyToVectorOfChunkPos::const_iterator itMapOfVectorsInInputArray = myVars._mapOfVectorsInInputArray->_map.begin();
                     itMapOfVectorsInInputArray != myVars._mapOfVectorsInInputArray->_map.end();
                     ++itMapOfVectorsInInputArray)
             {
-                // Initialize an empty beginEdge
+                // the merged edges of all the chunks so far in the vector
                 //
                 HashOfAggregateStates beginEdge(myVars._aggregates[outputAttr]);
 
-                // Get an iterator into the matching vector in remote edges.
+                // Get an iterator into the matching vector in the edges.
                 //
-                MapOfVectorsOfChunkPos::KeyToVectorOfChunkPos::const_iterator itMapOfVectorsInRemoteEdges =
-                        myVars._mapOfVectorsInRemoteEdges->_map.find(itMapOfVectorsInInputArray->first);
-                bool hasRemoteEdges = (itMapOfVectorsInRemoteEdges != myVars._mapOfVectorsInRemoteEdges->_map.end());
-                vector<Coordinates>::const_iterator itVectorInRemoteEdges;
-                if (hasRemoteEdges) {
-                    itVectorInRemoteEdges = itMapOfVectorsInRemoteEdges->second->begin();
+                MapOfVectorsOfChunkPos::KeyToVectorOfChunkPos::const_iterator itMapOfVectorsInAllEdges =
+                        myVars._mapOfVectorsInAllEdges->_map.find(itMapOfVectorsInInputArray->first);
+                bool hasEdges = (itMapOfVectorsInAllEdges != myVars._mapOfVectorsInAllEdges->_map.end());
+                vector<Coordinates>::const_iterator itVectorInAllEdges;
+                if (hasEdges) {
+                    itVectorInAllEdges = itMapOfVectorsInAllEdges->second->begin();
                 }
 
                 // for every chunkPos in the vector (of the input array)
@@ -427,72 +521,134 @@ public:
                         itVectorInInputArray != vectorInInputArray.end();
                         ++itVectorInInputArray)
                 {
-                    Coordinates const& chunkPosInput = *itVectorInInputArray;
+                    Coordinates const& coordsInInputArray = *itVectorInInputArray;
 
-                    // Aggregate into beginEdge the edges from the matching vector in remoteEdges,
+                    // Aggregate into beginEdge the edges from the matching vector,
                     // whose aggrDim's coordinate < that of the chunk in the input array.
                     //
-                    while (hasRemoteEdges && itVectorInRemoteEdges != itMapOfVectorsInRemoteEdges->second->end()) {
-                        Coordinates const& coordsInInputArray = *itVectorInInputArray;
-                        Coordinates const& coordsInRemoteEdges = *itVectorInRemoteEdges;
-
-                        // Have we gone too far in remoteEdges?
-                        if ( coordsInRemoteEdges[myVars._aggrDim] >= coordsInInputArray[myVars._aggrDim]) {
-                            // sanity check; remote edges and local chunks should not overlap
-                            assert(coordsInRemoteEdges[myVars._aggrDim] > coordsInInputArray[myVars._aggrDim]);
+                    while (hasEdges && itVectorInAllEdges != itMapOfVectorsInAllEdges->second->end()) {
+                        Coordinates const& coordsInAllEdges = *itVectorInAllEdges;
 
+                        // Have we gone far enough in the edges?
+                        if ( coordsInAllEdges[myVars._aggrDim] >= coordsInInputArray[myVars._aggrDim]) {
                             break;
                         }
 
-                        // Merge the remote edge into beginEdge
+                        // Merge the edge into beginEdge
                         //
-                        bool mustSucceed = remoteEdgesArrayIter->setPosition(coordsInRemoteEdges);
+                        bool mustSucceed = allEdgesArrayIter->setPosition(coordsInAllEdges);
                         SCIDB_ASSERT(mustSucceed);
-                        ConstChunk const& chunk = remoteEdgesArrayIter->getChunk();
-                        std::shared_ptr<ConstChunkIterator> remoteEdgesChunkIter = chunk.getConstIterator();
+                        ConstChunk const& chunk = allEdgesArrayIter->getChunk();
+                        std::shared_ptr<ConstChunkIterator> edgesChunkIter = chunk.getConstIterator();
 
-                        while (!remoteEdgesChunkIter->end()) {
-                            Coordinates const& cellPos = remoteEdgesChunkIter->getPosition();
-                            Coordinates const& keyFromCellPos = myVars._cellPosToKey->toKey(cellPos);
-                            beginEdge.accumulateOrMerge(keyFromCellPos, remoteEdgesChunkIter->getItem(), true); // state
+                        while (!edgesChunkIter->end()) {
+                            Coordinates const& cellPos = edgesChunkIter->getPosition();
+                            beginEdge.accumulateOrMerge(cellPosToKey.toKey(cellPos), edgesChunkIter->getItem(), true); // state
 
-                            ++(*remoteEdgesChunkIter);
+                            ++(*edgesChunkIter);
                         }
 
-                        ++itVectorInRemoteEdges;
-                    } // while (hasRemoteEdges && itVectorInRemoteEdges != itMapOfVectorsInRemoteEdges->second->end())
+                        ++itVectorInAllEdges;
+                    } // while (hasEdges && itVectorInAllEdges != itMapOfVectorsInAllEdges->second->end())
 
-                    // Scan the input chunk and generate the output chunk
+                    // The carry into the chunk is a snapshot of beginEdge.
                     //
-                    bool mustSucceed = inputArrayIter->setPosition(chunkPosInput);
-                    SCIDB_ASSERT(mustSucceed);
-                    ConstChunk const& chunkInput = inputArrayIter->getChunk();
-                    std::shared_ptr<ConstChunkIterator> inputChunkIter = chunkInput.getConstIterator();
-                    Chunk& outputChunk = outputArrayIter->newChunk(chunkPosInput);
-                    int iterMode = ChunkIterator::SEQUENTIAL_WRITE;
-                    if (outputAttr!=0) {
-                        iterMode |= ChunkIterator::NO_EMPTY_CHECK;
-                    }
-                    std::shared_ptr<ChunkIterator> outputChunkIter = outputChunk.getIterator(commonVars._query, iterMode);
-
-                    while (!inputChunkIter->end()) {
-                        Coordinates const& cellPos =inputChunkIter->getPosition();
-                        Coordinates const& keyFromCellPos = myVars._cellPosToKey->toKey(cellPos);
-                        Value const& aggregateResult = beginEdge.accumulateOrMergeAndReturnFinalResult(
-                                keyFromCellPos, inputChunkIter->getItem(), false); // not state
-                        outputChunkIter->setPosition(cellPos);
-                        outputChunkIter->writeItem(aggregateResult);
-
-                        ++(*inputChunkIter);
-                    }
-
-                    // flush the output chunk
-                    outputChunkIter->flush();
+                    Carries& chunkCarries = carries[coordsInInputArray];
+                    chunkCarries.resize(myVars._numAggrs);
+                    chunkCarries[outputAttr] = make_shared<HashOfAggregateStates>(beginEdge);
                 } // for (vector<Coordinates>::const_iterator itVectorInInputArray = vectorInInputArray.begin();
             } // for (MapOfVectorsOfChunkPos::KeyToVectorOfChunkPos::const_iterator itMapOfVectorsInInputArray = myVars._mapOfVectorsInInputArray->_map.begin();
         } // for (AttributeID outputAttr = 0; outputAttr < commonVars._numAggrs; outputAttr++)
     }
 
+    /**
+     * Generate the output chunk at the chunkPos of one input chunk, accumulating its cells on top of the carry into it.
+     *
+     * @param[in] commonVars        variables in CommonVariablesInExecute
+     * @param[in] myVars            variables in MyVariablesInExecute
+     * @param[in] chunkPosInput     the chunkPos of the input chunk
+     * @param[in] aggregates        the aggregates of the calling job
+     * @param[in] inputArrayIters   the calling job's iterators of the input array, one per output attribute
+     * @param[in] outputArrayIters  the calling job's iterators of the output array, one per output attribute
+     */
+    void cumulateChunk(CommonVariablesInExecute const& commonVars,
+                       MyVariablesInExecute const& myVars,
+                       Coordinates const& chunkPosInput,
+                       vector<AggregatePtr> const& aggregates,
+                       vector<std::shared_ptr<ConstArrayIterator> > const& inputArrayIters,
+                       vector<std::shared_ptr<ArrayIterator> > const& outputArrayIters)
+    {
+        unordered_map<Coordinates, Carries, CoordinatesHash>::const_iterator itCarries = myVars._carries.find(chunkPosInput);
+        SCIDB_ASSERT(itCarries != myVars._carries.end());
+
+        CoordinatesToKey cellPosToKey;
+        cellPosToKey.addKeyConstraint(myVars._aggrDim, 0);
+
+        for (AttributeID outputAttr = 0; outputAttr < myVars._numAggrs; outputAttr++) {
+            // Start from a copy of the carry, as other chunks of the vector may be generated at the same time.
+            //
+            HashOfAggregateStates beginEdge(*itCarries->second[outputAttr], aggregates[outputAttr]);
+
+            // Scan the input chunk and generate the output chunk
+            //
+            bool mustSucceed = inputArrayIters[outputAttr]->setPosition(chunkPosInput);
+            SCIDB_ASSERT(mustSucceed);
+            ConstChunk const& chunkInput = inputArrayIters[outputAttr]->getChunk();
+            std::shared_ptr<ConstChunkIterator> inputChunkIter = chunkInput.getConstIterator();
+            Chunk& outputChunk = outputArrayIters[outputAttr]->newChunk(chunkPosInput);
+            int iterMode = ChunkIterator::SEQUENTIAL_WRITE;
+            if (outputAttr!=0) {
+                iterMode |= ChunkIterator::NO_EMPTY_CHECK;
+            }
+            std::shared_ptr<ChunkIterator> outputChunkIter = outputChunk.getIterator(commonVars._query, iterMode);
+
+            while (!inputChunkIter->end()) {
+                Coordinates const& cellPos =inputChunkIter->getPosition();
+                Coordinates const& keyFromCellPos = cellPosToKey.toKey(cellPos);
+                Value const& aggregateResult = beginEdge.accumulateOrMergeAndReturnFinalResult(
+                        keyFromCellPos, inputChunkIter->getItem(), false); // not state
+                outputChunkIter->setPosition(cellPos);
+                outputChunkIter->writeItem(aggregateResult);
+
+                ++(*inputChunkIter);
+            }
+
+            // flush the output chunk
+            outputChunkIter->flush();
+        } // for (AttributeID outputAttr = 0; outputAttr < commonVars._numAggrs; outputAttr++)
+    }
+
+    /**
+     * Run a parallel pass over the local chunks of the input array, in myVars._nJobs jobs.
+     *
+     * @param[in] pass        the pass to run
+     * @param[in] commonVars  variables in CommonVariablesInExecute
+     * @param[in] myVars      variables in MyVariablesInExecute
+     */
+    void runJobs(CumulateJob::Pass pass, CommonVariablesInExecute const& commonVars, MyVariablesInExecute const& myVars)
+    {
+        std::shared_ptr<JobQueue> queue = PhysicalOperator::getGlobalQueueForOperators();
+
+        vector< std::shared_ptr<CumulateJob> > jobs(myVars._nJobs);
+        for (size_t i = 0; i < myVars._nJobs; i++) {
+            jobs[i] = make_shared<CumulateJob>(*this, pass, i, commonVars, myVars);
+        }
+        for (size_t i = 1; i < myVars._nJobs; i++) {
+            queue->pushJob(jobs[i]);
+        }
+
+        jobs[0]->execute();
+
+        int errorJob = -1;
+        for (size_t i = 0; i < myVars._nJobs; i++) {
+            if (!jobs[i]->wait()) {
+                errorJob = safe_static_cast<int>(i);
+            }
+        }
+        if (errorJob >= 0) {
+            jobs[errorJob]->rethrow();
+        }
+    }
     /**
      * @see PhysicalOperator::execute()
      */
@@ -541,29 +697,21 @@ public:
 
         // get the vector of aggregate functions and the vector of input attrIDs
         //
-        myVars._aggregates.resize(myVars._numAggrs);
-        myVars._inputAttrIDs.resize(myVars._numAggrs);
-
-        for (size_t i = 0; i<myVars._numAggrs; i++) {
-            assert( _parameters[i]->getParamType() == PARAM_AGGREGATE_CALL );
-
-            myVars._aggregates[i] = resolveAggregate(
-                    (std::shared_ptr <OperatorParamAggregateCall> const&) _parameters[i],
-                    commonVars._input._attrsWithoutET,
-                    &myVars._inputAttrIDs[i],
-                    0);
+        resolveAggregates(commonVars, myVars._aggregates, &myVars._inputAttrIDs);
 
-            // If an aggregate has a star, such as count(*), inputAttrIDs[i] will be -1.
-            // We should replace with 0, so that we know which attribute in the input array to scan.
-            //
-            if (myVars._inputAttrIDs[i] == INVALID_ATTRIBUTE_ID) {
-                myVars._inputAttrIDs[i] = 0;
-            }
-        }
+        // The local chunks are split among the jobs of each parallel pass.
+        //
+        std::shared_ptr<CoordinateSet> chunkPosInputArray = inputArray->findChunkPositions();
+        myVars._localChunkPos.assign(chunkPosInputArray->begin(), chunkPosInputArray->end());
+        size_t const nThreads = static_cast<size_t>(
+            std::max(Config::getInstance()->getOption<int>(CONFIG_RESULT_PREFETCH_QUEUE_SIZE), 1));
+        myVars._nJobs = std::max(std::min(nThreads, myVars._localChunkPos.size()), size_t(1));
 
         // Build localEdges, a MemArray that stores one aggregate state per 'vector' of values in each local chunk of inputArray.
+        // This is the first parallel pass: every chunk's edge only depends on the chunk.
         //
-        myVars._localEdges = buildLocalEdges(commonVars, myVars);
+        myVars._localEdges = createLocalEdges(commonVars, myVars);
+        runJobs(CumulateJob::BUILD_LOCAL_EDGES, commonVars, myVars);
 
         // Generate allEdges, by putting together every instance's localEdges.
         //
@@ -573,24 +721,20 @@ public:
                                                       _schema.getResidency(),
                                                       query);
 
-        // Generate a map of vector<chunkPos> for chunks in _allEdges, but not in _localEdges.
-        // The key of the map is chunkPos, with the coordinate in aggrDim replaced with 0.
-        //
-        myVars._mapOfVectorsInRemoteEdges = buildMapOfVectorsInRemoteEdges(commonVars, myVars);
-
-        // Generate a map of vector<chunkPos> for chunks in inputArray.
-        // The key of the map is chunkPos, with the coordinate in aggrDim replaced with 0.
+        // Generate a map of vector<chunkPos> for chunks in _allEdges, and one for chunks in inputArray.
+        // The key of the maps is chunkPos, with the coordinate in aggrDim replaced with 0.
         //
-        myVars._mapOfVectorsInInputArray = buildMapOfVectorsInInputArray(commonVars, myVars);
+        myVars._mapOfVectorsInAllEdges = buildMapOfVectors(myVars, myVars._allEdges);
+        myVars._mapOfVectorsInInputArray = buildMapOfVectors(myVars, inputArray);
 
-        // A utility object that turns each cellPos to a 'key', i.e. by turning the coordinate in aggrDim to 0.
+        // Prefix-combine the edges along the aggrDim into the carry into every local chunk.
         //
-        myVars._cellPosToKey = make_shared<CoordinatesToKey>();
-        myVars._cellPosToKey->addKeyConstraint(myVars._aggrDim, 0);
+        buildCarries(commonVars, myVars, myVars._carries);
 
         // Generate the cumulate() result.
+        // This is the second parallel pass: every output chunk only depends on the input chunk and the carry into it.
         //
-        doCumulate(commonVars, myVars);
+        runJobs(CumulateJob::CUMULATE, commonVars, myVars);
 
         // return the result
         //
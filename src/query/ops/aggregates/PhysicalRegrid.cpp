@@ -27,6 +27,12 @@
  *      Author: poliocough@gmail.com
  */
 
+#include <map>
+
+#include <system/Config.h>
+#include <util/CoordinatesMapper.h>
+#include <util/Job.h>
+
 #include "Aggregator.h"
 
 using namespace std;
@@ -39,6 +45,103 @@ class PhysicalRegrid: public AggregatePartitioningOperator
   private:
      vector<uint64_t> _grid;
 
+     /**
+      * The most grid cells a job keeps the states of, per aggregate, for one
+      * output chunk. An output chunk whose local cells spread further than
+      * this, as in a sparse array with large chunks, makes regrid fall back to
+      * the cell by cell path of AggregatePartitioningOperator.
+      */
+     static size_t const MAX_BLOCK_CELLS = 1024 * 1024;
+
+     /**
+      * A local output chunk: the box of its grid cells that the local input
+      * chunks map to, and those input chunks.
+      */
+     struct OutputBlock
+     {
+         Coordinates    position;
+         Coordinates    low;
+         Coordinates    high;
+         vector<size_t> inputChunks;
+     };
+
+     /**
+      * The output blocks and how to fill them, shared by the jobs.
+      */
+     struct BlockPlan
+     {
+         vector<Coordinates> inputChunkPos;   /// the positions of the local input chunks
+         vector<OutputBlock> blocks;          /// the local output chunks, in order of position
+         vector<bool>        skipNulls;       /// per mapping: whether the cells with null values are skipped
+         size_t              nJobs;           /// the number of jobs the blocks are split into
+     };
+
+     /**
+      * A job that builds the id-th output block, the (id+nJobs)-th block, and
+      * so on, for every mapping. A job has its own aggregates and iterators,
+      * and each block is built by a single job, so the jobs share nothing they
+      * modify but the state array, whose chunks are each written by one job.
+      */
+     class RegridJob : public Job
+     {
+       private:
+         PhysicalRegrid& _op;
+         size_t _id;
+         BlockPlan const& _plan;
+         MemArray& _stateArray;
+         std::shared_ptr<Array> const& _inputArray;
+         vector< vector<AggregatePtr> > _aggs;
+
+       public:
+         RegridJob(PhysicalRegrid& op, size_t id, BlockPlan const& plan, MemArray& stateArray,
+                   std::shared_ptr<Array> const& inputArray, std::shared_ptr<Query> const& query)
+         : Job(query),
+           _op(op),
+           _id(id),
+           _plan(plan),
+           _stateArray(stateArray),
+           _inputArray(inputArray),
+           _aggs(op._ioMappings.size())
+         {
+             for (size_t m = 0; m < _aggs.size(); ++m)
+             {
+                 AggIOMapping const& mapping = _op._ioMappings[m];
+                 for (size_t i = 0, n = mapping.size(); i < n; ++i)
+                 {
+                     _aggs[m].push_back(mapping.getAggregate(i)->clone());
+                 }
+             }
+         }
+
+       protected:
+         virtual void run()
+         {
+             size_t const nMappings = _aggs.size();
+             vector<std::shared_ptr<ConstArrayIterator> > inputIters(nMappings);
+             vector<vector<std::shared_ptr<ArrayIterator> > > stateIters(nMappings);
+             for (size_t m = 0; m < nMappings; ++m)
+             {
+                 AggIOMapping const& mapping = _op._ioMappings[m];
+                 inputIters[m] = _inputArray->getConstIterator(mapping.getInputAttributeId());
+                 for (size_t i = 0, n = mapping.size(); i < n; ++i)
+                 {
+                     stateIters[m].push_back(_stateArray.getIterator(mapping.getOutputAttributeId(i)));
+                 }
+             }
+
+             std::shared_ptr<Query> query(Query::getValidQueryPtr(_query));
+             for (size_t i = _id; i < _plan.blocks.size(); i += _plan.nJobs)
+             {
+                 Query::validateQueryPtr(_query);
+                 for (size_t m = 0; m < nMappings; ++m)
+                 {
+                     _op.aggregateBlock(_plan.blocks[i], _plan.inputChunkPos, _aggs[m], _plan.skipNulls[m],
+                                        *inputIters[m], stateIters[m], query);
+                 }
+             }
+         }
+     };
+
   public:
      PhysicalRegrid(const string& logicalName, const string& physicalName, const Parameters& parameters, const ArrayDesc& schema):
          AggregatePartitioningOperator(logicalName, physicalName, parameters, schema)
@@ -62,6 +165,313 @@ class PhysicalRegrid: public AggregatePartitioningOperator
             outPos[i] = _schema.getDimensions()[i].getStartMin() + (inPos[i] - _schema.getDimensions()[i].getStartMin())/_grid[i];
         }
     }
+
+  protected:
+    /**
+     * The box of an input chunk maps to a box of grid cells, which a fixed
+     * division tells, so each local output chunk is built from the input
+     * chunks whose boxes overlap it, into a dense block of states, by jobs
+     * that run in parallel. The runs of cells of an input chunk that go to the
+     * same grid cell are accumulated with Aggregate::accumulatePayload(). The
+     * partial chunks of the other instances are then merged as for any other
+     * aggregation, by the AggregateChunkMerger of the redistribution.
+     */
+    virtual bool aggregateGroupedChunks(MemArray& stateArray,
+                                        std::shared_ptr<Array>& inputArray,
+                                        std::shared_ptr<Query> const& query)
+    {
+        BlockPlan plan;
+        for (size_t m = 0, n = _ioMappings.size(); m < n; ++m)
+        {
+            AggregationFlags aggFlags = composeGroupedFlags(inputArray, _ioMappings[m]);
+            if (aggFlags.iterationMode & ConstChunkIterator::IGNORE_DEFAULT_VALUES)
+            {
+                return false;
+            }
+            logMapping(_ioMappings[m], aggFlags);
+            plan.skipNulls.push_back(aggFlags.iterationMode & ConstChunkIterator::IGNORE_NULL_VALUES);
+        }
+
+        std::shared_ptr<CoordinateSet> chunkPositions = inputArray->findChunkPositions();
+        plan.inputChunkPos.assign(chunkPositions->begin(), chunkPositions->end());
+        if (!planBlocks(inputArray->getArrayDesc(), plan))
+        {
+            LOG4CXX_DEBUG(aggLogger, "regrid: output blocks too large, aggregating cell by cell");
+            return false;
+        }
+
+        std::shared_ptr<Array> input(inputArray);
+        if (!input->isMaterialized())
+        {
+            input = std::make_shared<MemArray>(input, query);
+        }
+
+        size_t const nThreads = static_cast<size_t>(
+            std::max(Config::getInstance()->getOption<int>(CONFIG_RESULT_PREFETCH_QUEUE_SIZE), 1));
+        plan.nJobs = std::max(std::min(nThreads, plan.blocks.size()), size_t(1));
+
+        std::shared_ptr<JobQueue> queue = PhysicalOperator::getGlobalQueueForOperators();
+        vector< std::shared_ptr<RegridJob> > jobs(plan.nJobs);
+        for (size_t i = 0; i < plan.nJobs; i++)
+        {
+            jobs[i] = std::make_shared<RegridJob>(*this, i, plan, stateArray, input, query);
+        }
+        for (size_t i = 1; i < plan.nJobs; i++)
+        {
+            queue->pushJob(jobs[i]);
+        }
+
+        jobs[0]->execute();
+
+        int errorJob = -1;
+        for (size_t i = 0; i < plan.nJobs; i++)
+        {
+            if (!jobs[i]->wait())
+            {
+                errorJob = safe_static_cast<int>(i);
+            }
+        }
+        if (errorJob >= 0)
+        {
+            jobs[errorJob]->rethrow();
+        }
+        return true;
+    }
+
+  private:
+    /**
+     * Find the output chunks that the boxes of the input chunks of 'plan' map
+     * to, and the box of grid cells of each that they cover.
+     * @return false if a block has more than MAX_BLOCK_CELLS cells
+     */
+    bool planBlocks(ArrayDesc const& inputDesc, BlockPlan& plan)
+    {
+        Dimensions const& inDims = inputDesc.getDimensions();
+        Dimensions const& outDims = _schema.getDimensions();
+        map<Coordinates, OutputBlock, CoordinatesLess> blocks;
+        Coordinates inLast(_inDims), first(_outDims), last(_outDims);
+
+        for (size_t i = 0; i < plan.inputChunkPos.size(); ++i)
+        {
+            Coordinates const& inFirst = plan.inputChunkPos[i];
+            for (size_t d = 0; d < _inDims; ++d)
+            {
+                inLast[d] = std::min(inFirst[d] + inDims[d].getChunkInterval() - 1, inDims[d].getEndMax());
+            }
+            transformCoordinates(inFirst, first);
+            transformCoordinates(inLast, last);
+
+            // Visit every output chunk that the box [first, last] overlaps
+            Coordinates firstChunk(first);
+            _schema.getChunkPositionFor(firstChunk);
+            Coordinates chunkPos(firstChunk);
+            while (true)
+            {
+                OutputBlock& block = blocks[chunkPos];
+                if (block.inputChunks.empty())
+                {
+                    block.position = chunkPos;
+                    block.low.assign(_outDims, CoordinateBounds::getMax());
+                    block.high.assign(_outDims, CoordinateBounds::getMin());
+                }
+                for (size_t d = 0; d < _outDims; ++d)
+                {
+                    Coordinate const chunkEnd = chunkPos[d] + outDims[d].getChunkInterval() - 1;
+                    block.low[d] = std::min(block.low[d], std::max(first[d], chunkPos[d]));
+                    block.high[d] = std::max(block.high[d], std::min(last[d], chunkEnd));
+                }
+                block.inputChunks.push_back(i);
+
+                size_t d = _outDims;
+                for (; d != 0; --d)
+                {
+                    chunkPos[d-1] += outDims[d-1].getChunkInterval();
+                    if (chunkPos[d-1] <= last[d-1])
+                    {
+                        break;
+                    }
+                    chunkPos[d-1] = firstChunk[d-1];
+                }
+                if (d == 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        plan.blocks.reserve(blocks.size());
+        for (map<Coordinates, OutputBlock, CoordinatesLess>::iterator i = blocks.begin(); i != blocks.end(); ++i)
+        {
+            size_t nCells = 1;
+            for (size_t d = 0; d < _outDims; ++d)
+            {
+                size_t const length = i->second.high[d] - i->second.low[d] + 1;
+                if (length > MAX_BLOCK_CELLS / nCells)
+                {
+                    return false;
+                }
+                nCells *= length;
+            }
+            plan.blocks.push_back(i->second);
+        }
+        return true;
+    }
+
+    /**
+     * Accumulate the cells of the input chunks of 'block' into a dense block of
+     * states, one per grid cell and aggregate, then write the states of the grid
+     * cells that got any to the chunk of the block in the state array.
+     */
+    void aggregateBlock(OutputBlock const& block,
+                        vector<Coordinates> const& inputChunkPos,
+                        vector<AggregatePtr> const& aggs,
+                        bool skipNulls,
+                        ConstArrayIterator& inputIter,
+                        vector<std::shared_ptr<ArrayIterator> >& stateIters,
+                        std::shared_ptr<Query> const& query)
+    {
+        size_t const nAggs = aggs.size();
+        size_t const lastDim = _outDims - 1;
+
+        // The states are in row-major order of the grid cells of the block
+        vector<size_t> strides(_outDims);
+        size_t nCells = 1;
+        for (size_t d = _outDims; d != 0; --d)
+        {
+            strides[d-1] = nCells;
+            nCells *= block.high[d-1] - block.low[d-1] + 1;
+        }
+        Value null;
+        null.setNull(0);
+        vector<Value> states(nCells * nAggs, null);
+
+        Coordinate const start = _schema.getDimensions()[lastDim].getStartMin();
+        position_t const grid = _grid[lastDim];
+        Coordinates inPos(_inDims), outPos(_outDims);
+
+        for (size_t i = 0, n = block.inputChunks.size(); i < n; ++i)
+        {
+            if (!inputIter.setPosition(inputChunkPos[block.inputChunks[i]]))
+            {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+            }
+            RLEChunkData data(inputIter.getChunk());
+            ConstChunk const& chunk = data.getChunk();
+            ConstRLEPayload const& payload = *data.getPayload();
+            std::shared_ptr<RLEEmptyBitmap> cut;
+            ConstRLEEmptyBitmap const* cells = &data.getBitmap();
+            if (chunk.getArrayDesc().hasOverlap())
+            {
+                cut = cells->cut(chunk.getFirstPosition(true), chunk.getLastPosition(true),
+                                 chunk.getFirstPosition(false), chunk.getLastPosition(false));
+                cells = cut.get();
+            }
+            CoordinatesMapper mapper(chunk);
+            Coordinate const rowEnd = chunk.getLastPosition(true)[lastDim];
+
+            for (size_t s = 0, nSegs = cells->nSegments(); s < nSegs; ++s)
+            {
+                ConstRLEEmptyBitmap::Segment const& segment = cells->getSegment(s);
+                for (position_t pos = segment._lPosition, end = pos + segment._length; pos < end; )
+                {
+                    // The cells up to the end of the row or of the grid cell go to the same grid cell
+                    mapper.pos2coord(pos, inPos);
+                    transformCoordinates(inPos, outPos);
+                    position_t run = std::min(end - pos, position_t(rowEnd - inPos[lastDim] + 1));
+                    run = std::min(run, grid - (inPos[lastDim] - start) % grid);
+                    position_t const pPos = segment._pPosition + (pos - segment._lPosition);
+                    pos += run;
+
+                    size_t cell = 0;
+                    bool inBlock = true;
+                    for (size_t d = 0; d < _outDims && inBlock; ++d)
+                    {
+                        inBlock = outPos[d] >= block.low[d] && outPos[d] <= block.high[d];
+                        cell += (outPos[d] - block.low[d]) * strides[d];
+                    }
+                    if (inBlock)
+                    {
+                        accumulateRun(&states[cell * nAggs], aggs, skipNulls, payload, pPos, run);
+                    }
+                }
+            }
+        }
+
+        Coordinates cellPos(_outDims);
+        for (size_t a = 0; a < nAggs; ++a)
+        {
+            std::shared_ptr<ChunkIterator> stateChunkIter;
+            for (size_t cell = 0; cell < nCells; ++cell)
+            {
+                Value const& state = states[cell * nAggs + a];
+                if (state.getMissingReason() == 0)
+                {
+                    continue;   // no cells of this grid cell were accumulated
+                }
+                if (!stateChunkIter)
+                {
+                    stateChunkIter = stateIters[a]->newChunk(block.position).getIterator(query);
+                }
+                for (size_t d = 0; d < _outDims; ++d)
+                {
+                    cellPos[d] = block.low[d] + (cell / strides[d]) % (block.high[d] - block.low[d] + 1);
+                }
+                if (!stateChunkIter->setPosition(cellPos))
+                {
+                    throw SYSTEM_EXCEPTION(SCIDB_SE_QPROC, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+                }
+                stateChunkIter->writeItem(state);
+            }
+            if (stateChunkIter)
+            {
+                stateChunkIter->flush();
+            }
+        }
+    }
+
+    /**
+     * Accumulate the values at positions [from, from+count) of 'payload' into
+     * 'states', one per aggregate. If the null cells are skipped, as the cell by
+     * cell path skips them, only the runs of values that are not null are, so
+     * that a grid cell with nothing but nulls gets no state either.
+     */
+    void accumulateRun(Value* states,
+                       vector<AggregatePtr> const& aggs,
+                       bool skipNulls,
+                       ConstRLEPayload const& payload,
+                       position_t from,
+                       position_t count)
+    {
+        if (!skipNulls)
+        {
+            for (size_t a = 0, n = aggs.size(); a < n; ++a)
+            {
+                aggs[a]->accumulatePayload(states[a], payload, from, count);
+            }
+            return;
+        }
+
+        position_t const end = from + count;
+        for (size_t i = payload.findSegment(from), n = payload.nSegments(); i < n; ++i)
+        {
+            size_t length;
+            RLEPayload::Segment const& segment = payload.getSegment(i, length);
+            if (position_t(segment.pPosition()) >= end)
+            {
+                break;
+            }
+            if (segment.null())
+            {
+                continue;
+            }
+            position_t const lo = std::max(from, position_t(segment.pPosition()));
+            position_t const hi = std::min(end, position_t(segment.pPosition() + length));
+            for (size_t a = 0, nAggs = aggs.size(); a < nAggs; ++a)
+            {
+                aggs[a]->accumulatePayload(states[a], payload, lo, hi - lo);
+            }
+        }
+    }
 };
 
 DECLARE_PHYSICAL_OPERATOR_FACTORY(PhysicalRegrid, "regrid", "physical_regrid")
@@ -39,15 +39,19 @@ namespace scidb {
  * @brief The operator: bernoulli().
  *
  * @par Synopsis:
- *   bernoulli( srcArray, probability [, seed] )
+ *   bernoulli( srcArray, probability [, seed [, blockSampling]] )
  *
  * @par Summary:
  *   Evaluates whether to include a cell in the result array by generating a random number and checks if it is less than probability.
+ *   The positions of the included cells are drawn directly, skipping the cells in between.
+ *   In the block-sampling mode, whole chunks are included or not instead, which is decided
+ *   from the seed and the chunk position alone, so the chunks left out are never read.
  *
  * @par Input:
  *   - srcArray: a source array with srcAttrs and srcDims.
  *   - probability: the probability threshold, in [0..1]
  *   - an optional seed for the random number generator.
+ *   - blockSampling: whether to sample whole chunks; false by default.
  *
  * @par Output array:
  *        <
@@ -93,7 +97,14 @@ public:
 	{
 		std::vector<std::shared_ptr<OperatorParamPlaceholder> > res;
         res.push_back(END_OF_VARIES_PARAMS());
-        res.push_back(PARAM_CONSTANT("int64"));
+        switch (_parameters.size()) {
+          case 1:
+            res.push_back(PARAM_CONSTANT("int64"));
+            break;
+          case 2:
+            res.push_back(PARAM_CONSTANT("bool"));
+            break;
+        }
         return res;
 	}
 
@@ -31,6 +31,7 @@
 #include "array/Metadata.h"
 #include "array/DelegateArray.h"
 #include "system/SciDBConfigOptions.h"
+#include "util/Hashing.h"
 #include "NumericOps.h"
 
 using namespace std;
@@ -46,13 +47,18 @@ class BernoulliArrayIterator : public DelegateArrayIterator
   public:
 	virtual void operator ++()
     {
+        if (blockSampling) {
+            ++(*inputIterator);
+            skipUnselectedChunks();
+            return;
+        }
         while (nextElem < nChunkElems) {
             nextElem += nops.geomdist(probability);
         }
         nextElem -= nChunkElems;
         ++(*inputIterator);
         while (!inputIterator->end()) {
-            nChunkElems = inputIterator->getChunk().count();
+            nChunkElems = getChunkElems();
             if (nextElem < nChunkElems) {
                 return;
             }
@@ -66,6 +72,9 @@ class BernoulliArrayIterator : public DelegateArrayIterator
         CoordinatesLess less;
         currPos = pos;
         inputDesc.getChunkPositionFor(currPos);
+        if (blockSampling) {
+            return isChunkSelected(currPos) && inputIterator->setPosition(currPos);
+        }
         if (end() || !less(inputIterator->getPosition(), currPos)) {
             reset();
         }
@@ -78,10 +87,14 @@ class BernoulliArrayIterator : public DelegateArrayIterator
 	virtual void reset()
     {
         inputIterator->reset();
+        if (blockSampling) {
+            skipUnselectedChunks();
+            return;
+        }
         nops.ResetSeed(seed);
         nextElem = nops.geomdist(probability);
         while (!inputIterator->end()) {
-            nChunkElems = inputIterator->getChunk().count();
+            nChunkElems = getChunkElems();
             if (nextElem < nChunkElems) {
                 return;
             }
@@ -91,18 +104,57 @@ class BernoulliArrayIterator : public DelegateArrayIterator
     }
 
     BernoulliArrayIterator(DelegateArray const& array, AttributeID attrID, std::shared_ptr<ConstArrayIterator> inputIterator,
-                           double prob, int rndGenSeed)
+                           double prob, int rndGenSeed, bool block)
     : DelegateArrayIterator(array, attrID, inputIterator),
       probability(prob), seed(rndGenSeed), threshold((int)(RAND_MAX*probability)),
       nops(rndGenSeed),
       inputDesc(array.getInputArray()->getArrayDesc()),
-      isPlainArray(inputDesc.getEmptyBitmapAttribute() == NULL)
+      isPlainArray(inputDesc.getEmptyBitmapAttribute() == NULL),
+      blockSampling(block)
     {
         isNewEmptyIndicator = attrID >= array.getInputArray()->getArrayDesc().getAttributes().size();
         reset();
     }
 
   private:
+    /**
+     * @return the number of cells of the current input chunk, which the positions drawn from the
+     * geometric distribution are offsets in.  The cells of a chunk without empty cells are counted
+     * from its shape, so that chunks the sample skips over are not fetched.
+     */
+    size_t getChunkElems()
+    {
+        if (isPlainArray) {
+            return getChunkNumberOfElements(inputIterator->getPosition(), inputDesc.getDimensions(), false);
+        }
+        return inputIterator->getChunk().count();
+    }
+
+    /**
+     * @return whether the whole chunk at chunkPos is in the sample, in the block-sampling mode.
+     * The choice depends only on the seed and on chunkPos, so that every attribute and every
+     * instance agrees on it without looking at the chunk.
+     */
+    bool isChunkSelected(Coordinates const& chunkPos) const
+    {
+        uint64_t h = fmix(static_cast<uint64_t>(seed));
+        for (size_t i = 0; i < chunkPos.size(); ++i) {
+            h = fmix(h ^ static_cast<uint64_t>(chunkPos[i]));
+        }
+        // The top 53 bits as a double in [0, 1)
+        return static_cast<double>(h >> 11) / static_cast<double>(1ULL << 53) < probability;
+    }
+
+    /**
+     * Move the input iterator to the next selected chunk, from the chunk positions alone.
+     */
+    void skipUnselectedChunks()
+    {
+        while (!inputIterator->end() && !isChunkSelected(inputIterator->getPosition())) {
+            ++(*inputIterator);
+        }
+    }
+
     double probability;
     unsigned int seed;
     int threshold;
@@ -112,6 +164,7 @@ class BernoulliArrayIterator : public DelegateArrayIterator
     size_t nChunkElems;
     bool isPlainArray;
     bool isNewEmptyIndicator;
+    bool blockSampling;
     Coordinates currPos;
 
 };
@@ -190,23 +243,59 @@ class BernoulliArrayIterator : public DelegateArrayIterator
         Value trueValue;
     };
 
+    /**
+     * The iterator over the empty tag added to an input without one, in the block-sampling mode,
+     * where all the cells of a selected chunk are in the sample.  The other attributes clone the
+     * input chunks.
+     */
+    class BernoulliBlockChunkIterator : public DelegateChunkIterator
+    {
+      public:
+        virtual Value const& getItem()
+        {
+            return trueValue;
+        }
+
+        BernoulliBlockChunkIterator(DelegateChunk const* chunk, int iterationMode)
+        : DelegateChunkIterator(chunk, (iterationMode & ~(ConstChunkIterator::TILE_MODE|ConstChunkIterator::INTENDED_TILE_MODE))
+                                       | ConstChunkIterator::IGNORE_EMPTY_CELLS)
+        {
+            trueValue.setBool(true);
+        }
+
+      private:
+        Value trueValue;
+    };
+
 class BernoulliArray : public DelegateArray
 {
   public:
     virtual DelegateChunkIterator* createChunkIterator(DelegateChunk const* chunk, int iterationMode) const
     {
+        if (blockSampling) {
+            return chunk->getAttributeDesc().getId() < nAttrs
+                ? DelegateArray::createChunkIterator(chunk, iterationMode)
+                : new BernoulliBlockChunkIterator(chunk, iterationMode);
+        }
         return new BernoulliChunkIterator(chunk, iterationMode);
     }
 
+    virtual DelegateChunk* createChunk(DelegateArrayIterator const* iterator, AttributeID id) const
+    {
+        return new DelegateChunk(*this, *iterator, id, blockSampling && id < nAttrs);
+    }
+
     virtual DelegateArrayIterator* createArrayIterator(AttributeID id) const
     {
-        return new BernoulliArrayIterator(*this, id, inputArray->getConstIterator(id < nAttrs ? id : AttributeID(0)), probability, seed);
+        return new BernoulliArrayIterator(*this, id, inputArray->getConstIterator(id < nAttrs ? id : AttributeID(0)),
+                                          probability, seed, blockSampling);
     }
 
-    BernoulliArray(ArrayDesc const& desc, std::shared_ptr<Array> input, double prob, int rndGenSeed)
+    BernoulliArray(ArrayDesc const& desc, std::shared_ptr<Array> input, double prob, int rndGenSeed, bool block)
     : DelegateArray(desc, input),
       probability(prob),
-      seed(rndGenSeed)
+      seed(rndGenSeed),
+      blockSampling(block)
     {
         nAttrs = input->getArrayDesc().getAttributes().size();
     }
@@ -216,6 +305,7 @@ class BernoulliArray : public DelegateArray
     size_t nAttrs;
     double probability;
     int seed;
+    bool blockSampling;
 };
 
 class PhysicalBernoulli: public PhysicalOperator
@@ -243,15 +333,17 @@ public:
 
         std::shared_ptr<Array> inputArray = ensureRandomAccess(inputArrays[0], query);
 
-        int seed = (_parameters.size() == 2)
+        int seed = (_parameters.size() >= 2)
             ? (int)((std::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[1])->getExpression()->evaluate().getInt64()
             : (int)time(NULL);
+        bool blockSampling = (_parameters.size() == 3)
+            && ((std::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[2])->getExpression()->evaluate().getBool();
         double probability = ((std::shared_ptr<OperatorParamPhysicalExpression>&)_parameters[0])->getExpression()->evaluate().getDouble();
         if (seed < 0)
             throw USER_EXCEPTION(SCIDB_SE_OPERATOR, SCIDB_LE_OP_SAMPLE_ERROR1);
         if (probability <= 0 || probability > 1)
             throw USER_EXCEPTION(SCIDB_SE_OPERATOR, SCIDB_LE_OP_SAMPLE_ERROR2);
-        return std::shared_ptr<Array>(new BernoulliArray(_schema, inputArray, probability, seed));
+        return std::shared_ptr<Array>(new BernoulliArray(_schema, inputArray, probability, seed, blockSampling));
     }
 };
 
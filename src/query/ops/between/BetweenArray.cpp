@@ -62,6 +62,7 @@ namespace scidb
     : DelegateChunk(arr, iterator, attrID, false),
       array(arr),
       myRange(arr.getArrayDesc().getDimensions().size()),
+      rangesInChunk(arr.getArrayDesc().getDimensions().size()),
       fullyInside(false),
       fullyOutside(false)
     {
@@ -77,9 +78,15 @@ namespace scidb
         // TO-DO: the fullyInside computation is simple but not optimal.
         // It is possible that the current chunk is fully inside the union of the specified ranges,
         // although not fully contained in any of them.
+        //
+        // The ranges that intersect the chunk are all the cells of the chunk need to be looked up in,
+        // and the ones that contain it are among them.
+        rangesInChunk._ranges.clear();
+        array._spatialRangesPtr->findAllThatIntersect(myRange, rangesInChunk);
+        rangesInChunk.buildIndex();
         size_t dummy = 0;
-        fullyInside  =  array._spatialRangesPtr->findOneThatContains(myRange, dummy);
-        fullyOutside = !array._spatialRangesPtr->findOneThatIntersects(myRange, dummy);
+        fullyOutside = rangesInChunk._ranges.empty();
+        fullyInside  = !fullyOutside && rangesInChunk.findOneThatContains(myRange, dummy);
 
         isClone = fullyInside && attrID < array.getInputArray()->getArrayDesc().getAttributes().size();
         if (emptyBitmapIterator) {
@@ -88,6 +95,29 @@ namespace scidb
         }
     }
 
+    void BetweenChunk::selectCells(MemChunk& result) const
+    {
+        RLEChunkData data(getInputChunk());
+        Coordinates const& first = myRange._low;
+        Coordinates const& last = myRange._high;
+        size_t const nDims = first.size();
+
+        // The cuts keep the physical positions of the input, so that they unite
+        std::shared_ptr<RLEEmptyBitmap> cells = std::make_shared<RLEEmptyBitmap>();
+        Coordinates low(nDims);
+        Coordinates high(nDims);
+        for (size_t i = 0; i < rangesInChunk._ranges.size(); ++i) {
+            SpatialRange const& range = rangesInChunk._ranges[i];
+            for (size_t j = 0; j < nDims; ++j) {
+                low[j] = std::max(range._low[j], first[j]);
+                high[j] = std::min(range._high[j], last[j]);
+            }
+            std::shared_ptr<RLEEmptyBitmap> cut = data.getBitmap().cut(first, last, low, high);
+            cells = i == 0 ? cut : cells->unite(*cut);
+        }
+        data.select(*cells, array, attrID, result);
+    }
+
     Value const& BetweenChunkIterator::getItem()
     {
         if (!hasCurrent) {
@@ -102,7 +132,7 @@ namespace scidb
             throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
         }
         return inputIterator->isEmpty() ||
-            !array._spatialRangesPtr->findOneThatContains(currPos, _hintForSpatialRanges);
+            !isInRanges(currPos);
     }
 
     bool BetweenChunkIterator::end()
@@ -118,7 +148,7 @@ namespace scidb
                 if (!inputIterator->end()) {
                     Coordinates const& pos = inputIterator->getPosition();
 
-                    if (array._spatialRangesPtr->findOneThatContains(pos, _hintForSpatialRanges)) {
+                    if (isInRanges(pos)) {
                         currPos = pos;
                         hasCurrent = true;
                         return;
@@ -142,7 +172,7 @@ namespace scidb
     bool BetweenChunkIterator::setPosition(Coordinates const& pos)
     {
         if (_ignoreEmptyCells) {
-            if (array._spatialRangesPtr->findOneThatContains(pos, _hintForSpatialRanges)) {
+            if (isInRanges(pos)) {
                 hasCurrent = inputIterator->setPosition(pos);
                 if (hasCurrent) {
                     currPos = pos;
@@ -163,7 +193,7 @@ namespace scidb
             inputIterator->reset();
             if (!inputIterator->end()) {
                 Coordinates const& pos = inputIterator->getPosition();
-                if (array._spatialRangesPtr->findOneThatContains(pos, _hintForSpatialRanges)) {
+                if (isInRanges(pos)) {
                     currPos = pos;
                     hasCurrent = true;
                     return;
@@ -181,6 +211,11 @@ namespace scidb
         }
     }
 
+    bool BetweenChunkIterator::isInRanges(Coordinates const& pos) const
+    {
+        return chunk.rangesInChunk.findOneThatContains(pos, _hintForSpatialRanges);
+    }
+
     ConstChunk const& BetweenChunkIterator::getChunk()
     {
         return chunk;
@@ -207,7 +242,7 @@ namespace scidb
     {
         _value.setBool(
                 inputIterator->getItem().getBool() &&
-                array._spatialRangesPtr->findOneThatContains(currPos, _hintForSpatialRanges));
+                isInRanges(currPos));
         return _value;
     }
 
@@ -222,7 +257,7 @@ namespace scidb
     //
     Value const& NewBitmapBetweenChunkIterator::getItem()
     {
-        _value.setBool(array._spatialRangesPtr->findOneThatContains(currPos, _hintForSpatialRanges));
+        _value.setBool(isInRanges(currPos));
         return _value;
     }
 
@@ -265,6 +300,21 @@ namespace scidb
         reset();
     }
 
+    ConstChunk const& BetweenArrayIterator::getChunk()
+    {
+        if (!hasCurrent)
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
+        BetweenChunk const& between = static_cast<BetweenChunk const&>(DelegateArrayIterator::getChunk());
+        if (!array._tileMode || between.isFullyInside()) {
+            return between;
+        }
+        if (!chunkInitialized) {
+            between.selectCells(_tileChunk);
+            chunkInitialized = true;
+        }
+        return _tileChunk;
+    }
+
     bool BetweenArrayIterator::end()
     {
         return !hasCurrent;
@@ -431,9 +481,11 @@ namespace scidb
     //
     // Between array methods
     //
-    BetweenArray::BetweenArray(ArrayDesc const& array, SpatialRangesPtr const& spatialRangesPtr, std::shared_ptr<Array> const& input)
+    BetweenArray::BetweenArray(ArrayDesc const& array, SpatialRangesPtr const& spatialRangesPtr, std::shared_ptr<Array> const& input,
+                               bool tileMode)
     : DelegateArray(array, input),
-      _spatialRangesPtr(spatialRangesPtr)
+      _spatialRangesPtr(spatialRangesPtr),
+      _tileMode(tileMode)
     {
         // Copy _spatialRangesPtr to extendedSpatialRangesPtr, but reducing low by (interval-1) to cover chunkPos.
         _extendedSpatialRangesPtr = make_shared<SpatialRanges>(_spatialRangesPtr->_numDims);
@@ -443,6 +495,7 @@ namespace scidb
             array.getChunkPositionFor(newLow);
             _extendedSpatialRangesPtr->_ranges.push_back(SpatialRange(newLow, _spatialRangesPtr->_ranges[i]._high));
         }
+        _extendedSpatialRangesPtr->buildIndex();
     }
 
     DelegateArrayIterator* BetweenArray::createArrayIterator(AttributeID attrID) const
@@ -66,9 +66,21 @@ public:
 
     BetweenChunk(BetweenArray const& array, DelegateArrayIterator const& iterator, AttributeID attrID);
 
+    bool isFullyInside() const
+    {
+        return fullyInside;
+    }
+
+    /**
+     * Make 'result' the chunk with just the cells of the input chunk that are
+     * in the ranges, in RLE format, so that it can be read as tiles.
+     */
+    void selectCells(MemChunk& result) const;
+
 private:
     BetweenArray const& array;
     SpatialRange myRange;  // the firstPosition and lastPosition of this chunk.
+    SpatialRanges rangesInChunk;  // the ranges that intersect myRange, which the cells are looked up in.
     bool fullyInside;
     bool fullyOutside;
     std::shared_ptr<ConstArrayIterator> emptyBitmapIterator;
@@ -108,6 +120,11 @@ public:
      * Several member functions of class SpatialRanges takes a hint, on where the last successful search.
      */
     mutable size_t _hintForSpatialRanges;
+
+    /**
+     * @return whether a cell of the chunk is in some query range.
+     */
+    bool isInRanges(Coordinates const& pos) const;
 };
 
 class ExistedBitmapBetweenChunkIterator : public BetweenChunkIterator
@@ -222,9 +239,16 @@ public:
 	 */
 	virtual void reset();
 
+    /***
+     * In tile mode, a chunk which is partly in the ranges is returned as a
+     * materialized chunk with just the cells in the ranges
+     */
+    virtual ConstChunk const& getChunk();
+
 protected:
     BetweenArray const& array;
     SpatialRangesChunkPosIteratorPtr _spatialRangesChunkPosIteratorPtr;
+    MemChunk _tileChunk;
 	Coordinates pos;
     bool hasCurrent;
 
@@ -260,7 +284,8 @@ class BetweenArray : public DelegateArray
     friend class NewBitmapBetweenChunkIterator;
 
 public:
-    BetweenArray(ArrayDesc const& desc, SpatialRangesPtr const& spatialRangesPtr, std::shared_ptr<Array> const& input);
+    BetweenArray(ArrayDesc const& desc, SpatialRangesPtr const& spatialRangesPtr, std::shared_ptr<Array> const& input,
+                 bool tileMode = false);
 
     DelegateArrayIterator* createArrayIterator(AttributeID attrID) const;
     DelegateChunk* createChunk(DelegateArrayIterator const* iterator, AttributeID attrID) const;
@@ -279,6 +304,12 @@ private:
      * equivalently, the modified range [-1, 19] contains 0.
      */
     SpatialRangesPtr _extendedSpatialRangesPtr;
+
+    /**
+     * Whether the consumer reads tiles, which the chunks partly in the ranges
+     * are materialized for.
+     */
+    bool _tileMode;
 };
 
 } //namespace
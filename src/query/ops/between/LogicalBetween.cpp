@@ -101,6 +101,8 @@ class LogicalBetween: public  LogicalOperator
     ArrayDesc inferSchema(std::vector< ArrayDesc> schemas, std::shared_ptr< Query> query)
 	{
 		assert(schemas.size() == 1);
+        // The tiles of the chunks partly in the window are cut out of the input's empty bitmap
+        _properties.tile = schemas[0].getEmptyBitmapAttribute() != NULL;
         return addEmptyTagAttribute(schemas[0]);
 	}
 };
@@ -107,7 +107,7 @@ public:
       if (isDominatedBy(lowPos, highPos)) {
           spatialRangesPtr->_ranges.push_back(SpatialRange(lowPos, highPos));
       }
-      return std::shared_ptr<Array>(make_shared<BetweenArray>(_schema, spatialRangesPtr, inputArray));
+      return std::shared_ptr<Array>(make_shared<BetweenArray>(_schema, spatialRangesPtr, inputArray, _tileMode));
    }
 };
 
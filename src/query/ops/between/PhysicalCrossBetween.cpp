@@ -109,6 +109,7 @@ public:
             }
             ++ multiItersRangesArray;
         }
+        spatialRangesPtr->buildIndex();
 
         // Return a CrossBetweenArray.
         return std::shared_ptr< Array>(make_shared<BetweenArray>(_schema, spatialRangesPtr, inputArray));
@@ -40,6 +40,31 @@ class CastArrayChunkIterator: public DelegateChunkIterator
 {
     FunctionPointer _converter;
     Value _result;
+    Value _tile;
+
+    /**
+     * Convert the values of a tile, once for each run of a value.
+     */
+    void convertTile(RLEPayload const& input)
+    {
+        _tile = Value(TypeLibrary::getType(chunk->getAttributeDesc().getType()), Value::asTile);
+        RLEPayload::append_iterator appender(_tile.getTile());
+        Value value;
+        const Value* params[1] = { &value };
+        for (ConstRLEPayload::iterator i(&input); !i.end(); ) {
+            uint64_t const count = i.getRepeatCount();
+            i.getItem(value);
+            if (value.isNull()) {
+                appender.add(value, count);
+            } else {
+                _converter(params, &_result, NULL);
+                appender.add(_result, count);
+            }
+            i += count;
+        }
+        appender.flush();
+    }
+
 public:
     /**
      * Constructor
@@ -56,14 +81,20 @@ public:
     }
 
     /**
-     * Returns value produced after types converting
+     * Returns value produced after types converting, or the tile of them
+     * in tile mode
      *
      * @return Value
      */
     Value& getItem()
     {
+        Value const& item = DelegateChunkIterator::getItem();
+        if (item.isTile()) {
+            convertTile(*item.getTile());
+            return _tile;
+        }
         const Value* params[1];
-        params[0] = &DelegateChunkIterator::getItem();
+        params[0] = &item;
         _converter(params, &_result, NULL);
         return _result;
     }
@@ -29,6 +29,9 @@
  * @author poliocough@gmail.com
  */
 
+#include <algorithm>
+#include <limits>
+
 #include <array/MemArray.h>
 #include <system/Exceptions.h>
 #include "CrossJoinArray.h"
@@ -83,11 +86,39 @@ namespace scidb
     }
 
     CrossJoinChunk::CrossJoinChunk(CrossJoinArray const& cross, AttributeID attrID, bool isLeftAttr)
-    : array(cross), attr(attrID), isLeftAttribute(isLeftAttr)
+    : array(cross), attr(attrID), isLeftAttribute(isLeftAttr), hashCacheCells(0), hashCacheMode(0)
     {
         isEmptyIndicatorAttribute = getAttributeDesc().isEmptyIndicator();
     }
 
+    std::shared_ptr<CrossJoinHashTable const> CrossJoinChunk::getRightHash(int iterationMode) const
+    {
+        if (iterationMode != hashCacheMode)
+        {
+            hashCache.clear();
+            hashCacheCells = 0;
+            hashCacheMode = iterationMode;
+        }
+
+        Coordinates const& rightPos = rightChunk->getFirstPosition(false);
+        HashCache::const_iterator it = hashCache.find(rightPos);
+        if (it != hashCache.end())
+        {
+            return it->second;
+        }
+
+        std::shared_ptr<CrossJoinHashTable const> table =
+            std::make_shared<CrossJoinHashTable>(array, *rightChunk, iterationMode);
+        if (hashCacheCells + table->size() > MAX_CACHED_CELLS)
+        {
+            hashCache.clear();
+            hashCacheCells = 0;
+        }
+        hashCache[rightPos] = table;
+        hashCacheCells += table->size();
+        return table;
+    }
+
     void CrossJoinChunk::setInputChunk(ConstChunk const* left, ConstChunk const* right)
     {
         leftChunk  = left;
@@ -125,7 +156,7 @@ namespace scidb
 
         return chunk.isLeftAttribute
             ? leftIterator->getItem()
-            : (*currentBucket)[currentIndex].second;
+            : rightHash->getValue(currentIndex);
     }
 
     bool CrossJoinChunkIterator::isEmpty() const
@@ -138,29 +169,30 @@ namespace scidb
         return !hasCurrent;
     }
 
+    bool CrossJoinChunkIterator::findBucket()
+    {
+        while (!leftIterator->end())
+        {
+            array.decomposeLeftCoordinates(leftIterator->getPosition(), joinKey);
+            if (rightHash->find(joinKey, currentBucket))
+            {
+                currentIndex = currentBucket.begin;
+                return true;
+            }
+            ++(*leftIterator);
+        }
+        return false;
+    }
+
     void CrossJoinChunkIterator::operator ++()
     {
         if (!hasCurrent)
             throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
 
-        if( ++currentIndex >= (ssize_t) currentBucket->size())
+        if (++currentIndex >= currentBucket.end)
         {
-            Coordinates joinKey(array.nJoinDims);
             ++(*leftIterator);
-            while (!leftIterator->end())
-            {
-                array.decomposeLeftCoordinates(leftIterator->getPosition(), joinKey);
-
-                ChunkHash::const_iterator it = rightHash.find(joinKey);
-                if (it!=rightHash.end())
-                {
-                    currentBucket = &(it->second);
-                    currentIndex = 0;
-                    return;
-                }
-                ++(*leftIterator);
-            }
-            hasCurrent = false;
+            hasCurrent = findBucket();
         }
     }
 
@@ -169,53 +201,37 @@ namespace scidb
         if (!hasCurrent)
             throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
 
-        array.composeOutCoordinates(leftIterator->getPosition(), (*currentBucket)[currentIndex].first, currentPos);
+        array.composeOutCoordinates(leftIterator->getPosition(), rightHash->getLeftover(currentIndex), currentPos);
         return currentPos;
     }
 
     bool CrossJoinChunkIterator::setPosition(Coordinates const& pos)
     {
-        Coordinates left(array.nLeftDims);
-        Coordinates joinKey(array.nJoinDims);
-        Coordinates rightLeftover(array.nRightDims - array.nJoinDims);
-        array.decomposeOutCoordinates(pos, left, joinKey, rightLeftover);
+        array.decomposeOutCoordinates(pos, leftPos, joinKey, rightLeftover);
 
-        if(!leftIterator->setPosition(left))
+        if(!leftIterator->setPosition(leftPos))
         {
             return hasCurrent = false;
         }
 
-        ChunkHash::const_iterator it = rightHash.find(joinKey);
-        if (it==rightHash.end())
+        if (!rightHash->find(joinKey, currentBucket))
         {
             return hasCurrent = false;
         }
 
-        currentBucket = &(it->second);
-        currentIndex = findValueInBucket(currentBucket, rightLeftover);
-
-        return hasCurrent = (currentIndex!=-1);
+        ssize_t cell = rightHash->findLeftover(currentBucket, rightLeftover);
+        if (cell < 0)
+        {
+            return hasCurrent = false;
+        }
+        currentIndex = cell;
+        return hasCurrent = true;
     }
 
     void CrossJoinChunkIterator::reset()
     {
-        hasCurrent = false;
         leftIterator->reset();
-        Coordinates joinKey(array.nJoinDims);
-        while (!leftIterator->end())
-        {
-            array.decomposeLeftCoordinates(leftIterator->getPosition(), joinKey);
-            ChunkHash::const_iterator it = rightHash.find(joinKey);
-            if (it!=rightHash.end())
-            {
-                currentBucket = &(it->second);
-                currentIndex = 0;
-                hasCurrent = true;
-                return;
-            }
-
-            ++(*leftIterator);
-        }
+        hasCurrent = findBucket();
     }
 
     ConstChunk const& CrossJoinChunkIterator::getChunk()
@@ -228,30 +244,153 @@ namespace scidb
       chunk(aChunk),
       leftIterator(aChunk.leftChunk->getConstIterator(iterationMode & ~INTENDED_TILE_MODE)),
       currentPos(aChunk.array.desc.getDimensions().size()),
-      currentBucket(0),
-      currentIndex(-1)
-    {
-        rightHash.clear();
-        std::shared_ptr<ConstChunkIterator> iter = aChunk.rightChunk->getConstIterator(iterationMode & ~INTENDED_TILE_MODE);
-        Coordinates joinKey(array.nJoinDims);
-        Coordinates rightLeftover(array.nRightDims - array.nJoinDims);
-        while(!iter->end())
+      hasCurrent(false),
+      rightHash(aChunk.getRightHash(iterationMode & ~INTENDED_TILE_MODE)),
+      currentIndex(0),
+      joinKey(aChunk.array.getJoinDimsCount()),
+      leftPos(aChunk.array.nLeftDims),
+      rightLeftover(aChunk.array.getLeftoverDimsCount())
+    {
+        currentBucket.begin = currentBucket.end = 0;
+        reset();
+    }
+
+    //
+    // CrossJoin hash table methods
+    //
+    CrossJoinHashTable::CrossJoinHashTable(CrossJoinArray const& array,
+                                           ConstChunk const& rightChunk,
+                                           int iterationMode)
+    : _nKeyDims(array.getJoinDimsCount()),
+      _nLeftoverDims(array.getLeftoverDimsCount()),
+      _slotMask(0)
+    {
+        // Collect the cells in chunk order first, then group them by key.
+        std::vector<Coordinate> keys;
+        std::vector<Coordinate> leftovers;
+        std::vector<Value> values;
+        Coordinates joinKey(_nKeyDims);
+        Coordinates rightLeftover(_nLeftoverDims);
+        std::shared_ptr<ConstChunkIterator> iter = rightChunk.getConstIterator(iterationMode);
+        while (!iter->end())
         {
             array.decomposeRightCoordinates(iter->getPosition(), joinKey, rightLeftover);
-            rightHash[joinKey].push_back( make_pair(rightLeftover, iter->getItem()));
+            keys.insert(keys.end(), joinKey.begin(), joinKey.end());
+            leftovers.insert(leftovers.end(), rightLeftover.begin(), rightLeftover.end());
+            values.push_back(iter->getItem());
             ++(*iter);
         }
+        size_t const nCells = values.size();
 
-        reset();
+        // A stable sort on the key alone keeps the cells of each group in
+        // chunk order, i.e. sorted by their leftover coordinates.
+        std::vector<size_t> order(nCells);
+        for (size_t i = 0; i < nCells; ++i)
+        {
+            order[i] = i;
+        }
+        size_t const nKeyDims = _nKeyDims;
+        std::stable_sort(order.begin(), order.end(),
+                         [&keys, nKeyDims](size_t a, size_t b) {
+                             return std::lexicographical_compare(&keys[a * nKeyDims], &keys[(a + 1) * nKeyDims],
+                                                                 &keys[b * nKeyDims], &keys[(b + 1) * nKeyDims]);
+                         });
+
+        _leftovers.reserve(leftovers.size());
+        _values.reserve(nCells);
+        for (size_t i = 0; i < nCells; ++i)
+        {
+            size_t const cell = order[i];
+            Coordinate const* key = &keys[cell * _nKeyDims];
+            if (i == 0 || !keyEquals(_groupStart.size() - 1, key))
+            {
+                _groupStart.push_back(i);
+                _keys.insert(_keys.end(), key, key + _nKeyDims);
+            }
+            _leftovers.insert(_leftovers.end(),
+                              leftovers.begin() + cell * _nLeftoverDims,
+                              leftovers.begin() + (cell + 1) * _nLeftoverDims);
+            _values.push_back(values[cell]);
+        }
+        size_t const nGroups = _groupStart.size();
+        _groupStart.push_back(nCells);
+
+        if (nGroups >= std::numeric_limits<uint32_t>::max())
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNKNOWN_ERROR)
+                << "too many join keys in cross_join chunk";
+        }
+
+        // Keep the load factor at or below one half.
+        size_t nSlots = 2;
+        while (nSlots < nGroups * 2)
+        {
+            nSlots <<= 1;
+        }
+        _slots.assign(nSlots, 0);
+        _slotMask = nSlots - 1;
+        for (size_t g = 0; g < nGroups; ++g)
+        {
+            size_t slot = hashKey(&_keys[g * _nKeyDims]) & _slotMask;
+            while (_slots[slot] != 0)
+            {
+                slot = (slot + 1) & _slotMask;
+            }
+            _slots[slot] = safe_static_cast<uint32_t>(g + 1);
+        }
     }
 
-    ssize_t CrossJoinChunkIterator::findValueInBucket(HashBucket const* bucket, Coordinates const& coords) const
+    size_t CrossJoinHashTable::hashKey(Coordinate const* key) const
     {
-        CoordinatesLess cless;
-        size_t l = 0, r = bucket->size();
-        while (l < r) {
+        uint64_t h = 0;
+        for (size_t i = 0; i < _nKeyDims; ++i)
+        {
+            h = (h ^ static_cast<uint64_t>(key[i])) * 0x9E3779B97F4A7C15ULL;
+        }
+        return static_cast<size_t>(h ^ (h >> 32));
+    }
+
+    bool CrossJoinHashTable::keyEquals(size_t group, Coordinate const* key) const
+    {
+        Coordinate const* groupKey = &_keys[group * _nKeyDims];
+        for (size_t i = 0; i < _nKeyDims; ++i)
+        {
+            if (groupKey[i] != key[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool CrossJoinHashTable::find(Coordinates const& joinKey, Bucket& bucket) const
+    {
+        assert(joinKey.size() == _nKeyDims);
+        Coordinate const* key = joinKey.data();
+        size_t slot = hashKey(key) & _slotMask;
+        while (_slots[slot] != 0)
+        {
+            size_t const group = _slots[slot] - 1;
+            if (keyEquals(group, key))
+            {
+                bucket.begin = _groupStart[group];
+                bucket.end = _groupStart[group + 1];
+                return true;
+            }
+            slot = (slot + 1) & _slotMask;
+        }
+        return false;
+    }
+
+    ssize_t CrossJoinHashTable::findLeftover(Bucket const& bucket, Coordinates const& leftover) const
+    {
+        assert(leftover.size() == _nLeftoverDims);
+        size_t l = bucket.begin, r = bucket.end;
+        while (l < r)
+        {
             size_t m = (l + r) >> 1;
-            if ( cless((*bucket)[m].first, coords))
+            if (std::lexicographical_compare(getLeftover(m), getLeftover(m) + _nLeftoverDims,
+                                             leftover.begin(), leftover.end()))
             {
                 l = m + 1;
             }
@@ -260,12 +399,10 @@ namespace scidb
                 r = m;
             }
         }
-
-        if (r < bucket->size() && (*bucket)[r].first == coords)
+        if (r < bucket.end && std::equal(leftover.begin(), leftover.end(), getLeftover(r)))
         {
             return r;
         }
-
         return -1;
     }
 
@@ -453,14 +590,13 @@ namespace scidb
         }
     }
 
-    void CrossJoinArray::composeOutCoordinates(Coordinates const &left, Coordinates const& rightLeftover, Coordinates& out) const
+    void CrossJoinArray::composeOutCoordinates(Coordinates const &left, Coordinate const* rightLeftover, Coordinates& out) const
     {
         assert(left.size() == nLeftDims);
-        assert(rightLeftover.size() == nRightDims - nJoinDims);
         assert(out.size() == desc.getDimensions().size());
 
-        memcpy(&out[0], &left[0], nLeftDims*sizeof(Coordinate));
-        memcpy(&out[left.size()], &rightLeftover[0], (nRightDims-nJoinDims)*sizeof(Coordinate));
+        memcpy(out.data(), left.data(), nLeftDims*sizeof(Coordinate));
+        memcpy(out.data() + nLeftDims, rightLeftover, (nRightDims-nJoinDims)*sizeof(Coordinate));
     }
 
     Coordinates CrossJoinArray::getLeftPosition(Coordinates const& pos) const
@@ -39,8 +39,8 @@
 #ifndef CROSS_JOIN_ARRAY_H_
 #define CROSS_JOIN_ARRAY_H_
 
+#include <map>
 #include <string>
-#include <unordered_map>
 
 #include <array/Array.h>
 #include <array/Metadata.h>
@@ -48,13 +48,88 @@
 namespace scidb
 {
 
-typedef std::vector<std::pair<Coordinates, Value> > HashBucket;
-typedef std::unordered_map<Coordinates, HashBucket, CoordinatesHash> ChunkHash;
-
 class CrossJoinArray;
 class CrossJoinArrayIterator;
 class CrossJoinChunkIterator;
 
+/**
+ * Hash table over the cells of one chunk of the (replicated) right input,
+ * keyed by the join coordinates. Instead of a node-based map of vectors,
+ * everything lives in a few flat vectors: cells with the same join key are
+ * stored contiguously and sorted by their remaining (leftover) coordinates,
+ * and an open-addressing slot array maps a key to its group of cells.
+ */
+class CrossJoinHashTable
+{
+  public:
+    /**
+     * A range [begin, end) of cells sharing one join key.
+     */
+    struct Bucket
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    /**
+     * Build the table from all cells of a right chunk.
+     * @param array the cross join array the chunk belongs to
+     * @param rightChunk a chunk of the right input
+     * @param iterationMode the mode used to iterate over rightChunk
+     */
+    CrossJoinHashTable(CrossJoinArray const& array, ConstChunk const& rightChunk, int iterationMode);
+
+    /**
+     * Look up the cells matching a join key.
+     * @param joinKey the join coordinates, in the order of the right dimensions
+     * @param bucket [out] the matching cells
+     * @return false if no cell matches
+     */
+    bool find(Coordinates const& joinKey, Bucket& bucket) const;
+
+    /**
+     * @return the index of the cell with the given leftover coordinates in bucket, or -1
+     */
+    ssize_t findLeftover(Bucket const& bucket, Coordinates const& leftover) const;
+
+    /**
+     * @return the leftover (non-join) coordinates of a cell
+     */
+    Coordinate const* getLeftover(size_t cell) const
+    {
+        return &_leftovers[cell * _nLeftoverDims];
+    }
+
+    /**
+     * @return the right attribute value of a cell
+     */
+    Value const& getValue(size_t cell) const
+    {
+        return _values[cell];
+    }
+
+    /**
+     * @return the number of cells in the table
+     */
+    size_t size() const
+    {
+        return _values.size();
+    }
+
+  private:
+    size_t hashKey(Coordinate const* key) const;
+    bool keyEquals(size_t group, Coordinate const* key) const;
+
+    size_t const _nKeyDims;
+    size_t const _nLeftoverDims;
+    std::vector<Coordinate> _keys;       // _nKeyDims coordinates per group
+    std::vector<size_t> _groupStart;     // first cell of each group, plus the end
+    std::vector<Coordinate> _leftovers;  // _nLeftoverDims coordinates per cell
+    std::vector<Value> _values;          // one value per cell
+    std::vector<uint32_t> _slots;        // group number + 1, or 0 if the slot is free
+    size_t _slotMask;
+};
+
 class CrossJoinChunk : public ConstChunk
 {
     friend class CrossJoinChunkIterator;
@@ -69,6 +144,13 @@ class CrossJoinChunk : public ConstChunk
 
     void setInputChunk(ConstChunk const* leftChunk, ConstChunk const* rightChunk);
 
+    /**
+     * Get the hash table of the current right chunk, building it if it is
+     * not cached yet. The same right chunk is typically paired with many
+     * left chunks, so the tables are kept until the cache grows too large.
+     */
+    std::shared_ptr<CrossJoinHashTable const> getRightHash(int iterationMode) const;
+
     bool isMaterialized() const;
     virtual Array const& getArray() const;
 
@@ -86,6 +168,15 @@ class CrossJoinChunk : public ConstChunk
     Coordinates lastPosWithOverlap;
     bool isEmptyIndicatorAttribute;
     bool isLeftAttribute;
+
+    typedef std::map<Coordinates, std::shared_ptr<CrossJoinHashTable const>, CoordinatesLess> HashCache;
+
+    /// Upper bound on the number of right cells kept in hashCache
+    static const size_t MAX_CACHED_CELLS = 1024*1024;
+
+    mutable HashCache hashCache;
+    mutable size_t hashCacheCells;
+    mutable int hashCacheMode;
 };
 
 class CrossJoinChunkIterator : public ConstChunkIterator
@@ -104,7 +195,7 @@ class CrossJoinChunkIterator : public ConstChunkIterator
     CrossJoinChunkIterator(CrossJoinChunk const& chunk, int iterationMode);
 
   private:
-    ssize_t findValueInBucket(HashBucket const* bucket, Coordinates const& coords) const;
+    bool findBucket();
 
     CrossJoinArray const& array;
     CrossJoinChunk const& chunk;
@@ -113,9 +204,12 @@ class CrossJoinChunkIterator : public ConstChunkIterator
     bool hasCurrent;
     Value boolValue;
 
-    HashBucket const* currentBucket;
-    ssize_t currentIndex;
-    ChunkHash rightHash;
+    std::shared_ptr<CrossJoinHashTable const> rightHash;
+    CrossJoinHashTable::Bucket currentBucket;
+    size_t currentIndex;
+    Coordinates joinKey;
+    Coordinates leftPos;        // scratch space for setPosition()
+    Coordinates rightLeftover;  // scratch space for setPosition()
 };
 
 /***
@@ -213,7 +307,17 @@ class CrossJoinArray : public Array
     void decomposeRightCoordinates(Coordinates const& right, Coordinates& hashKey, Coordinates &rightLeftover) const;
     void decomposeOutCoordinates(Coordinates const& out, Coordinates& left, Coordinates& hashKey, Coordinates& rightLeftover) const;
     void decomposeLeftCoordinates(Coordinates const& left, Coordinates& hashKey) const;
-    void composeOutCoordinates(Coordinates const &left, Coordinates const& rightLeftover, Coordinates& out) const;
+    void composeOutCoordinates(Coordinates const &left, Coordinate const* rightLeftover, Coordinates& out) const;
+
+    size_t getJoinDimsCount() const
+    {
+        return nJoinDims;
+    }
+
+    size_t getLeftoverDimsCount() const
+    {
+        return nRightDims - nJoinDims;
+    }
 
   private:
     ArrayDesc desc;
@@ -126,7 +126,11 @@ public:
                 newEnd.push_back(rightEnd[i]);
             }
         }
-        return PhysicalBoundaries(newStart, newEnd);
+        // Assuming the cells are spread independently along the join
+        // dimensions, each join key matches (left density * right density)
+        // of the box formed by the two sides.
+        return PhysicalBoundaries(newStart, newEnd,
+                                  inputBoundaries[0].getDensity() * inputBoundaries[1].getDensity());
     }
 
     virtual bool changesDistribution(std::vector<ArrayDesc> const&) const
@@ -154,7 +154,17 @@ namespace scidb
     ConstChunk const& JoinEmptyableArrayIterator::getChunk()
     {
         chunk->overrideClone(!_chunkLevelJoin);
-        return DelegateArrayIterator::getChunk();
+        ConstChunk const& joined = DelegateArrayIterator::getChunk();
+        if (!_chunkLevelJoin || !((JoinEmptyableArray const&)array).tileMode) {
+            return joined;
+        }
+        if (!chunkInitialized) {
+            RLEChunkData input(inputIterator->getChunk());
+            RLEChunkData join(_joinIterator->getChunk());
+            input.select(*input.getBitmap().intersect(join.getBitmap()), array, attr, _tileChunk);
+            chunkInitialized = true;
+        }
+        return _tileChunk;
     }
 
     JoinEmptyableArrayIterator::JoinEmptyableArrayIterator(JoinEmptyableArray const& array,
@@ -267,8 +277,9 @@ namespace scidb
         return new JoinEmptyableArrayIterator(*this, attrID, inputIterator, joinIterator, chunkLevelJoin);
     }
 
-    JoinEmptyableArray::JoinEmptyableArray(ArrayDesc const& desc, std::shared_ptr<Array> leftArr, std::shared_ptr<Array> rightArr)
-    : DelegateArray(desc, leftArr), left(leftArr), right(rightArr)
+    JoinEmptyableArray::JoinEmptyableArray(ArrayDesc const& desc, std::shared_ptr<Array> leftArr, std::shared_ptr<Array> rightArr,
+                                           bool tile)
+    : DelegateArray(desc, leftArr), left(leftArr), right(rightArr), tileMode(tile)
     {
         ArrayDesc const& leftDesc = left->getArrayDesc();
         ArrayDesc const& rightDesc = right->getArrayDesc();
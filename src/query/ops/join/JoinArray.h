@@ -79,6 +79,11 @@ class JoinEmptyableArrayIterator : public DelegateArrayIterator
     virtual void reset();
     virtual void operator ++();
     virtual bool end();
+
+    /**
+     * In tile mode, the chunk of a chunk level join is materialized with just
+     * the cells of both inputs, as the intersection of their empty bitmaps.
+     */
 	virtual ConstChunk const& getChunk();
     JoinEmptyableArrayIterator(JoinEmptyableArray const& array, AttributeID attrID, std::shared_ptr<ConstArrayIterator> inputIterator, std::shared_ptr<ConstArrayIterator> joinIterator, bool chunkLevelJoin);
 
@@ -88,6 +93,7 @@ class JoinEmptyableArrayIterator : public DelegateArrayIterator
     std::shared_ptr<ConstArrayIterator> _joinIterator;
     bool _hasCurrent;
     bool _chunkLevelJoin;
+    MemChunk _tileChunk;
 };
 
 class JoinEmptyableArray : public DelegateArray
@@ -98,7 +104,8 @@ class JoinEmptyableArray : public DelegateArray
     virtual DelegateChunkIterator* createChunkIterator(DelegateChunk const* chunk, int iterationMode) const;
     virtual DelegateArrayIterator* createArrayIterator(AttributeID id) const;
 
-    JoinEmptyableArray(ArrayDesc const& desc, std::shared_ptr<Array> left, std::shared_ptr<Array> right);
+    JoinEmptyableArray(ArrayDesc const& desc, std::shared_ptr<Array> left, std::shared_ptr<Array> right,
+                       bool tileMode = false);
 
   private:
     std::shared_ptr<Array> left;
@@ -107,6 +114,7 @@ class JoinEmptyableArray : public DelegateArray
     int    leftEmptyTagPosition;
     int    rightEmptyTagPosition;
     int    emptyTagPosition;
+    bool   tileMode;
 };
 
 }
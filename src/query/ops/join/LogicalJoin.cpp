@@ -80,6 +80,7 @@ class LogicalJoin: public LogicalOperator
     {
     	ADD_PARAM_INPUT()
     	ADD_PARAM_INPUT()
+        _properties.tile = true;
     }
 
     ArrayDesc inferSchema(std::vector< ArrayDesc> schemas, std::shared_ptr< Query> query)
@@ -198,7 +198,7 @@ public:
         }
         return std::shared_ptr<Array>(_schema.getEmptyBitmapAttribute() == NULL
                                         ? (Array*)new JoinArray(_schema, left, right)
-                                        : (Array*)new JoinEmptyableArray(_schema, left, right));
+                                        : (Array*)new JoinEmptyableArray(_schema, left, right, _tileMode));
     }
 };
 
@@ -23,6 +23,7 @@
 /****************************************************************************/
 #include <iostream>
 #include <boost/assign/list_of.hpp>                      // For list_of()
+#include <util/arena/PoolArena.h>                        // For PoolArena
 #include "ListArrayBuilders.h"
 
 using namespace std;
@@ -262,6 +263,8 @@ Attributes ListDataStoresArrayBuilder::getAttributes() const
     (AttributeDesc(FILE_BYTES,     "file_bytes",     TID_UINT64,0,0))
     (AttributeDesc(FILE_BLOCKS_512,"file_blocks_512",TID_UINT64,0,0))
     (AttributeDesc(FILE_FREE,      "file_free_bytes",TID_UINT64,0,0))
+    (AttributeDesc(FREE_EXTENTS,   "free_extents",   TID_UINT64,0,0))
+    (AttributeDesc(LARGEST_FREE,   "largest_free_bytes",TID_UINT64,0,0))
     (emptyBitmapAttribute(EMPTY_INDICATOR));
 }
 
@@ -270,14 +273,81 @@ void ListDataStoresArrayBuilder::list(DataStore const& item)
     off_t    filesize = 0;
     blkcnt_t fileblks = 0;
     off_t    filefree = 0;
+    size_t   nextents = 0;
+    size_t   largest  = 0;
 
     item.getSizes(filesize, fileblks, filefree);
+    item.getFreeExtentStats(nextents, largest);
 
     beginElement();
     write(GUID,           item.getGuid());
     write(FILE_BYTES,     filesize);
     write(FILE_BLOCKS_512,fileblks);
     write(FILE_FREE ,     filefree);
+    write(FREE_EXTENTS,   nextents);
+    write(LARGEST_FREE,   largest);
+    endElement();
+}
+
+/****************************************************************************/
+
+Attributes ListReplicationArrayBuilder::getAttributes() const
+{
+    return list_of
+    (AttributeDesc(PEER,         "peer",          TID_UINT64,0,0))
+    (AttributeDesc(CHUNKS,       "chunks",        TID_UINT64,0,0))
+    (AttributeDesc(MESSAGES,     "messages",      TID_UINT64,0,0))
+    (AttributeDesc(BYTES,        "bytes",         TID_UINT64,0,0))
+    (AttributeDesc(QUEUED_CHUNKS,"queued_chunks", TID_UINT64,0,0))
+    (AttributeDesc(QUEUED_BYTES, "queued_bytes",  TID_UINT64,0,0))
+    (AttributeDesc(WAITS,        "writer_waits",  TID_UINT64,0,0))
+    (AttributeDesc(WAIT_MSECS,   "writer_wait_msecs",TID_UINT64,0,0))
+    (emptyBitmapAttribute(EMPTY_INDICATOR));
+}
+
+void ListReplicationArrayBuilder::list(ReplicationManager::PeerStats const& item)
+{
+    beginElement();
+    write(PEER,          item.instanceId);
+    write(CHUNKS,        item.chunks);
+    write(MESSAGES,      item.messages);
+    write(BYTES,         item.bytes);
+    write(QUEUED_CHUNKS, item.queuedChunks);
+    write(QUEUED_BYTES,  item.queuedBytes);
+    write(WAITS,         item.waits);
+    write(WAIT_MSECS,    item.waitMsecs);
+    endElement();
+}
+
+/****************************************************************************/
+
+Attributes ListMemoryArrayBuilder::getAttributes() const
+{
+    return list_of
+    (AttributeDesc(NAME,        "name",        TID_STRING,0,0))
+    (AttributeDesc(ALLOCATED,   "allocated",   TID_UINT64,0,0))
+    (AttributeDesc(PEAK,        "peak",        TID_UINT64,0,0))
+    (AttributeDesc(ALLOCATIONS, "allocations", TID_UINT64,0,0))
+    (AttributeDesc(CACHED,      "cached",      TID_UINT64,0,0))
+    (AttributeDesc(HITS,        "hits",        TID_UINT64,0,0))
+    (AttributeDesc(MISSES,      "misses",      TID_UINT64,0,0))
+    (AttributeDesc(RELEASED,    "released",    TID_UINT64,0,0))
+    (emptyBitmapAttribute(EMPTY_INDICATOR));
+}
+
+void ListMemoryArrayBuilder::list(arena::Arena const& item)
+{
+    arena::PoolArena const* pool = dynamic_cast<arena::PoolArena const*>(&item);
+
+    beginElement();
+    write(NAME,        item.name());
+    write(ALLOCATED,   item.allocated());
+    write(PEAK,        item.peakusage());
+    write(ALLOCATIONS, item.allocations());
+    write(CACHED,      pool ? pool->cached()   : size_t(0));
+    write(HITS,        pool ? pool->hits()     : size_t(0));
+    write(MISSES,      pool ? pool->misses()   : size_t(0));
+    write(RELEASED,    pool ? pool->released() : size_t(0));
     endElement();
 }
 
@@ -293,6 +363,9 @@ Attributes ListQueriesArrayBuilder::getAttributes() const
     (AttributeDesc(ERROR_CODE,   "error_code",   TID_INT32,   0,0))
     (AttributeDesc(ERROR,        "error",        TID_STRING,  0,0))
     (AttributeDesc(IDLE,         "idle",         TID_BOOL,    0,0))
+    (AttributeDesc(MEM_RESERVED, "mem_reserved", TID_UINT64,  0,0))
+    (AttributeDesc(QUEUED,       "queued",       TID_BOOL,    0,0))
+    (AttributeDesc(ADMISSION_WAIT,"admission_wait_msecs",TID_UINT64,0,0))
     (emptyBitmapAttribute(EMPTY_INDICATOR));
 }
 
@@ -313,6 +386,9 @@ void ListQueriesArrayBuilder::list(std::shared_ptr<Query> const& query)
     write(ERROR_CODE,   error ? error->getLongErrorCode() : 0);
     write(ERROR,        error ? error->getErrorMessage() : "");
     write(IDLE,         query->idle());
+    write(MEM_RESERVED, query->getMemoryReservation());
+    write(QUEUED,       query->isAdmissionQueued());
+    write(ADMISSION_WAIT,query->getAdmissionWaitMsecs());
     endElement();
 }
 
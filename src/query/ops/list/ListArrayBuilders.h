@@ -31,6 +31,7 @@
 #include <util/PluginManager.h>
 #include <util/DataStore.h>
 #include <util/Counter.h>
+#include <util/Arena.h>
 
 /****************************************************************************/
 namespace scidb {
@@ -162,6 +163,8 @@ struct ListDataStoresArrayBuilder : ListArrayBuilder
         FILE_BYTES,
         FILE_BLOCKS_512,
         FILE_FREE,
+        FREE_EXTENTS,
+        LARGEST_FREE,
         EMPTY_INDICATOR,
         NUM_ATTRIBUTES
     };
@@ -170,6 +173,52 @@ struct ListDataStoresArrayBuilder : ListArrayBuilder
     Attributes getAttributes() const;
 };
 
+/**
+ *  A ListArrayBuilder for listing the chunk replicas sent to each instance.
+ */
+struct ListReplicationArrayBuilder : ListArrayBuilder
+{
+    enum
+    {
+        PEER,
+        CHUNKS,
+        MESSAGES,
+        BYTES,
+        QUEUED_CHUNKS,
+        QUEUED_BYTES,
+        WAITS,
+        WAIT_MSECS,
+        EMPTY_INDICATOR,
+        NUM_ATTRIBUTES
+    };
+
+    void       list(const ReplicationManager::PeerStats&);
+    Attributes getAttributes() const;
+};
+
+/**
+ *  A ListArrayBuilder for listing the memory held by the arenas and pools.
+ */
+struct ListMemoryArrayBuilder : ListArrayBuilder
+{
+    enum
+    {
+        NAME,
+        ALLOCATED,
+        PEAK,
+        ALLOCATIONS,
+        CACHED,
+        HITS,
+        MISSES,
+        RELEASED,
+        EMPTY_INDICATOR,
+        NUM_ATTRIBUTES
+    };
+
+    void       list(const arena::Arena&);
+    Attributes getAttributes() const;
+};
+
 /**
  *  A ListArrayBuilder for listing Query objects.
  */
@@ -184,6 +233,9 @@ struct ListQueriesArrayBuilder : ListArrayBuilder
         ERROR_CODE,
         ERROR,
         IDLE,
+        MEM_RESERVED,
+        QUEUED,
+        ADMISSION_WAIT,
         EMPTY_INDICATOR,
         NUM_ATTRIBUTES
     };
@@ -63,6 +63,8 @@ using namespace boost;
  *   - types: show all the datatypes that SciDB supports.
  *   - queries: show all the active queries.
  *   - datastores: show information about each datastore
+ *   - replication: show the chunk replicas each instance has sent to each other instance
+ *   - memory: show the memory each instance holds in its root arena and its chunk and value pools
  *   - counters: (undocumented) dump info from performance counters
  *
  * @par Input:
@@ -190,6 +192,10 @@ struct LogicalList : LogicalOperator
             return ListLibrariesArrayBuilder().getSchema(query);
         } else if (what == "datastores") {
             return ListDataStoresArrayBuilder().getSchema(query);
+        } else if (what == "replication") {
+            return ListReplicationArrayBuilder().getSchema(query);
+        } else if (what == "memory") {
+            return ListMemoryArrayBuilder().getSchema(query);
         } else if (what == "counters") {
             return ListCounterArrayBuilder().getSchema(query);
         } else if (what == "users") {
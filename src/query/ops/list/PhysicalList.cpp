@@ -34,6 +34,7 @@
 #include <system/SystemCatalog.h>
 #include <query/TypeSystem.h>
 #include <util/PluginManager.h>
+#include <util/arena/PoolArena.h>
 #include <smgr/io/Storage.h>
 #include "ListArrayBuilders.h"
 #include <usr_namespace/NamespacesCommunicator.h>
@@ -97,7 +98,9 @@ struct PhysicalList : PhysicalOperator
             "datastores",
             "libraries",
             "meminfo",
+            "memory",
             "queries",
+            "replication",
         };
 
         return !std::binary_search(s,s+SCIDB_SIZE(s),getMainParameter().c_str(),less_strcmp());
@@ -269,6 +272,21 @@ struct PhysicalList : PhysicalOperator
                     boost::bind(
                         &ListDataStoresArrayBuilder::list,&builder,_1)));
             return builder.getArray();
+        } else if (what == "replication") {
+            ListReplicationArrayBuilder builder;
+            builder.initialize(query);
+            ReplicationManager::getInstance()->visitPeerStats(
+                ReplicationManager::PeerStatsVisitor(
+                    boost::bind(
+                        &ListReplicationArrayBuilder::list,&builder,_1)));
+            return builder.getArray();
+        } else if (what == "memory") {
+            ListMemoryArrayBuilder builder;
+            builder.initialize(query);
+            builder.list(*arena::getArena());
+            builder.list(arena::getChunkPool());
+            builder.list(arena::getValuePool());
+            return builder.getArray();
         } else if (what == "counters") {
             bool reset = false;
             if (_parameters.size() == 2)
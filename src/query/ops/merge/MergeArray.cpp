@@ -30,6 +30,7 @@
 #include <query/Operator.h>
 #include <array/Metadata.h>
 #include <array/Array.h>
+#include <array/RLE.h>
 #include <query/ops/merge/MergeArray.h>
 
 namespace scidb
@@ -51,24 +52,6 @@ namespace scidb
         return !cl(pos2,pos1);
     }
 
-    /**
-     * Compare a positioned ChunkIterator with a coordinate pair.
-     * @return true if i1 is positioned at coordinates less than pos2, false otherwise
-     */
-    inline bool precede(std::shared_ptr<ConstChunkIterator>& i1, Coordinates const& pos2)
-    {
-        return cl(i1->getPosition(), pos2);
-    }
-
-    /**
-     * Compare the positions of two ChunkIterators.
-     * @return true if i1 is positioned at coordinates less than i2, false otherwise.
-     */
-    inline bool precede(std::shared_ptr<ConstChunkIterator>& i1, std::shared_ptr<ConstChunkIterator>& i2)
-    {
-        return precede(i1, i2->getPosition());
-    }
-
     /**
      * Compare the positions of two ArrayIterators
      * @return true if i1 is positioned at coordinates less than i2, false otherwise.
@@ -78,104 +61,126 @@ namespace scidb
         return cl(i1->getPosition(), i2->getPosition());
     }
 
-    //
-    // Merge chunk iterator methods
-    //
-
-    bool MergeChunkIterator::isEmpty()
-    {
-        if (currIterator < 0)
-            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
-        return iterators[currIterator]->isEmpty();
-    }
-
-    bool MergeChunkIterator::end()
+    namespace
     {
-        return currIterator < 0 || iterators[currIterator]->end();
-    }
-
-    void MergeChunkIterator::reset()
-    {
-        //reset all of our iterators, and set currIterator to the lowest position
-
-        currIterator = -1;
-        for (size_t i = 0, n = iterators.size(); i < n; i++) {
-            iterators[i]->reset();
-            if (!iterators[i]->end() && (currIterator < 0 || precede(iterators[i], iterators[currIterator])))
-            {
-                currIterator = safe_static_cast<int>(i);
+        /**
+         * Append the 'length' cells at logical position 'lPosition' to 'segments',
+         * extending the last one if they follow it, and bump 'pPosition' past them.
+         */
+        void appendCells(vector<ConstRLEEmptyBitmap::Segment>& segments,
+                         position_t lPosition,
+                         position_t length,
+                         position_t& pPosition)
+        {
+            if (!segments.empty() && segments.back()._lPosition + segments.back()._length == lPosition) {
+                segments.back()._length += length;
+            } else {
+                ConstRLEEmptyBitmap::Segment segment;
+                segment._lPosition = lPosition;
+                segment._pPosition = pPosition;
+                segment._length = length;
+                segments.push_back(segment);
             }
+            pPosition += length;
         }
-    }
 
-    bool MergeChunkIterator::setPosition(Coordinates const& pos)
-    {
-        //simply set currIterator to the first iterator that has pos (if any)
-
-        currIterator = -1;
-        for (size_t i = 0, n = iterators.size(); i < n; i++)
+        /**
+         * Advance 'it' by the first 'length' cells of its current 'segment'.
+         */
+        void advanceBy(ConstRLEEmptyBitmap::SegmentIterator& it,
+                       ConstRLEEmptyBitmap::Segment const& segment,
+                       position_t length)
         {
-            if (iterators[i]->setPosition(pos))
-            {
-                currIterator = safe_static_cast<int>(i);
-                return true;
-            }
-            else
-            {
-                iterators[i]->reset();
+            if (length == segment._length) {
+                ++it;
+            } else {
+                it.advanceWithinSegment(length);
             }
         }
-        return false;
-    }
-
-    Value const& MergeChunkIterator::getItem()
-    {
-        if (currIterator < 0)
-            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
-        return iterators[currIterator]->getItem();
-    }
-
-    void MergeChunkIterator::operator ++()
-    {
-        //fast-forward all iterators until their position is greater than currPos,
-        //then pick the iterator with the lowest position
 
-        if (currIterator < 0)
-            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
-
-        Coordinates currPos = iterators[currIterator]->getPosition();
-        size_t n = iterators.size();
-        currIterator = -1;
-        for (size_t i = 0; i < n; i++)
+        /**
+         * Append the 'length' values that 'it' has from physical position 'pPosition'.
+         */
+        void appendValues(RLEPayload::append_iterator& appender,
+                          ConstRLEPayload::iterator& it,
+                          position_t pPosition,
+                          position_t length)
         {
-            while(!iterators[i]->end() && coordinatesLessOrEqual(iterators[i]->getPosition(), currPos))
-            {
-                ++(*iterators[i]);
+            if (!it.setPosition(pPosition)) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "setPosition";
             }
-            if(!iterators[i]->end() && (currIterator<0 || precede(iterators[i], iterators[currIterator])))
-            {
-                currIterator = safe_static_cast<int>(i);
+            uint64_t remaining = length;
+            while (remaining != 0) {
+                remaining -= appender.add(it, remaining);
             }
         }
-    }
 
-    Coordinates const& MergeChunkIterator::getPosition()
-    {
-        if (currIterator < 0)
-            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
-        return iterators[currIterator]->getPosition();
-    }
+        /**
+         * Merge two chunks as their empty bitmaps and payloads, the cells of 'hi'
+         * hiding those of 'lo'. Runs of cells are copied a segment at a time, so
+         * that the cost is in the number of segments and of distinct values.
+         * @param payload the merged payload, or NULL for the empty bitmap attribute,
+         *                in which case the payloads are not used
+         */
+        void mergeRle(ConstRLEEmptyBitmap const& hiBitmap, ConstRLEPayload const* hiPayload,
+                      ConstRLEEmptyBitmap const& loBitmap, ConstRLEPayload const* loPayload,
+                      RLEEmptyBitmap& bitmap, RLEPayload* payload)
+        {
+            vector<ConstRLEEmptyBitmap::Segment> segments;
+            segments.reserve(hiBitmap.nSegments() + loBitmap.nSegments());
+            std::unique_ptr<RLEPayload::append_iterator> appender(payload ? new RLEPayload::append_iterator(payload) : NULL);
+            ConstRLEPayload::iterator hiValues, loValues;
+            if (payload) {
+                hiValues = ConstRLEPayload::iterator(hiPayload);
+                loValues = ConstRLEPayload::iterator(loPayload);
+            }
 
-    MergeChunkIterator::MergeChunkIterator(vector< ConstChunk const* > const& inputChunks, DelegateChunk const* chunk, int iterationMode)
-    : DelegateChunkIterator(chunk, iterationMode),
-      iterators(inputChunks.size())
-    {
-        currIterator = -1;
-        for (size_t i = 0, n = inputChunks.size(); i < n; i++) {
-            iterators[i] = inputChunks[i]->getConstIterator(iterationMode & ~INTENDED_TILE_MODE);
-            if (!iterators[i]->end() && (currIterator < 0 || precede(iterators[i], iterators[currIterator])))
-            {
-                currIterator = safe_static_cast<int>(i);
+            ConstRLEEmptyBitmap::SegmentIterator hi(&hiBitmap);
+            ConstRLEEmptyBitmap::SegmentIterator lo(&loBitmap);
+            ConstRLEEmptyBitmap::Segment hiSegment, loSegment;
+            position_t pPosition = 0;
+            while (!hi.end() || !lo.end()) {
+                if (!hi.end()) {
+                    hi.getVirtualSegment(hiSegment);
+                }
+                if (!lo.end()) {
+                    lo.getVirtualSegment(loSegment);
+                }
+                if (!hi.end() && (lo.end() || hiSegment._lPosition <= loSegment._lPosition)) {
+                    // Cells of hi, hiding the cells of lo that they overlap
+                    position_t length = hiSegment._length;
+                    if (!lo.end() && hiSegment._lPosition < loSegment._lPosition) {
+                        length = min(length, loSegment._lPosition - hiSegment._lPosition);
+                    } else if (!lo.end()) {
+                        length = min(length, loSegment._length);
+                        advanceBy(lo, loSegment, length);
+                    }
+                    if (appender) {
+                        appendValues(*appender, hiValues, hiSegment._pPosition, length);
+                    }
+                    appendCells(segments, hiSegment._lPosition, length, pPosition);
+                    advanceBy(hi, hiSegment, length);
+                } else {
+                    // Cells of lo only
+                    position_t length = loSegment._length;
+                    if (!hi.end()) {
+                        length = min(length, hiSegment._lPosition - loSegment._lPosition);
+                    }
+                    if (appender) {
+                        appendValues(*appender, loValues, loSegment._pPosition, length);
+                    }
+                    appendCells(segments, loSegment._lPosition, length, pPosition);
+                    advanceBy(lo, loSegment, length);
+                }
+            }
+
+            bitmap.clear();
+            bitmap.reserve(segments.size());
+            for (size_t i = 0; i < segments.size(); ++i) {
+                bitmap.addSegment(segments[i]);
+            }
+            if (appender) {
+                appender->flush();
             }
         }
     }
@@ -252,6 +257,55 @@ namespace scidb
         return iterators[currIterator]->getPosition();
     }
 
+    bool MergeArrayIterator::isFull(ConstChunk const& chunk) const
+    {
+        std::shared_ptr<ConstRLEEmptyBitmap> bitmap = chunk.getEmptyBitmap();
+        return bitmap && bitmap->count() == chunk.getNumberOfElements(true);
+    }
+
+    void MergeArrayIterator::mergeChunks(vector< ConstChunk const* > const& chunks)
+    {
+        assert(chunks.size() > 1);
+        ConstChunk const& first = *chunks[0];
+        bool const isBitmap = first.getAttributeDesc().isEmptyIndicator();
+        Type const& type = TypeLibrary::getType(first.getAttributeDesc().getType());
+
+        // Each input is merged under the result of the ones before it
+        std::shared_ptr<RLEEmptyBitmap> bitmap = std::make_shared<RLEEmptyBitmap>();
+        std::shared_ptr<RLEPayload> payload = std::make_shared<RLEPayload>(type);
+        {
+            RLEChunkData hi(first);
+            RLEChunkData lo(*chunks[1]);
+            mergeRle(hi.getBitmap(), hi.getPayload(), lo.getBitmap(), lo.getPayload(),
+                     *bitmap, isBitmap ? NULL : payload.get());
+        }
+        for (size_t i = 2; i < chunks.size(); ++i) {
+            RLEChunkData lo(*chunks[i]);
+            std::shared_ptr<RLEEmptyBitmap> merged = std::make_shared<RLEEmptyBitmap>();
+            std::shared_ptr<RLEPayload> mergedPayload = std::make_shared<RLEPayload>(type);
+            mergeRle(*bitmap, payload.get(), lo.getBitmap(), lo.getPayload(),
+                     *merged, isBitmap ? NULL : mergedPayload.get());
+            bitmap = merged;
+            payload = mergedPayload;
+        }
+
+        Address addr(first.getAttributeDesc().getId(), first.getFirstPosition(false));
+        mergedChunk.initialize(&array, &array.getArrayDesc(), addr, first.getCompressionMethod());
+        if (isBitmap) {
+            mergedChunk.allocate(bitmap->packedSize());
+            bitmap->pack(static_cast<char*>(mergedChunk.getData()));
+        } else {
+            // The payload carries its empty bitmap, as after a deep chunk merge
+            mergedChunk.allocate(payload->packedSize() + bitmap->packedSize());
+            payload->pack(static_cast<char*>(mergedChunk.getData()));
+            bitmap->pack(static_cast<char*>(mergedChunk.getData()) + payload->packedSize());
+            mergedChunk.setEmptyBitmap(bitmap);
+        }
+        if (!array.getArrayDesc().hasOverlap()) {
+            mergedChunk.setCount(bitmap->count());
+        }
+    }
+
     ConstChunk const& MergeArrayIterator::getChunk()
     {
         if (currentChunk == NULL) {
@@ -259,28 +313,29 @@ namespace scidb
                 throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
             Coordinates const& currPos = iterators[currIterator]->getPosition();
             ConstChunk const& currChunk = iterators[currIterator]->getChunk();
-            if (!isEmptyable) {
+            if (!isEmptyable || isFull(currChunk)) {
+                // Nothing of the other inputs shows through
                 currentChunk = &currChunk;
                 return currChunk;
             }
-            chunk.inputChunks.clear();
-            chunk.inputChunks.push_back(&currChunk);
+            inputChunks.clear();
+            inputChunks.push_back(&currChunk);
             for (size_t i = currIterator+1, n = iterators.size(); i < n; i++) {
                 if (!iterators[i]->end() && iterators[i]->getPosition() == currPos) {
                     ConstChunk const& mergeChunk = iterators[i]->getChunk();
                     if (!mergeChunk.getConstIterator(ChunkIterator::IGNORE_EMPTY_CELLS)->end()) {
-                        chunk.inputChunks.push_back(&mergeChunk);
+                        inputChunks.push_back(&mergeChunk);
                     } else {
                         ++(*iterators[i]);
                     }
                 }
             }
-            if (chunk.inputChunks.size() == 1) {
+            if (inputChunks.size() == 1) {
                 currentChunk = &currChunk;
                 return currChunk;
             }
-            chunk.setInputChunk(currChunk);
-            currentChunk = &chunk;
+            mergeChunks(inputChunks);
+            currentChunk = &mergedChunk;
         }
         return *currentChunk;
     }
@@ -289,7 +344,6 @@ namespace scidb
 
     MergeArrayIterator::MergeArrayIterator(MergeArray const& array, AttributeID attrID)
     : DelegateArrayIterator(array, attrID, array.inputArrays[0]->getConstIterator(attrID)),
-      chunk(array, *this, attrID),
       iterators(array.inputArrays.size()),
       currIterator(-1),
       currentChunk(NULL)
@@ -308,11 +362,6 @@ namespace scidb
     //
     // Merge array methods
     //
-    DelegateChunkIterator* MergeArray::createChunkIterator(DelegateChunk const* chunk, int iterationMode) const
-    {
-        return new MergeChunkIterator(((MergeChunk const*)chunk)->inputChunks, chunk, iterationMode);
-    }
-
     DelegateArrayIterator* MergeArray::createArrayIterator(AttributeID attrID) const
     {
         return new MergeArrayIterator(*this, attrID);
@@ -34,6 +34,7 @@
 #include <vector>
 
 #include <array/DelegateArray.h>
+#include <array/MemChunk.h>
 #include <array/Metadata.h>
 
 namespace scidb
@@ -43,38 +44,17 @@ using namespace std;
 
 class MergeArray;
 class MergeArrayIterator;
-class MergeChunkIterator;
-
-
-class MergeChunkIterator : public DelegateChunkIterator
-{
-  public:
-    virtual bool end();
-    virtual bool isEmpty();
-    virtual Value const& getItem();
-    virtual void operator ++();
-    virtual void reset();
-	virtual bool setPosition(Coordinates const& pos);
-	virtual Coordinates const& getPosition();
-
-    MergeChunkIterator(std::vector< ConstChunk const* > const& inputChunks, DelegateChunk const* chunk, int iterationMode);
-
-  private:
-    int currIterator;
-    int mode;
-    std::vector< std::shared_ptr<ConstChunkIterator> > iterators;
-};
-
-class MergeChunk : public DelegateChunk
-{
-  public:
-    std::vector< ConstChunk const* > inputChunks;
-
-    MergeChunk(DelegateArray const& array, DelegateArrayIterator const& iterator, AttributeID attrID)
-    : DelegateChunk(array, iterator, attrID, false) {}
-};
 
 
+/**
+ * Iterates over the chunks of the inputs of merge(), in position order.
+ *
+ * A chunk that only one input has, or that the first input holding it fills
+ * entirely, is the chunk of that input; otherwise the chunks of the inputs at
+ * that position are merged, segment by segment of their empty bitmaps and RLE
+ * payloads, into a chunk of the iterator.  Merging a patch into a large array
+ * therefore only touches the chunks that the patch has.
+ */
 class MergeArrayIterator : public DelegateArrayIterator
 {
   public:
@@ -87,7 +67,21 @@ class MergeArrayIterator : public DelegateArrayIterator
     MergeArrayIterator(MergeArray const& array, AttributeID attrID);
 
   private:
-    MergeChunk chunk;
+    /**
+     * @return true if 'chunk' has every cell of its area, so that the chunks
+     * of the inputs after it at the same position are hidden
+     */
+    bool isFull(ConstChunk const& chunk) const;
+
+    /**
+     * Merge the chunks of the inputs at the current position into mergedChunk,
+     * the cells of each input hiding those of the inputs after it.
+     * @param inputChunks the chunks, in the order of the inputs
+     */
+    void mergeChunks(std::vector< ConstChunk const* > const& inputChunks);
+
+    MemChunk mergedChunk;
+    std::vector< ConstChunk const* > inputChunks;
     std::vector< std::shared_ptr<ConstArrayIterator> > iterators;
     int currIterator;
     bool isEmptyable;
@@ -98,7 +92,6 @@ class MergeArray : public DelegateArray
 {
     friend class MergeArrayIterator;
   public:
-    virtual DelegateChunkIterator* createChunkIterator(DelegateChunk const* chunk, int iterationMode) const;
     virtual DelegateArrayIterator* createArrayIterator(AttributeID id) const;
 
     /**
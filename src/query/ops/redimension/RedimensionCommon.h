@@ -197,6 +197,21 @@ public:
         return PhysicalBoundaries::createFromFullSchema(_schema);
     }
 
+    /**
+     * @see PhysicalOperator::getMemoryEstimate
+     * @return this instance's share of the input, which is buffered and
+     * sorted before the output chunks are built
+     */
+    virtual uint64_t getMemoryEstimate(std::vector<PhysicalBoundaries>const& inputBoundaries,
+                                       std::vector<ArrayDesc>const& inputSchemas,
+                                       size_t nInstances) const
+    {
+        double const bytes = inputBoundaries[0].getSizeEstimateBytes(inputSchemas[0]) /
+                             static_cast<double>(std::max<size_t>(nInstances, 1));
+        return bytes < static_cast<double>(std::numeric_limits<uint64_t>::max()) ?
+            static_cast<uint64_t>(bytes) : std::numeric_limits<uint64_t>::max();
+    }
+
     /**
      * @see PhysicalOperator::getOutputDistribution
      * @return RedistributeContext(defaultPartitioning())
@@ -32,6 +32,7 @@
 #include <array/Metadata.h>
 #include <array/TransientCache.h>
 #include <query/Operator.h>
+#include <smgr/io/Storage.h>
 #include <system/SystemCatalog.h>
 #include <usr_namespace/NamespacesCommunicator.h>
 
@@ -84,7 +85,38 @@ class PhysicalScan: public  PhysicalOperator
         Coordinates lowBoundary = _schema.getLowBoundary();
         Coordinates highBoundary = _schema.getHighBoundary();
 
-        return PhysicalBoundaries(lowBoundary, highBoundary);
+        return PhysicalBoundaries(lowBoundary, highBoundary, estimateDensity(lowBoundary, highBoundary));
+    }
+
+    /**
+     * Estimate the fraction of non-empty cells inside the array bounding box
+     * from the local chunk map. The local share is scaled up by the number of
+     * instances in the array residency, which assumes that the chunks are
+     * spread evenly.
+     * @return the estimated density, or 1.0 if there are no statistics
+     */
+    double estimateDensity(Coordinates const& low, Coordinates const& high) const
+    {
+        if (_schema.isTransient() || low.empty()) {
+            return 1.0;
+        }
+        Storage::ArrayStats stats;
+        if (!StorageManager::getInstance().getArrayStats(_schema, stats) || stats.nCells == 0) {
+            return 1.0;
+        }
+        double nCells = static_cast<double>(stats.nCells);
+        if (_schema.getDistribution()->getPartitioningSchema() != psReplication) {
+            nCells *= static_cast<double>(_schema.getResidency()->size());
+        }
+        double const boxCells = static_cast<double>(PhysicalBoundaries::getNumCells(low, high));
+        double const density = boxCells > 0 ? std::min(nCells / boxCells, 1.0) : 1.0;
+
+        LOG4CXX_TRACE(logger, "PhysicalScan::estimateDensity array=" << _arrayName
+                      << " localChunks=" << stats.nChunks
+                      << " localCells=" << stats.nCells
+                      << " localBytes=" << stats.nBytes
+                      << " density=" << density);
+        return density;
     }
 
     virtual void preSingleExecute(std::shared_ptr<Query> query)
@@ -30,6 +30,7 @@
 
 #include "query/Operator.h"
 #include "query/OperatorLibrary.h"
+#include "query/PreparedPlanCache.h"
 #include "array/TupleArray.h"
 #include "system/Config.h"
 
@@ -81,6 +82,8 @@ class PhysicalSetopt: public PhysicalOperator
                                      SCIDB_LE_ERROR_NEAR_CONFIG_OPTION)
                     << e.what() << name;
             }
+            // The cached plans were made under the old value
+            PreparedPlanCache::getInstance()->clear();
 
             Value tuple[2];
             tuple[0].setString(oldValue.c_str());
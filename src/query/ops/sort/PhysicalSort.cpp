@@ -27,6 +27,7 @@
  *      Author: Donghui Zhang
  */
 
+#include <limits>
 #include <vector>
 
 #include <query/Operator.h>
@@ -75,6 +76,20 @@ public:
         return PhysicalBoundaries(start,end);
     }
 
+    /**
+     * @see PhysicalOperator::getMemoryEstimate
+     * @return this instance's share of the input, which is sorted in memory
+     */
+    virtual uint64_t getMemoryEstimate(const std::vector<PhysicalBoundaries> & inputBoundaries,
+                                       const std::vector< ArrayDesc> & inputSchemas,
+                                       size_t nInstances) const
+    {
+        double const bytes = inputBoundaries[0].getSizeEstimateBytes(inputSchemas[0]) /
+                             static_cast<double>(std::max<size_t>(nInstances, 1));
+        return bytes < static_cast<double>(std::numeric_limits<uint64_t>::max()) ?
+            static_cast<uint64_t>(bytes) : std::numeric_limits<uint64_t>::max();
+    }
+
     /**
      * From the user-provided parameters to the sort() operator, generate SortingAttributeInfos.
      * @param[out] an initially empty vector to receive the SortingAttributeInfos.
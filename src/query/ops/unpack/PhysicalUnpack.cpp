@@ -28,12 +28,14 @@
  *      Author: poliocough@gmail.com
  */
 
-#include <boost/scope_exit.hpp>
-
 #include <query/Operator.h>
+#include <system/Config.h>
+#include <util/Job.h>
 #include <util/Network.h>
 #include <array/Metadata.h>
 
+#include "UnpackArray.h"
+
 using namespace std;
 using namespace boost;
 
@@ -274,33 +276,49 @@ std::ostream& operator<<(std::ostream& stream, const UnpackArrayInfo& info)
 }
 
 /**
- * Helper: given a vector of iterator pointers, check if they are set;  call flush() on numIterators first elements, then clear them.
- * @param[in] iterators the iterators to flush
- * @param[in] numIterators number of elements to flush
+ * A job that counts the cells of the id-th local chunk of the input array, the (id+nJobs)-th chunk, and so on.
+ * A job has its own iterator and writes only its own entries of the counts.
  */
-template <class T>
-inline void resetIterators(vector<std::shared_ptr<T> > & iterators, size_t const numIterators)
+class UnpackCountJob : public Job
 {
-    for (size_t i=0; i<numIterators && iterators[i]; i++)
-    {
-        iterators[i]->flush();
-        iterators[i].reset();
-    }
-}
+private:
+    std::shared_ptr<Array> _inputArray;
+    AttributeID _cellsAttribute;
+    size_t _id;
+    size_t _nJobs;
+    vector<Coordinates> const& _chunkPos;
+    vector<size_t>& _counts;
 
-/**
- * Helper: given a vector of iterator pointers, call operator++ on each.
- * @param[in] iterators the iterators to increment
- * @param[in] numIterators number of elements to increment
- */
-template <class T>
-inline void incrementIterators(vector<std::shared_ptr<T> > & iterators, size_t const numIterators)
-{
-    for (size_t i=0; i<numIterators; i++)
+public:
+    UnpackCountJob(std::shared_ptr<Query> const& query,
+                   std::shared_ptr<Array> const& inputArray,
+                   AttributeID cellsAttribute,
+                   size_t id,
+                   size_t nJobs,
+                   vector<Coordinates> const& chunkPos,
+                   vector<size_t>& counts)
+    : Job(query),
+      _inputArray(inputArray),
+      _cellsAttribute(cellsAttribute),
+      _id(id),
+      _nJobs(nJobs),
+      _chunkPos(chunkPos),
+      _counts(counts)
+    {}
+
+protected:
+    virtual void run()
     {
-        ++(*iterators[i]);
+        std::shared_ptr<ConstArrayIterator> iter = _inputArray->getConstIterator(_cellsAttribute);
+        for (size_t i = _id; i < _chunkPos.size(); i += _nJobs) {
+            Query::validateQueryPtr(_query);
+            if (!iter->setPosition(_chunkPos[i])) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+            }
+            _counts[i] = UnpackArray::countCells(iter->getChunk());
+        }
     }
-}
+};
 
 /**
  * The Unpack Physical Operator.
@@ -388,14 +406,13 @@ public:
     }
 
     /**
-     * Perform a single pass over some attribute of the inputArray and populate info with data about
-     * the array.
-     * @param[in] inputArray the array to iterate over
-     * @param[out] info the structure to populate
+     * Pick the attribute of the input whose chunks give the cells: the empty bitmap if there is one, else the
+     * attribute with the smallest fixed size.
+     * @param[in] desc the shape of the input array
+     * @return the id of the attribute
      */
-    void collectChunkInfo(std::shared_ptr<Array> const& inputArray, UnpackArrayInfo& info)
+    static AttributeID getCellsAttribute(ArrayDesc const& desc)
     {
-        ArrayDesc const& desc = inputArray->getArrayDesc();
         AttributeID victimAttribute = 0;
         if( desc.getEmptyBitmapAttribute() )
         {
@@ -416,16 +433,59 @@ public:
                 }
             }
         }
-        std::shared_ptr<ConstArrayIterator> iter = inputArray->getConstIterator(victimAttribute);
-        while (!iter->end())
+        return victimAttribute;
+    }
+
+    /**
+     * Count the cells of the local chunks of the inputArray, in parallel jobs, and populate info with data
+     * about the array. The count of a chunk is taken from its metadata when it is known.
+     * @param[in] inputArray the array to iterate over
+     * @param[in] query the query context
+     * @param[out] localChunkPos the positions of the local chunks, in order
+     * @param[out] info the structure to populate
+     */
+    void collectChunkInfo(std::shared_ptr<Array> const& inputArray,
+                          std::shared_ptr<Query> const& query,
+                          vector<Coordinates>& localChunkPos,
+                          UnpackArrayInfo& info)
+    {
+        std::shared_ptr<CoordinateSet> chunkPos = inputArray->findChunkPositions();
+        localChunkPos.assign(chunkPos->begin(), chunkPos->end());
+        vector<size_t> counts(localChunkPos.size());
+
+        size_t const nThreads = static_cast<size_t>(
+            std::max(Config::getInstance()->getOption<int>(CONFIG_RESULT_PREFETCH_QUEUE_SIZE), 1));
+        size_t const nJobs = std::max(std::min(nThreads, localChunkPos.size()), size_t(1));
+        AttributeID const cellsAttribute = getCellsAttribute(inputArray->getArrayDesc());
+
+        std::shared_ptr<JobQueue> queue = PhysicalOperator::getGlobalQueueForOperators();
+        vector< std::shared_ptr<UnpackCountJob> > jobs(nJobs);
+        for (size_t i = 0; i < nJobs; i++) {
+            jobs[i] = make_shared<UnpackCountJob>(query, inputArray, cellsAttribute, i, nJobs, localChunkPos, counts);
+        }
+        for (size_t i = 1; i < nJobs; i++) {
+            queue->pushJob(jobs[i]);
+        }
+
+        jobs[0]->execute();
+
+        int errorJob = -1;
+        for (size_t i = 0; i < nJobs; i++) {
+            if (!jobs[i]->wait()) {
+                errorJob = safe_static_cast<int>(i);
+            }
+        }
+        if (errorJob >= 0) {
+            jobs[errorJob]->rethrow();
+        }
+
+        for (size_t i = 0; i < localChunkPos.size(); i++)
         {
             UnpackChunkAddress addr;
-            addr.inputChunkPos = iter->getPosition();
-            ConstChunk const& chunk = iter->getChunk();
-            addr.elementCount = chunk.count();
+            addr.inputChunkPos = localChunkPos[i];
+            addr.elementCount = counts[i];
             addr.outputPos = 0;
             info.insert(addr);
-            ++(*iter);
         }
     }
 
@@ -472,14 +532,17 @@ public:
 
     /**
      * Build a UnpackArrayInfo from the local array, then exchange data with other nodes, then compute the starting
-     * positions for each of the chunks.
+     * positions for each of the chunks. The prefix sum is over one entry per chunk of the whole array, which is
+     * cheap next to counting the cells.
      * @param[in] inputArray the array to scan
      * @param[in] query the query context
+     * @param[out] localChunkPos the positions of the local chunks, in order
      * @param[out] info the data to collect
      */
-    void computeGlobalChunkInfo(std::shared_ptr<Array> const& inputArray, std::shared_ptr<Query>& query, UnpackArrayInfo& info)
+    void computeGlobalChunkInfo(std::shared_ptr<Array> const& inputArray, std::shared_ptr<Query>& query,
+                                vector<Coordinates>& localChunkPos, UnpackArrayInfo& info)
     {
-        collectChunkInfo(inputArray, info);
+        collectChunkInfo(inputArray, query, localChunkPos, info);
         exchangeChunkInfo(info, query);
         Coordinate startingPosition = 0;
         for(UnpackArrayInfo::iterator i = info.begin(); i != info.end(); ++i)
@@ -489,95 +552,15 @@ public:
         }
     }
 
-    /**
-     * Given an input array and an UnpackArrayInfo - create an outputArray by opening each chunk of the input, looking up
-     * the corresponding position for the data in the output array and appending it.
-     * @param[in] inputArray the array to take data from
-     * @param[in] chunkInfo the information about where to place which chunks
-     * @param[in] query the query context
-     * @return the output MemArray with partially filled chunks wherein all the data elements are at the right place
-     */
-    std::shared_ptr<Array> fillOutputArray(std::shared_ptr<Array> const& inputArray, UnpackArrayInfo const& chunkInfo, std::shared_ptr<Query> &query)
-    {
-        std::shared_ptr<Array> result = make_shared<MemArray>(_schema,query);
-        ArrayDesc const& inputSchema = inputArray->getArrayDesc();
-        size_t nSrcDims = inputSchema.getDimensions().size();
-        size_t nSrcAttrs = inputSchema.getAttributes(true).size();
-        size_t startOfAttributes = inputSchema.getDimensions().size(); //remember that the first attributes of dst are dimensions from src
-        size_t nDstAttrs = _schema.getAttributes(true).size();
-        Coordinates outputChunkPos(0);
-        Coordinates outputCellPos(1,0);
-        vector<std::shared_ptr<ConstArrayIterator> > saiters (nSrcAttrs); //source array and chunk iters
-        vector<std::shared_ptr<ConstChunkIterator> > sciters (nSrcAttrs);
-        vector<std::shared_ptr<ArrayIterator> > daiters (nDstAttrs);      //destination array and chunk iters
-        vector<std::shared_ptr<ChunkIterator> > dciters (nDstAttrs);
-        for(AttributeID i =0; i<nSrcAttrs; i++)
-        {
-            saiters[i] = inputArray->getConstIterator(i);
-        }
-        for(AttributeID i =0; i<nDstAttrs; i++)
-        {
-            daiters[i] = result->getIterator(i);
-        }
-
-        BOOST_SCOPE_EXIT((&dciters)(&nDstAttrs)) {
-            resetIterators(dciters, nDstAttrs);
-        } BOOST_SCOPE_EXIT_END
-
-        Value buf;
-        while ( !saiters[0]->end() )
-        {
-            Coordinates const& chunkPos = saiters[0]->getPosition();
-            outputCellPos[0] = chunkInfo.getOutputPos(chunkPos);
-            for (AttributeID i = 0; i < nSrcAttrs; i++)
-            {
-                sciters[i] = saiters[i]->getChunk().getConstIterator();
-            }
-            while(!sciters[0]->end())
-            {
-                SCIDB_ASSERT(outputChunkPos.size() == 0 || outputCellPos[0] >= outputChunkPos[0] ); //can't go backwards!
-                if(outputChunkPos.size() == 0 || outputCellPos[0] > (outputChunkPos[0] + _outputChunkSize) - 1)
-                {
-                    resetIterators(dciters, nDstAttrs);
-                    outputChunkPos = outputCellPos;
-                    _schema.getChunkPositionFor(outputChunkPos);
-                    for (AttributeID i=0; i<nDstAttrs; i++)
-                    {
-                        Chunk& outChunk = daiters[i]->newChunk(outputChunkPos);
-                        dciters[i] = outChunk.getIterator(query, i == 0 ? ChunkIterator::SEQUENTIAL_WRITE : //populate empty tag from attr 0 implicitly
-                                                                          ChunkIterator::SEQUENTIAL_WRITE | ChunkIterator::NO_EMPTY_CHECK);
-                    }
-                }
-                Coordinates const& inputCellPos = sciters[0]->getPosition();
-                for(size_t i=0; i<nSrcDims; i++)
-                {
-                    dciters[i]->setPosition(outputCellPos);
-                    buf.setInt64(inputCellPos[i]);
-                    dciters[i]->writeItem(buf);
-                }
-                for(size_t i=0; i<nSrcAttrs; i++)
-                {
-                    dciters[i+startOfAttributes]->setPosition(outputCellPos);
-                    dciters[i+startOfAttributes]->writeItem(sciters[i]->getItem());
-                }
-                outputCellPos[0]++;
-                incrementIterators(sciters, nSrcAttrs);
-            }
-            incrementIterators(saiters, nSrcAttrs);
-        }
-        resetIterators(dciters, nDstAttrs);
-        return result;
-    }
-
     /**
      * Given the input array, first build an UnpackArrayInfo of how many elements each chunk has, then
      * redistribute the info to the coordinator, merge it, and use it to compute a place in the output array for
-     * each chunk in the input; construct a MemArray with partially filled chunks where each element is in the proper
-     * dense position. The operator will complete when the optimizer inserts redistribute after the operator and
-     * merges the partially-filled chunks together.
+     * each chunk in the input; return an UnpackArray whose partially filled chunks, with each element in the proper
+     * dense position, are built from the input chunks as they are asked for. The operator will complete when the
+     * optimizer inserts redistribute after the operator and merges the partially-filled chunks together.
      * @param[in] inputArrays only care about the first
      * @param[in] query the query context
-     * @return the MemArray with partially filled chunks wherein each element is in the correct place
+     * @return the UnpackArray with partially filled chunks wherein each element is in the correct place
      */
     std::shared_ptr<Array> execute(vector< std::shared_ptr<Array> >& inputArrays, std::shared_ptr<Query> query)
     {
@@ -586,9 +569,26 @@ public:
         Dimensions const& dims = inputArray->getArrayDesc().getDimensions();
 
         UnpackArrayInfo info(dims.size());
-        computeGlobalChunkInfo(inputArray, query, info);
+        vector<Coordinates> localChunkPos;
+        computeGlobalChunkInfo(inputArray, query, localChunkPos, info);
         LOG4CXX_TRACE(logger, "Computed global chunk info "<<info);
-        return fillOutputArray(inputArray, info, query);
+
+        vector<UnpackArray::InputChunk> localChunks(localChunkPos.size());
+        for (size_t i = 0; i < localChunkPos.size(); i++)
+        {
+            UnpackChunkAddress addr;
+            addr.inputChunkPos = localChunkPos[i];
+            UnpackArrayInfo::const_iterator iter = info.find(addr);
+            if (iter == info.end())
+            {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "Can't find coordinates "<<CoordsToStr(addr.inputChunkPos)<<" in set";
+            }
+            localChunks[i].position = iter->inputChunkPos;
+            localChunks[i].outputPos = iter->outputPos;
+            localChunks[i].count = iter->elementCount;
+        }
+        return make_shared<UnpackArray>(_schema, inputArray, localChunks,
+                                        getCellsAttribute(inputArray->getArrayDesc()));
     }
 };
 
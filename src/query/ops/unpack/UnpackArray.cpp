@@ -0,0 +1,296 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * UnpackArray.cpp
+ */
+
+#include <algorithm>
+
+#include <query/TypeSystem.h>
+#include <system/Exceptions.h>
+#include <util/CoordinatesMapper.h>
+
+#include "UnpackArray.h"
+
+using namespace std;
+
+namespace scidb
+{
+    //
+    // Array iterator
+    //
+    UnpackArrayIterator::UnpackArrayIterator(UnpackArray const& array, AttributeID attrID, AttributeID inputAttrID)
+    : DelegateArrayIterator(array, attrID, array.getInputArray()->getConstIterator(inputAttrID)),
+      _array(array),
+      _outputChunkNo(0)
+    {
+    }
+
+    bool UnpackArrayIterator::end()
+    {
+        return _outputChunkNo >= _array._outputChunks.size();
+    }
+
+    void UnpackArrayIterator::operator ++()
+    {
+        if (end()) {
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
+        }
+        ++_outputChunkNo;
+        chunkInitialized = false;
+    }
+
+    Coordinates const& UnpackArrayIterator::getPosition()
+    {
+        if (end()) {
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
+        }
+        return _array._outputChunks[_outputChunkNo].position;
+    }
+
+    bool UnpackArrayIterator::setPosition(Coordinates const& pos)
+    {
+        Coordinates chunkPos = pos;
+        _array.getArrayDesc().getChunkPositionFor(chunkPos);
+        size_t lo = 0, hi = _array._outputChunks.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (_array._outputChunks[mid].position[0] < chunkPos[0]) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        chunkInitialized = false;
+        if (lo < _array._outputChunks.size() && _array._outputChunks[lo].position[0] == chunkPos[0]) {
+            _outputChunkNo = lo;
+            return true;
+        }
+        _outputChunkNo = _array._outputChunks.size();
+        return false;
+    }
+
+    void UnpackArrayIterator::reset()
+    {
+        _outputChunkNo = 0;
+        chunkInitialized = false;
+    }
+
+    void UnpackArrayIterator::appendInputChunk(size_t inputChunkNo,
+                                               RLEPayload::append_iterator* appender,
+                                               vector<ConstRLEEmptyBitmap::Segment>& segments)
+    {
+        UnpackArray::InputChunk const& input = _array._inputChunks[inputChunkNo];
+        Coordinate const chunkStart = _array._outputChunks[_outputChunkNo].position[0];
+        Coordinate const chunkEnd = chunkStart + _array.getArrayDesc().getDimensions()[0].getChunkInterval();
+
+        // The ranks of the cells of the input chunk that go to this output chunk
+        position_t const from = max(chunkStart - input.outputPos, Coordinate(0));
+        position_t const till = min(chunkEnd, input.outputPos + Coordinate(input.count)) - input.outputPos;
+
+        if (!inputIterator->setPosition(input.position)) {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+        }
+        RLEChunkData data(inputIterator->getChunk());
+        std::shared_ptr<RLEEmptyBitmap> cut;
+        ConstRLEEmptyBitmap const& cells = UnpackArray::getCells(data, cut);
+        if (cells.count() != input.count) {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "count";
+        }
+
+        // A dimension attribute repeats the coordinate of a dimension for as
+        // long as the cells stay in the same row of the dimensions after it
+        bool const isDimension = attr < _array._nInputDims;
+        position_t stride = 1;
+        Coordinates const& first = data.getChunk().getFirstPosition(true);
+        Coordinates const& last = data.getChunk().getLastPosition(true);
+        for (size_t i = attr + 1; isDimension && i < first.size(); ++i) {
+            stride *= last[i] - first[i] + 1;
+        }
+        CoordinatesMapper mapper(data.getChunk());
+        Coordinates coords;
+
+        ConstRLEPayload::iterator values;
+        if (appender && !isDimension) {
+            values = ConstRLEPayload::iterator(data.getPayload());
+        }
+
+        position_t rank = 0;
+        for (size_t i = 0, n = cells.nSegments(); i < n && rank < till; ++i) {
+            ConstRLEEmptyBitmap::Segment const& segment = cells.getSegment(i);
+            if (rank + segment._length <= from) {
+                rank += segment._length;
+                continue;
+            }
+            position_t const skip = max(from - rank, position_t(0));
+            position_t const length = min(rank + segment._length, till) - rank - skip;
+            position_t const outputPos = input.outputPos + rank + skip - chunkStart;
+
+            if (!segments.empty() && segments.back()._lPosition + segments.back()._length == outputPos) {
+                segments.back()._length += length;
+            } else {
+                ConstRLEEmptyBitmap::Segment next;
+                next._lPosition = outputPos;
+                next._length = length;
+                next._pPosition = segments.empty() ? 0 : segments.back()._pPosition + segments.back()._length;
+                segments.push_back(next);
+            }
+
+            if (appender && isDimension) {
+                for (position_t pos = segment._lPosition + skip, end = pos + length; pos < end; ) {
+                    mapper.pos2coord(pos, coords);
+                    position_t const run = min(stride - pos % stride, end - pos);
+                    _coordinate.setInt64(coords[attr]);
+                    appender->add(_coordinate, run);
+                    pos += run;
+                }
+            } else if (appender) {
+                if (!values.setPosition(segment._pPosition + skip)) {
+                    throw SYSTEM_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_OPERATION_FAILED) << "setPosition";
+                }
+                uint64_t remaining = length;
+                while (remaining != 0) {
+                    remaining -= appender->add(values, remaining);
+                }
+            }
+            rank += segment._length;
+        }
+    }
+
+    ConstChunk const& UnpackArrayIterator::getChunk()
+    {
+        if (end()) {
+            throw USER_EXCEPTION(SCIDB_SE_EXECUTION, SCIDB_LE_NO_CURRENT_ELEMENT);
+        }
+        if (chunkInitialized) {
+            return _outputChunk;
+        }
+
+        UnpackArray::OutputChunk const& output = _array._outputChunks[_outputChunkNo];
+        AttributeDesc const& attrDesc = _array.getArrayDesc().getAttributes()[attr];
+        bool const isBitmap = attrDesc.isEmptyIndicator();
+
+        RLEPayload payload(TypeLibrary::getType(attrDesc.getType()));
+        std::unique_ptr<RLEPayload::append_iterator> appender;
+        if (!isBitmap) {
+            appender.reset(new RLEPayload::append_iterator(&payload));
+        }
+        vector<ConstRLEEmptyBitmap::Segment> segments;
+        for (size_t i = output.firstInput; i < output.endInput; ++i) {
+            appendInputChunk(i, appender.get(), segments);
+        }
+
+        std::shared_ptr<RLEEmptyBitmap> bitmap = std::make_shared<RLEEmptyBitmap>();
+        bitmap->reserve(segments.size());
+        for (size_t i = 0; i < segments.size(); ++i) {
+            bitmap->addSegment(segments[i]);
+        }
+
+        Address addr(attr, output.position);
+        _outputChunk.initialize(&_array, &_array.getArrayDesc(), addr, attrDesc.getDefaultCompressionMethod());
+        if (isBitmap) {
+            _outputChunk.allocate(bitmap->packedSize());
+            bitmap->pack(static_cast<char*>(_outputChunk.getData()));
+        } else {
+            appender->flush();
+            _outputChunk.allocate(payload.packedSize() + bitmap->packedSize());
+            payload.pack(static_cast<char*>(_outputChunk.getData()));
+            bitmap->pack(static_cast<char*>(_outputChunk.getData()) + payload.packedSize());
+            _outputChunk.setEmptyBitmap(bitmap);
+        }
+        _outputChunk.setCount(bitmap->count());
+        chunkInitialized = true;
+        return _outputChunk;
+    }
+
+    //
+    // Unpack array
+    //
+    UnpackArray::UnpackArray(ArrayDesc const& desc,
+                             std::shared_ptr<Array> const& input,
+                             vector<InputChunk> const& inputChunks,
+                             AttributeID cellsAttrID)
+    : DelegateArray(desc, input),
+      _nInputDims(input->getArrayDesc().getDimensions().size()),
+      _cellsAttrID(cellsAttrID)
+    {
+        Coordinate const chunkInterval = desc.getDimensions()[0].getChunkInterval();
+        _inputChunks.reserve(inputChunks.size());
+        for (size_t i = 0; i < inputChunks.size(); ++i) {
+            InputChunk const& input = inputChunks[i];
+            if (input.count == 0) {
+                continue;
+            }
+            assert(_inputChunks.empty() ||
+                   _inputChunks.back().outputPos + Coordinate(_inputChunks.back().count) <= input.outputPos);
+            size_t const inputChunkNo = _inputChunks.size();
+            _inputChunks.push_back(input);
+
+            // The output chunks that the cells of the input chunk go to
+            Coordinate const firstChunk = input.outputPos / chunkInterval * chunkInterval;
+            Coordinate const lastChunk = (input.outputPos + Coordinate(input.count) - 1) / chunkInterval * chunkInterval;
+            for (Coordinate chunkPos = firstChunk; chunkPos <= lastChunk; chunkPos += chunkInterval) {
+                if (!_outputChunks.empty() && _outputChunks.back().position[0] == chunkPos) {
+                    _outputChunks.back().endInput = inputChunkNo + 1;
+                } else {
+                    OutputChunk output;
+                    output.position = Coordinates(1, chunkPos);
+                    output.firstInput = inputChunkNo;
+                    output.endInput = inputChunkNo + 1;
+                    _outputChunks.push_back(output);
+                }
+            }
+        }
+    }
+
+    DelegateArrayIterator* UnpackArray::createArrayIterator(AttributeID attrID) const
+    {
+        AttributeDesc const& attr = desc.getAttributes()[attrID];
+        AttributeID inputAttrID = _cellsAttrID;
+        if (attrID >= _nInputDims && !attr.isEmptyIndicator()) {
+            inputAttrID = safe_static_cast<AttributeID>(attrID - _nInputDims);
+        }
+        return new UnpackArrayIterator(*this, attrID, inputAttrID);
+    }
+
+    ConstRLEEmptyBitmap const& UnpackArray::getCells(RLEChunkData const& data, std::shared_ptr<RLEEmptyBitmap>& cut)
+    {
+        ConstChunk const& chunk = data.getChunk();
+        if (!chunk.getArrayDesc().hasOverlap()) {
+            return data.getBitmap();
+        }
+        cut = data.getBitmap().cut(chunk.getFirstPosition(true), chunk.getLastPosition(true),
+                                   chunk.getFirstPosition(false), chunk.getLastPosition(false));
+        return *cut;
+    }
+
+    size_t UnpackArray::countCells(ConstChunk const& chunk)
+    {
+        if (!chunk.getArrayDesc().hasOverlap() && chunk.isCountKnown()) {
+            return chunk.count();
+        }
+        RLEChunkData data(chunk);
+        std::shared_ptr<RLEEmptyBitmap> cut;
+        return getCells(data, cut).count();
+    }
+}
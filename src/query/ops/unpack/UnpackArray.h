@@ -0,0 +1,141 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/**
+ * @file UnpackArray.h
+ *
+ * @brief The array returned by unpack(), which builds its chunks on demand
+ */
+
+#ifndef UNPACK_ARRAY_H_
+#define UNPACK_ARRAY_H_
+
+#include <vector>
+
+#include <array/DelegateArray.h>
+#include <array/MemChunk.h>
+#include <array/Metadata.h>
+
+namespace scidb
+{
+
+class UnpackArray;
+
+/**
+ * Iterates over the output chunks that the local input chunks have cells in.
+ * Each chunk is built from the input chunks when it is first asked for: the
+ * runs of cells are copied a segment at a time, with the values of the input
+ * payloads rather than cell by cell.
+ */
+class UnpackArrayIterator : public DelegateArrayIterator
+{
+public:
+    UnpackArrayIterator(UnpackArray const& array, AttributeID attrID, AttributeID inputAttrID);
+
+    virtual ConstChunk const& getChunk();
+    virtual bool end();
+    virtual void operator ++();
+    virtual Coordinates const& getPosition();
+    virtual bool setPosition(Coordinates const& pos);
+    virtual void reset();
+
+private:
+    /**
+     * Append the cells of the input chunk at 'inputChunkNo' that go to the
+     * output chunk at _outputChunkNo to the payload, for a data or dimension
+     * attribute, and to the segments of the output bitmap.
+     */
+    void appendInputChunk(size_t inputChunkNo,
+                          RLEPayload::append_iterator* appender,
+                          std::vector<ConstRLEEmptyBitmap::Segment>& segments);
+
+    UnpackArray const& _array;
+    size_t _outputChunkNo;
+    MemChunk _outputChunk;
+    Value _coordinate;
+};
+
+/**
+ * The output of unpack() on this instance. The cells of each input chunk
+ * have consecutive positions along the output dimension, from the offset
+ * of the chunk, which is the number of cells in all the chunks before it
+ * in the whole array. The output chunks are only partly filled, as the
+ * chunks before and after an input chunk may be on other instances.
+ */
+class UnpackArray : public DelegateArray
+{
+    friend class UnpackArrayIterator;
+
+public:
+    /// A local input chunk and where its cells go
+    struct InputChunk
+    {
+        Coordinates position;
+        Coordinate  outputPos;   // position of its first cell in the output
+        size_t      count;       // number of cells, overlaps excluded
+    };
+
+    /**
+     * @param inputChunks the local input chunks, in increasing order of
+     *                    outputPos, which is the order of their positions
+     * @param cellsAttrID the attribute of the input whose chunks give the
+     *                    cells: the empty bitmap, if any
+     */
+    UnpackArray(ArrayDesc const& desc,
+                std::shared_ptr<Array> const& input,
+                std::vector<InputChunk> const& inputChunks,
+                AttributeID cellsAttrID);
+
+    virtual DelegateArrayIterator* createArrayIterator(AttributeID attrID) const;
+
+    /**
+     * @return the bitmap of the cells of the chunk, overlaps excluded, with
+     * the physical positions of 'data': its own bitmap, or else the cut of it
+     * made in 'cut'
+     */
+    static ConstRLEEmptyBitmap const& getCells(RLEChunkData const& data,
+                                               std::shared_ptr<RLEEmptyBitmap>& cut);
+
+    /**
+     * @return the number of cells of 'chunk', overlaps excluded, from the
+     * chunk if known or else from its empty bitmap
+     */
+    static size_t countCells(ConstChunk const& chunk);
+
+private:
+    /// An output chunk, and the range of input chunks with cells in it
+    struct OutputChunk
+    {
+        Coordinates position;
+        size_t      firstInput;
+        size_t      endInput;
+    };
+
+    std::vector<InputChunk> _inputChunks;
+    std::vector<OutputChunk> _outputChunks;
+    size_t _nInputDims;
+    AttributeID _cellsAttrID;
+};
+
+} //namespace
+
+#endif /* UNPACK_ARRAY_H_ */
@@ -42,6 +42,7 @@
 #include <log4cxx/logger.h>
 
 #include <fstream>
+#include <limits>
 #include <memory>
 
 using namespace std;
@@ -90,6 +91,11 @@ PhysPlanPtr HabilisOptimizer::optimize(const std::shared_ptr<Query>& query,
 
     bool tileMode = Config::getInstance()->getOption<int>(CONFIG_TILE_SIZE) > 1;
     _root = tw_createPhysicalTree(logicalRoot, tileMode);
+    if (tileMode) {
+        // A node is in tile mode only if its whole subtree is
+        LOG4CXX_DEBUG(logger, "The plan is " << (_root->supportsTileMode() ? "" : "not ")
+                      << "in tile mode end to end");
+    }
 
     if (!logicalPlan->getRoot()->isDdl())
     {
@@ -588,6 +594,23 @@ static PhysNodePtr s_findThinPoint(PhysNodePtr root)
     return candidate;
 }
 
+/**
+ * Estimate the amount of data sent over the network to bring the output of
+ * a chain into a new distribution.
+ * @param candidate the node at which the data would be redistributed
+ * @param distro the current distribution of the chain
+ * @return the estimated number of bytes to move; a replicated input is
+ *         reduced locally and costs nothing to move
+ */
+static double s_getRedistributionCost(PhysNodePtr const& candidate,
+                                      RedistributeContext const& distro)
+{
+    if (distro.getPartitioningSchema() == psReplication) {
+        return 0;
+    }
+    return candidate->getDataWidth();
+}
+
 static RedistributeContext s_propagateDistribution(PhysNodePtr node,
                                                  PhysNodePtr end)
 {
@@ -835,17 +858,22 @@ void HabilisOptimizer::tw_insertSgNodes(PhysNodePtr root)
                     PhysNodePtr leftCandidate = s_findThinPoint(root->getChildren()[0]);
                     PhysNodePtr rightCandidate = s_findThinPoint(root->getChildren()[1]);
 
-                    double leftDataWidth = leftCandidate->getDataWidth();
-                    double rightDataWidth = rightCandidate->getDataWidth();
-
-                    LOG4CXX_TRACE(logger,
-                                  "[tw_insertSgNodes] candidate requests two collocated inputs, leftWidth="
-                                  << leftDataWidth);
-                    LOG4CXX_TRACE(logger,
-                                  "[tw_insertSgNodes] candidate requests two collocated inputs, rigthWidth="
-                                  << rightDataWidth);
-
-                    if (leftDataWidth < rightDataWidth && canMoveLeftToRight)
+                    // Pick the cheapest of: moving left onto right, moving right onto left,
+                    // or moving both onto the default distribution.
+                    double const leftCost = s_getRedistributionCost(leftCandidate, lhs);
+                    double const rightCost = s_getRedistributionCost(rightCandidate, rhs);
+                    double const infinity = std::numeric_limits<double>::infinity();
+                    double const moveLeftCost = canMoveLeftToRight ? leftCost : infinity;
+                    double const moveRightCost = canMoveRightToLeft ? rightCost : infinity;
+                    double const moveBothCost = leftCost + rightCost;
+
+                    LOG4CXX_DEBUG(logger,
+                                  "[tw_insertSgNodes] candidate requests two collocated inputs, costs:"
+                                  << " moveLeft=" << moveLeftCost
+                                  << " moveRight=" << moveRightCost
+                                  << " moveBoth=" << moveBothCost);
+
+                    if (moveLeftCost < moveRightCost && moveLeftCost <= moveBothCost)
                     {   //move left to right
                         if(lhs.getPartitioningSchema() == psReplication)
                         {   //left is replicated - reduce it
@@ -865,7 +893,7 @@ void HabilisOptimizer::tw_insertSgNodes(PhysNodePtr root)
                             s_propagateDistribution(sgNode, root);
                         }
                     }
-                    else if (canMoveRightToLeft)
+                    else if (moveRightCost <= moveBothCost)
                     {   //move right to left
                         if(rhs.getPartitioningSchema() == psReplication)
                         {   //right is replicated - reduce it
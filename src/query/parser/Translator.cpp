@@ -1607,12 +1607,14 @@ bool Translator::resolveParamDimensionReference(const vector<ArrayDesc> &inputSc
 
 std::shared_ptr<OperatorParamAggregateCall> Translator::passAggregateCall(const Node* ast, const vector<ArrayDesc> &inputSchemas)
 {
-    if (ast->get(applicationArgOperands)->getSize() != 1)
+    cnodes const operands = ast->getList(applicationArgOperands);
+
+    if (operands.size() < 1)
     {
         fail(SYNTAX(SCIDB_LE_WRONG_AGGREGATE_ARGUMENTS_COUNT,ast));
     }
 
-    const Node* const arg = ast->get(applicationArgOperands)->get(listArg0);
+    const Node* const arg = operands[listArg0];
 
     std::shared_ptr<OperatorParam> opParam;
 
@@ -1637,11 +1639,25 @@ std::shared_ptr<OperatorParamAggregateCall> Translator::passAggregateCall(const
         fail(SYNTAX(SCIDB_LE_WRONG_AGGREGATE_ARGUMENT, ast));
     }
 
+    // Any further arguments are constants that parameterize the aggregate,
+    // as in approxquantile(x, 0.9); the aggregate itself checks them
+    vector<double> parameters;
+    for (size_t i = 1; i < operands.size(); ++i)
+    {
+        Value const v = passConstantExpression(operands[i], TID_DOUBLE);
+        if (v.isNull())
+        {
+            fail(SYNTAX(SCIDB_LE_CONSTANT_EXPRESSION_EXPECTED, operands[i]));
+        }
+        parameters.push_back(v.getDouble());
+    }
+
     return make_shared<OperatorParamAggregateCall> (
             newParsingContext(ast),
             getStringApplicationArgName(ast),
             opParam,
-            getString(ast,applicationArgAlias));
+            getString(ast,applicationArgAlias),
+            parameters);
 }
 
 bool Translator::placeholdersVectorContainType(const vector<std::shared_ptr<OperatorParamPlaceholder> > &placeholders,
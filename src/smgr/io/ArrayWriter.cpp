@@ -44,6 +44,7 @@
 #include <limits.h>
 #include <float.h>
 #include <string>
+#include <deque>
 #include <errno.h>
 
 #include <boost/archive/text_oarchive.hpp>
@@ -52,6 +53,8 @@
 #include <log4cxx/basicconfigurator.h>
 #include <log4cxx/helpers/exception.h>
 
+#include <system/Config.h>
+#include <system/Constants.h>
 #include <system/Exceptions.h>
 #include <query/TypeSystem.h>
 #include <query/FunctionDescription.h>
@@ -344,7 +347,7 @@ namespace scidb
 
     const char XsvParms::DEFAULT_CSV_QUOTE;
 
-    static void s_fprintValue(FILE *f,
+    static void s_appendValue(string& out,
                               const Value* v,
                               TypeId const& valueType,
                               FunctionPointer const converter,
@@ -361,7 +364,41 @@ namespace scidb
             tidp = &STRING_TYPE_ID;
         }
 
-        Fprintf(f, "%s", v->toString(*tidp, vf).c_str());
+        vf.format(*tidp, *v, out);
+    }
+
+    static void s_fprintValue(FILE *f,
+                              const Value* v,
+                              TypeId const& valueType,
+                              FunctionPointer const converter,
+                              Value::Formatter const& vf)
+    {
+        string s;
+        s_appendValue(s, v, valueType, converter, vf);
+        Fputs(s.c_str(), f);
+    }
+
+    static void s_appendCoordinate(string& out, Coordinate coord)
+    {
+        char buf[24];
+        char* const end = buf + sizeof(buf);
+        char* p = end;
+        uint64_t u = coord < 0 ? 0 - static_cast<uint64_t>(coord) : static_cast<uint64_t>(coord);
+        do {
+            *--p = static_cast<char>('0' + u % 10);
+            u /= 10;
+        } while (u != 0);
+        if (coord < 0) {
+            *--p = '-';
+        }
+        out.append(p, end - p);
+    }
+
+    static void s_fwrite(FILE *f, string const& s)
+    {
+        if (!s.empty() && ::fwrite(s.data(), 1, s.size(), f) != s.size()) {
+            throw AwIoError(errno ? errno : EIO);
+        }
     }
 
     static void s_fprintCoordinate(FILE *f,
@@ -420,12 +457,219 @@ namespace scidb
         Fputc('\n', f);
     }
 
+    /**
+     * The cells of a run of chunks, as copied out of the chunk iterators, and
+     * their text once formatted.  Formatting is by far the costliest part of
+     * writing a cell, so that the batches are formatted in parallel, and their
+     * text is written out in the order of the batches.
+     */
+    struct XsvBatch
+    {
+        /// Most cells in a batch, which bounds the memory of the pending batches
+        static const size_t MAX_CELLS = 64 * KiB;
+
+        XsvBatch() : nCells(0) {}
+
+        void clear()
+        {
+            coords.clear();
+            values.clear();
+            text.clear();
+            nCells = 0;
+        }
+
+        vector<Coordinate> coords;    // nDims per cell, if wanted
+        vector<Value>      values;    // one per attribute per cell
+        size_t             nCells;
+        string             text;
+    };
+
+    /**
+     * What the formatting of every batch of an array needs; shared with the
+     * jobs, which may outlive the writer when it fails.
+     */
+    struct XsvContext
+    {
+        XsvContext(XsvParms const& parms) : parms(parms), nDims(0) {}
+
+        XsvParms                parms;
+        vector<FunctionPointer> converters;
+        vector<TypeId>          types;
+        size_t                  nDims;
+    };
+
+    static void formatXsvBatch(XsvBatch& batch, XsvContext const& ctx)
+    {
+        XsvParms const& parms = ctx.parms;
+        size_t const numAttrs = ctx.types.size();
+        batch.text.reserve(batch.values.size() * 12);
+        for (size_t c = 0; c < batch.nCells; ++c) {
+
+            // Coordinates, anyone?
+            if (parms.wantCoords()) {
+                if (parms.pretty())
+                    batch.text += '{';
+                for (size_t i = 0; i < ctx.nDims; ++i) {
+                    if (i) {
+                        batch.text += parms.delim();
+                    }
+                    s_appendCoordinate(batch.text, batch.coords[c * ctx.nDims + i]);
+                }
+                if (parms.pretty()) {
+                    batch.text += "} ";
+                } else {
+                    batch.text += parms.delim();
+                }
+            }
+
+            // Then come the attributes.
+            for (size_t i = 0; i < numAttrs; ++i) {
+                if (i) {
+                    batch.text += parms.delim();
+                }
+                s_appendValue(batch.text,
+                              &batch.values[c * numAttrs + i],
+                              ctx.types[i],
+                              ctx.converters[i],
+                              parms.getFormatter());
+            }
+            batch.text += '\n';
+        }
+    }
+
+#ifndef SCIDB_CLIENT
+    class XsvFormatJob : public Job
+    {
+    public:
+        XsvFormatJob(std::shared_ptr<Query> const& query,
+                     std::shared_ptr<XsvBatch> const& batch,
+                     std::shared_ptr<XsvContext const> const& ctx)
+            : Job(query),
+              _batch(batch),
+              _ctx(ctx)
+        {}
+
+        std::shared_ptr<XsvBatch> const& getBatch() const { return _batch; }
+
+    protected:
+        virtual void run()
+        {
+            formatXsvBatch(*_batch, *_ctx);
+        }
+
+    private:
+        std::shared_ptr<XsvBatch>         _batch;
+        std::shared_ptr<XsvContext const> _ctx;
+    };
+#endif
+
+    /**
+     * Formats the batches of a writer and writes them out in order: on the
+     * global job queue with a window of pending batches when there is a query
+     * to run the jobs for, otherwise in place.
+     */
+    class XsvBatchWriter
+    {
+    public:
+        XsvBatchWriter(FILE* f,
+                       std::shared_ptr<XsvContext const> const& ctx,
+                       std::shared_ptr<Query> const& query)
+            : _f(f),
+              _ctx(ctx),
+              _query(query),
+              _maxPending(0)
+        {
+#ifndef SCIDB_CLIENT
+            if (query) {
+                int const nJobs = Config::getInstance()->getOption<int>(CONFIG_RESULT_PREFETCH_QUEUE_SIZE);
+                _maxPending = nJobs > 1 ? 2 * nJobs : 0;
+            }
+#endif
+        }
+
+        ~XsvBatchWriter()
+        {
+#ifndef SCIDB_CLIENT
+            // The jobs of a failed writer must not outlive the file
+            for (size_t i = 0; i < _pending.size(); ++i) {
+                _pending[i]->wait();
+            }
+#endif
+        }
+
+        /// @return an empty batch to fill
+        std::shared_ptr<XsvBatch> getBatch()
+        {
+            std::shared_ptr<XsvBatch> batch;
+            if (_spare.empty()) {
+                batch = std::make_shared<XsvBatch>();
+            } else {
+                batch = _spare.back();
+                _spare.pop_back();
+                batch->clear();
+            }
+            return batch;
+        }
+
+        /// Format and write 'batch' after the ones before it
+        void push(std::shared_ptr<XsvBatch> const& batch)
+        {
+#ifndef SCIDB_CLIENT
+            if (_maxPending) {
+                std::shared_ptr<XsvFormatJob> job = std::make_shared<XsvFormatJob>(_query, batch, _ctx);
+                PhysicalOperator::getGlobalQueueForOperators()->pushJob(job);
+                _pending.push_back(job);
+                if (_pending.size() >= _maxPending) {
+                    writeOldest();
+                }
+                return;
+            }
+#endif
+            formatXsvBatch(*batch, *_ctx);
+            s_fwrite(_f, batch->text);
+            _spare.push_back(batch);
+        }
+
+        /// Write out all the pending batches
+        void flush()
+        {
+#ifndef SCIDB_CLIENT
+            while (!_pending.empty()) {
+                writeOldest();
+            }
+#endif
+        }
+
+    private:
+#ifndef SCIDB_CLIENT
+        void writeOldest()
+        {
+            std::shared_ptr<XsvFormatJob> job = _pending.front();
+            _pending.pop_front();
+            if (!job->wait()) {
+                job->rethrow();
+            }
+            s_fwrite(_f, job->getBatch()->text);
+            _spare.push_back(job->getBatch());
+        }
+
+        std::deque<std::shared_ptr<XsvFormatJob> >  _pending;
+#endif
+        FILE*                                       _f;
+        std::shared_ptr<XsvContext const>           _ctx;
+        std::shared_ptr<Query>                      _query;
+        size_t                                      _maxPending;
+        vector<std::shared_ptr<XsvBatch> >          _spare;
+    };
+
     /**
      * @brief Single code path for "foo-separated values" formats.
      *
      * @description The handling of some text formats is remarkably
      * similar, and can be parameterized via an @c XsvParms object.
      * Currently supported formats are csv, csv+, tsv, tsv+, and dcsv.
+     * The cells are copied out of the chunks in batches, which are
+     * formatted in parallel and written in order, see XsvBatchWriter.
      */
     static uint64_t saveXsvFormat(Array const& array,
                                   ArrayDesc const& desc,
@@ -443,17 +687,19 @@ namespace scidb
         }
 
         // Gather various per-attribute items.
+        std::shared_ptr<XsvContext> ctx = std::make_shared<XsvContext>(parms);
         vector<std::shared_ptr<ConstArrayIterator> > arrayIterators(numAttrs);
-        vector<FunctionPointer>                 converters(numAttrs);
-        vector<TypeId>                          types(numAttrs);
+        ctx->converters.resize(numAttrs);
+        ctx->types.resize(numAttrs);
+        ctx->nDims = desc.getDimensions().size();
         for (unsigned i = 0, j = 0; i < attrs.size(); ++i) {
             if (emptyAttr && emptyAttr == &attrs[i])
                 continue; // j not incremented!
             arrayIterators[j] = array.getConstIterator(i);
-            types[j] = attrs[i].getType();
-            if (!isBuiltinType(types[j])) {
-                converters[j] = FunctionLibrary::getInstance()->findConverter(
-                    types[j],
+            ctx->types[j] = attrs[i].getType();
+            if (!isBuiltinType(ctx->types[j])) {
+                ctx->converters[j] = FunctionLibrary::getInstance()->findConverter(
+                    ctx->types[j],
                     TID_STRING,
                     false);
             }
@@ -475,6 +721,8 @@ namespace scidb
 
         // Time to walk the chunks!
         uint64_t count = 0;
+        XsvBatchWriter writer(f, ctx, query);
+        std::shared_ptr<XsvBatch> batch = writer.getBatch();
         vector<std::shared_ptr<ConstChunkIterator> > chunkIterators(numAttrs);
         const int CHUNK_MODE =
             ConstChunkIterator::IGNORE_OVERLAPS |
@@ -492,44 +740,24 @@ namespace scidb
                 }
             }
 
-            // Print these chunks...
+            // Copy out the cells of these chunks, bumping their
+            // chunk iterators as we go.
             while (!chunkIterators[0]->end()) {
-
-                // Coordinates, anyone?
                 if (parms.wantCoords()) {
                     Coordinates const& pos = chunkIterators[0]->getPosition();
-                    if (parms.pretty())
-                        Fputc('{', f);
-                    for (unsigned i = 0; i < pos.size(); ++i) {
-                        if (i) {
-                            Fputc(parms.delim(), f);
-                        }
-                        Fprintf(f, "%" PRIi64, pos[i]);
-                    }
-                    if (parms.pretty()) {
-                        Fputs("} ", f);
-                    } else {
-                        Fputc(parms.delim(), f);
-                    }
+                    batch->coords.insert(batch->coords.end(), pos.begin(), pos.end());
                 }
-
-                // Then come the attributes.  Bump their corresponding
-                // chunk iterators as we go.
                 for (size_t i = 0; i < numAttrs; ++i) {
-                    if (i) {
-                        Fputc(parms.delim(), f);
-                    }
-                    s_fprintValue(f,
-                                  &chunkIterators[i]->getItem(),
-                                  types[i],
-                                  converters[i],
-                                  parms.getFormatter());
+                    batch->values.push_back(chunkIterators[i]->getItem());
                     ++(*chunkIterators[i]);
                 }
 
                 // Another array cell for peace!
                 count += 1;
-                Fputc('\n', f);
+                if (++batch->nCells == XsvBatch::MAX_CELLS) {
+                    writer.push(batch);
+                    batch = writer.getBatch();
+                }
             }
 
             // Bump the array iterators to get the next set of chunks.
@@ -537,6 +765,10 @@ namespace scidb
                 ++(*arrayIterators[i]);
             }
         }
+        if (batch->nCells) {
+            writer.push(batch);
+        }
+        writer.flush();
 
         checkStreamError(f, __FUNCTION__);
         return count;
@@ -1290,6 +1522,8 @@ namespace scidb
         ArrayDesc const& desc = array.getArrayDesc();
         uint64_t n = 0;
 
+        // Declared before the FILE that uses it, and released after it is closed
+        vector<char> textBuffer;
         FILE* f;
         bool isBinary = compareStringsIgnoreCase(format, "opaque") == 0 || format[0] == '(';
         if (file == "console" || file == "stdout") {
@@ -1324,6 +1558,14 @@ namespace scidb
                         << file << ::strerror(errno) << errno;
                 }
             }
+
+            // Text is written in small pieces, so a larger stdio buffer
+            // saves most of the write calls.  setvbuf() only uses the size
+            // of a buffer that it is given.
+            if (!isBinary) {
+                textBuffer.resize(MiB);
+                ::setvbuf(f, &textBuffer[0], _IOFBF, textBuffer.size());
+            }
         }
 
         // Switch out to "foo-separated values" if we can.
@@ -1377,6 +1619,15 @@ namespace scidb
             throw USER_EXCEPTION(SCIDB_SE_ARRAY_WRITER, SCIDB_LE_FILE_WRITE_ERROR)
                 << ::strerror(e.error) << e.error;
         }
+        catch (...) {
+            // The file must not outlive textBuffer
+            if (f == stdout || f == stderr) {
+                ::fflush(f);
+            } else {
+                ::fclose(f);
+            }
+            throw;
+        }
 
         int rc(0);
         if (f == stdout || f == stderr) {
@@ -0,0 +1,201 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * DeltaChunk.h
+ *
+ *      Description: On-disk format of a chunk version stored as a delta
+ *      against the full copy of the same chunk in an older version
+ */
+
+#ifndef DELTA_CHUNK_H_
+#define DELTA_CHUNK_H_
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#include <array/Metadata.h>
+#include <system/Exceptions.h>
+
+namespace scidb
+{
+    /**
+     * Header of a delta chunk as it is written to the data store.
+     *
+     * A delta chunk is a chunk whose ChunkHeader has the DELTA_CHUNK flag
+     * set.  Its body is not compressed: it is this header, followed by a
+     * bitmap with one bit for each block of the uncompressed chunk data
+     * (in 64-bit words), followed by the contents of the blocks whose bit is
+     * set, in order.  The other blocks are the same as in the base chunk,
+     * which is the full (non-delta) chunk at the same address in version
+     * baseArrId.
+     */
+    struct DeltaChunkHeader
+    {
+        uint32_t magic;
+        uint32_t blockSize;  // bytes per block; the last one may be shorter
+        ArrayID  baseArrId;  // versioned array id of the base chunk
+        uint64_t baseSize;   // uncompressed size of the base chunk
+        uint64_t size;       // uncompressed size of this chunk
+        uint64_t nBlocks;    // number of blocks of this chunk
+    };
+
+    /**
+     * Encoding and decoding of delta chunks.  The unit of change is a block
+     * of bytes of the uncompressed chunk data rather than a cell, so that the
+     * same code serves every attribute type and the empty bitmap alike.
+     */
+    class DeltaChunk
+    {
+      public:
+        static const uint32_t MAGIC = 0xDE17AC40;
+
+        /**
+         * Block size used by new deltas; small enough that a single cell
+         * update changes few bytes, large enough to keep the bitmap small
+         */
+        static const uint32_t BLOCK_SIZE = 32;
+
+        /**
+         * Encode 'data' as a delta against 'base'.
+         * @param base uncompressed data of the base chunk
+         * @param baseSize size of base
+         * @param data uncompressed data of the new chunk
+         * @param size size of data
+         * @param baseArrId versioned array id of the base chunk
+         * @param limit the delta is only of use if it is smaller than this
+         * @param[out] delta the encoded delta, if true is returned
+         * @return false if the delta would take limit bytes or more
+         */
+        static bool encode(void const* base, size_t baseSize,
+                           void const* data, size_t size,
+                           ArrayID baseArrId, size_t limit,
+                           std::vector<char>& delta)
+        {
+            uint64_t const nBlocks = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+            size_t const nWords = (nBlocks + 63) / 64;
+            size_t const prefix = sizeof(DeltaChunkHeader) + nWords * sizeof(uint64_t);
+            if (prefix >= limit) {
+                return false;
+            }
+            char const* const src = static_cast<char const*>(data);
+            char const* const old = static_cast<char const*>(base);
+
+            delta.assign(prefix, 0);
+            for (uint64_t i = 0; i < nBlocks; ++i) {
+                size_t const offs = i * BLOCK_SIZE;
+                size_t const len = std::min<size_t>(BLOCK_SIZE, size - offs);
+                if (offs + len <= baseSize && memcmp(src + offs, old + offs, len) == 0) {
+                    continue;
+                }
+                if (delta.size() + len >= limit) {
+                    delta.clear();
+                    return false;
+                }
+                uint64_t* bitmap = reinterpret_cast<uint64_t*>(&delta[sizeof(DeltaChunkHeader)]);
+                bitmap[i / 64] |= uint64_t(1) << (i % 64);
+                delta.insert(delta.end(), src + offs, src + offs + len);
+            }
+
+            DeltaChunkHeader& hdr = *reinterpret_cast<DeltaChunkHeader*>(&delta[0]);
+            hdr.magic = MAGIC;
+            hdr.blockSize = BLOCK_SIZE;
+            hdr.baseArrId = baseArrId;
+            hdr.baseSize = baseSize;
+            hdr.size = size;
+            hdr.nBlocks = nBlocks;
+            return true;
+        }
+
+        /**
+         * @return the header of an encoded delta of deltaSize bytes
+         * @throws SystemException if it is not a valid delta header
+         */
+        static DeltaChunkHeader getHeader(void const* delta, size_t deltaSize)
+        {
+            DeltaChunkHeader hdr;
+            if (deltaSize < sizeof(hdr)) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+            }
+            memcpy(&hdr, delta, sizeof(hdr));
+            if (hdr.magic != MAGIC || hdr.blockSize == 0 ||
+                hdr.nBlocks != (hdr.size + hdr.blockSize - 1) / hdr.blockSize) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+            }
+            return hdr;
+        }
+
+        /**
+         * Reconstruct the chunk data from its delta and its base.
+         * @param base uncompressed data of the base chunk
+         * @param baseSize size of base, which must match the delta
+         * @param delta the encoded delta
+         * @param deltaSize size of delta
+         * @param[out] data buffer for the uncompressed chunk data
+         * @param size size of data, which must match the delta
+         * @throws SystemException if the delta is malformed or does not fit
+         */
+        static void apply(void const* base, size_t baseSize,
+                          void const* delta, size_t deltaSize,
+                          void* data, size_t size)
+        {
+            DeltaChunkHeader const hdr = getHeader(delta, deltaSize);
+            size_t const nWords = (hdr.nBlocks + 63) / 64;
+            size_t offs = sizeof(hdr) + nWords * sizeof(uint64_t);
+            if (hdr.size != size || hdr.baseSize != baseSize || offs > deltaSize) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+            }
+            char const* const bitmap = static_cast<char const*>(delta) + sizeof(hdr);
+            char const* const changes = static_cast<char const*>(delta);
+            char const* const old = static_cast<char const*>(base);
+            char* const dst = static_cast<char*>(data);
+
+            for (uint64_t w = 0; w < nWords; ++w) {
+                uint64_t word;
+                memcpy(&word, bitmap + w * sizeof(word), sizeof(word));
+                uint64_t const end = std::min<uint64_t>(hdr.nBlocks, (w + 1) * 64);
+                for (uint64_t i = w * 64; i < end; ++i) {
+                    size_t const pos = i * hdr.blockSize;
+                    size_t const len = std::min<size_t>(hdr.blockSize, size - pos);
+                    if (word & (uint64_t(1) << (i % 64))) {
+                        if (offs + len > deltaSize) {
+                            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+                        }
+                        memcpy(dst + pos, changes + offs, len);
+                        offs += len;
+                    } else {
+                        if (pos + len > baseSize) {
+                            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+                        }
+                        memcpy(dst + pos, old + pos, len);
+                    }
+                }
+            }
+            if (offs != deltaSize) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+            }
+        }
+    };
+}
+
+#endif
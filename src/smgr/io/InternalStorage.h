@@ -450,6 +450,12 @@ namespace scidb
 
         ChunkMap _chunkMap;  // The root of the chunk map
 
+        /// getArrayStats() results by array and version, guarded by _mutex.
+        /// The entry of an array is dropped whenever one of its chunks is
+        /// created, written, rewritten or freed.
+        typedef std::map<ArrayID, ArrayStats> VersionStats;
+        mutable std::unordered_map<ArrayUAID, VersionStats> _arrayStats;
+
         size_t _cacheSize;    // maximal size of memory used by cached chunks
         size_t _cacheUsed;    // current size of memory used by cached chunks
                               // (it can be larger than cacheSize if all chunks are pinned)
@@ -464,6 +470,7 @@ namespace scidb
         Event _cacheOverflowEvent;
 
         int32_t _writeLogThreshold;
+        int32_t _compactionThreshold; // % of free space in a data store that triggers compaction
 
         std::string _databasePath;   // path to db directory
         std::string _databaseHeader; // path of chunk header file
@@ -497,6 +504,48 @@ namespace scidb
          */
         void initChunkMap();
 
+        /**
+         * A piece of the chunk map rebuild run on the recovery thread pool
+         */
+        class ChunkMapRecoveryJob : public Job
+        {
+          public:
+            ChunkMapRecoveryJob(boost::function<void()> const& work)
+                : Job(std::shared_ptr<Query>()),
+                  _work(work)
+            {}
+
+          protected:
+            virtual void run() { _work(); }
+
+          private:
+            boost::function<void()> _work;
+        };
+
+        /**
+         * Rebuild the chunk map entries of an array from some descriptors of
+         * a block of the storage header, applied in header order
+         * @param adesc the unversioned array
+         * @param oldestVersion array id of the oldest version of the array
+         * @param innerMap the chunk map of the array
+         * @param block descriptors read from the storage header
+         * @param slots positions in block of the descriptors of this array
+         * @param extents extents of the array's chunks, for the integrity check
+         */
+        void recoverArrayChunks(ArrayDesc const& adesc,
+                                ArrayID oldestVersion,
+                                InnerChunkMap& innerMap,
+                                std::vector<ChunkDescriptor>& block,
+                                std::vector<size_t> const& slots,
+                                Extents& extents);
+
+        /**
+         * Free the given descriptors of a block of the storage header, which
+         * belong to an array that has been removed
+         */
+        void wipeChunkDescriptors(std::vector<ChunkDescriptor>& block,
+                                  std::vector<size_t> const& slots);
+
         /**
          * Record an extent in the extent map
          */
@@ -529,10 +578,25 @@ namespace scidb
         void markChunkAsFree(InnerChunkMapEntry& entry, std::shared_ptr<DataStore>& ds);
 
         /**
-         * Wait for the replica items (i.e. chunks) to be sent to NetworkManager
-         * @param replicas a list of replica items to wait on
+         * Relocate the chunks of an array towards the start of its data store
+         * so that the space they leave at the end of the file can be returned
+         * to the file system.  Does nothing unless the fraction of free space
+         * in the data store is at least _compactionThreshold percent.
+         * @pre caller holds _mutex and an exclusive lock on the array
+         * @param uaId unversioned id of the array to compact
+         */
+        void compactDataStore(ArrayUAID uaId);
+
+        /**
+         * Leave the replica items (i.e. chunks) to be sent in the background:
+         * wait only while the replication window of a target is full, and let
+         * the query wait for the rest when it synchronizes its replicas
+         * @param replicas a list of replica items already passed to the ReplicationManager
+         * @param query the query writing the chunks
+         * @see ReplicationContext::replicationSync
          */
-        void waitForReplicas(std::vector<std::shared_ptr<ReplicationManager::Item> >& replicas);
+        void deferReplicas(std::vector<std::shared_ptr<ReplicationManager::Item> >& replicas,
+                           std::shared_ptr<Query> const& query);
 
         /**
          * Abort any outstanding replica items (in case of errors)
@@ -603,6 +667,37 @@ namespace scidb
          */
         void fetchChunk(ArrayDesc const& desc, PersistentChunk& chunk);
 
+        /**
+         * Fetch a delta chunk from the disk: read the delta, load its base chunk
+         * and apply the one to a copy of the other
+         */
+        void fetchDeltaChunk(ArrayDesc const& desc, PersistentChunk& chunk, DataStore& ds);
+
+        /**
+         * Find the chunk that a new chunk at addr could be stored as a delta
+         * against: the chunk at the same position in the previous version, or
+         * the base of that chunk if it is itself a delta
+         * @return the base chunk, pinned, or NULL if there is none
+         */
+        std::shared_ptr<PersistentChunk> findDeltaBase(ArrayDesc const& desc,
+                                                       StorageAddress const& addr);
+
+        /**
+         * Encode a new chunk as a delta against its base
+         * @param limit the size of the chunk when stored in full
+         * @param[out] delta the encoded delta
+         * @return true if there is a base and the delta is smaller than limit
+         */
+        bool encodeDelta(ArrayDesc const& desc, PersistentChunk& chunk,
+                         size_t limit, std::vector<char>& delta);
+
+        /**
+         * Rewrite the surviving chunks of an array whose deltas are based on
+         * chunks that removeVersions is about to free
+         * @pre caller does not hold _mutex, and holds an exclusive lock on the array
+         */
+        void rebaseDeltas(ArrayUAID uaId, ArrayID lastLiveArrId);
+
         /**
          * Replicate chunk
          */
@@ -780,6 +875,17 @@ namespace scidb
          */
         InstanceID getPrimaryInstanceId(ArrayDesc const& desc, StorageAddress const& address) const;
 
+        /**
+         * @see Storage::getArrayStats
+         */
+        bool getArrayStats(ArrayDesc const& desc, ArrayStats& stats) const;
+
+        /**
+         * Forget the statistics of all versions of an array, or of all arrays
+         * when uaId is 0. Must be called with _mutex held.
+         */
+        void invalidateArrayStats(ArrayUAID uaId);
+
         /**
          * @see Storage::visitChunkDescriptors
          */
@@ -155,6 +155,7 @@ namespace scidb
 
     const size_t HEADER_SIZE = 4*KiB;  // align header on page boundary to allow aligned IO operations
     const size_t N_LATCHES = 101;      // XXX TODO: figure out if latching is still necessary after removing clone logic
+    const size_t CHUNKMAP_RECOVERY_BLOCK_SIZE = 16*MiB; // storage header bytes read at a time on startup
 
     /**
      * Position of chunk in the storage
@@ -23,19 +23,96 @@
 /*
  * ReplicationManager.cpp
  *
- * Description: Poor man's replication manager that blocks the replicating thread if the network is congested
+ * Description: Replication manager that batches chunk replicas per instance
+ * and blocks the replicating thread if the network is congested
  */
 
 #include "ReplicationManager.h"
 
+#include <string.h>
+
 #include <system/Config.h>
+#include <system/Constants.h>
 #include <network/BaseConnection.h>
+#include <network/proto/scidb_msg.pb.h>
+#include <util/Timing.h>
 
 using namespace std;
 namespace scidb
 {
 static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.replication"));
 
+namespace
+{
+    /// A batch is cut short before it carries more chunk data than this;
+    /// a single larger chunk is still sent on its own
+    const size_t MAX_BATCH_BYTES = 8 * MiB;
+
+    /// @return the chunk record of an item not yet sent
+    std::shared_ptr<scidb_msg::Chunk> getChunkRecord(const std::shared_ptr<ReplicationManager::Item>& item)
+    {
+        return item->getChunkMsg()->getRecord<scidb_msg::Chunk>();
+    }
+
+    /**
+     * @return true if 'item' can go in the same message as 'first':
+     * both are replicas (not eofs) of the same array in the same query
+     */
+    bool isBatchable(const std::shared_ptr<ReplicationManager::Item>& first,
+                     const std::shared_ptr<ReplicationManager::Item>& item)
+    {
+        if (item->isDone() ||
+            item->getChunkMsg()->getQueryID() != first->getChunkMsg()->getQueryID()) {
+            return false;
+        }
+        std::shared_ptr<scidb_msg::Chunk> rec = getChunkRecord(item);
+        return !rec->eof() && rec->batch_size() == 0 &&
+            rec->array_id() == getChunkRecord(first)->array_id();
+    }
+
+    /// @return one message with the replicas of the first n items of 'ri', in order
+    std::shared_ptr<MessageDesc> makeBatch(const std::deque<std::shared_ptr<ReplicationManager::Item> >& ri,
+                                           size_t n, size_t bytes)
+    {
+        std::shared_ptr<MessageDesc> msg;
+        char* dst = NULL;
+        if (bytes > 0) {
+            std::shared_ptr<CompressedBuffer> buffer = std::make_shared<CompressedBuffer>();
+            buffer->allocate(bytes);
+            dst = static_cast<char*>(buffer->getData());
+            msg = std::make_shared<MessageDesc>(mtChunkReplica, buffer);
+        } else {
+            msg = std::make_shared<MessageDesc>(mtChunkReplica);
+        }
+        msg->setQueryID(ri.front()->getChunkMsg()->getQueryID());
+        std::shared_ptr<scidb_msg::Chunk> record = msg->getRecord<scidb_msg::Chunk>();
+        record->set_array_id(getChunkRecord(ri.front())->array_id());
+        record->set_eof(false);
+
+        for (size_t i = 0; i < n; ++i) {
+            std::shared_ptr<MessageDesc> chunkMsg = ri[i]->getChunkMsg();
+            std::shared_ptr<scidb_msg::Chunk> chunkRecord = chunkMsg->getRecord<scidb_msg::Chunk>();
+            scidb_msg::Chunk_Replica* replica = record->add_batch();
+            replica->set_attribute_id(chunkRecord->attribute_id());
+            replica->mutable_coordinates()->CopyFrom(chunkRecord->coordinates());
+            if (chunkRecord->tombstone()) {
+                replica->set_tombstone(true);
+                continue;
+            }
+            replica->set_compression_method(chunkRecord->compression_method());
+            replica->set_decompressed_size(chunkRecord->decompressed_size());
+            replica->set_count(chunkRecord->count());
+            const size_t size = ri[i]->getSize();
+            if (size > 0) {
+                memcpy(dst, chunkMsg->getBinary()->getData(), size);
+                dst += size;
+            }
+            replica->set_size(size);
+        }
+        return msg;
+    }
+}
+
 void ReplicationManager::start(const std::shared_ptr<JobQueue>& jobQueue)
 {
     ScopedMutexLock cs(_repMutex, PTCW_REP);
@@ -52,6 +129,11 @@ void ReplicationManager::start(const std::shared_ptr<JobQueue>& jobQueue)
     // this queue is single-threaded because the order of replicas is important (per source)
     // and CachedStorage serializes everything anyway via THE mutex.
     _inboundReplicationQ = std::make_shared<WorkQueue>(jobQueue, 1, static_cast<uint64_t>(size));
+
+    const int batchSize = Config::getInstance()->getOption<int>(CONFIG_REPLICATION_BATCH_SIZE);
+    _batchSize = (batchSize < 1) ? 1 : static_cast<size_t>(batchSize);
+    _windowBytes = Config::getInstance()->getOption<size_t>(CONFIG_REPLICATION_WINDOW) * MiB;
+
     InjectedErrorListener<ReplicaSendInjectedError>::start();
     InjectedErrorListener<ReplicaWaitInjectedError>::start();
 }
@@ -74,15 +156,15 @@ void ReplicationManager::send(const std::shared_ptr<Item>& item)
     assert(_lsnrId);
 
     ScopedMutexLock cs(_repMutex, PTCW_REP);
-    std::shared_ptr<RepItems>& ri = _repQueue[item->getInstanceId()];
-    if (!ri) {
-        ri = std::shared_ptr<RepItems>(new RepItems);
-    }
-    ri->push_back(item);
-    if (ri->size() == 1) {
-        assert(ri->front() == item);
-        sendItem(*ri);
+    std::shared_ptr<Peer>& peer = _repQueue[item->getInstanceId()];
+    if (!peer) {
+        peer = std::make_shared<Peer>();
+        peer->stats.instanceId = item->getInstanceId();
     }
+    peer->items.push_back(item);
+    peer->queuedBytes += item->getSize();
+    // Whatever is queued ahead of the item goes out with it, if the network takes it
+    sendItems(*peer);
 }
 
 void ReplicationManager::wait(const std::shared_ptr<Item>& item)
@@ -96,23 +178,21 @@ void ReplicationManager::wait(const std::shared_ptr<Item>& item)
         return;
     }
 
-    std::shared_ptr<RepItems>& ri = _repQueue[item->getInstanceId()];
-    assert(ri);
+    std::shared_ptr<Peer> peer = _repQueue[item->getInstanceId()];
+    assert(peer);
 
     Event::ErrorChecker ec = bind(&ReplicationManager::checkItemState, item);
 
     while (true) {
 
         LOG4CXX_TRACE(logger, "ReplicationManager::wait: about to wait for instance=" << item->getInstanceId()
-                      << ", size=" << item->getChunkMsg()->getMessageSize()
+                      << ", size=" << item->getSize()
                       << ", query (" << item->getChunkMsg()->getQueryID()<<")"
-                      << ", queue size="<< ri->size());
-        assert(!ri->empty());
+                      << ", queue size="<< peer->items.size());
+        assert(!peer->items.empty());
 
-        bool mine = (ri->front() == item);
-        bool res = sendItem(*ri);
-        if (mine && res) {
-            assert(item->isDone());
+        bool res = sendItems(*peer);
+        if (item->isDone()) {
             item->validate();
             return;
         }
@@ -132,6 +212,61 @@ void ReplicationManager::wait(const std::shared_ptr<Item>& item)
     }
 }
 
+void ReplicationManager::throttle(const std::shared_ptr<Item>& item)
+{
+    ScopedMutexLock cs(_repMutex, PTCW_REP);
+
+    if (item->isDone()) {
+        item->validate();
+        return;
+    }
+    std::shared_ptr<Peer> peer = _repQueue[item->getInstanceId()];
+    assert(peer);
+    if (peer->queuedBytes <= _windowBytes) {
+        return;
+    }
+
+    LOG4CXX_TRACE(logger, "ReplicationManager::throttle: window full for instance=" << item->getInstanceId()
+                  << ", queued bytes=" << peer->queuedBytes
+                  << ", queue size="<< peer->items.size());
+
+    Event::ErrorChecker ec = bind(&ReplicationManager::checkItemState, item);
+    ElapsedMilliSeconds waited;
+    ++peer->stats.waits;
+    try {
+        while (peer->queuedBytes > _windowBytes && !item->isDone() && !sendItems(*peer)) {
+            InjectedErrorListener<ReplicaWaitInjectedError>::check();
+            if (!_repEvent.wait(_repMutex, ec, PTCW_REP)) {
+                break; // the item is done, or its query is gone
+            }
+        }
+    } catch (Exception& e) {
+        peer->stats.waitMsecs += waited.elapsed();
+        item->setDone(e.copy());
+        throw;
+    }
+    peer->stats.waitMsecs += waited.elapsed();
+    item->validate();
+}
+
+void ReplicationManager::visitPeerStats(const PeerStatsVisitor& visitor)
+{
+    vector<PeerStats> stats;
+    {
+        ScopedMutexLock cs(_repMutex, PTCW_REP);
+        stats.reserve(_repQueue.size());
+        for (RepQueue::const_iterator iter = _repQueue.begin(); iter != _repQueue.end(); ++iter) {
+            const Peer& peer = *iter->second;
+            stats.push_back(peer.stats);
+            stats.back().queuedChunks = peer.items.size();
+            stats.back().queuedBytes = peer.queuedBytes;
+        }
+    }
+    for (size_t i = 0; i < stats.size(); ++i) {
+        visitor(stats[i]);
+    }
+}
+
 void ReplicationManager::handleConnectionStatus(Notification<NetworkManager::ConnectionStatus>::MessageTypePtr connStatus)
 {
     assert(connStatus->getPhysicalInstanceId() != INVALID_INSTANCE);
@@ -158,51 +293,97 @@ void ReplicationManager::handleConnectionStatus(Notification<NetworkManager::Con
 
     LOG4CXX_TRACE(logger, "ReplicationManager::handleConnectionStatus: notification for instance="
                   << connStatus->getPhysicalInstanceId()
-                  << ", local replication queue size="<< iter->second->size()
+                  << ", local replication queue size="<< iter->second->items.size()
                   << ", remote receive queue size="<< connStatus->getAvailabeQueueSize());
     _repEvent.signal();
 }
 
-bool ReplicationManager::sendItem(RepItems& ri)
+bool ReplicationManager::sendItems(Peer& peer)
 {
     ScopedMutexLock cs(_repMutex, PTCW_REP);
 
-    const std::shared_ptr<Item>& item = ri.front();
+    while (!peer.items.empty()) {
+        if (peer.items.front()->isDone()) {
+            popItem(peer);
+            continue;
+        }
+        if (!sendBatch(peer)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ReplicationManager::sendBatch(Peer& peer)
+{
+    // _repMutex must be locked
+    RepItems& ri = peer.items;
+    const std::shared_ptr<Item> item = ri.front();
+    assert(!item->isDone());
 
-    if (item->isDone()) {
-        ri.pop_front();
-        return true;
+    size_t n = 1;
+    size_t bytes = item->getSize();
+    const bool isReplica = isBatchable(item, item); // rather than an eof
+    if (isReplica) {
+        while (n < ri.size() && n < _batchSize &&
+               isBatchable(item, ri[n]) &&
+               bytes + ri[n]->getSize() <= MAX_BATCH_BYTES) {
+            bytes += ri[n]->getSize();
+            ++n;
+        }
     }
     try {
         std::shared_ptr<Query> q(Query::getValidQueryPtr(item->getQuery()));
 
-        std::shared_ptr<MessageDesc> chunkMsg(item->getChunkMsg());
+        std::shared_ptr<MessageDesc> chunkMsg(n == 1 ? item->getChunkMsg() : makeBatch(ri, n, bytes));
         NetworkManager::getInstance()->sendPhysical(item->getInstanceId(), chunkMsg,
                                                    NetworkManager::mqtReplication);
-        LOG4CXX_TRACE(logger, "ReplicationManager::sendItem: successful replica chunk send to instance="
+        LOG4CXX_TRACE(logger, "ReplicationManager::sendBatch: successful replica send to instance="
                       << item->getInstanceId()
-                      << ", size=" << item->getChunkMsg()->getMessageSize()
+                      << ", chunks=" << n
+                      << ", size=" << bytes
                       << ", query (" << q->getQueryID()<<")"
                       << ", queue size="<< ri.size());
+        ++peer.stats.messages;
+        peer.stats.chunks += isReplica ? n : 0;
+        peer.stats.bytes += bytes;
         InjectedErrorListener<ReplicaSendInjectedError>::check();
-        item->setDone();
+        for (size_t i = 0; i < n; ++i) {
+            ri[i]->setDone();
+        }
     } catch (NetworkManager::OverflowException& e) {
         assert(e.getQueueType() == NetworkManager::mqtReplication);
         return false;
     } catch (Exception& e) {
-        item->setDone(e.copy());
+        std::shared_ptr<Exception> error(e.copy());
+        for (size_t i = 0; i < n; ++i) {
+            ri[i]->setDone(error);
+        }
     }
-    ri.pop_front();
+    for (size_t i = 0; i < n; ++i) {
+        popItem(peer);
+    }
+    // writers held back by the window may go on
+    _repEvent.signal();
     return true;
 }
 
+void ReplicationManager::popItem(Peer& peer)
+{
+    // _repMutex must be locked
+    assert(!peer.items.empty());
+    const size_t size = peer.items.front()->getSize();
+    peer.queuedBytes -= std::min(size, peer.queuedBytes);
+    peer.items.pop_front();
+}
+
 void ReplicationManager::clear()
 {
     // mutex must be locked
     for (RepQueue::iterator iter = _repQueue.begin(); iter != _repQueue.end(); ++iter) {
-        std::shared_ptr<RepItems>& ri = iter->second;
-        assert(ri);
-        for (RepItems::iterator i=ri->begin(); i != ri->end(); ++i) {
+        std::shared_ptr<Peer>& peer = iter->second;
+        assert(peer);
+        for (RepItems::iterator i=peer->items.begin(); i != peer->items.end(); ++i) {
             (*i)->setDone(SYSTEM_EXCEPTION_SPTR(SCIDB_SE_REPLICATION, SCIDB_LE_UNKNOWN_ERROR));
         }
     }
@@ -211,4 +392,3 @@ void ReplicationManager::clear()
 }
 
 }
-
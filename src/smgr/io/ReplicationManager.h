@@ -23,7 +23,8 @@
 /*
  * ReplicationManager.h
  *
- *      Description: Simple replication manager that blocks the replicating thread if the network is congested
+ *      Description: Replication manager that sends chunk replicas to each instance in batches,
+ *      and holds back a writer once too much of its data is waiting for the network
  */
 
 #ifndef REPLICATION_MANAGER_H_
@@ -31,6 +32,8 @@
 
 #include <deque>
 #include <map>
+#include <boost/function.hpp>
+#include <network/BaseConnection.h>
 #include <network/NetworkManager.h>
 #include <util/Event.h>
 #include <util/Mutex.h>
@@ -53,7 +56,8 @@ class ReplicationManager;
         Item(InstanceID instanceId,
              const std::shared_ptr<MessageDesc>& chunkMsg,
              const std::shared_ptr<Query>& query) :
-        _instanceId(instanceId), _chunkMsg(chunkMsg), _query(query), _isDone(false)
+        _instanceId(instanceId), _chunkMsg(chunkMsg), _query(query), _isDone(false),
+        _size(chunkMsg->getBinary() ? chunkMsg->getBinary()->getSize() : 0)
         {
             assert(instanceId != INVALID_INSTANCE);
             assert(chunkMsg);
@@ -63,6 +67,8 @@ class ReplicationManager;
         std::weak_ptr<Query> getQuery() { return _query; }
         InstanceID getInstanceId() { return _instanceId; }
         std::shared_ptr<MessageDesc> getChunkMsg() { return _chunkMsg; }
+        /// @return the size of the chunk data, which remains known after it is sent
+        size_t getSize() { return _size; }
         /**
          * @return true if the chunk has been sent to the network manager or an error has occurred
          */
@@ -105,23 +111,61 @@ class ReplicationManager;
         std::weak_ptr<Query> _query;
         bool _isDone;
         std::shared_ptr<scidb::Exception> _error;
+        size_t _size;
     };
 
+    /// Replication counters of one target instance, since startup
+    struct PeerStats
+    {
+        InstanceID instanceId;
+        uint64_t   chunks;       // chunk replicas (and tombstones) sent
+        uint64_t   messages;     // messages they were sent in
+        uint64_t   bytes;        // bytes of chunk data they carried
+        uint64_t   queuedChunks; // replicas waiting for the network now
+        uint64_t   queuedBytes;  // bytes of chunk data of those replicas
+        uint64_t   waits;        // times a writer was held back by a full window
+        uint64_t   waitMsecs;    // time writers spent held back
+
+        PeerStats()
+        : instanceId(INVALID_INSTANCE), chunks(0), messages(0), bytes(0),
+          queuedChunks(0), queuedBytes(0), waits(0), waitMsecs(0)
+        {}
+    };
+    typedef boost::function<void(const PeerStats&)> PeerStatsVisitor;
+
  private:
     typedef std::deque<std::shared_ptr<Item> > RepItems;
-    // XXX TODO: convert this to a set
-    typedef std::map<InstanceID, std::shared_ptr<RepItems> > RepQueue;
+
+    /// The replicas waiting to be sent to one instance, in order
+    struct Peer
+    {
+        RepItems  items;
+        size_t    queuedBytes;
+        PeerStats stats;
+
+        Peer() : queuedBytes(0) {}
+    };
+    typedef std::map<InstanceID, std::shared_ptr<Peer> > RepQueue;
  public:
-    ReplicationManager() {}
+    ReplicationManager() : _batchSize(1), _windowBytes(0) {}
     virtual ~ReplicationManager() {}
     /// start the operations
     void start(const std::shared_ptr<JobQueue>& jobQueue);
     /// stop the operations and release resources
     void stop();
-    /// replicate an item
+    /// replicate an item; never waits
     void send(const std::shared_ptr<Item>& item);
     /// wait until the item is sent to network manager
     void wait(const std::shared_ptr<Item>& item);
+    /**
+     * Wait while more than the replication window of data is queued for the
+     * target instance of the item, unless the item is done.
+     * Writers call it with no storage locks held, after send().
+     * @throw if the replication of the item failed
+     */
+    void throttle(const std::shared_ptr<Item>& item);
+    /// call the visitor with the counters of every instance replicas were sent to
+    void visitPeerStats(const PeerStatsVisitor& visitor);
     /// discard the item
     void abort(const std::shared_ptr<Item>& item)
     {
@@ -203,7 +247,13 @@ class ReplicationManager;
     };
 
     void handleConnectionStatus(Notification<NetworkManager::ConnectionStatus>::MessageTypePtr connStatus);
-    bool sendItem(RepItems& ri);
+    /// send the items queued for a peer until the network pushes back
+    /// @return true if none are left
+    bool sendItems(Peer& peer);
+    /// send the first item of the peer with as many of the following ones as fit in a batch
+    /// @return false if the network pushed back
+    bool sendBatch(Peer& peer);
+    void popItem(Peer& peer);
     void clear();
     static bool checkItemState(const std::shared_ptr<Item>& item)
     {
@@ -221,6 +271,8 @@ class ReplicationManager;
     RepQueue _repQueue;
     Mutex    _repMutex;
     Event    _repEvent;
+    size_t   _batchSize;   // most items per message
+    size_t   _windowBytes; // most bytes queued per peer before throttle() waits
     Notification<NetworkManager::ConnectionStatus>::ListenerID _lsnrId;
 
     std::shared_ptr<WorkQueue> _inboundReplicationQ;
@@ -30,9 +30,11 @@
  * @author sfridella@paradigm4.com
  */
 
+#include <algorithm>
 #include <sys/time.h>
 #include <inttypes.h>
 #include <limits>
+#include <list>
 #include <map>
 #include <unordered_set>
 #include <log4cxx/logger.h>
@@ -53,8 +55,11 @@
 #include <system/Exceptions.h>
 #include <system/SystemCatalog.h>
 #include <util/Platform.h>
+#include <util/ThreadPool.h>
+#include <system/Sysinfo.h>
 #include <array/TileIteratorAdaptors.h>
 #include <smgr/io/InternalStorage.h>
+#include <smgr/io/DeltaChunk.h>
 
 namespace scidb
 {
@@ -387,7 +392,188 @@ CachedStorage::checkExtentsForOverlaps(Extents& extents)
     }
 }
 
-/* Initialize the chunk map from on-disk store
+/* Rebuild the chunk map entries of one array from the descriptors at the
+   given slots of a block of the storage header, taken in header order.
+   Runs on a thread of the recovery pool: the inner map and the extents
+   belong to this array alone, and the shared free header set is only
+   touched under _mutex.
+ */
+void
+CachedStorage::recoverArrayChunks(ArrayDesc const& adesc,
+                                  ArrayID oldestVersion,
+                                  InnerChunkMap& innerMap,
+                                  vector<ChunkDescriptor>& block,
+                                  vector<size_t> const& slots,
+                                  Extents& extents)
+{
+    StorageAddress addr;
+    std::shared_ptr<DataStore> ds;
+
+    for (size_t s = 0; s < slots.size(); ++s)
+    {
+        ChunkDescriptor& desc = block[slots[s]];
+        uint64_t const chunkPos = desc.hdr.pos.hdrPos;
+        assert(adesc.getUAId() == desc.hdr.pos.dsGuid);
+
+        /* Find the oldest version of array, and the storage address
+           of the chunk currently in use by this version
+        */
+        desc.getAddress(addr);
+        StorageAddress oldestVersionAddr = addr;
+        oldestVersionAddr.arrId = oldestVersion;
+        StorageAddress oldestLiveChunkAddr;
+        InnerChunkMap::iterator oldestLiveChunk =
+            innerMap.lower_bound(oldestVersionAddr);
+        if (oldestLiveChunk == innerMap.end() ||
+            oldestLiveChunk->first.coords != oldestVersionAddr.coords ||
+            oldestLiveChunk->first.attId != oldestVersionAddr.attId)
+        {
+            oldestLiveChunkAddr = oldestVersionAddr;
+            oldestLiveChunkAddr.arrId = 0;
+        }
+        else
+        {
+            oldestLiveChunkAddr = oldestLiveChunk->first;
+        }
+
+        /* Chunk is live if and only if arrayID of chunk is > arrayID of chunk
+           currently pointed to by oldest version
+        */
+        if (desc.hdr.arrId > oldestLiveChunkAddr.arrId)
+        {
+            /* Chunk is live, put it in the map
+             */
+            std::shared_ptr<PersistentChunk>& chunk = innerMap[addr].getChunk();
+            ASSERT_EXCEPTION((!chunk), "smgr open: NOT unique chunk");
+            if (!desc.hdr.is<ChunkHeader::TOMBSTONE>())
+            {
+                chunk.reset(new PersistentChunk());
+                chunk->setAddress(adesc, desc);
+                recordExtent(extents, chunk);
+            }
+            else
+            {
+                innerMap[addr].setTombstonePos(InnerChunkMapEntry::TOMBSTONE,
+                                               desc.hdr.pos.hdrPos);
+            }
+
+            /* Now check if by inserting this chunk we made the previous one dead...
+               unless this chunk is a delta, which may be based on it: then it
+               stays until remove_versions rebases the delta.
+             */
+            if (oldestLiveChunkAddr.arrId &&
+                desc.hdr.arrId <= oldestVersionAddr.arrId &&
+                !desc.hdr.is<ChunkHeader::DELTA_CHUNK>())
+            {
+                /* The oldestLiveChunk is now dead... wipe it out
+                 */
+                if (!ds)
+                {
+                    ds = _datastores.getDataStore(desc.hdr.pos.dsGuid);
+                }
+                if (!oldestLiveChunk->second.isTombstone())
+                {
+                    eraseExtent(extents, oldestLiveChunk->second.getChunk());
+                }
+                {
+                    ScopedMutexLock cs(_mutex);
+                    markChunkAsFree(oldestLiveChunk->second, ds);
+                }
+                innerMap.erase(oldestLiveChunk);
+            }
+        }
+        else if (desc.hdr.arrId < oldestLiveChunkAddr.arrId &&
+                 !desc.hdr.is<ChunkHeader::TOMBSTONE>() &&
+                 !desc.hdr.is<ChunkHeader::DELTA_CHUNK>() &&
+                 !oldestLiveChunk->second.isTombstone() &&
+                 oldestLiveChunk->second.getChunk()->isDelta())
+        {
+            /* Chunk is older than the one in use by the oldest version, but
+               that one is a delta which may be based on it: keep it
+             */
+            std::shared_ptr<PersistentChunk>& chunk = innerMap[addr].getChunk();
+            ASSERT_EXCEPTION((!chunk), "smgr open: NOT unique chunk");
+            chunk.reset(new PersistentChunk());
+            chunk->setAddress(adesc, desc);
+            recordExtent(extents, chunk);
+        }
+        else
+        {
+            /* Chunk is dead, wipe it out
+             */
+            if (!ds)
+            {
+                ds = _datastores.getDataStore(desc.hdr.pos.dsGuid);
+            }
+            desc.hdr.arrId = 0;
+            LOG4CXX_TRACE(chunkLogger, "chunkl: initchunkmap: "
+                          << "remove dead chunk desc for non-existent "
+                          << "array version at position " << chunkPos);
+            _hd->writeAll(&desc.hdr, sizeof(ChunkHeader), chunkPos);
+            assert(desc.hdr.nCoordinates < MAX_NUM_DIMS_SUPPORTED);
+            {
+                ScopedMutexLock cs(_mutex);
+                _freeHeaders.insert(chunkPos);
+            }
+            ds->freeChunk(desc.hdr.pos.offs, desc.hdr.allocatedSize);
+        }
+    }
+}
+
+/* Wipe the descriptors at the given slots of a block of the storage
+   header: they belong to an array that no longer exists.
+ */
+void
+CachedStorage::wipeChunkDescriptors(vector<ChunkDescriptor>& block,
+                                    vector<size_t> const& slots)
+{
+    for (size_t s = 0; s < slots.size(); ++s)
+    {
+        ChunkDescriptor& desc = block[slots[s]];
+        uint64_t const chunkPos = desc.hdr.pos.hdrPos;
+        desc.hdr.arrId = 0;
+        LOG4CXX_TRACE(chunkLogger,
+                      "chunkl: initchunkmap: remove chunk desc "
+                      << "for non-existant array at position "
+                      << chunkPos);
+        _hd->writeAll(&desc.hdr, sizeof(ChunkHeader), chunkPos);
+        assert(desc.hdr.nCoordinates < MAX_NUM_DIMS_SUPPORTED);
+        {
+            ScopedMutexLock cs(_mutex);
+            _freeHeaders.insert(chunkPos);
+        }
+    }
+}
+
+/* Wait for all of the given recovery jobs, so that none is still using a
+   block of the header when an error is reported, then rethrow the first
+   error, if any.
+ */
+static void waitForRecoveryJobs(vector< std::shared_ptr<Job> >& jobs)
+{
+    std::shared_ptr<Job> failed;
+    for (size_t i = 0; i < jobs.size(); ++i)
+    {
+        if (!jobs[i]->wait() && !failed)
+        {
+            failed = jobs[i];
+        }
+    }
+    jobs.clear();
+    if (failed)
+    {
+        failed->rethrow();
+    }
+}
+
+/* Initialize the chunk map from on-disk store.
+
+   The storage header is read in large blocks, each read overlapping the
+   rebuild of the block before it.  The descriptors of a block are sorted
+   by array; arrays seen for the first time are looked up in the catalog
+   together, and the chunk map of each array is then rebuilt by its own
+   job.  Descriptors of an array are always applied in header order, which
+   the liveness rules of recoverArrayChunks depend on.
  */
 void
 CachedStorage::initChunkMap()
@@ -401,197 +587,176 @@ CachedStorage::initChunkMap()
     _skipChunkmapIntegrityCheck =
         Config::getInstance()->getOption<bool> (CONFIG_SKIP_CHUNKMAP_INTEGRITY_CHECK);
 
-    ChunkDescriptor desc;
-    uint64_t chunkPos = HEADER_SIZE;
-    StorageAddress addr;
+    uint64_t const startTime = getTimeInNanoSecs();
+    uint64_t readTime = 0;
+    uint64_t catalogTime = 0;
+    uint64_t buildTime = 0;
+
+    int nThreads = Config::getInstance()->getOption<int> (CONFIG_CHUNKMAP_RECOVERY_THREADS);
+    if (nThreads <= 0)
+    {
+        nThreads = safe_static_cast<int>(Sysinfo::getNumberOfCPUs());
+    }
+    std::shared_ptr<JobQueue> queue = std::make_shared<JobQueue>();
+    ThreadPool pool(std::max(nThreads, 1), queue);
+    pool.start();
+
+    size_t const blockSize =
+        std::max<size_t>(std::min<size_t>(CHUNKMAP_RECOVERY_BLOCK_SIZE / sizeof(ChunkDescriptor),
+                                          _hdr.nChunks), 1);
+    vector<ChunkDescriptor> blocks[2];
+    blocks[0].resize(blockSize);
+    blocks[1].resize(blockSize);
+    int curr = 0;
+
     set<ArrayID> removedArrays;
     typedef map<ArrayID, ArrayID> ArrayMap;
     ArrayMap oldestVersions;
     typedef map<ArrayID, std::shared_ptr<ArrayDesc> > ArrayDescCache;
     ArrayDescCache existentArrays;
-    Extents extents;
+    typedef std::unordered_map<ArrayUAID, Extents> ArrayExtents;
+    ArrayExtents extents;
+    vector< std::shared_ptr<Job> > jobs;
 
-    for (size_t i = 0; i < _hdr.nChunks; i++, chunkPos += sizeof(ChunkDescriptor))
-    {
-        size_t rc = _hd->read(&desc, sizeof(ChunkDescriptor), chunkPos);
-        if (rc != sizeof(ChunkDescriptor))
+    /* Read up to blockSize descriptors into blocks[b], starting with the
+       one numbered 'first', at position 'pos'.  A short read truncates the
+       header after the last whole descriptor read.
+     */
+    size_t counts[2] = { 0, 0 };
+    bool truncated[2] = { false, false };
+    auto readBlock = [&](int b, size_t first, uint64_t pos)
+    {
+        uint64_t const t0 = getTimeInNanoSecs();
+        size_t const n = std::min<size_t>(blockSize, _hdr.nChunks - first);
+        size_t const rc = _hd->read(&blocks[b][0], n * sizeof(ChunkDescriptor), pos);
+        counts[b] = n;
+        truncated[b] = false;
+        if (rc != n * sizeof(ChunkDescriptor))
         {
+            counts[b] = rc / sizeof(ChunkDescriptor);
+            truncated[b] = true;
             LOG4CXX_ERROR(logger, "Inconsistency in storage header: rc="
                           << rc << ", chunkPos="
-                          << chunkPos << ", i="
-                          << i << ", hdr.nChunks="
+                          << pos + counts[b] * sizeof(ChunkDescriptor) << ", i="
+                          << first + counts[b] << ", hdr.nChunks="
                           << _hdr.nChunks << ", hdr.currPos="
                           << _hdr.currPos);
-            _hdr.currPos = chunkPos;
-            _hdr.nChunks = i;
-            break;
-        }
-        if (desc.hdr.pos.hdrPos != chunkPos)
-        {
-            LOG4CXX_ERROR(logger, "Invalid chunk header " << i << " at position " << chunkPos
-                          << " desc.hdr.pos.hdrPos=" << desc.hdr.pos.hdrPos
-                          << " arrayID=" << desc.hdr.arrId
-                          << " hdr.nChunks=" << _hdr.nChunks);
-            _freeHeaders.insert(chunkPos);
         }
-        else
-        {
-            assert(desc.hdr.nCoordinates < MAX_NUM_DIMS_SUPPORTED);
+        readTime += getTimeInNanoSecs() - t0;
+    };
 
-            if (desc.hdr.arrId != 0)
+    uint64_t chunkPos = HEADER_SIZE;
+    size_t i = 0;
+    if (_hdr.nChunks > 0)
+    {
+        readBlock(curr, i, chunkPos);
+    }
+    while (i < _hdr.nChunks)
+    {
+        vector<ChunkDescriptor>& block = blocks[curr];
+        size_t const count = counts[curr];
+
+        /* Sort the descriptors of the block by array, keeping header order
+         */
+        typedef std::unordered_map<ArrayUAID, vector<size_t> > Slots;
+        Slots slots;
+        set<ArrayID> unknownArrays;
+        for (size_t j = 0; j < count; ++j, chunkPos += sizeof(ChunkDescriptor))
+        {
+            ChunkDescriptor const& desc = block[j];
+            if (desc.hdr.pos.hdrPos != chunkPos)
             {
-                /* Check if unversioned array exists
-                 */
-                ArrayDescCache::iterator it = existentArrays.find(desc.hdr.pos.dsGuid);
-                if (it == existentArrays.end())
+                LOG4CXX_ERROR(logger, "Invalid chunk header " << i + j << " at position " << chunkPos
+                              << " desc.hdr.pos.hdrPos=" << desc.hdr.pos.hdrPos
+                              << " arrayID=" << desc.hdr.arrId
+                              << " hdr.nChunks=" << _hdr.nChunks);
+                _freeHeaders.insert(chunkPos);
+            }
+            else if (desc.hdr.arrId == 0)
+            {
+                _freeHeaders.insert(chunkPos);
+            }
+            else
+            {
+                assert(desc.hdr.nCoordinates < MAX_NUM_DIMS_SUPPORTED);
+                ArrayUAID const uaid = desc.hdr.pos.dsGuid;
+                slots[uaid].push_back(j);
+                if (existentArrays.count(uaid) == 0 && removedArrays.count(uaid) == 0)
                 {
-                    if (removedArrays.count(desc.hdr.pos.dsGuid) == 0)
-                    {
-                        try
-                        {
-                            std::shared_ptr<ArrayDesc> ad =
-                                SystemCatalog::getInstance()->getArrayDesc(desc.hdr.pos.dsGuid);
-                            it = existentArrays.insert(
-                                ArrayDescCache::value_type(desc.hdr.pos.dsGuid, ad)
-                                ).first;
-                        }
-                        catch (SystemException const& x)
-                        {
-                            if (x.getLongErrorCode() == SCIDB_LE_ARRAYID_DOESNT_EXIST)
-                            {
-                                removedArrays.insert(desc.hdr.pos.dsGuid);
-                            }
-                            else
-                            {
-                                throw x;
-                            }
-                        }
-                    }
+                    unknownArrays.insert(uaid);
                 }
+            }
+        }
+        i += count;
 
-                /* If the unversioned array does not exist... wipe the chunk
-                 */
-                if (it == existentArrays.end())
+        /* Check which of the newly seen unversioned arrays still exist, all
+           in one catalog transaction
+         */
+        if (!unknownArrays.empty())
+        {
+            uint64_t const t0 = getTimeInNanoSecs();
+            ArrayDescCache descs;
+            ArrayMap oldest;
+            SystemCatalog::getInstance()->getArrayDescs(unknownArrays, descs, oldest);
+            for (set<ArrayID>::const_iterator a = unknownArrays.begin(); a != unknownArrays.end(); ++a)
+            {
+                ArrayDescCache::const_iterator d = descs.find(*a);
+                if (d == descs.end())
                 {
-                    desc.hdr.arrId = 0;
-                    LOG4CXX_TRACE(chunkLogger,
-                                  "chunkl: initchunkmap: remove chunk desc "
-                                  << "for non-existant array at position "
-                                  << chunkPos);
-                    _hd->writeAll(&desc.hdr, sizeof(ChunkHeader), chunkPos);
-                    assert(desc.hdr.nCoordinates < MAX_NUM_DIMS_SUPPORTED);
-                    _freeHeaders.insert(chunkPos);
+                    removedArrays.insert(*a);
                     continue;
                 }
-
-                /* Else add chunk to map (if it is live)
-                 */
-                else
+                existentArrays[*a] = d->second;
+                oldestVersions[*a] = oldest[*a];
+                if (_chunkMap.find(*a) == _chunkMap.end())
                 {
-                    /* Init array descriptor
-                     */
-                    ArrayDesc& adesc = *it->second;
-                    assert(adesc.getUAId() == desc.hdr.pos.dsGuid);
-
-                    /* Find/init the inner chunk map
-                     */
-                    ChunkMap::iterator iter = _chunkMap.find(adesc.getUAId());
-                    if (iter == _chunkMap.end())
-                    {
-                        iter = _chunkMap.insert(make_pair(adesc.getUAId(),
-                                                          make_shared <InnerChunkMap> ())).first;
-                    }
-                    std::shared_ptr<InnerChunkMap>& innerMap = iter->second;
-
-                    /* Find the oldest version of array, and the storage address
-                       of the chunk currently in use by this version
-                    */
-                    ArrayMap::iterator oldest_it = oldestVersions.find(adesc.getUAId());
-                    if (oldest_it == oldestVersions.end())
-                    {
-                        oldestVersions[adesc.getUAId()] =
-                            SystemCatalog::getInstance()->getOldestArrayVersion(adesc.getUAId());
-                    }
-                    desc.getAddress(addr);
-                    StorageAddress oldestVersionAddr = addr;
-                    oldestVersionAddr.arrId = oldestVersions[adesc.getUAId()];
-                    StorageAddress oldestLiveChunkAddr;
-                    InnerChunkMap::iterator oldestLiveChunk =
-                        innerMap->lower_bound(oldestVersionAddr);
-                    if (oldestLiveChunk == innerMap->end() ||
-                        oldestLiveChunk->first.coords != oldestVersionAddr.coords ||
-                        oldestLiveChunk->first.attId != oldestVersionAddr.attId)
-                    {
-                        oldestLiveChunkAddr = oldestVersionAddr;
-                        oldestLiveChunkAddr.arrId = 0;
-                    }
-                    else
-                    {
-                        oldestLiveChunkAddr = oldestLiveChunk->first;
-                    }
-
-                    /* Chunk is live if and only if arrayID of chunk is > arrayID of chunk
-                       currently pointed to by oldest version
-                    */
-                    if (desc.hdr.arrId > oldestLiveChunkAddr.arrId)
-                    {
-                        /* Chunk is live, put it in the map
-                         */
-                        std::shared_ptr<PersistentChunk>& chunk =(*innerMap)[addr].getChunk();
-                        ASSERT_EXCEPTION((!chunk), "smgr open: NOT unique chunk");
-                        if (!desc.hdr.is<ChunkHeader::TOMBSTONE>())
-                        {
-                            chunk.reset(new PersistentChunk());
-                            chunk->setAddress(adesc, desc);
-                            recordExtent(extents, chunk);
-                        }
-                        else
-                        {
-                            (*innerMap)[addr].setTombstonePos(
-                                    InnerChunkMapEntry::TOMBSTONE,
-                                    desc.hdr.pos.hdrPos);
-                        }
-
-                        /* Now check if by inserting this chunk we made the previous one dead...
-                         */
-                        if (oldestLiveChunkAddr.arrId &&
-                            desc.hdr.arrId <= oldestVersionAddr.arrId)
-                        {
-                            /* The oldestLiveChunk is now dead... wipe it out
-                             */
-                            std::shared_ptr<DataStore> ds =
-                                _datastores.getDataStore(desc.hdr.pos.dsGuid);
-                            if (!oldestLiveChunk->second.isTombstone())
-                            {
-                                eraseExtent(extents,
-                                            oldestLiveChunk->second.getChunk());
-                            }
-                            markChunkAsFree(oldestLiveChunk->second, ds);
-                            innerMap->erase(oldestLiveChunk);
-                        }
-                    }
-                    else
-                    {
-                        /* Chunk is dead, wipe it out
-                         */
-                        std::shared_ptr<DataStore> ds =
-                            _datastores.getDataStore(desc.hdr.pos.dsGuid);
-                        desc.hdr.arrId = 0;
-                        LOG4CXX_TRACE(chunkLogger, "chunkl: initchunkmap: "
-                                      << "remove dead chunk desc for non-existent "
-                                      << "array version at position " << chunkPos);
-                        _hd->writeAll(&desc.hdr, sizeof(ChunkHeader), chunkPos);
-                        assert(desc.hdr.nCoordinates < MAX_NUM_DIMS_SUPPORTED);
-                        _freeHeaders.insert(chunkPos);
-                        ds->freeChunk(desc.hdr.pos.offs, desc.hdr.allocatedSize);
-                    }
+                    _chunkMap.insert(make_pair(*a, make_shared<InnerChunkMap>()));
                 }
+                extents[*a];
+            }
+            catalogTime += getTimeInNanoSecs() - t0;
+        }
+
+        /* Rebuild the chunk map of each array on the pool, reading the next
+           block meanwhile
+         */
+        uint64_t const t0 = getTimeInNanoSecs();
+        for (Slots::const_iterator s = slots.begin(); s != slots.end(); ++s)
+        {
+            ArrayUAID const uaid = s->first;
+            boost::function<void()> work;
+            if (removedArrays.count(uaid))
+            {
+                work = boost::bind(&CachedStorage::wipeChunkDescriptors, this,
+                                   boost::ref(block), boost::cref(s->second));
             }
             else
             {
-                _freeHeaders.insert(chunkPos);
+                work = boost::bind(&CachedStorage::recoverArrayChunks, this,
+                                   boost::cref(*existentArrays[uaid]),
+                                   oldestVersions[uaid],
+                                   boost::ref(*_chunkMap[uaid]),
+                                   boost::ref(block),
+                                   boost::cref(s->second),
+                                   boost::ref(extents[uaid]));
             }
+            jobs.push_back(std::make_shared<ChunkMapRecoveryJob>(work));
+            queue->pushJob(jobs.back());
+        }
+        if (!truncated[curr] && i < _hdr.nChunks)
+        {
+            readBlock(1 - curr, i, chunkPos);
+        }
+        waitForRecoveryJobs(jobs);
+        buildTime += getTimeInNanoSecs() - t0;
+
+        if (truncated[curr])
+        {
+            _hdr.currPos = chunkPos;
+            _hdr.nChunks = i;
+            break;
         }
+        curr = 1 - curr;
     }
 
     /* Perform some simple validation for storage header
@@ -612,9 +777,29 @@ CachedStorage::initChunkMap()
         ++remit;
     }
 
-    /* Check chunkmap for overlaps...
+    /* Check the chunk map of each array for overlaps...
      */
-    checkExtentsForOverlaps(extents);
+    uint64_t const checkStart = getTimeInNanoSecs();
+    if (!_skipChunkmapIntegrityCheck)
+    {
+        for (ArrayExtents::iterator e = extents.begin(); e != extents.end(); ++e)
+        {
+            boost::function<void()> work =
+                boost::bind(&CachedStorage::checkExtentsForOverlaps, this, boost::ref(e->second));
+            jobs.push_back(std::make_shared<ChunkMapRecoveryJob>(work));
+            queue->pushJob(jobs.back());
+        }
+        waitForRecoveryJobs(jobs);
+    }
+    uint64_t const endTime = getTimeInNanoSecs();
+
+    LOG4CXX_INFO(logger, "smgr open:  chunk map of " << _hdr.nChunks << " descriptors and "
+                 << existentArrays.size() << " arrays rebuilt in "
+                 << (endTime - startTime) / 1000000 << " ms with " << nThreads << " threads"
+                 << " (read " << readTime / 1000000 << " ms"
+                 << ", catalog " << catalogTime / 1000000 << " ms"
+                 << ", build " << buildTime / 1000000 << " ms"
+                 << ", integrity check " << (endTime - checkStart) / 1000000 << " ms)");
 }
 
 /* Read the storage description file to find path for chunk map file.
@@ -686,6 +871,7 @@ CachedStorage::open(const string& storageDescriptorFilePath, size_t cacheSizeByt
     }
 
     _writeLogThreshold = Config::getInstance()->getOption<int> (CONFIG_IO_LOG_THRESHOLD);
+    _compactionThreshold = Config::getInstance()->getOption<int> (CONFIG_DATASTORE_COMPACTION_THRESHOLD);
     _enableDeltaEncoding = Config::getInstance()->getOption<bool> (CONFIG_ENABLE_DELTA_ENCODING);
 
     // disable replication during rollback: each instance is perfroming rollback locally
@@ -766,6 +952,7 @@ CachedStorage::close()
         }
     }
     _chunkMap.clear();
+    invalidateArrayStats(0);
 
     _hd.reset();
     _log[0].reset();
@@ -884,12 +1071,24 @@ void CachedStorage::compressChunk(ArrayDesc const& desc, PersistentChunk const*
     }
     buf.setDecompressedSize(chunk.getSize());
     buf.setCompressionMethod(compressionMethod);
+
+    /* A delta on disk is of no use to the receiver: reconstruct the chunk
+       in the cache and compress it from there
+     */
+    PersistentChunk::UnPinner deltaScope(NULL);
+    if (chunk.isDelta())
+    {
+        chunk.pin();
+        deltaScope.set(&chunk);
+        loadChunk(desc, &chunk);
+    }
     {
         ScopedMutexLock cs(_mutex);
         if (!chunk.isRaw() && chunk._data != NULL)
         {
             PersistentChunk::Pinner scope(&chunk);
-            buf.allocate(chunk.getCompressedSize() != 0 ? chunk.getCompressedSize() : chunk.getSize());
+            buf.allocate(chunk.getCompressedSize() != 0 && !chunk.isDelta()
+                         ? chunk.getCompressedSize() : chunk.getSize());
             DBArrayChunkInternal intChunk(desc, &chunk);
             size_t compressedSize = _compressors[compressionMethod]->compress(buf.getData(), intChunk);
             if (compressedSize == chunk.getSize())
@@ -972,6 +1171,7 @@ std::shared_ptr<PersistentChunk> CachedStorage::createChunk(ArrayDesc const& des
         throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CHUNK_ALREADY_EXISTS)
         << CoordsToStr(addr.coords);
     }
+    invalidateArrayStats(desc.getUAId());
 
     std::shared_ptr<PersistentChunk>& chunk = (*(iter->second))[addr].getChunk();
     chunk.reset(new PersistentChunk());
@@ -1032,6 +1232,11 @@ void CachedStorage::removeVersions(QueryID queryId,
                                    ArrayUAID uaId,
                                    ArrayID lastLiveArrId)
 {
+    if (lastLiveArrId)
+    {
+        rebaseDeltas(uaId, lastLiveArrId);
+    }
+
     ScopedMutexLock cs(_mutex);
     std::shared_ptr<InnerChunkMap> innerMap;
     ChunkMap::const_iterator iter = _chunkMap.find(uaId);
@@ -1108,6 +1313,207 @@ void CachedStorage::removeVersions(QueryID queryId,
         _chunkMap.erase(uaId);
         _datastores.closeDataStore(uaId, true /* remove from disk */);
     }
+    else
+    {
+        compactDataStore(uaId);
+    }
+}
+
+/* Rewrite the chunks whose deltas would lose their base when removeVersions
+   frees the chunks that are older than lastLiveArrId.  At each position the
+   oldest surviving chunk, if it is a delta, becomes a full chunk, and the
+   deltas that follow it are re-encoded against it.  The deltas are switched
+   first, so that after a crash every descriptor names data whose base is
+   still on disk.
+ */
+void CachedStorage::rebaseDeltas(ArrayUAID uaId, ArrayID lastLiveArrId)
+{
+    typedef vector< std::shared_ptr<PersistentChunk> > Run;
+    vector<Run> runs;
+    {
+        ScopedMutexLock cs(_mutex);
+        ChunkMap::const_iterator iter = _chunkMap.find(uaId);
+        if (iter == _chunkMap.end())
+        {
+            return;
+        }
+        InnerChunkMap& innerMap = *iter->second;
+        InnerChunkMap::iterator i = innerMap.begin();
+        while (i != innerMap.end())
+        {
+            /* The survivors at this position, newest first: the chunks added
+               after the oldest version, and the one in use by it
+             */
+            Run survivors;
+            StorageAddress const& position = i->first;
+            bool oldest = false;
+            for (; i != innerMap.end() && i->first.sameBaseAddr(position); ++i)
+            {
+                if (!oldest)
+                {
+                    survivors.push_back(i->second.isTombstone()
+                                        ? std::shared_ptr<PersistentChunk>()
+                                        : i->second.getChunk());
+                    oldest = (i->first.arrId <= lastLiveArrId);
+                }
+            }
+            Run run;
+            for (Run::reverse_iterator c = survivors.rbegin();
+                 c != survivors.rend() && *c && (*c)->isDelta(); ++c)
+            {
+                run.push_back(*c);
+            }
+            if (!run.empty())
+            {
+                runs.push_back(run);
+            }
+        }
+    }
+    if (runs.empty())
+    {
+        return;
+    }
+
+    std::shared_ptr<ArrayDesc> desc = SystemCatalog::getInstance()->getArrayDesc(lastLiveArrId);
+    std::shared_ptr<DataStore> ds = _datastores.getDataStore(uaId);
+
+    struct Rewrite
+    {
+        PersistentChunk* chunk;
+        vector<char>     image;
+        bool             delta;
+        ChunkHeader      oldHdr;
+    };
+
+    /* Write the new images of some chunks and switch their descriptors
+       over to them, as compactDataStore does
+     */
+    auto rewrite = [this, &ds, uaId](vector<Rewrite>& rewrites)
+    {
+        if (rewrites.empty())
+        {
+            return;
+        }
+        ScopedMutexLock cs(_mutex);
+        invalidateArrayStats(uaId);
+        size_t placed = 0;
+        try
+        {
+            for (; placed < rewrites.size(); ++placed)
+            {
+                Rewrite& w = rewrites[placed];
+                ChunkHeader& hdr = w.chunk->_hdr;
+                w.oldHdr = hdr;
+                size_t allocated = 0;
+                off_t offs = ds->allocateSpace(w.image.size(), allocated);
+                hdr.pos.offs = offs;
+                hdr.allocatedSize = allocated;
+                hdr.compressedSize = w.image.size();
+                hdr.set<ChunkHeader::DELTA_CHUNK>(w.delta);
+                writeChunkToDataStore(*ds, *w.chunk, &w.image[0]);
+            }
+            ds->flush();
+        }
+        catch (std::exception const&)
+        {
+            for (size_t k = 0; k < rewrites.size() && k <= placed; ++k)
+            {
+                ChunkHeader& hdr = rewrites[k].chunk->_hdr;
+                if (hdr.pos.offs != rewrites[k].oldHdr.pos.offs)
+                {
+                    ds->freeChunk(hdr.pos.offs, hdr.allocatedSize);
+                }
+                hdr = rewrites[k].oldHdr;
+            }
+            throw;
+        }
+        for (size_t k = 0; k < rewrites.size(); ++k)
+        {
+            ChunkHeader const& hdr = rewrites[k].chunk->_hdr;
+            LOG4CXX_TRACE(chunkLogger, "chunkl: rebase: rewrite chunk at desc pos "
+                          << hdr.pos.hdrPos << (rewrites[k].delta ? " as delta" : " in full"));
+            _hd->writeAll(&hdr, sizeof(ChunkHeader), hdr.pos.hdrPos);
+        }
+        if (_hd->fsync() != 0)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_OPERATION_FAILED_WITH_ERRNO)
+                << "fsync" << ::strerror(errno) << errno;
+        }
+    };
+
+    /* Take the runs a batch at a time, so that the chunks being rewritten
+       fit comfortably in the cache
+     */
+    size_t nRewritten = 0;
+    for (size_t r = 0; r < runs.size(); )
+    {
+        std::list<PersistentChunk::UnPinner> pins;
+        vector<Rewrite> deltas;
+        vector<Rewrite> fulls;
+        size_t batchSize = 0;
+        do
+        {
+            Run const& run = runs[r];
+            for (size_t c = 0; c < run.size(); ++c)
+            {
+                run[c]->pin();
+                pins.emplace_back(run[c].get());
+                loadChunk(*desc, run[c].get());
+                batchSize += run[c]->getSize();
+            }
+
+            /* Each chunk stored in full, as writeChunk would, or as a delta
+               of the first one of the run if that is smaller
+             */
+            PersistentChunk& base = *run[0];
+            for (size_t c = 0; c < run.size(); ++c)
+            {
+                PersistentChunk& chunk = *run[c];
+                Rewrite w;
+                w.chunk = &chunk;
+                w.image.resize(chunk.getSize());
+                DBArrayChunkInternal intChunk(*desc, &chunk);
+                size_t compressedSize =
+                    _compressors[chunk.getCompressionMethod()]->compress(&w.image[0], intChunk);
+                if (compressedSize == chunk.getSize())
+                {
+                    memcpy(&w.image[0], chunk._data, compressedSize);
+                }
+                w.image.resize(compressedSize);
+                vector<char> delta;
+                w.delta = c > 0 &&
+                    DeltaChunk::encode(base._data, base.getSize(),
+                                       chunk._data, chunk.getSize(),
+                                       base._addr.arrId, compressedSize, delta);
+                if (w.delta)
+                {
+                    w.image.swap(delta);
+                }
+                (c == 0 ? fulls : deltas).push_back(w);
+            }
+            ++r;
+        } while (r < runs.size() && batchSize < _cacheSize / 4);
+
+        rewrite(deltas);
+        rewrite(fulls);
+        nRewritten += deltas.size() + fulls.size();
+
+        /* Only now is it safe to free the old copies
+         */
+        ScopedMutexLock cs(_mutex);
+        for (size_t k = 0; k < deltas.size(); ++k)
+        {
+            ds->freeChunk(deltas[k].oldHdr.pos.offs, deltas[k].oldHdr.allocatedSize);
+        }
+        for (size_t k = 0; k < fulls.size(); ++k)
+        {
+            ds->freeChunk(fulls[k].oldHdr.pos.offs, fulls[k].oldHdr.allocatedSize);
+        }
+        ds->releaseFreedSpace();
+    }
+    LOG4CXX_DEBUG(logger, "CachedStorage::rebaseDeltas: array " << uaId
+                  << " rewrote " << nRewritten << " chunks in "
+                  << runs.size() << " delta runs");
 }
 
 void CachedStorage::removeVersionFromMemory(ArrayUAID uaId, ArrayID arrId)
@@ -1123,6 +1529,7 @@ void CachedStorage::removeVersionFromMemory(ArrayUAID uaId, ArrayID arrId)
     {
         innerMap = iter->second;
     }
+    invalidateArrayStats(uaId);
     vector<StorageAddress> victims;
     for (InnerChunkMap::iterator i = innerMap->begin(); i != innerMap->end(); ++i)
     {
@@ -1288,16 +1695,21 @@ void CachedStorage::abortReplicas(vector<std::shared_ptr<ReplicationManager::Ite
     }
 }
 
-void CachedStorage::waitForReplicas(vector<std::shared_ptr<ReplicationManager::Item> >& replicasVec)
+void CachedStorage::deferReplicas(vector<std::shared_ptr<ReplicationManager::Item> >& replicasVec,
+                                  std::shared_ptr<Query> const& query)
 {
     // _mutex must NOT be locked
+    if (replicasVec.empty())
+    {
+        return;
+    }
+    std::shared_ptr<ReplicationContext> replicationCtx = query->getReplicationContext();
     for (size_t i = 0; i < replicasVec.size(); ++i)
     {
-        const std::shared_ptr<ReplicationManager::Item>& item = replicasVec[i];
         assert(_replicationManager);
-        _replicationManager->wait(item);
-        assert(item->isDone());
-        assert(item->validate(false));
+        _replicationManager->throttle(replicasVec[i]);
+        replicationCtx->addPendingReplica(boost::bind(&ReplicationManager::wait,
+                                                      _replicationManager, replicasVec[i]));
     }
 }
 
@@ -1566,6 +1978,17 @@ CachedStorage::writeChunk(ArrayDesc const& adesc,
     replicate(adesc, chunk._addr, &chunk, deflated,
               compressedSize, chunk.getSize(), query, replicasVec);
 
+    /* Store a new version of a chunk as a delta against the chunk in the
+       previous version, if that is smaller.  Replicas get the full chunk.
+     */
+    vector<char> delta;
+    if (_enableDeltaEncoding && dstVersion != 0 &&
+        encodeDelta(adesc, chunk, compressedSize, delta))
+    {
+        deflated = &delta[0];
+        compressedSize = delta.size();
+    }
+
     /* Write chunk locally into storage
      */
     {
@@ -1574,9 +1997,12 @@ CachedStorage::writeChunk(ArrayDesc const& adesc,
         Query::validateQueryPtr(query);
         std::shared_ptr<DataStore> ds = _datastores.getDataStore(adesc.getUAId());
 
+        invalidateArrayStats(adesc.getUAId());
+
         /* Fill in the chunk descriptor
          */
         chunk._hdr.compressedSize = compressedSize;
+        chunk._hdr.set<ChunkHeader::DELTA_CHUNK>(!delta.empty());
         chunk._hdr.pos.dsGuid = adesc.getUAId();
         chunk._hdr.pos.offs = ds->allocateSpace(compressedSize,
                                                 chunk._hdr.allocatedSize);
@@ -1664,9 +2090,10 @@ CachedStorage::writeChunk(ArrayDesc const& adesc,
         } // else chunkCleaner will dec accessCount and free
     }
 
-    /* Wait for replication to complete
+    /* Replication completes in the background; the query waits for it
+       before it commits
      */
-    waitForReplicas(replicasVec);
+    deferReplicas(replicasVec, query);
     replicasCleaner.disarm();
 }
 
@@ -1694,8 +2121,6 @@ void CachedStorage::markChunkAsFree(InnerChunkMapEntry& entry, std::shared_ptr<D
         /* Handle live chunks
          */
         memcpy(&header, &(chunk->_hdr), sizeof(ChunkHeader));
-        if (ds)
-            ds->freeChunk(chunk->_hdr.pos.offs, chunk->_hdr.allocatedSize);
     }
 
     /* Update header as free and write back to storage header file
@@ -1707,6 +2132,139 @@ void CachedStorage::markChunkAsFree(InnerChunkMapEntry& entry, std::shared_ptr<D
     _hd->writeAll(&header, sizeof(ChunkHeader), header.pos.hdrPos);
     assert(header.nCoordinates < MAX_NUM_DIMS_SUPPORTED);
     _freeHeaders.insert(header.pos.hdrPos);
+
+    /* The data store keeps the space in the file until the next flush()
+       has made the descriptor durably free
+     */
+    if (chunk && ds)
+    {
+        ds->freeChunk(chunk->_hdr.pos.offs, chunk->_hdr.allocatedSize);
+    }
+    invalidateArrayStats(0);
+}
+
+/* Relocate the chunks of an array towards the start of its data store
+ */
+void CachedStorage::compactDataStore(ArrayUAID uaId)
+{
+    if (_compactionThreshold <= 0)
+    {
+        return;
+    }
+    ChunkMap::const_iterator iter = _chunkMap.find(uaId);
+    if (iter == _chunkMap.end())
+    {
+        return;
+    }
+    std::shared_ptr<InnerChunkMap> innerMap = iter->second;
+    std::shared_ptr<DataStore> ds = _datastores.getDataStore(uaId);
+
+    off_t    fileSize = 0;
+    blkcnt_t fileBlocks = 0;
+    off_t    fileFree = 0;
+
+    ds->getSizes(fileSize, fileBlocks, fileFree);
+    if (fileSize == 0 || fileFree * 100 < fileSize * _compactionThreshold)
+    {
+        return;
+    }
+
+    /* Visit the chunks from the end of the file backwards, moving each one
+       into the lowest free extent below it that can hold it.  Chunks that
+       are pinned or being loaded may be read from disk without the mutex,
+       so they stay where they are.
+     */
+    vector<PersistentChunk*> chunks;
+    for (InnerChunkMap::iterator i = innerMap->begin(); i != innerMap->end(); ++i)
+    {
+        std::shared_ptr<PersistentChunk>& chunk = i->second.getChunk();
+        if (chunk && chunk->_accessCount == 0 && !chunk->_raw)
+        {
+            assert(chunk->_hdr.pos.dsGuid == uaId);
+            chunks.push_back(chunk.get());
+        }
+    }
+    std::sort(chunks.begin(), chunks.end(),
+              [](PersistentChunk const* l, PersistentChunk const* r)
+              { return l->_hdr.pos.offs > r->_hdr.pos.offs; });
+
+    /* 1) Copy the chunks into their new places.  The chunk map on disk
+          still points at the old copies, which stay allocated.
+     */
+    vector<ChunkHeader> oldHeaders;
+    vector<PersistentChunk*> moved;
+    vector<char> buf;
+    try
+    {
+        for (size_t i = 0; i < chunks.size(); ++i)
+        {
+            ChunkHeader& hdr = chunks[i]->_hdr;
+            size_t allocated = 0;
+            off_t offs = ds->allocateSpaceBelow(hdr.compressedSize, hdr.pos.offs, allocated);
+            if (offs < 0)
+            {
+                continue;
+            }
+            oldHeaders.push_back(hdr);
+            moved.push_back(chunks[i]);
+            hdr.pos.offs = offs;
+            hdr.allocatedSize = allocated;
+
+            buf.resize(std::max<size_t>(hdr.compressedSize, 1));
+            ds->readData(oldHeaders.back().pos.offs, &buf[0], hdr.compressedSize);
+            ds->writeData(hdr.pos.offs, &buf[0], hdr.compressedSize, hdr.allocatedSize);
+        }
+        if (moved.empty())
+        {
+            return;
+        }
+
+        /* 2) Make the copies durable before anything refers to them
+         */
+        ds->flush();
+    }
+    catch (std::exception const&)
+    {
+        for (size_t i = 0; i < moved.size(); ++i)
+        {
+            ds->freeChunk(moved[i]->_hdr.pos.offs, moved[i]->_hdr.allocatedSize);
+            moved[i]->_hdr = oldHeaders[i];
+        }
+        throw;
+    }
+
+    /* 3) Point the chunk descriptors at the copies.  Each descriptor is
+          switched by a single write, so after a crash it names either the
+          old or the new copy, both of which are intact.
+     */
+    for (size_t i = 0; i < moved.size(); ++i)
+    {
+        ChunkHeader const& hdr = moved[i]->_hdr;
+        LOG4CXX_TRACE(chunkLogger, "chunkl: compact: move chunk at desc pos "
+                      << hdr.pos.hdrPos << " from " << oldHeaders[i].pos.offs
+                      << " to " << hdr.pos.offs);
+        _hd->writeAll(&hdr, sizeof(ChunkHeader), hdr.pos.hdrPos);
+    }
+    if (_hd->fsync() != 0)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_OPERATION_FAILED_WITH_ERRNO)
+            << "fsync" << ::strerror(errno) << errno;
+    }
+
+    /* 4) Free the old copies; the data store gives back the tail of the file
+     */
+    for (size_t i = 0; i < oldHeaders.size(); ++i)
+    {
+        ds->freeChunk(oldHeaders[i].pos.offs, oldHeaders[i].allocatedSize);
+    }
+    ds->flush();
+    ds->releaseFreedSpace();
+
+    off_t newSize = 0;
+    ds->getSizes(newSize, fileBlocks, fileFree);
+    LOG4CXX_DEBUG(logger, "CachedStorage::compactDataStore: array " << uaId
+                  << " moved " << moved.size() << " chunks, file size "
+                  << fileSize << " -> " << newSize);
 }
 
 void CachedStorage::removeDeadChunks(ArrayDesc const& arrayDesc,
@@ -1746,7 +2304,7 @@ void CachedStorage::removeChunkVersion(ArrayDesc const& arrayDesc,
     StorageAddress addr(arrayDesc.getId(), 0, coords);
     replicate(arrayDesc, addr, NULL, NULL, 0, 0, query, replicasVec);
     removeLocalChunkVersion(arrayDesc, coords, query);
-    waitForReplicas(replicasVec);
+    deferReplicas(replicasVec, query);
     replicasCleaner.disarm();
 }
 
@@ -1792,6 +2350,7 @@ void CachedStorage::removeLocalChunkVersion(ArrayDesc const& arrayDesc,
     {
         throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_ILLEGAL_OPERATION) << "Attempt to create tombstone for unexistent array";
     }
+    invalidateArrayStats(arrayDesc.getUAId());
     std::shared_ptr<InnerChunkMap> inner = iter->second;
     for (AttributeID i =0; i<arrayDesc.getAttributes().size(); i++)
     {
@@ -1853,6 +2412,7 @@ void CachedStorage::rollback(RollbackMap const& undoUpdates)
     LOG4CXX_DEBUG(logger, "Performing rollback");
 
     ScopedMutexLock cs(_mutex);
+    invalidateArrayStats(0);
     for (int i = 0; i < 2; i++)
     {
         uint64_t pos = 0;
@@ -2019,16 +2579,19 @@ CachedStorage::flush(ArrayUAID uaId)
             << "fsync" << ::strerror(errno) << errno;
     }
 
-    /* flush the data store for the indicated array (or flush all datastores)
+    /* flush the data store for the indicated array (or flush all datastores),
+       then give the space of the chunks whose descriptors are now durably
+       free back to the file system
      */
     if (uaId != INVALID_ARRAY_ID)
     {
         std::shared_ptr<DataStore> ds = _datastores.getDataStore(uaId);
         ds->flush();
+        ds->releaseFreedSpace();
     }
     else
     {
-        _datastores.flushAllDataStores();
+        _datastores.flushAllDataStores(true);
     }
 }
 
@@ -2057,7 +2620,11 @@ void CachedStorage::fetchChunk(ArrayDesc const& desc, PersistentChunk& chunk)
     }
     size_t chunkSize = chunk.getSize();
     chunk.allocate(chunkSize);
-    if (chunk.getCompressedSize() != chunkSize)
+    if (chunk.isDelta())
+    {
+        fetchDeltaChunk(desc, chunk, *ds);
+    }
+    else if (chunk.getCompressedSize() != chunkSize)
     {
         const size_t bufSize = chunk.getCompressedSize();
         boost::scoped_array<char> buf(new char[bufSize]);
@@ -2079,6 +2646,101 @@ void CachedStorage::fetchChunk(ArrayDesc const& desc, PersistentChunk& chunk)
     }
 }
 
+/* Reconstruct a delta chunk: read the delta from the disk, load the base
+   chunk it refers to (from the cache if it is there) and apply the delta
+   to a copy of the base.
+ */
+void CachedStorage::fetchDeltaChunk(ArrayDesc const& desc, PersistentChunk& chunk, DataStore& ds)
+{
+    vector<char> delta(chunk.getCompressedSize());
+    readChunkFromDataStore(ds, chunk, &delta[0]);
+    DeltaChunkHeader const dhdr = DeltaChunk::getHeader(&delta[0], delta.size());
+
+    StorageAddress baseAddr(dhdr.baseArrId, chunk._addr.attId, chunk._addr.coords);
+    std::shared_ptr<PersistentChunk> base = lookupChunk(desc, baseAddr);
+    if (!base)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CHUNK_NOT_FOUND);
+    }
+    PersistentChunk::UnPinner scope(base.get());
+    loadChunk(desc, base.get());
+    DeltaChunk::apply(base->_data, base->getSize(),
+                      &delta[0], delta.size(),
+                      chunk._data, chunk.getSize());
+}
+
+std::shared_ptr<PersistentChunk>
+CachedStorage::findDeltaBase(ArrayDesc const& desc, StorageAddress const& addr)
+{
+    std::shared_ptr<PersistentChunk> prev;
+    {
+        ScopedMutexLock cs(_mutex);
+        ChunkMap::const_iterator iter = _chunkMap.find(desc.getUAId());
+        if (iter == _chunkMap.end())
+        {
+            return prev;
+        }
+        /* The chunk map keeps the versions of a chunk newest first, so the
+           previous version is the first entry below the new one
+         */
+        StorageAddress prevAddr(addr.arrId - 1, addr.attId, addr.coords);
+        InnerChunkMap::iterator i = iter->second->lower_bound(prevAddr);
+        if (i == iter->second->end() ||
+            !i->first.sameBaseAddr(addr) ||
+            i->second.isTombstone() ||
+            !i->second.getChunk())
+        {
+            return prev;
+        }
+        prev = i->second.getChunk();
+        prev->beginAccess();
+        if (!prev->isDelta())
+        {
+            return prev;
+        }
+    }
+
+    /* The previous version is itself a delta: use its base, so that a delta
+       never needs more than one other chunk to be read
+     */
+    std::shared_ptr<PersistentChunk> base;
+    {
+        PersistentChunk::UnPinner scope(prev.get());
+        std::shared_ptr<DataStore> ds = _datastores.getDataStore(desc.getUAId());
+        DeltaChunkHeader dhdr;
+        ds->readData(prev->_hdr.pos.offs, &dhdr, sizeof(dhdr));
+        dhdr = DeltaChunk::getHeader(&dhdr, sizeof(dhdr));
+        base = lookupChunk(desc, StorageAddress(dhdr.baseArrId, addr.attId, addr.coords));
+    }
+    if (base && base->isDelta())
+    {
+        base->unPin();
+        base.reset();
+    }
+    return base;
+}
+
+bool CachedStorage::encodeDelta(ArrayDesc const& desc,
+                                PersistentChunk& chunk,
+                                size_t limit,
+                                vector<char>& delta)
+{
+    std::shared_ptr<PersistentChunk> base = findDeltaBase(desc, chunk._addr);
+    if (!base)
+    {
+        return false;
+    }
+    PersistentChunk::UnPinner scope(base.get());
+    loadChunk(desc, base.get());
+    bool encoded = DeltaChunk::encode(base->_data, base->getSize(),
+                                      chunk._data, chunk.getSize(),
+                                      base->_addr.arrId, limit, delta);
+    LOG4CXX_TRACE(logger, "CachedStorage::encodeDelta: chunk " << chunk.getHeader()
+                  << (encoded ? " stored as delta of " : " stored in full, base ")
+                  << base->_addr.arrId << ", " << delta.size() << " of " << limit << " bytes");
+    return encoded;
+}
+
 void CachedStorage::loadChunk(ArrayDesc const& desc, PersistentChunk* aChunk)
 {
     PersistentChunk& chunk = *aChunk;
@@ -2188,6 +2850,85 @@ void CachedStorage::visitChunkMap(const ChunkMapVisitor& visit) const
     }
 }
 
+bool CachedStorage::getArrayStats(ArrayDesc const& desc, ArrayStats& stats) const
+{
+    stats = ArrayStats();
+
+    ScopedMutexLock cs(_mutex);
+    ChunkMap::const_iterator iter = _chunkMap.find(desc.getUAId());
+    if (iter == _chunkMap.end())
+    {
+        return false;
+    }
+
+    // A version is only walked the first time it is asked for, or after its
+    // array has changed, so that planning a scan does not hold the storage
+    // mutex for a time that grows with the array.
+    VersionStats& versions = _arrayStats[desc.getUAId()];
+    VersionStats::const_iterator cached = versions.find(desc.getId());
+    if (cached != versions.end())
+    {
+        stats = cached->second;
+        return true;
+    }
+
+    // Cells and chunk positions are counted on a single attribute,
+    // the empty bitmap when there is one; bytes are counted on all of them.
+    AttributeDesc const* ebm = desc.getEmptyBitmapAttribute();
+    AttributeID const countAttId = ebm ? ebm->getId() : 0;
+    bool const isReplicated =
+        desc.getDistribution()->getPartitioningSchema() == psReplication;
+
+    // The inner map keeps the most recent version of each chunk first,
+    // so the first entry not newer than desc is the visible one.
+    StorageAddress const* visible = NULL;
+    InnerChunkMap const& innerMap = *iter->second;
+    for (InnerChunkMap::const_iterator j = innerMap.begin(); j != innerMap.end(); ++j)
+    {
+        StorageAddress const& addr = j->first;
+        if (addr.arrId > desc.getId())
+        {
+            continue;
+        }
+        if (visible && visible->attId == addr.attId && visible->coords == addr.coords)
+        {
+            continue;
+        }
+        visible = &addr;
+
+        if (j->second.isTombstone() || !j->second.getChunk())
+        {
+            continue;
+        }
+        ChunkHeader const& hdr = j->second.getChunk()->getHeader();
+        if (!isReplicated && hdr.instanceId != _hdr.instanceId)
+        {
+            continue;
+        }
+        stats.nBytes += hdr.size;
+        stats.nCompressedBytes += hdr.compressedSize;
+        if (addr.attId == countAttId)
+        {
+            ++stats.nChunks;
+            stats.nCells += hdr.nElems;
+        }
+    }
+    versions[desc.getId()] = stats;
+    return true;
+}
+
+void CachedStorage::invalidateArrayStats(ArrayUAID uaId)
+{
+    if (uaId == 0)
+    {
+        _arrayStats.clear();
+    }
+    else
+    {
+        _arrayStats.erase(uaId);
+    }
+}
+
 ///////////////////////////////////////////////////////////////////
 /// DBArrayIterator
 ///////////////////////////////////////////////////////////////////
@@ -2627,23 +3368,19 @@ void CachedStorage::DBArrayChunk::showEmptyBitmap(const std::string & strPrefix)
         if(dbChunk->pin()) {
             char const* src = (char const*)dbChunk->getConstData();
             if (src != NULL) {
-                ConstRLEEmptyBitmap::Header const* hdr = (ConstRLEEmptyBitmap::Header const*)src;
-                assert(hdr->_magic == RLE_EMPTY_BITMAP_MAGIC);
-
-                // uint64_t nNonEmptyElements = hdr->_nNonEmptyElements;
-                size_t nSegs = hdr->_nSegs;
-                ConstRLEEmptyBitmap::Segment const* seg = (ConstRLEEmptyBitmap::Segment const*)(hdr+1);
+                ConstRLEEmptyBitmap bitmap(src);
 
-                for(size_t k = 0;  k < nSegs; k++)
+                for(size_t k = 0;  k < bitmap.nSegments(); k++)
                 {
+                    ConstRLEEmptyBitmap::Segment const& segment = bitmap.getSegment(k);
 
                     stringstream ss;
                     ss  << strPrefix
                         << " " << getArrayDesc().getName()
                         << " segment["
-                        << "  _lPosition="   << seg[k]._lPosition
-                        << "  _length="      << seg[k]._length
-                        << "  _pPosition="   << seg[k]._pPosition
+                        << "  _lPosition="   << segment._lPosition
+                        << "  _length="      << segment._length
+                        << "  _pPosition="   << segment._pPosition
                         << "]";
 
                     LOG4CXX_DEBUG(logger, ss.str());
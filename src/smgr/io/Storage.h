@@ -299,6 +299,30 @@ namespace scidb
 
         virtual void getDiskInfo(DiskInfo& info) = 0;
 
+        /**
+         * Summary of the locally stored chunks of one array version,
+         * used by the optimizer to estimate input sizes.
+         */
+        struct ArrayStats
+        {
+            uint64_t nChunks;          ///< number of chunk positions
+            uint64_t nCells;           ///< number of non-empty cells
+            uint64_t nBytes;           ///< uncompressed size of all attribute chunks
+            uint64_t nCompressedBytes; ///< on-disk size of all attribute chunks
+
+            ArrayStats() : nChunks(0), nCells(0), nBytes(0), nCompressedBytes(0) {}
+        };
+
+        /**
+         * Collect the statistics for the chunks of a given array version that
+         * this instance holds as a primary copy (replicas are not counted,
+         * except for replicated arrays where every instance holds all chunks).
+         * @param desc versioned array descriptor
+         * @param stats [out] the statistics
+         * @return false if the storage has no chunk map entry for the array
+         */
+        virtual bool getArrayStats(ArrayDesc const& desc, ArrayStats& stats) const = 0;
+
         virtual uint64_t getCurrentTimestamp() const = 0;
 
         virtual uint64_t getUsedMemSize() const = 0;
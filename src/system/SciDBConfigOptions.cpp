@@ -158,7 +158,7 @@ void initConfig(int argc, char* argv[])
         (CONFIG_ASYNC_IO_BUFFER, 0, "async-io-buffer", "ASYNC_IO_BUFFER", "", Config::INTEGER,
                 "Maximal size of connection output IO queue (Mb)", 64, false)
         (CONFIG_CHUNK_RESERVE, 0, "chunk-reserve", "CHUNK_RESERVE", "", Config::INTEGER, "Percent of chunks size preallocated for adding deltas", 0, false)
-        (CONFIG_ENABLE_DELTA_ENCODING, 0, "enable-delta-encoding", "ENABLE_DELTA_ENCODING", "", Config::BOOLEAN, "True if system should attempt to compute delta chunk versions", false, false)
+        (CONFIG_ENABLE_DELTA_ENCODING, 0, "enable-delta-encoding", "ENABLE_DELTA_ENCODING", "", Config::BOOLEAN, "True if a new version of a chunk should be stored as a delta against the previous version when that is smaller", false, false)
         (CONFIG_VERSION, 'V', "version", "", "", Config::BOOLEAN, "Version.",
                 false, false)
         (CONFIG_STAT_MONITOR, 0, "stat-monitor", "STAT_MONITOR", "", Config::INTEGER,
@@ -219,6 +219,37 @@ void initConfig(int argc, char* argv[])
         (CONFIG_AUTOCHUNK_MAX_SYNTHETIC_INTERVAL, '\0', "autochunk-max-synthetic-interval",
          "AUTOCHUNK_MAX_SYNTHETIC_INTERVAL", "", Config::SIZE,
          "Largest chunk interval to allow for the synthetic dimension if that dimension is autochunked.", 20UL, false)
+        (CONFIG_MEM_ARRAY_SPILL_COMPRESSION, 0, "mem-array-spill-compression",
+         "MEM_ARRAY_SPILL_COMPRESSION", "", Config::STRING,
+         "Compressor applied to temporary array chunks spilled to disk (zlib, bzlib or none)", string("zlib"), false)
+        (CONFIG_DATASTORE_COMPACTION_THRESHOLD, 0, "datastore-compaction-threshold",
+         "DATASTORE_COMPACTION_THRESHOLD", "", Config::INTEGER,
+         "Percentage of free space in an array data file above which remove_versions compacts the file (0 disables compaction).", 25, false)
+        (CONFIG_CHUNKMAP_RECOVERY_THREADS, 0, "chunkmap-recovery-threads",
+         "CHUNKMAP_RECOVERY_THREADS", "", Config::INTEGER,
+         "Number of threads rebuilding the chunk map on startup (0 means one per CPU).", 0, false)
+        (CONFIG_ADMISSION_MEMORY_POOL, 0, "admission-memory-pool", "ADMISSION_MEMORY_POOL", "", Config::INTEGER,
+         "Memory from which queries get their reservations before they run (MiB). Queries that do not "
+         "fit wait for admission. 0 disables admission control; -1 uses three quarters of max-memory-limit, "
+         "if that is set.", -1, false)
+        (CONFIG_QUERY_MEMORY_RESERVATION, 0, "query-memory-reservation", "QUERY_MEMORY_RESERVATION", "", Config::SIZE,
+         "Smallest memory reservation of a query under admission control (MiB); also the reservation "
+         "of a query whose needs are unknown.", 256UL, false)
+        (CONFIG_REPLICATION_BATCH_SIZE, 0, "replication-batch-size", "REPLICATION_BATCH_SIZE", "", Config::INTEGER,
+         "The most chunk replicas sent to an instance in one message.", 32, false)
+        (CONFIG_REPLICATION_WINDOW, 0, "replication-window", "REPLICATION_WINDOW", "", Config::SIZE,
+         "The most replica data (MiB) queued for an instance before a writer waits for the network.", 64UL, false)
+        (CONFIG_RESULT_CACHE_SIZE, 0, "result-cache-size", "RESULT_CACHE_SIZE", "", Config::SIZE,
+         "Memory of the coordinator (MiB) that keeps the results of read-only queries for the next "
+         "identical query over the same array versions. 0 disables the cache.", 0UL, false)
+        (CONFIG_PLAN_CACHE_SIZE, 0, "plan-cache-size", "PLAN_CACHE_SIZE", "", Config::SIZE,
+         "The most physical plans of read-only queries that the coordinator keeps for the next query "
+         "with the same text, once its parameters are bound, over the same catalog. 0 disables the cache.",
+         256UL, false)
+        (CONFIG_CHUNK_POOL_SIZE, 0, "chunk-pool-size", "CHUNK_POOL_SIZE", "", Config::SIZE,
+         "Memory (MiB) of freed chunk buffers that each instance keeps for reuse by the next chunks "
+         "of the same size, taken out of mem-array-threshold, of which it may use at most half. "
+         "0 disables the pool.", 0UL, false)
         ;
 
     cfg->addHook(configHook);
@@ -1342,116 +1342,195 @@ void SystemCatalog::_getArrayDesc(const std::string &array_name,
         try
         {
             work tr(*_connection);
-            string sql1 = "select id, name, distribution_id, flags from \"array\" where id = $1";
-            _connection->prepare("find-by-id", sql1) PQXX_DECL("bigint", treat_direct);
-            result query_res1 = tr.prepared("find-by-id")(array_id).exec();
-            if (query_res1.size() <= 0)
-            {
-                throw SYSTEM_EXCEPTION(SCIDB_SE_SYSCAT, SCIDB_LE_ARRAYID_DOESNT_EXIST) << array_id;
-            }
+            newDesc = _getArrayDesc(array_id, &tr);
+            tr.commit();
+        }
+        catch (const broken_connection &e)
+        {
+            throw;
+        }
+        catch (const sql_error &e)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_SYSCAT, SCIDB_LE_PG_QUERY_EXECUTION_FAILED) << e.query() << e.what();
+        }
+        catch (const pqxx::failure &e)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_SYSCAT, SCIDB_LE_UNKNOWN_ERROR) << e.what();
+        }
+        assert(newDesc->getUAId()!=0);
 
-            assert(array_id ==  query_res1[0].at("id").as(uint64_t()));
-            string array_name = query_res1[0].at("name").as(string());
-            ArrayUAID uaid;
-            VersionID vid;
-            fillArrayIdentifiers(_connection, &tr, array_name, array_id, uaid, vid);
+        return newDesc;
+    }
+
+    //Not thread safe. Must be called with active connection under _pgLock.
+    std::shared_ptr<ArrayDesc> SystemCatalog::_getArrayDesc(const ArrayID array_id,
+                                                           pqxx::basic_transaction* tr)
+    {
+        assert(tr);
+        string sql1 = "select id, name, distribution_id, flags from \"array\" where id = $1";
+        _connection->prepare("find-by-id", sql1) PQXX_DECL("bigint", treat_direct);
+        result query_res1 = tr->prepared("find-by-id")(array_id).exec();
+        if (query_res1.size() <= 0)
+        {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_SYSCAT, SCIDB_LE_ARRAYID_DOESNT_EXIST) << array_id;
+        }
+
+        assert(array_id ==  query_res1[0].at("id").as(uint64_t()));
+        string array_name = query_res1[0].at("name").as(string());
+        ArrayUAID uaid;
+        VersionID vid;
+        fillArrayIdentifiers(_connection, tr, array_name, array_id, uaid, vid);
 
-            string key="GET_ATTR";
-            string sql2 = "select id, name, type, flags, default_compression_method, reserve, default_missing_reason, default_value"
-                " from \"array_attribute\" where array_id = $1 order by id";
-            _connection->prepare(key + sql2, sql2) PQXX_DECL("integer", treat_direct);
-            result query_res2 = tr.prepared(key + sql2)(array_id).exec();
+        string key="GET_ATTR";
+        string sql2 = "select id, name, type, flags, default_compression_method, reserve, default_missing_reason, default_value"
+            " from \"array_attribute\" where array_id = $1 order by id";
+        _connection->prepare(key + sql2, sql2) PQXX_DECL("integer", treat_direct);
+        result query_res2 = tr->prepared(key + sql2)(array_id).exec();
 
-            Attributes attributes;
-            if (query_res2.size() > 0)
+        Attributes attributes;
+        if (query_res2.size() > 0)
+        {
+            attributes.reserve(query_res2.size());
+            for (result::const_iterator i = query_res2.begin(); i != query_res2.end(); ++i)
             {
-                attributes.reserve(query_res2.size());
-                for (result::const_iterator i = query_res2.begin(); i != query_res2.end(); ++i)
-                {
-                    Value defaultValue;
-                    string defaultValueExpr = "";
-                    int missingReason = i.at("default_missing_reason").as(int());
-                    if (missingReason >= 0) {
-                        defaultValue.setNull(safe_static_cast<Value::reason>(missingReason));
-                    } else {
-                        defaultValueExpr = i.at("default_value").as(string());
-
-                        // Evaluate expression if present and set default value
-                        if (defaultValueExpr != "")
+                Value defaultValue;
+                string defaultValueExpr = "";
+                int missingReason = i.at("default_missing_reason").as(int());
+                if (missingReason >= 0) {
+                    defaultValue.setNull(safe_static_cast<Value::reason>(missingReason));
+                } else {
+                    defaultValueExpr = i.at("default_value").as(string());
+
+                    // Evaluate expression if present and set default value
+                    if (defaultValueExpr != "")
+                    {
+                        Expression expr = deserializePhysicalExpression(defaultValueExpr);
+                        defaultValue = expr.evaluate();
+                    }
+                    // Else fallback to null or zero as before
+                    else
+                    {
+                        TypeId typeId = i.at("type").as(TypeId());
+                        defaultValue = Value(TypeLibrary::getType(typeId));
+                        if (i.at("flags").as(int16_t()) & AttributeDesc::IS_NULLABLE)
                         {
-                            Expression expr = deserializePhysicalExpression(defaultValueExpr);
-                            defaultValue = expr.evaluate();
+                            defaultValue.setNull();
                         }
-                        // Else fallback to null or zero as before
                         else
                         {
-                            TypeId typeId = i.at("type").as(TypeId());
-                            defaultValue = Value(TypeLibrary::getType(typeId));
-                            if (i.at("flags").as(int16_t()) & AttributeDesc::IS_NULLABLE)
-                            {
-                                defaultValue.setNull();
-                            }
-                            else
-                            {
-                                defaultValue = TypeLibrary::getDefaultValue(typeId);
-                            }
+                            defaultValue = TypeLibrary::getDefaultValue(typeId);
                         }
                     }
-                    AttributeDesc att(
-                        i.at("id").as(AttributeID()),
-                        i.at("name").as(string()),
-                        i.at("type").as (TypeId()),
-                        i.at("flags").as(int16_t()),
-                        i.at("default_compression_method").as(uint16_t()),
-                        std::set<std::string>(),
-                        i.at("reserve").as(int16_t()),
-                        &defaultValue,
-                        defaultValueExpr
-                        );
-
-                    attributes.push_back(att);
                 }
+                AttributeDesc att(
+                    i.at("id").as(AttributeID()),
+                    i.at("name").as(string()),
+                    i.at("type").as (TypeId()),
+                    i.at("flags").as(int16_t()),
+                    i.at("default_compression_method").as(uint16_t()),
+                    std::set<std::string>(),
+                    i.at("reserve").as(int16_t()),
+                    &defaultValue,
+                    defaultValueExpr
+                    );
+
+                attributes.push_back(att);
             }
+        }
 
-            // string sql3 = "select name, start, length, chunk_interval, chunk_overlap "
-            //      " from \"array_dimension\" where array_id = $1 order by id";
+        // string sql3 = "select name, start, length, chunk_interval, chunk_overlap "
+        //      " from \"array_dimension\" where array_id = $1 order by id";
 
-            string sql3 = "select name, startmin, currstart, currend, endmax, chunk_interval, chunk_overlap "
-                " from \"array_dimension\" where array_id = $1 order by id";
-            _connection->prepare(sql3, sql3) PQXX_DECL("integer", treat_direct);
-            result query_res3 = tr.prepared(sql3)(array_id).exec();
+        string sql3 = "select name, startmin, currstart, currend, endmax, chunk_interval, chunk_overlap "
+            " from \"array_dimension\" where array_id = $1 order by id";
+        _connection->prepare(sql3, sql3) PQXX_DECL("integer", treat_direct);
+        result query_res3 = tr->prepared(sql3)(array_id).exec();
 
-            Dimensions dimensions;
-            if (query_res3.size() > 0)
+        Dimensions dimensions;
+        if (query_res3.size() > 0)
+        {
+            attributes.reserve(query_res3.size());
+            for (result::const_iterator i = query_res3.begin(); i != query_res3.end(); ++i)
             {
-                attributes.reserve(query_res3.size());
-                for (result::const_iterator i = query_res3.begin(); i != query_res3.end(); ++i)
-                {
-                    dimensions.push_back(
-                        DimensionDesc(
-                            i.at("name").as(string()),
-                            i.at("startmin").as(int64_t()),
-                            i.at("currstart").as(int64_t()),
-                            i.at("currend").as(int64_t()),
-                            i.at("endmax").as(int64_t()),
-                            i.at("chunk_interval").as(int64_t()),
-                            i.at("chunk_overlap").as(int64_t())));
-                }
+                dimensions.push_back(
+                    DimensionDesc(
+                        i.at("name").as(string()),
+                        i.at("startmin").as(int64_t()),
+                        i.at("currstart").as(int64_t()),
+                        i.at("currend").as(int64_t()),
+                        i.at("endmax").as(int64_t()),
+                        i.at("chunk_interval").as(int64_t()),
+                        i.at("chunk_overlap").as(int64_t())));
             }
+        }
+
+        //array distribution should be the same as that of the unversioned array
+        uint64_t arrDistId = query_res1[0].at("distribution_id").as(uint64_t());
+
+        ArrayDistPtr distribution = getArrayDistribution(arrDistId, tr);
+        ArrayResPtr residency = getArrayResidency(uaid, tr);
+
+        std::shared_ptr<ArrayDesc> newDesc(new ArrayDesc(array_id, uaid, vid,
+                                                           query_res1[0].at("name").as(string()),
+                                                           attributes,
+                                                           dimensions,
+                                                           distribution,
+                                                           residency,
+                                                           query_res1[0].at("flags").as(int())));
+        return newDesc;
+    }
+
+    void SystemCatalog::getArrayDescs(const std::set<ArrayID>& ids,
+                                      std::map<ArrayID, std::shared_ptr<ArrayDesc> >& descs,
+                                      std::map<ArrayID, ArrayID>& oldestVersions)
+    {
+        boost::function<void()> work = boost::bind(&SystemCatalog::_getArrayDescs,
+                                                   this, boost::cref(ids),
+                                                   boost::ref(descs), boost::ref(oldestVersions));
+        Query::runRestartableWork<void, broken_connection>(work, _reconnectTries);
+    }
+
+    void SystemCatalog::_getArrayDescs(const std::set<ArrayID>& ids,
+                                       std::map<ArrayID, std::shared_ptr<ArrayDesc> >& descs,
+                                       std::map<ArrayID, ArrayID>& oldestVersions)
+    {
+        LOG4CXX_TRACE(logger, "SystemCatalog::getArrayDescs( " << ids.size() << " ids )");
+        if (ids.empty()) {
+            return;
+        }
 
-            //array distribution should be the same as that of the unversioned array
-            uint64_t arrDistId = query_res1[0].at("distribution_id").as(uint64_t());
+        ScopedMutexLock mutexLock(_pgLock, PTCW_PG);
+        ScopedWaitTimer timer(PTCW_PG);
 
-            ArrayDistPtr distribution = getArrayDistribution(arrDistId, &tr);
-            ArrayResPtr residency = getArrayResidency(uaid, &tr);
+        assert(_connection);
+        descs.clear();
+        oldestVersions.clear();
+        try
+        {
+            work tr(*_connection);
+
+            // The ids are integers, so they can be spliced into the statement
+            // as they are; the statement itself varies with their number and
+            // is not worth preparing.
+            stringstream sql;
+            sql << "select ARR.id as id, COALESCE(min(VER.version_array_id),0) as vid"
+                   " from \"array\" as ARR left join \"array_version\" as VER on VER.array_id = ARR.id"
+                   " where ARR.id in (";
+            for (std::set<ArrayID>::const_iterator i = ids.begin(); i != ids.end(); ++i) {
+                sql << (i == ids.begin() ? "" : ",") << *i;
+            }
+            sql << ") group by ARR.id";
 
-            newDesc = std::shared_ptr<ArrayDesc>(new ArrayDesc(array_id, uaid, vid,
-                                                               query_res1[0].at("name").as(string()),
-                                                               attributes,
-                                                               dimensions,
-                                                               distribution,
-                                                               residency,
-                                                               query_res1[0].at("flags").as(int())));
+            result query_res = tr.exec(sql.str());
+            for (result::const_iterator i = query_res.begin(); i != query_res.end(); ++i)
+            {
+                oldestVersions[i.at("id").as(uint64_t())] = i.at("vid").as(uint64_t());
+            }
+            for (std::map<ArrayID, ArrayID>::const_iterator i = oldestVersions.begin();
+                 i != oldestVersions.end(); ++i)
+            {
+                descs[i->first] = _getArrayDesc(i->first, &tr);
+            }
             tr.commit();
         }
         catch (const broken_connection &e)
@@ -1460,15 +1539,14 @@ void SystemCatalog::_getArrayDesc(const std::string &array_name,
         }
         catch (const sql_error &e)
         {
+            LOG4CXX_ERROR(logger, "SystemCatalog::getArrayDescs: postgress exception:"<< e.what());
+            LOG4CXX_ERROR(logger, "SystemCatalog::getArrayDescs: query:"<< e.query());
             throw SYSTEM_EXCEPTION(SCIDB_SE_SYSCAT, SCIDB_LE_PG_QUERY_EXECUTION_FAILED) << e.query() << e.what();
         }
         catch (const pqxx::failure &e)
         {
             throw SYSTEM_EXCEPTION(SCIDB_SE_SYSCAT, SCIDB_LE_UNKNOWN_ERROR) << e.what();
         }
-        assert(newDesc->getUAId()!=0);
-
-        return newDesc;
     }
 
     bool SystemCatalog::deleteArray(const string &array_name)
@@ -28,12 +28,20 @@
 
 /* Implementation notes:
 
-   DataStore file is divided into power-of-two sized chunks. Some important
-   invariants:
+   DataStore file is divided into extents whose sizes are drawn from a set
+   of size classes (see roundUpSizeClass).  Free extents are indexed both
+   by size (for best-fit allocation) and by offset (for merging neighbours
+   and for compaction).  Some important invariants:
 
-   1) If the file is non-zero length, then there are always valid chunks at
-      offset 0, and offset filesize/2.  We never have a file with a single
-      chunk that spans the entire file.
+   1) Free extents never overlap or abut: a freed region is merged with the
+      free extents on either side of it.
+
+   2) The file never ends in a free extent: a free extent that reaches the
+      end of the file is cut off with ftruncate.  Large freed regions in the
+      middle of the file are returned to the file system by punching holes.
+
+   Files written by the older buddy allocator (power-of-two extents) remain
+   readable: their free lists load as ordinary free extents.
  */
 
 #include <log4cxx/logger.h>
@@ -179,12 +187,9 @@ DataStore::allocateSpace(size_t requestedSize, size_t& allocatedSize)
 
     invalidateFreelistFile();
 
-    /* Round up required size to next power-of-two
+    /* Round up required size to the next size class
      */
-    size_t requiredSize = requestedSize + sizeof(DiskChunkHeader);
-    if (requiredSize < _dsm->getMinAllocSize())
-        requiredSize = _dsm->getMinAllocSize();
-    requiredSize = roundUpPowerOf2(requiredSize);
+    size_t requiredSize = getRequiredSize(requestedSize);
 
     /* Check if the free lists have a chunk of the proper size
      */
@@ -209,6 +214,48 @@ DataStore::allocateSpace(size_t requestedSize, size_t& allocatedSize)
     return ret;
 }
 
+/* Find space for the chunk of indicated size in a free extent below limit
+ */
+off_t
+DataStore::allocateSpaceBelow(size_t requestedSize, off_t limit, size_t& allocatedSize)
+{
+    ScopedMutexLock sm(_dslock);
+
+    size_t requiredSize = getRequiredSize(requestedSize);
+
+    /* First fit by address, so that relocated chunks pack towards the
+       start of the file
+     */
+    for (DataStoreExtents::iterator it = _freeExtents.begin();
+         it != _freeExtents.end() && it->first < limit;
+         ++it)
+    {
+        if (it->second < requiredSize ||
+            it->first + static_cast<off_t>(requiredSize) > limit)
+        {
+            continue;
+        }
+
+        invalidateFreelistFile();
+
+        off_t ret = it->first;
+        size_t extent = it->second;
+
+        removeFreeExtent(ret, extent);
+        if (extent > requiredSize)
+        {
+            insertFreeExtent(ret + requiredSize, extent - requiredSize);
+        }
+        calcLargestFreeChunk();
+        allocatedSize = requiredSize;
+
+        LOG4CXX_TRACE(logger, "datastore: allocate space " << requestedSize << " below "
+                      << limit << " for " << _file->getPath() << " returned " << ret);
+        return ret;
+    }
+    return -1;
+}
+
 /* Write bytes to the DataStore, to a location that is already
    allocated
  */
@@ -309,10 +356,48 @@ DataStore::freeChunk(off_t off, size_t allocated)
 
     invalidateFreelistFile();
 
-    /* Update the free list
+    /* Update the free list.  The space stays in the file until the caller
+       has made the chunk descriptor that names it durably free
      */
     addToFreelist(allocated, off);
     calcLargestFreeChunk();
+    _freed.push_back(std::make_pair(off, allocated));
+}
+
+/* Give a free tail back to the file system, and punch out whatever of the
+   chunks freed since the last call is still free and inside the file
+ */
+void
+DataStore::releaseFreedSpace()
+{
+    ScopedMutexLock sm(_dslock);
+
+    if (_freed.empty())
+    {
+        return;
+    }
+
+    releaseTail();
+    calcLargestFreeChunk();
+
+    for (size_t i = 0; i < _freed.size(); ++i)
+    {
+        off_t const off = _freed[i].first;
+        DataStoreExtents::iterator ext = _freeExtents.upper_bound(off);
+        if (ext == _freeExtents.begin())
+        {
+            continue;
+        }
+        --ext;
+        off_t const end = std::min(off + static_cast<off_t>(_freed[i].second),
+                                   std::min(ext->first + static_cast<off_t>(ext->second),
+                                            static_cast<off_t>(_allocatedSize)));
+        if (off < end)
+        {
+            punchHole(off, end - off);
+        }
+    }
+    _freed.clear();
 }
 
 
@@ -344,19 +429,26 @@ DataStore::getSizes(off_t& filesize,
 
     /* Calc the number of free bytes in the file
      */
-    DataStoreFreelists::iterator dsit = _freelists.begin();
-    while (dsit != _freelists.end())
+    DataStoreExtents::const_iterator it = _freeExtents.begin();
+    while (it != _freeExtents.end())
     {
-        set<off_t>::iterator bucketit = dsit->second.begin();
-        while (bucketit != dsit->second.end())
-        {
-            filefree += dsit->first;
-            ++bucketit;
-        }
-        ++dsit;
+        filefree += it->second;
+        ++it;
     }
 }
 
+/* Return fragmentation information about the free space
+ */
+void
+DataStore::getFreeExtentStats(size_t& nextents,
+                              size_t& largest) const
+{
+    ScopedMutexLock sm(_dslock);
+
+    nextents = _freeExtents.size();
+    largest = _largestFreeChunk;
+}
+
 /* Persist free lists to disk
    @pre caller has locked the DataStore
  */
@@ -423,25 +515,11 @@ DataStore::initializeFreelist()
                                SCIDB_LE_SYSCALL_ERROR)
             << "fstat" << -1 << errno << ::strerror(errno) << _file->getPath();
     }
-    _allocatedSize = roundUpPowerOf2(st.st_size);
+    _allocatedSize = st.st_size;
 
-    /* If the file is empty, initialize with a single free
-       block of the minimum size.
+    /* An empty file has no free space: it grows on the first allocation.
     */
-    if (_allocatedSize < _dsm->getMinAllocSize())
-    {
-        _allocatedSize = _dsm->getMinAllocSize();
-        _allocatedSize = roundUpPowerOf2(_allocatedSize);
-        _freelists[_allocatedSize].insert(0);
-        if (_file->ftruncate(_allocatedSize) != 0)
-        {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE,
-                                   SCIDB_LE_SYSCALL_ERROR)
-                << "ftruncate" << -1 << errno << ::strerror(errno) 
-                << _file->getPath();
-        }
-    }
-    else
+    if (_allocatedSize > 0)
     {
         readFreelistFromFile();
     }
@@ -484,6 +562,7 @@ DataStore::readFreelistFromFile()
     off_t fileoff = 0;
     size_t nbuckets = 0;
     size_t current;
+    DataStoreFreelists freelists;
 
     flfile->readAll(&nbuckets, sizeof(size_t), fileoff);
     fileoff += sizeof(size_t);
@@ -498,17 +577,32 @@ DataStore::readFreelistFromFile()
             FreelistBucket flb(flfile, fileoff);
 
             fileoff += flb.size();
-            flb.unload(_freelists);
+            flb.unload(freelists);
         }
         catch (SystemException const& x)
         {
             LOG4CXX_ERROR(logger, "DataStore: failed to read freelist for " <<
                           _file->getPath() << ", error (" << x.getErrorMessage() << ")");
-            _freelists.clear();
             return 0;
         }
     }
 
+    /* Load the buckets through addToFreelist, which merges neighbouring
+       extents (the buddy allocator kept adjacent blocks of different sizes
+       apart)
+     */
+    for (DataStoreFreelists::iterator fl_it = freelists.begin();
+         fl_it != freelists.end();
+         ++fl_it)
+    {
+        for (set<off_t>::iterator bucket_it = fl_it->second.begin();
+             bucket_it != fl_it->second.end();
+             ++bucket_it)
+        {
+            addToFreelist(fl_it->first, *bucket_it);
+        }
+    }
+
     return nbuckets;
 }
 
@@ -571,29 +665,6 @@ DataStore::dumpFreelist()
     }
 }
 
-/* Check whether any parent blocks are on the freelist
-   pre: lock is held
- */
-bool
-DataStore::isParentBlockFree(off_t off, size_t size)
-{
-    DataStoreFreelists::iterator fl_it =
-        _freelists.upper_bound(size);
-
-    while (fl_it != _freelists.end())
-    {
-        const size_t bucketSize = fl_it->first;
-        const set<off_t>& bucket = fl_it->second;
-        const off_t parentOff = off - (off % bucketSize);
-        if (bucket.find(parentOff) != bucket.end())
-        {
-            return true;
-        }
-        ++fl_it;
-    }
-    return false;
-}
-
 /* Verify the integrity of the free list and throw exception
  * if there is a problem
  */
@@ -609,22 +680,43 @@ DataStore::verifyFreelist()
 void
 DataStore::verifyFreelistInternal()
 {
-    DataStoreFreelists::iterator fl_it = _freelists.begin();
+    DataStoreExtents::iterator it = _freeExtents.begin();
+    off_t prevEnd = -1;
+    size_t nFree = 0;
 
-    while (fl_it != _freelists.end())
+    /* Extents must lie inside the file, be separated by used space, and
+       appear in the size index
+     */
+    while (it != _freeExtents.end())
     {
-        set<off_t>::iterator bucket_it = fl_it->second.begin();
-        while (bucket_it != fl_it->second.end())
+        DataStoreFreelists::iterator fl_it = _freelists.find(it->second);
+        if (it->second == 0 ||
+            it->first <= prevEnd ||
+            it->first + it->second > _allocatedSize ||
+            fl_it == _freelists.end() ||
+            fl_it->second.find(it->first) == fl_it->second.end())
         {
-            if (isParentBlockFree(*bucket_it, fl_it->first))
-            {
-                throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE,
-                                       SCIDB_LE_DATASTORE_CORRUPT_FREELIST)
-                    << _file->getPath();
-            }
-            ++bucket_it;
+            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE,
+                                   SCIDB_LE_DATASTORE_CORRUPT_FREELIST)
+                << _file->getPath();
         }
-        ++fl_it;
+        prevEnd = it->first + it->second;
+        ++it;
+    }
+
+    /* ...and the size index must hold nothing else
+     */
+    for (DataStoreFreelists::iterator fl_it = _freelists.begin();
+         fl_it != _freelists.end();
+         ++fl_it)
+    {
+        nFree += fl_it->second.size();
+    }
+    if (nFree != _freeExtents.size())
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE,
+                               SCIDB_LE_DATASTORE_CORRUPT_FREELIST)
+            << _file->getPath();
     }
 }
 
@@ -655,7 +747,8 @@ DataStore::DataStore(char const* filename, Guid guid, DataStores& parent) :
     _frees(0),
     _largestFreeChunk(0),
     _dirty(false),
-    _fldirty(false)
+    _fldirty(false),
+    _punchHoles(true)
 {
     /* Open the file
      */
@@ -694,125 +787,155 @@ DataStore::roundUpPowerOf2(size_t size)
     return roundupSize;
 }
 
+/* Round up size_t value to the next allocation size class (static)
+ */
+size_t
+DataStore::roundUpSizeClass(size_t size)
+{
+    size_t rounded = (size + ALLOC_GRANULE - 1) & ~(ALLOC_GRANULE - 1);
+
+    if (rounded <= SIZE_CLASS_LINEAR_LIMIT)
+    {
+        return rounded;
+    }
+
+    /* Above the linear limit the classes between 2^k and 2^(k+1) are
+       2^k/SIZE_CLASSES_PER_DOUBLING apart
+     */
+    size_t step = (roundUpPowerOf2(rounded) / 2) / SIZE_CLASSES_PER_DOUBLING;
+    return (rounded + step - 1) / step * step;
+}
+
+/* Return the allocation size needed to hold a chunk of the requested size
+ */
+size_t
+DataStore::getRequiredSize(size_t requestedSize)
+{
+    size_t requiredSize = requestedSize + sizeof(DiskChunkHeader);
+    if (requiredSize < _dsm->getMinAllocSize())
+        requiredSize = _dsm->getMinAllocSize();
+    return roundUpSizeClass(requiredSize);
+}
+
 /* Allocate more space into the data store to handle the requested chunk
  */
 void
 DataStore::makeMoreSpace(size_t request)
 {
     SCIDB_ASSERT(request > _largestFreeChunk);
-    SCIDB_ASSERT(_allocatedSize >= _largestFreeChunk);
 
-    while (request > _largestFreeChunk)
+    /* Grow the file just enough to hold the request, reusing a free extent
+       at the end of the file if there is one
+     */
+    off_t start = _allocatedSize;
+
+    if (!_freeExtents.empty())
     {
-        _freelists[_allocatedSize].insert(_allocatedSize);
-        _largestFreeChunk = _allocatedSize;
-        _allocatedSize *= 2;
-        if (_file->ftruncate(_allocatedSize) != 0)
+        DataStoreExtents::iterator last = --_freeExtents.end();
+        if (last->first + last->second == _allocatedSize)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE,
-                                   SCIDB_LE_SYSCALL_ERROR)
-                << "ftruncate" << -1 << errno << ::strerror(errno) 
-                << _file->getPath();
+            start = last->first;
+            removeFreeExtent(last->first, last->second);
         }
     }
+
+    if (_file->ftruncate(start + request) != 0)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE,
+                               SCIDB_LE_SYSCALL_ERROR)
+            << "ftruncate" << -1 << errno << ::strerror(errno)
+            << _file->getPath();
+    }
+    _allocatedSize = start + request;
+    insertFreeExtent(start, request);
+    _largestFreeChunk = request;
 }
 
-/* Iterate the free lists and find a free chunk of the requested size
+/* Find the best fitting free extent for a chunk of the requested size
    @pre caller has locked the DataStore
  */
 off_t
 DataStore::searchFreelist(size_t request)
 {
-    off_t ret = 0;
-
     SCIDB_ASSERT(request <= _largestFreeChunk);
 
-    /* Base case:  the target bucket contains a free chunk
+    /* Smallest extent that fits; lowest offset among those of that size
      */
-    DataStoreFreelists::iterator it =
-        _freelists.find(request);
-    if (it != _freelists.end())
-    {
-        assert(it->second.size() > 0);
-        ret = *(it->second.begin());
-        it->second.erase(ret);
-        if (it->second.size() == 0)
-        {
-            _freelists.erase(it);
-        }
-    }
-    /* Recursive case:  we have to get a free chunk by breaking
-       up a larger free chunk
-     */
-    else
+    DataStoreFreelists::iterator it = _freelists.lower_bound(request);
+    SCIDB_ASSERT(it != _freelists.end() && !it->second.empty());
+
+    size_t extent = it->first;
+    off_t ret = *(it->second.begin());
+
+    removeFreeExtent(ret, extent);
+    if (extent > request)
     {
-        ret = searchFreelist(request * 2);
-        _freelists[request].insert(ret + request);
+        /* The remainder's neighbours are this chunk and the used space
+           that followed the extent, so it needs no merging
+         */
+        insertFreeExtent(ret + request, extent - request);
     }
 
     return ret;
 }
 
-/* Add block to free list and try to consolidate buddy blocks
+/* Add region to the free lists, merging it with any free extents it
+   overlaps or abuts
  */
 void
-DataStore::addToFreelist(size_t bucket, off_t off)
+DataStore::addToFreelist(size_t size, off_t off)
 {
-    SCIDB_ASSERT(roundUpPowerOf2(bucket) == bucket);
-    SCIDB_ASSERT(off % bucket == 0);
+    off_t start = off;
+    off_t end = off + size;
 
-    /* First check if a parent block is already on the freelist
-       (possibly in crash recovery case).  If so, we don't
-       need to do anything.
-    */
-    if (isParentBlockFree(off, bucket))
+    /* Space beyond the end of the file has already been given back
+       (possibly in crash recovery case)
+     */
+    if (end > static_cast<off_t>(_allocatedSize))
+    {
+        end = _allocatedSize;
+    }
+    if (start >= end)
     {
         return;
     }
 
-    /* Calc the buddy block
+    /* Find the first free extent that overlaps or abuts the region
      */
-    size_t parent = bucket * 2;
-    off_t buddy;
-
-    if (off % parent == 0)
+    DataStoreExtents::iterator it = _freeExtents.upper_bound(start);
+    if (it != _freeExtents.begin())
     {
-        buddy = off + bucket;
+        DataStoreExtents::iterator prev = it;
+        --prev;
+        if (prev->first + static_cast<off_t>(prev->second) >= start)
+        {
+            it = prev;
+        }
     }
-    else
+
+    /* If an extent already covers the region there is nothing to do
+       (possibly in crash recovery case)
+     */
+    if (it != _freeExtents.end() &&
+        it->first <= start &&
+        it->first + static_cast<off_t>(it->second) >= end)
     {
-        buddy = off - bucket;
+        return;
     }
 
-    /* Check if the buddy is free
+    /* Absorb every free extent the region overlaps or abuts
      */
-    DataStoreFreelists::iterator it =
-        _freelists.find(bucket);
-    if (it != _freelists.end())
+    while (it != _freeExtents.end() && it->first <= end)
     {
-        std::set<off_t>::iterator bucket_it;
-
-        bucket_it = (it->second).find(buddy);
-        if (bucket_it != (it->second).end())
-        {
-            /* Merge with the buddy
-             */
-            off_t merged = (off < buddy) ? off : buddy;
+        off_t extOff = it->first;
+        size_t extSize = it->second;
 
-            (it->second).erase(bucket_it);
-            if ((it->second).size() == 0)
-            {
-                _freelists.erase(it);
-            }
-            addToFreelist(parent, merged);
-            return;
-        }
+        ++it;
+        start = std::min(start, extOff);
+        end = std::max(end, static_cast<off_t>(extOff + extSize));
+        removeFreeExtent(extOff, extSize);
     }
-
-    /* Buddy is not free, just insert into
-       free list
-     */
-    _freelists[bucket].insert(off);
+    insertFreeExtent(start, end - start);
 
     /* Occaisionally we should check the integrity of
        the freelist (only in DEBUG)
@@ -826,6 +949,93 @@ DataStore::addToFreelist(size_t bucket, off_t off)
     }
 }
 
+/* Insert a free extent in both the size and offset indexes
+ */
+void
+DataStore::insertFreeExtent(off_t off, size_t size)
+{
+    SCIDB_ASSERT(size > 0);
+    _freelists[size].insert(off);
+    _freeExtents[off] = size;
+}
+
+/* Remove a free extent from both the size and offset indexes
+ */
+void
+DataStore::removeFreeExtent(off_t off, size_t size)
+{
+    DataStoreFreelists::iterator it = _freelists.find(size);
+    SCIDB_ASSERT(it != _freelists.end());
+
+    it->second.erase(off);
+    if (it->second.empty())
+    {
+        _freelists.erase(it);
+    }
+    _freeExtents.erase(off);
+}
+
+/* Truncate the file if it ends in a free extent
+ */
+void
+DataStore::releaseTail()
+{
+    if (_freeExtents.empty())
+    {
+        return;
+    }
+
+    DataStoreExtents::iterator last = --_freeExtents.end();
+    if (last->first + last->second != _allocatedSize)
+    {
+        return;
+    }
+
+    off_t newSize = last->first;
+    if (_file->ftruncate(newSize) != 0)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE,
+                               SCIDB_LE_SYSCALL_ERROR)
+            << "ftruncate" << -1 << errno << ::strerror(errno)
+            << _file->getPath();
+    }
+    LOG4CXX_TRACE(logger, "datastore: released " << (_allocatedSize - newSize)
+                  << " bytes at the end of " << _file->getPath());
+
+    removeFreeExtent(last->first, last->second);
+    _allocatedSize = newSize;
+}
+
+/* Return the aligned interior of a freed region to the file system.  This
+   is an optimization only, so failures are logged and otherwise ignored.
+ */
+void
+DataStore::punchHole(off_t off, size_t size)
+{
+    off_t start = (off + ALLOC_GRANULE - 1) & ~(off_t)(ALLOC_GRANULE - 1);
+    off_t end = (off + size) & ~(off_t)(ALLOC_GRANULE - 1);
+
+    if (!_punchHoles || end - start < static_cast<off_t>(PUNCH_HOLE_MIN_SIZE))
+    {
+        return;
+    }
+
+    if (_file->punchHole(start, end - start) != 0)
+    {
+        if (errno == EOPNOTSUPP || errno == ENOSYS)
+        {
+            LOG4CXX_DEBUG(logger, "datastore: file system does not support punching holes in "
+                          << _file->getPath());
+            _punchHoles = false;
+        }
+        else
+        {
+            LOG4CXX_WARN(logger, "datastore: failed to punch hole at " << start
+                         << " in " << _file->getPath() << ", error " << ::strerror(errno));
+        }
+    }
+}
+
 /* Update the largest free chunk member
  */
 void
@@ -961,10 +1171,11 @@ DataStores::closeDataStore(DataStore::Guid guid, bool remove)
     _theDataStores->erase(it);
 }
 
-/* Flush all DataStore objects
+/* Flush all DataStore objects, and optionally give the space they
+   have freed back to the file system
  */
 void
-DataStores::flushAllDataStores()
+DataStores::flushAllDataStores(bool releaseFreedSpace)
 {
     DataStoreMap::iterator it;
     std::shared_ptr<DataStore> current;
@@ -987,6 +1198,10 @@ DataStores::flushAllDataStores()
         }
 
         current->flush();
+        if (releaseFreedSpace)
+        {
+            current->releaseFreedSpace();
+        }
         current.reset();
     }
 }
@@ -23,6 +23,7 @@
 
 #include <inttypes.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -657,6 +658,36 @@ namespace scidb
         return rc;
     }
 
+    /* Deallocate a range of the file (restarting after signal interrupt if necessary)
+     */
+    int
+    File::punchHole(off_t offs, off_t len)
+    {
+        /* Verify that the fd is open
+         */
+        checkClosedByUser();
+        FileMonitor fm(_fm, *this);
+
+        assert(_fd >= 0);
+        assert(_pin);
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+        /* Try to punch the hole
+         */
+        ScopedWaitTimer timer(PTCW_FS_WR); // after FileMonitor
+        int rc = 0;
+
+        do
+        {
+            rc = ::fallocate(_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, offs, len);
+        } while (rc != 0 && errno == EINTR);
+        return rc;
+#else
+        errno = EOPNOTSUPP;
+        return -1;
+#endif
+    }
+
 
     /* Set an advisory lock on the file (restarting after signal intr)
      */
@@ -31,59 +31,179 @@
 #include "util/JobQueue.h"
 #include "util/Mutex.h"
 #include <log4cxx/logger.h>
+#include <sched.h>
 
 namespace scidb
 {
 
 static log4cxx::LoggerPtr logger(log4cxx::Logger::getLogger("scidb.common.thread"));
 
+namespace
+{
+    /// The queue the current thread is a worker of, and its worker slot
+    thread_local JobQueue const* t_workerQueue = NULL;
+    thread_local size_t t_workerIndex = 0;
+}
+
 JobQueue::JobQueue()
+: _nWorkers(0),
+  _sharedSize(0),
+  _size(0)
+{
+
+}
+
+void JobQueue::registerWorker()
 {
+    ScopedMutexLock scopedMutexLock(_registerMutex);
+    size_t const n = _nWorkers;
+    if (n >= MAX_WORKERS) {
+        LOG4CXX_DEBUG(logger, "JobQueue::registerWorker: Q ("<<this<<") has too many workers, "
+                      "the new one uses the shared lanes only");
+        return;
+    }
+    _workers[n].reset(new Worker());
+    _nWorkers = n + 1;
+    t_workerQueue = this;
+    t_workerIndex = n;
+}
 
+JobQueue::Worker* JobQueue::getLocalWorker() const
+{
+    return (t_workerQueue == this && t_workerIndex < _nWorkers) ? _workers[t_workerIndex].get() : NULL;
 }
 
 // Add new job to the end of queue
 void JobQueue::pushJob(std::shared_ptr<Job> job)
 {
-    { // scope
+    // Count the job before it becomes visible, so that popJob() can never
+    // see the counter go below zero.
+    ++_size;
+    Worker* self = getLocalWorker();
+    if (self) {
+        ScopedMutexLock scopedMutexLock(self->mutex);
+        self->jobs.push_back(std::move(job));
+        ++self->size;
+    } else {
         ScopedMutexLock scopedMutexLock(_queueMutex);
-        _queue.push_back(job);
-        LOG4CXX_TRACE(logger, "JobQueue::pushJob: Q ("<<this<<") size = "<<getSize());
+        _queue.push_back(std::move(job));
+        ++_sharedSize;
     }
+    LOG4CXX_TRACE(logger, "JobQueue::pushJob: Q ("<<this<<") size = "<<getSize());
     // We are releasing semaphore after unlocking mutex to
-    // prevent unwanted _queueMutex sleeping in popJob.
+    // prevent unwanted mutex sleeping in popJob.
     _queueSemaphore.release();
 }
 
-// Add new job to the end of queue
+// Add new job to the beginning of queue
 void JobQueue::pushHighPriorityJob(std::shared_ptr<Job> job)
 {
+    ++_size;
     { // scope
         ScopedMutexLock scopedMutexLock(_queueMutex);
-        _queue.push_front(job);
-        LOG4CXX_TRACE(logger, "JobQueue::pushHighPriorityJob: Q ("<<this<<") size = "<<getSize());
+        _highPriorityQueue.push_front(std::move(job));
+        ++_sharedSize;
     }
+    LOG4CXX_TRACE(logger, "JobQueue::pushHighPriorityJob: Q ("<<this<<") size = "<<getSize());
     // We are releasing semaphore after unlocking mutex to
-    // prevent unwanted _queueMutex sleeping in popJob.
+    // prevent unwanted mutex sleeping in popJob.
     _queueSemaphore.release();
 }
 
+bool JobQueue::popShared(std::shared_ptr<Job>& job, bool highPriorityOnly)
+{
+    if (_sharedSize == 0) {
+        return false;
+    }
+    ScopedMutexLock scopedMutexLock(_queueMutex);
+    std::deque< std::shared_ptr<Job> >* lane = &_highPriorityQueue;
+    if (lane->empty()) {
+        if (highPriorityOnly || _queue.empty()) {
+            return false;
+        }
+        lane = &_queue;
+    }
+    job = std::move(lane->front());
+    lane->pop_front();
+    --_sharedSize;
+    return true;
+}
+
+bool JobQueue::popLocal(Worker& worker, std::shared_ptr<Job>& job)
+{
+    if (worker.size == 0) {
+        return false;
+    }
+    ScopedMutexLock scopedMutexLock(worker.mutex);
+    if (worker.jobs.empty()) {
+        return false;
+    }
+    job = std::move(worker.jobs.front());
+    worker.jobs.pop_front();
+    --worker.size;
+    return true;
+}
+
+bool JobQueue::steal(Worker* self, std::shared_ptr<Job>& job)
+{
+    size_t const n = _nWorkers;
+    size_t const start = self ? t_workerIndex + 1 : 0;
+    for (size_t i = 0; i < n; ++i) {
+        Worker* victim = _workers[(start + i) % n].get();
+        if (victim != self && popLocal(*victim, job)) {
+            if (self) {
+                ++self->stolen;
+            }
+            return true;
+        }
+    }
+    return false;
+}
 
 // Get next job from the beginning of the queue
 // If there is next element the method waits
 std::shared_ptr<Job> JobQueue::popJob()
 {
-    _queueSemaphore.enter();
-    { // scope
-        ScopedMutexLock scopedMutexLock(_queueMutex);
-        assert(!_queue.empty());
+    Worker* self = getLocalWorker();
+    if (!_queueSemaphore.tryEnter()) {
+        if (self) {
+            ++self->idle;
+        }
+        _queueSemaphore.enter();
+    }
 
-        std::shared_ptr<Job> job = _queue.front();
-        _queue.pop_front();
-        LOG4CXX_TRACE(logger, "JobQueue::popJob: Q ("<<this<<") size = "<<getSize());
-        return job;
+    // The semaphore guarantees that a job is queued for us somewhere,
+    // but it may still be on its way into one of the deques.
+    bool const sharedFirst = !self || (self->popped % SHARED_LANE_INTERVAL == 0);
+    std::shared_ptr<Job> job;
+    while (true)
+    {
+        if (popShared(job, !sharedFirst) ||
+            (self && popLocal(*self, job)) ||
+            popShared(job, false) ||
+            steal(self, job)) {
+            break;
+        }
+        sched_yield();
     }
+    if (self) {
+        ++self->popped;
+    }
+    --_size;
+    LOG4CXX_TRACE(logger, "JobQueue::popJob: Q ("<<this<<") size = "<<getSize());
+    return job;
 }
 
+void JobQueue::getWorkerStats(std::vector<WorkerStats>& stats) const
+{
+    size_t const n = _nWorkers;
+    stats.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+        Worker const& w = *_workers[i];
+        stats[i].popped = w.popped;
+        stats[i].stolen = w.stolen;
+        stats[i].idle = w.idle;
+    }
+}
 
 } // namespace
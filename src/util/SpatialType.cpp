@@ -29,6 +29,9 @@
 
 #include <util/SpatialType.h>
 
+#include <algorithm>
+#include <cmath>
+
 namespace scidb
 {
 DominanceRelationship calculateDominance(Coordinates const& left, Coordinates const& right)
@@ -59,6 +62,208 @@ bool isDominatedBy(Coordinates const& left, Coordinates const& right)
     return dr==EQUALS || dr==IS_STRICTLY_DOMINATED_BY;
 }
 
+namespace
+{
+/**
+ * @return whether the box [low, high] intersects (or, if 'containing', contains) the box [qLow, qHigh].
+ */
+inline bool boxMatches(Coordinate const* low, Coordinate const* high,
+                       Coordinate const* qLow, Coordinate const* qHigh,
+                       size_t numDims, bool containing)
+{
+    for (size_t i=0; i<numDims; ++i) {
+        if (containing ? (low[i] > qLow[i] || qHigh[i] > high[i])
+                       : (low[i] > qHigh[i] || qLow[i] > high[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Orders ranges by their centers in one dimension.
+ */
+struct CenterLess
+{
+    size_t _dim;
+
+    CenterLess(size_t dim) : _dim(dim) {}
+
+    bool operator()(SpatialRange const& a, SpatialRange const& b) const
+    {
+        // Compare the doubled centers; coordinates are well within the int64 range.
+        return a._low[_dim] + a._high[_dim] < b._low[_dim] + b._high[_dim];
+    }
+};
+
+/**
+ * Stops at the first range found, and records its index.
+ */
+struct FindFirst
+{
+    size_t _found;
+
+    FindFirst() : _found(0) {}
+
+    bool operator()(size_t i)
+    {
+        _found = i;
+        return true;
+    }
+};
+
+/**
+ * Copies every range found.
+ */
+struct CopyAll
+{
+    std::vector<SpatialRange> const& _ranges;
+    std::vector<SpatialRange>& _result;
+
+    CopyAll(std::vector<SpatialRange> const& ranges, std::vector<SpatialRange>& result)
+    : _ranges(ranges), _result(result)
+    {}
+
+    bool operator()(size_t i)
+    {
+        _result.push_back(_ranges[i]);
+        return false;
+    }
+};
+}
+
+template<class Visitor>
+bool SpatialRanges::search(Coordinate const* low, Coordinate const* high, bool containing, Visitor& visit) const
+{
+    assert(isIndexed());
+
+    // Every level of the descent stacks at most NODE_SIZE nodes.
+    size_t stack[NODE_SIZE * MAX_DEPTH];
+    size_t top = 0;
+    stack[top++] = _nodeChildren.size() - 1;
+
+    while (top > 0) {
+        size_t const node = stack[--top];
+        Coordinate const* bounds = &_nodeBounds[node * _numDims * 2];
+        if (!boxMatches(bounds, bounds + _numDims, low, high, _numDims, containing)) {
+            continue;
+        }
+        std::pair<size_t, size_t> const& children = _nodeChildren[node];
+        if (node < _numLeafNodes) {
+            for (size_t i=children.first; i<children.second; ++i) {
+                SpatialRange const& range = _ranges[i];
+                if (boxMatches(&range._low[0], &range._high[0], low, high, _numDims, containing) && visit(i)) {
+                    return true;
+                }
+            }
+        }
+        else {
+            // Push in reverse, so that the children are visited in order.
+            for (size_t i=children.second; i>children.first; --i) {
+                assert(top < NODE_SIZE * MAX_DEPTH);
+                stack[top++] = i - 1;
+            }
+        }
+    }
+    return false;
+}
+
+void SpatialRanges::sortTiles(size_t begin, size_t end, size_t dim)
+{
+    std::sort(_ranges.begin() + begin, _ranges.begin() + end, CenterLess(dim));
+    if (dim + 1 == _numDims) {
+        return;
+    }
+
+    // Cut the ranges into as many slabs as a side of a (_numDims - dim)-dimensional grid of the leaf
+    // nodes they fill, each slab holding a whole number of leaf nodes.
+    size_t const numLeaves = (end - begin + NODE_SIZE - 1) / NODE_SIZE;
+    size_t const numSlabs = static_cast<size_t>(
+        std::ceil(std::pow(static_cast<double>(numLeaves), 1.0 / static_cast<double>(_numDims - dim))));
+    size_t const slabSize = NODE_SIZE * ((numLeaves + numSlabs - 1) / numSlabs);
+    for (size_t i=begin; i<end; i+=slabSize) {
+        sortTiles(i, std::min(i + slabSize, end), dim + 1);
+    }
+}
+
+void SpatialRanges::addNode(size_t begin, size_t end, bool isLeaf)
+{
+    assert(begin < end);
+    size_t const offset = _nodeBounds.size();
+    _nodeBounds.resize(offset + _numDims * 2);
+    Coordinate* low = &_nodeBounds[offset];
+    Coordinate* high = low + _numDims;
+
+    for (size_t i=begin; i<end; ++i) {
+        Coordinate const* childLow;
+        Coordinate const* childHigh;
+        if (isLeaf) {
+            childLow = &_ranges[i]._low[0];
+            childHigh = &_ranges[i]._high[0];
+        }
+        else {
+            childLow = &_nodeBounds[i * _numDims * 2];
+            childHigh = childLow + _numDims;
+        }
+        for (size_t d=0; d<_numDims; ++d) {
+            if (i == begin || childLow[d] < low[d]) {
+                low[d] = childLow[d];
+            }
+            if (i == begin || childHigh[d] > high[d]) {
+                high[d] = childHigh[d];
+            }
+        }
+    }
+    _nodeChildren.push_back(std::make_pair(begin, end));
+}
+
+void SpatialRanges::buildIndex()
+{
+    _indexedSize = 0;
+    _numLeafNodes = 0;
+    _nodeBounds.clear();
+    _nodeChildren.clear();
+
+    // A single leaf is no faster to search than the ranges themselves.
+    size_t const numRanges = _ranges.size();
+    if (numRanges <= NODE_SIZE || _numDims == 0) {
+        return;
+    }
+
+    sortTiles(0, numRanges, 0);
+    for (size_t i=0; i<numRanges; i+=NODE_SIZE) {
+        addNode(i, std::min(i + NODE_SIZE, numRanges), true);
+    }
+    _numLeafNodes = _nodeChildren.size();
+
+    // Pack every level into the one above it, until a single root is left.
+    size_t levelBegin = 0;
+    size_t levelEnd = _numLeafNodes;
+    while (levelEnd - levelBegin > 1) {
+        for (size_t i=levelBegin; i<levelEnd; i+=NODE_SIZE) {
+            addNode(i, std::min(i + NODE_SIZE, levelEnd), false);
+        }
+        levelBegin = levelEnd;
+        levelEnd = _nodeChildren.size();
+    }
+    _indexedSize = numRanges;
+}
+
+void SpatialRanges::findAllThatIntersect(SpatialRange const& queryRange, SpatialRanges& result) const
+{
+    assert(queryRange._low.size() == _numDims && result._numDims == _numDims);
+    if (isIndexed()) {
+        CopyAll copy(_ranges, result._ranges);
+        search(&queryRange._low[0], &queryRange._high[0], false, copy);
+        return;
+    }
+    for (size_t i=0, n=_ranges.size(); i<n; ++i) {
+        if (_ranges[i].intersects(queryRange)) {
+            result._ranges.push_back(_ranges[i]);
+        }
+    }
+}
+
 bool SpatialRanges::findOneThatIntersects(SpatialRange const& queryRange, size_t& hint) const
 {
     if (hint>0 && hint<_ranges.size()) {
@@ -66,6 +271,15 @@ bool SpatialRanges::findOneThatIntersects(SpatialRange const& queryRange, size_t
             return true;
         }
     }
+    if (isIndexed()) {
+        FindFirst first;
+        if (search(&queryRange._low[0], &queryRange._high[0], false, first)) {
+            hint = first._found;
+            return true;
+        }
+        hint = -1;
+        return false;
+    }
     for (size_t i=0, n=_ranges.size(); i<n; ++i) {
         if (_ranges[i].intersects(queryRange)) {
             hint = i;
@@ -83,6 +297,15 @@ bool SpatialRanges::findOneThatContains(Coordinates const& queryPoint, size_t& h
             return true;
         }
     }
+    if (isIndexed()) {
+        FindFirst first;
+        if (search(&queryPoint[0], &queryPoint[0], true, first)) {
+            hint = first._found;
+            return true;
+        }
+        hint = -1;
+        return false;
+    }
     for (size_t i=0, n=_ranges.size(); i<n; ++i) {
         if (_ranges[i].contains(queryPoint)) {
             hint = i;
@@ -100,6 +323,15 @@ bool SpatialRanges::findOneThatContains(SpatialRange const& queryRange, size_t&
             return true;
         }
     }
+    if (isIndexed()) {
+        FindFirst first;
+        if (search(&queryRange._low[0], &queryRange._high[0], true, first)) {
+            hint = first._found;
+            return true;
+        }
+        hint = -1;
+        return false;
+    }
     for (size_t i=0, n=_ranges.size(); i<n; ++i) {
         if (_ranges[i].contains(queryRange)) {
             hint = i;
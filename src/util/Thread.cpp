@@ -131,6 +131,7 @@ void Thread::_threadFunction()
     LOG4CXX_TRACE(logger, "Thread::threadFunction: begin tid = "
                   << pthread_self()
                   << ", pool = " << tp);
+    _threadPool.getQueue()->registerWorker();
     while (true)
     {
         try
@@ -52,25 +52,51 @@ public:
     {
     }
 
+    /* Offset and allocated size of a block in the datastore
+     */
+    typedef pair<off_t, size_t> Block;
+
+    /* Throw a unit test failure with the given message
+     */
+    static void fail(string const& msg)
+    {
+        throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
+            << "UnitTestDataStorePhysical" << msg;
+    }
+
+    /* Check that an allocation for a request of the given size is 4 KiB
+       aligned and padded by no more than its size class allows
+     */
+    static void checkAllocation(std::shared_ptr<DataStore> ds, size_t size, size_t alloc)
+    {
+        size_t needed = size + ds->getOverhead();
+
+        if (alloc < needed || alloc % (4 * KiB) != 0 ||
+            alloc - needed >= max(4 * KiB, alloc / 8))
+        {
+            stringstream failstring;
+            failstring << "unexpected allocation " << alloc << " for " << size << " bytes";
+            fail(failstring.str());
+        }
+    }
+
     /* Allocate power-of-two sized blocks in the datastore from size 2^baselow
        up to 2^basehigh, and record the offsets in the blockmap
      */
     void allocatePowerOfTwos(uint32_t baselow,
                              uint32_t basehigh,
                              std::shared_ptr<DataStore> ds,
-                             map<size_t, off_t>& blockmap)
+                             map<size_t, Block>& blockmap)
     {
         /* Verify params
          */
         if (basehigh < baselow)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << "invalid argument to allocate";
+            fail("invalid argument to allocate");
         }
         if (!ds)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << "invalid datastore";
+            fail("invalid datastore");
         }
 
         /* do the allocations
@@ -79,13 +105,10 @@ public:
         for(uint32_t i = baselow; i < basehigh; ++i, size <<= 1)
         {
             size_t alloc = 0;
+            off_t off = ds->allocateSpace(size, alloc);
 
-            blockmap[size] = ds->allocateSpace(size, alloc);
-            if (alloc != size*2)
-            {
-                throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                    << "UnitTestDataStorePhysical" << "unexpected allocation";
-            }
+            checkAllocation(ds, size, alloc);
+            blockmap[size] = Block(off, alloc);
         }
     }
 
@@ -97,8 +120,9 @@ public:
 
            1) create a datastore for a dummy guid (-1)
            2) allocate a series of blocks, check the size of the store
-           3) free all the blocks
-           4) check the size of the store and the free bytes
+           3) free all the blocks, check that the file keeps its size until the
+              freed space is released
+           4) check that the whole store was given back to the file system
            5) close the store
            6) re-open the store
            7) allocate the same series of blocks, ensure the size of the store is unchanged
@@ -106,8 +130,10 @@ public:
            9) read back data from each block, verify
            10) remove the store
            11) re-create the store
-           12) test allocation/ freeing of blocks with block-splitting (bug 4389)
-           13) remove the store
+           12) test freeing of blocks that are already (partly) free (bug 4389)
+           13) test free extent merging, relocation below an offset, tail release
+               and the padding of large allocations
+           14) remove the store
          */
 
         /* 1)
@@ -118,13 +144,12 @@ public:
 
         if (!ds)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << "failed to open data store";
+            fail("failed to open data store");
         }
 
         /* 2)
          */
-        map<size_t, off_t> blockmap;
+        map<size_t, Block> blockmap;
         off_t    size = 0;
         blkcnt_t blocks = 0;
         off_t    freebytes = 0;
@@ -134,12 +159,24 @@ public:
 
         /* 3)
          */
-        map<size_t, off_t>::iterator it;
+        map<size_t, Block>::iterator it;
 
         for (it = blockmap.begin(); it != blockmap.end(); ++it)
         {
-            ds->freeChunk(it->second, it->first*2);
+            ds->freeChunk(it->second.first, it->second.second);
         }
+        ds->verifyFreelist();
+
+        off_t    sizeFreed = 0;
+        blkcnt_t blocksFreed = 0;
+        off_t    freebytesFreed = 0;
+
+        ds->getSizes(sizeFreed, blocksFreed, freebytesFreed);
+        if (sizeFreed != size)
+        {
+            fail("store released before releaseFreedSpace");
+        }
+        ds->releaseFreedSpace();
 
         /* 4)
          */
@@ -148,13 +185,11 @@ public:
         off_t    freebytes1 = 0;
 
         ds->getSizes(size1, blocks1, freebytes1);
-        if (size1 != size || blocks1 != blocks ||
-            freebytes1 != size1)
+        if (size1 != 0 || freebytes1 != 0)
         {
             stringstream failstring;
-            failstring << "incorrect number of free bytes reported: " << freebytes1;
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << failstring.str();
+            failstring << "store not released: size " << size1 << ", free bytes " << freebytes1;
+            fail(failstring.str());
         }
 
 
@@ -169,8 +204,7 @@ public:
 
         if (!ds)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << "failed to open data store 2";
+            fail("failed to open data store 2");
         }
 
         /* 7)
@@ -183,8 +217,7 @@ public:
         ds->getSizes(size2, blocks2, freebytes2);
         if (size2 != size || blocks2 != blocks || freebytes2 != freebytes)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << "unexpected change in store size";
+            fail("unexpected change in store size");
         }
 
         /* 8)
@@ -199,7 +232,7 @@ public:
             {
                 *p = safe_static_cast<uint32_t>(it->first);
             }
-            ds->writeData(it->second, buf, it->first, it->first*2);
+            ds->writeData(it->second.first, buf, it->first, it->second.second);
             delete [] buf;
         }
 
@@ -209,15 +242,14 @@ public:
         {
             char* buf = new char[it->first];
 
-            ds->readData(it->second, buf, it->first);
+            ds->readData(it->second.first, buf, it->first);
             for (uint32_t* p = reinterpret_cast<uint32_t*>(buf);
                  p < reinterpret_cast<uint32_t*>(buf + it->first);
                  ++p)
             {
                 if (*p != it->first)
                 {
-                    throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                        << "UnitTestDataStorePhysical" << "mismatch in data read from store";
+                    fail("mismatch in data read from store");
                 }
             }
             delete [] buf;
@@ -234,30 +266,67 @@ public:
                 static_cast<DataStore::Guid>(-1));
         if (!ds)
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << "failed to open data store2";
+            fail("failed to open data store2");
         }
 
         /* 12) Special test for bug 4389.  Make sure freeing a block that is
            already in the freelist works.  Even if the block in the freelist
-           has a different size or offset (it is a parent of the block to be
-           freed)
+           has a different size or offset (it covers the block to be freed).
+           A second block keeps the first one away from the end of the file.
          */
         size_t my_alloc = 0;
+        size_t guard_alloc = 0;
         off_t my_off = 0;
 
         my_off = ds->allocateSpace(8 * KiB, my_alloc);
-        if (my_alloc != 16 * KiB)
+        checkAllocation(ds, 8 * KiB, my_alloc);
+        ds->allocateSpace(8 * KiB, guard_alloc);
+        ds->freeChunk(my_off, my_alloc);
+        ds->freeChunk(my_off, 8 * KiB);
+        ds->freeChunk(my_off + 4 * KiB, 4 * KiB);
+        ds->verifyFreelist();
+
+        /* 13) The freed block above is the only free extent.  Allocating
+           below the guard block must reuse it, and freeing the guard block
+           then must give back the whole file.
+         */
+        size_t   nextents = 0;
+        size_t   largest = 0;
+        off_t    size3 = 0;
+        blkcnt_t blocks3 = 0;
+        off_t    freebytes3 = 0;
+
+        ds->getFreeExtentStats(nextents, largest);
+        ds->getSizes(size3, blocks3, freebytes3);
+        if (nextents != 1 || largest != my_alloc ||
+            freebytes3 != static_cast<off_t>(my_alloc) ||
+            size3 != static_cast<off_t>(my_alloc + guard_alloc))
         {
-            throw SYSTEM_EXCEPTION(SCIDB_SE_INTERNAL, SCIDB_LE_UNITTEST_FAILED)
-                << "UnitTestDataStorePhysical" << "unexpected allocation";
+            fail("unexpected free extents after free");
         }
-        ds->freeChunk(my_off, 16 * KiB);
-        ds->freeChunk(my_off, 8 * KiB);
-        ds->freeChunk(my_off + 8 * KiB, 4 * KiB);
+
+        size_t moved_alloc = 0;
+        off_t moved_off = ds->allocateSpaceBelow(4 * KiB, my_off + my_alloc, moved_alloc);
+        if (moved_off != my_off || ds->allocateSpaceBelow(4 * KiB, my_off, moved_alloc) != -1)
+        {
+            fail("unexpected relocation");
+        }
+        ds->freeChunk(my_off + my_alloc, guard_alloc);
+        ds->freeChunk(moved_off, moved_alloc);
+        ds->releaseFreedSpace();
+        ds->getSizes(size3, blocks3, freebytes3);
+        if (size3 != 0 || freebytes3 != 0)
+        {
+            fail("tail not released");
+        }
+
+        size_t big_alloc = 0;
+        off_t big_off = ds->allocateSpace(MiB + 1, big_alloc);
+        checkAllocation(ds, MiB + 1, big_alloc);
+        ds->freeChunk(big_off, big_alloc);
         ds->verifyFreelist();
 
-        /* 13)
+        /* 14)
          */
         StorageManager::getInstance().getDataStores().closeDataStore(
             static_cast<DataStore::Guid>(-1), true);
@@ -73,6 +73,26 @@ void LimitedArena::reset()
     assert(consistent());                                // Check consistency
 }
 
+/**
+ *  Change the limit to 'limit' bytes. The limit is never set below the memory
+ *  we have already handed out, however: the next allocation fails instead.
+ */
+void LimitedArena::setLimit(size_t const limit)
+{
+    _limit = std::max(limit,_peakusage);                 // Not below the peak
+
+    if (_limit < unlimited)                              // Enforcing a limit?
+    {
+        _available = _limit - _allocated;                // ...what remains
+    }
+    else                                                 // No limit at all
+    {
+        _available = unlimited;                          // ...no accounting
+    }
+
+    assert(consistent());                                // Check consistency
+}
+
 /**
  *  Allocate 'size' bytes of raw memory from our parent %arena, first checking
  *  to see if this would exceed our own internal limit, in which case we throw
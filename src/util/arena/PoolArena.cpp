@@ -0,0 +1,472 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/****************************************************************************/
+
+#include <string.h>                                      // For memcpy
+#include <vector>                                        // For vector
+#include <util/arena/PoolArena.h>                        // For PoolArena
+#include <util/arena/Malloc.h>                           // For realloc
+#include <util/Mutex.h>                                  // For Mutex
+#include "ArenaDetails.h"                                // For implementation
+
+/****************************************************************************/
+namespace scidb { namespace arena { namespace {
+/****************************************************************************/
+
+const size_t nStripes  = 16;                             // Stripes per pool
+const size_t minBlock  = 32;                             // The smallest class
+const size_t minBits   = 5;                              // Its base 2 log
+const std::memory_order relaxed = std::memory_order_relaxed;
+
+std::atomic<size_t>        nextStripe(0);                // Next one to assign
+thread_local size_t const  threadStripe = nextStripe++ % nStripes;
+
+/**
+ *  Raise 'peak' to at least 'value', without taking a lock.
+ */
+void ensureMax(std::atomic<size_t>& peak,size_t value)
+{
+    size_t sample = peak.load();                         // The current peak
+
+    while (value > sample && !peak.compare_exchange_weak(sample,value))
+    {}                                                   // Retry on collision
+}
+
+/****************************************************************************/
+}
+/****************************************************************************/
+
+/**
+ *  The free lists of one stripe, one per size class, each linked through the
+ *  first word of the blocks it holds, and the counters of the threads using
+ *  the stripe.
+ *
+ *  A block is often freed by a thread other than the one that allocated it,
+ *  so the 'allocated' and 'allocations' of a stripe may wrap around below 0:
+ *  only their sum over all of the stripes is meaningful.
+ */
+struct PoolArena::Stripe
+{
+            Mutex             mutex;                     // Guards the lists
+            std::vector<void*>lists;                     // Heads, by class
+       std::atomic<size_t>    cached;                    // Bytes on the lists
+       std::atomic<size_t>    allocated;                 // Bytes allocated
+       std::atomic<size_t>    allocations;               // Live allocations
+       std::atomic<size_t>    hits;                      // Taken from lists
+       std::atomic<size_t>    misses;                    // Taken from parent
+       std::atomic<size_t>    released;                  // Freed over limit
+};
+
+/**
+ *  Construct a pool of blocks of at most o.pagesize() bytes, that holds on to
+ *  at most 'cacheLimit' bytes of them while they are not in use, and gets its
+ *  blocks from the parent %arena o.parent().
+ */
+    PoolArena::PoolArena(const Options& o,size_t cacheLimit)
+             : _name       (o.name()),
+               _parent     (o.parent()),
+               _maxBlock   (sizeOf(classOf(std::max(o.pagesize(),minBlock)))),
+               _nClasses   (classOf(_maxBlock) + 1),
+               _stripes    (new Stripe[nStripes]),
+               _counts     (new std::atomic<size_t>[_nClasses]),
+               _cacheLimit (cacheLimit),
+               _peakusage  (0)
+{
+    for (size_t i=0; i!=nStripes; ++i)                   // For each stripe
+    {
+        Stripe& s(_stripes[i]);
+        s.lists.assign(_nClasses,0);                     // ...lists are empty
+        s.cached.store(0);                               // ...and so are the
+        s.allocated.store(0);                            // ...counters
+        s.allocations.store(0);
+        s.hits.store(0);
+        s.misses.store(0);
+        s.released.store(0);
+    }
+
+    for (size_t c=0; c!=_nClasses; ++c)                  // For each class
+    {
+        _counts[c].store(0);                             // ...nothing cached
+    }
+
+    assert(consistent());                                // Check consistency
+}
+
+/**
+ *  Release the blocks we are holding on to back to the parent %arena.
+ */
+    PoolArena::~PoolArena()
+{
+    trim(0);                                             // Release them all
+}
+
+size_t PoolArena::allocated()   const {return sum(&Stripe::allocated);}
+size_t PoolArena::allocations() const {return sum(&Stripe::allocations);}
+size_t PoolArena::cached()      const {return sum(&Stripe::cached);}
+size_t PoolArena::hits()        const {return sum(&Stripe::hits);}
+size_t PoolArena::misses()      const {return sum(&Stripe::misses);}
+size_t PoolArena::released()    const {return sum(&Stripe::released);}
+
+/**
+ *  Return the most bytes allocated at any one time. The peak is sampled when
+ *  the pool takes memory from outside its lists, which is when the memory it
+ *  holds grows, and when it is read.
+ */
+size_t PoolArena::peakusage() const
+{
+    return std::max(_peakusage.load(),allocated());      // The sampled peak
+}
+
+/**
+ *  Return a bitfield indicating the set of features this %arena supports.
+ */
+features_t PoolArena::features() const
+{
+    return finalizing | recycling | threading;           // Supports these
+}
+
+/**
+ *  Insert a formatted representation of the %arena onto the output stream 'o',
+ *  including the blocks currently held for reuse and how well they have been
+ *  reused so far.
+ */
+void PoolArena::insert(std::ostream& o) const
+{
+    Arena::insert(o);                                    // Emit the basics
+
+    o << ",cached="   << bytes_t(cached())               // Emit cached()
+      << ",hits="     << hits()                          // Emit hits()
+      << ",misses="   << misses()                        // Emit misses()
+      << ",released=" << released();                     // Emit released()
+}
+
+/**
+ *  Release all of the blocks we are holding on to back to the parent %arena.
+ *  The blocks that are still in use are not affected.
+ */
+void PoolArena::reset()
+{
+    trim(0);                                             // Release them all
+}
+
+/**
+ *  Change the most bytes we hold on to while not in use to 'limit', releasing
+ *  blocks to the parent until we are back within the new limit.
+ */
+void PoolArena::setCacheLimit(size_t limit)
+{
+    _cacheLimit.store(limit);                            // Assign new limit
+    trim(limit);                                         // Release any excess
+}
+
+/**
+ *  Resize the block of 'size' bytes at 'p', which may be null, to 'newSize'
+ *  bytes, moving it only if the new size falls into a different class.
+ *
+ *  Blocks too large for the pool are resized by the system allocator when our
+ *  parent is the root %arena, which can often grow them in place.
+ */
+void* PoolArena::reallocate(void* p,size_t size,size_t newSize)
+{
+    assert(newSize != 0);                                // Validate arguments
+
+    if (p == 0)                                          // Nothing to resize?
+    {
+        return this->malloc(newSize);                    // ...just allocate
+    }
+
+    if (size<=_maxBlock && newSize<=_maxBlock && classOf(size)==classOf(newSize))
+    {
+        return p;                                        // Block still fits
+    }
+
+    if (size>_maxBlock && newSize>_maxBlock && _parent==getRootArena())
+    {
+        void* q = arena::realloc(p,newSize);             // ...resize it there
+
+        if (q == 0)                                      // ...failed to grow?
+        {
+            this->exhausted(newSize);                    // ....signal failure
+        }
+
+        Stripe& s(stripe());                             // ...this thread's
+        s.allocated.fetch_add(newSize - size,relaxed);   // ...wraps if shrunk
+        s.misses.fetch_add(1,relaxed);                   // ...count the miss
+        sample();                                        // ...update the peak
+        return q;                                        // ...the block
+    }
+
+    void* q = this->malloc(newSize);                     // Allocate new block
+    memcpy(q,p,std::min(size,newSize));                  // ...copy data over
+    this->free(p,size);                                  // ...and free old
+
+    return q;                                            // The moved block
+}
+
+/**
+ *  Allocate 'size' bytes of raw storage, from the free list of its class if
+ *  there are any there, and otherwise from the parent %arena.
+ */
+void* PoolArena::doMalloc(size_t const size)
+{
+    assert(size != 0);                                   // Validate arguments
+
+    Stripe& s(stripe());                                 // This thread's
+    size_t  n = size;                                    // Bytes handed out
+    void*   p = 0;                                       // The allocation
+
+    if (size <= _maxBlock)                               // Pooled request?
+    {
+        size_t c = classOf(size);                        // ...its size class
+        n = sizeOf(c);                                   // ...the block size
+        p = take(c);                                     // ...try the lists
+    }
+
+    s.allocations.fetch_add(1,relaxed);                  // Update counters
+    s.allocated.fetch_add(n,relaxed);
+
+    if (p != 0)                                          // Found one cached?
+    {
+        s.hits.fetch_add(1,relaxed);                     // ...count the hit
+    }
+    else                                                 // No, so allocate
+    {
+        p = _parent->doMalloc(n);                        // ...from parent
+        s.misses.fetch_add(1,relaxed);                   // ...count the miss
+        sample();                                        // ...update the peak
+    }
+
+    return p;                                            // The new allocation
+}
+
+/**
+ *  Return the 'size' bytes of memory at address 'p' to the free list of its
+ *  class, or else to the parent %arena if the stripe of the calling thread is
+ *  already holding on to its share of our limit.
+ */
+void PoolArena::doFree(void* p,size_t const size)
+{
+    assert(aligned(p) && size!=0);                       // Validate arguments
+
+    Stripe& s(stripe());                                 // This thread's
+    s.allocations.fetch_sub(1,relaxed);                  // Update counter
+
+    if (size > _maxBlock)                                // Not pooled?
+    {
+        s.allocated.fetch_sub(size,relaxed);             // ...less allocated
+        _parent->doFree(p,size);                         // ...give it back
+        return;
+    }
+
+    size_t c = classOf(size);                            // The size class
+    size_t n = sizeOf(c);                                // The block size
+    s.allocated.fetch_sub(n,relaxed);                    // Less allocated
+
+    {
+        ScopedMutexLock x(s.mutex);                      // Lock its lists
+
+        if (s.cached.load(relaxed) + n <= _cacheLimit.load() / nStripes)
+        {
+            *static_cast<void**>(p) = s.lists[c];        // ...link in block
+            s.lists[c] = p;                              // ...at the head
+            s.cached.fetch_add(n,relaxed);               // ...more cached
+            ++_counts[c];                                // ...one more block
+            return;
+        }
+    }
+
+    s.released.fetch_add(1,relaxed);                     // Over our share
+    _parent->doFree(p,n);                                // ...so give it back
+}
+
+/**
+ *  Return the size class of a block of 'size' bytes: the classes run from 32
+ *  bytes up, four to each power of two.
+ */
+size_t PoolArena::classOf(size_t size)
+{
+    if (size <= minBlock)                                // The smallest?
+    {
+        return 0;                                        // ...first class
+    }
+
+    size_t m = size - 1;                                 // Round down
+    size_t k = 63 - __builtin_clzl(m);                   // The power of two
+    size_t s = (m - (size_t(1) << k)) >> (k - 2);        // The quarter of it
+
+    return (k - minBits) * 4 + s + 1;                    // Four to a power
+}
+
+/**
+ *  Return the size of the blocks of the size class 'c'.
+ */
+size_t PoolArena::sizeOf(size_t c)
+{
+    if (c == 0)                                          // The smallest?
+    {
+        return minBlock;                                 // ...32 bytes
+    }
+
+    size_t k = (c - 1) / 4 + minBits;                    // The power of two
+    size_t s = (c - 1) % 4;                              // The quarter of it
+
+    return (size_t(1) << k) + (size_t(1) << (k - 2)) * (s + 1);
+}
+
+/**
+ *  Return the stripe of free lists of the calling thread.
+ */
+PoolArena::Stripe& PoolArena::stripe() const
+{
+    return _stripes[threadStripe];                       // Assigned in turn
+}
+
+/**
+ *  Return the sum of the counter 'm' over all of the stripes, which wraps back
+ *  around to the total for counters that go below 0 in some stripes.
+ */
+size_t PoolArena::sum(std::atomic<size_t> Stripe::* m) const
+{
+    size_t n = 0;                                        // The running total
+
+    for (size_t i=0; i!=nStripes; ++i)                   // For each stripe
+    {
+        n += (_stripes[i].*m).load(relaxed);             // ...add its count
+    }
+
+    return n;                                            // The total count
+}
+
+/**
+ *  Raise the peak to the bytes now allocated. Called only as the pool takes
+ *  more memory from outside its lists, where the sum of the counters costs
+ *  little beside the allocation itself.
+ */
+void PoolArena::sample()
+{
+    ensureMax(_peakusage,allocated());                   // Raise the peak
+}
+
+/**
+ *  Take a block of class 'c' off the free lists, those of the calling thread
+ *  first, or return null if none are cached.
+ */
+void* PoolArena::take(size_t c)
+{
+    if (_counts[c].load() == 0)                          // None cached at all?
+    {
+        return 0;                                        // ...don't even look
+    }
+
+    for (size_t i=0; i!=nStripes; ++i)                   // For each stripe
+    {
+        Stripe& s(_stripes[(threadStripe + i) % nStripes]);
+        ScopedMutexLock x(s.mutex);                      // ...lock its lists
+
+        if (void* p = s.lists[c])                        // ...has a block?
+        {
+            s.lists[c] = *static_cast<void**>(p);        // ....unlink it
+            s.cached.fetch_sub(sizeOf(c),relaxed);       // ....less cached
+            --_counts[c];                                // ....one less
+            return p;                                    // ....and it's ours
+        }
+    }
+
+    return 0;                                            // Taken by others
+}
+
+/**
+ *  Release cached blocks back to the parent %arena, the largest first, until
+ *  each stripe holds on to no more than its share of 'limit' bytes.
+ */
+void PoolArena::trim(size_t limit)
+{
+    size_t const share = limit / nStripes;               // Each stripe's part
+
+    for (size_t i=0; i!=nStripes; ++i)                   // For each stripe
+    {
+        Stripe& s(_stripes[i]);
+        ScopedMutexLock x(s.mutex);                      // ...lock its lists
+
+        for (size_t c=_nClasses; c-- != 0 && s.cached.load(relaxed) > share; )
+        {
+            while (void* p = s.lists[c])                 // ...has a block?
+            {
+                if (s.cached.load(relaxed) <= share)     // ....within share?
+                {
+                    break;                               // .....we are done
+                }
+
+                s.lists[c] = *static_cast<void**>(p);    // ....unlink it
+                s.cached.fetch_sub(sizeOf(c),relaxed);   // ....less cached
+                --_counts[c];                            // ....one less
+                _parent->doFree(p,sizeOf(c));            // ....give it back
+            }
+        }
+    }
+}
+
+/**
+ *  Return true if the object looks to be in good shape.
+ */
+bool PoolArena::consistent() const
+{
+    assert(_parent != 0);                                // Validate parent
+    assert(_parent->supports(threading));                // Parent is shared
+    assert(_maxBlock >= minBlock);                       // Validate classes
+    assert(sizeOf(classOf(_maxBlock)) == _maxBlock);     // A class size
+
+    return true;                                         // Appears to be good
+}
+
+/****************************************************************************/
+
+/**
+ *  Return the pool of the buffers of in-memory chunks, shared by all queries.
+ *  It holds on to no blocks until setCacheLimit() is called at startup.
+ *
+ *  The pool is never destroyed, as chunks may outlive static destructors.
+ */
+PoolArena& getChunkPool()
+{
+    static PoolArena* const p = new PoolArena(Options("chunks").pagesize(64*MiB),0);
+
+    return *p;                                           // The chunk pool
+}
+
+/**
+ *  Return the pool of the storage of values too large to fit within a Value
+ *  itself, shared by all threads.
+ *
+ *  The pool is never destroyed, as values may outlive static destructors.
+ */
+PoolArena& getValuePool()
+{
+    static PoolArena* const p = new PoolArena(Options("values").pagesize(4*KiB),32*MiB);
+
+    return *p;                                           // The value pool
+}
+
+/****************************************************************************/
+}}
+/****************************************************************************/
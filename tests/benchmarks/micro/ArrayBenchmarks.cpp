@@ -0,0 +1,489 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * @file ArrayBenchmarks.cpp
+ *
+ * Micro-benchmarks for the in-memory chunk format: RLE payloads, empty
+ * bitmaps, MemChunk iterators and the chunk compressors, and for points as
+ * Coordinates keys.
+ */
+
+#include <cmath>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#include <array/ArrayDistributionInterface.h>
+#include <array/Compressor.h>
+#include <array/MemChunk.h>
+#include <array/Metadata.h>
+#include <array/RLE.h>
+#include <query/TypeSystem.h>
+
+#include "MicroBenchmark.h"
+
+using namespace std;
+
+/****************************************************************************/
+namespace scidb { namespace bench { namespace {
+/****************************************************************************/
+
+/// Cells per chunk for the payload and chunk cases
+const size_t CHUNK_CELLS = 64 * 1024;
+
+/// Cells spanned by the bitmap cases
+const position_t BITMAP_CELLS = 1024 * 1024;
+
+/**
+ * The value stored at cell i: runs of 16 equal values with a varying tail,
+ * so that every compressor has some, but not too much, to work with.
+ */
+inline int64_t cellValue(size_t i)
+{
+    return static_cast<int64_t>((i / 16) * 7 + ((i % 16) < 12 ? 0 : i % 5));
+}
+
+/**
+ * A one dimensional, non-emptyable int64 array holding exactly one chunk of
+ * CHUNK_CELLS cells.
+ */
+ArrayDesc const& getChunkSchema()
+{
+    static ArrayDesc* schema = NULL;
+    if (schema == NULL) {
+        Attributes attributes(1);
+        attributes[0] = AttributeDesc(0, "v", TID_INT64, 0, CompressorFactory::NO_COMPRESSION);
+        Dimensions dimensions(1);
+        dimensions[0] = DimensionDesc("i", 0, CHUNK_CELLS - 1, CHUNK_CELLS, 0);
+        InstanceID instances[] = { 0 };
+        schema = new ArrayDesc("micro_benchmark", attributes, dimensions,
+                               defaultPartitioning(),
+                               createDefaultResidency(PointerRange<InstanceID>(1, instances)));
+    }
+    return *schema;
+}
+
+/// Initialize 'chunk' as the only chunk of getChunkSchema()
+void initChunk(MemChunk& chunk, int compressionMethod = CompressorFactory::NO_COMPRESSION)
+{
+    Address addr(0, Coordinates(1, 0));
+    chunk.initialize(NULL, &getChunkSchema(), addr, compressionMethod);
+}
+
+/// Fill 'chunk' with cellValue() through a sequential-write RLEChunkIterator
+void writeChunk(MemChunk& chunk)
+{
+    std::shared_ptr<Query> noQuery;
+    std::shared_ptr<ChunkIterator> it = chunk.getIterator(noQuery, ChunkIterator::SEQUENTIAL_WRITE);
+    Value value(TypeLibrary::getType(TID_INT64));
+    Coordinates pos(1, 0);
+    for (size_t i = 0; i < CHUNK_CELLS; ++i) {
+        pos[0] = i;
+        it->setPosition(pos);
+        value.setInt64(cellValue(i));
+        it->writeItem(value);
+    }
+    it->flush();
+}
+
+/// A bitmap with one cell in roughly every 'stride' of BITMAP_CELLS cells
+void scatteredBitmap(RLEEmptyBitmap& bm, position_t stride)
+{
+    position_t ppos = 0;
+    for (position_t lpos = 0; lpos < BITMAP_CELLS; lpos += stride + (lpos & 3)) {
+        bm.addPositionPair(lpos, ppos++);
+    }
+}
+
+/****************************************************************************/
+
+void rlePayloadAppend(State& state)
+{
+    Type const& type = TypeLibrary::getType(TID_INT64);
+    Value value(type);
+    while (state.keepRunning()) {
+        RLEPayload payload(type);
+        RLEPayload::append_iterator appender(&payload);
+        for (size_t i = 0; i < CHUNK_CELLS; ++i) {
+            value.setInt64(cellValue(i));
+            appender.add(value);
+        }
+        appender.flush();
+        doNotOptimize(payload.count());
+    }
+    state.setItemsPerIteration(CHUNK_CELLS);
+    state.setBytesPerIteration(CHUNK_CELLS * sizeof(int64_t));
+}
+MICRO_BENCHMARK("rle/payload_append", rlePayloadAppend);
+
+void rlePayloadIterate(State& state)
+{
+    Type const& type = TypeLibrary::getType(TID_INT64);
+    RLEPayload payload(type);
+    {
+        Value value(type);
+        RLEPayload::append_iterator appender(&payload);
+        for (size_t i = 0; i < CHUNK_CELLS; ++i) {
+            value.setInt64(cellValue(i));
+            appender.add(value);
+        }
+        appender.flush();
+    }
+
+    Value item;
+    while (state.keepRunning()) {
+        int64_t sum = 0;
+        for (ConstRLEPayload::iterator it(&payload); !it.end(); ++it) {
+            it.getItem(item);
+            sum += item.getInt64();
+        }
+        doNotOptimize(sum);
+    }
+    state.setItemsPerIteration(CHUNK_CELLS);
+    state.setBytesPerIteration(CHUNK_CELLS * sizeof(int64_t));
+    state.setCounter("segments", static_cast<double>(payload.nSegments()));
+}
+MICRO_BENCHMARK("rle/payload_iterate", rlePayloadIterate);
+
+void bitmapBuild(State& state)
+{
+    size_t cells = 0;
+    while (state.keepRunning()) {
+        RLEEmptyBitmap bm;
+        scatteredBitmap(bm, 4);
+        cells = bm.nSegments();
+        doNotOptimize(cells);
+    }
+    state.setItemsPerIteration(cells);
+}
+MICRO_BENCHMARK("bitmap/build", bitmapBuild);
+
+void bitmapPackUnpack(State& state)
+{
+    RLEEmptyBitmap bm;
+    scatteredBitmap(bm, 4);
+    vector<char> buf(bm.packedSize());
+
+    while (state.keepRunning()) {
+        bm.pack(&buf[0]);
+        ConstRLEEmptyBitmap unpacked(&buf[0]);
+        doNotOptimize(unpacked.nSegments());
+    }
+    state.setItemsPerIteration(bm.nSegments());
+    state.setBytesPerIteration(buf.size());
+    state.setCounter("packed_bytes_per_segment", double(buf.size()) / double(bm.nSegments()));
+}
+MICRO_BENCHMARK("bitmap/pack_unpack", bitmapPackUnpack);
+
+void bitmapOrderedProbe(State& state)
+{
+    RLEEmptyBitmap bm;
+    scatteredBitmap(bm, 4);
+
+    while (state.keepRunning()) {
+        size_t hits = 0;
+        ConstRLEEmptyBitmap::iterator it = bm.getIterator();
+        for (position_t pos = 0; pos < BITMAP_CELLS; ++pos) {
+            hits += it.setPosition(pos);
+        }
+        doNotOptimize(hits);
+    }
+    state.setItemsPerIteration(BITMAP_CELLS);
+}
+MICRO_BENCHMARK("bitmap/ordered_probe", bitmapOrderedProbe);
+
+void bitmapRandomProbe(State& state)
+{
+    RLEEmptyBitmap bm;
+    scatteredBitmap(bm, 4);
+
+    while (state.keepRunning()) {
+        size_t hits = 0;
+        position_t pos = 0;
+        for (position_t i = 0; i < BITMAP_CELLS; ++i) {
+            pos = (pos + 7919) % BITMAP_CELLS;
+            hits += !bm.isEmpty(pos);
+        }
+        doNotOptimize(hits);
+    }
+    state.setItemsPerIteration(BITMAP_CELLS);
+}
+MICRO_BENCHMARK("bitmap/random_probe", bitmapRandomProbe);
+
+/// Probe every cell in order, by iterator (galloping) or by isEmpty() (binary)
+void bitmapStrideProbe(State& state, position_t stride, bool ordered)
+{
+    RLEEmptyBitmap bm;
+    scatteredBitmap(bm, stride);
+    vector<char> buf(bm.packedSize());
+    bm.pack(&buf[0]);
+
+    while (state.keepRunning()) {
+        size_t hits = 0;
+        if (ordered) {
+            ConstRLEEmptyBitmap::iterator it = bm.getIterator();
+            for (position_t pos = 0; pos < BITMAP_CELLS; ++pos) {
+                hits += it.setPosition(pos);
+            }
+        } else {
+            for (position_t pos = 0; pos < BITMAP_CELLS; ++pos) {
+                hits += !bm.isEmpty(pos);
+            }
+        }
+        doNotOptimize(hits);
+    }
+    state.setItemsPerIteration(BITMAP_CELLS);
+    state.setCounter("packed_bytes_per_cell", double(buf.size()) / double(bm.count()));
+    state.setCounter("segment_bytes_per_cell",
+                     double(bm.nSegments() * sizeof(ConstRLEEmptyBitmap::Segment)) / double(bm.count()));
+}
+
+/// Registers the ordered and binary probe cases for strides 2 to 512
+struct BitmapProbeRegistrar
+{
+    BitmapProbeRegistrar()
+    {
+        for (position_t stride = 2; stride <= 512; stride *= 4) {
+            ostringstream suffix;
+            suffix << "_stride_" << stride;
+            Registrar("bitmap/ordered_probe" + suffix.str(),
+                      bind(bitmapStrideProbe, placeholders::_1, stride, true));
+            Registrar("bitmap/binary_probe" + suffix.str(),
+                      bind(bitmapStrideProbe, placeholders::_1, stride, false));
+        }
+    }
+} bitmapProbeRegistrar;
+
+void memChunkWrite(State& state)
+{
+    size_t size = 0;
+    while (state.keepRunning()) {
+        MemChunk chunk;
+        initChunk(chunk);
+        writeChunk(chunk);
+        size = chunk.getSize();
+    }
+    state.setItemsPerIteration(CHUNK_CELLS);
+    state.setCounter("chunk_bytes", static_cast<double>(size));
+}
+MICRO_BENCHMARK("memchunk/sequential_write", memChunkWrite);
+
+void memChunkRead(State& state)
+{
+    MemChunk chunk;
+    initChunk(chunk);
+    writeChunk(chunk);
+
+    while (state.keepRunning()) {
+        int64_t sum = 0;
+        std::shared_ptr<ConstChunkIterator> it = chunk.getConstIterator(0);
+        while (!it->end()) {
+            sum += it->getItem().getInt64();
+            ++(*it);
+        }
+        doNotOptimize(sum);
+    }
+    state.setItemsPerIteration(CHUNK_CELLS);
+}
+MICRO_BENCHMARK("memchunk/read", memChunkRead);
+
+void memChunkRandomWrite(State& state)
+{
+    Value value(TypeLibrary::getType(TID_INT64));
+    std::shared_ptr<Query> noQuery;
+    while (state.keepRunning()) {
+        MemChunk chunk;
+        initChunk(chunk);
+        std::shared_ptr<ChunkIterator> it = chunk.getIterator(noQuery, 0);
+        Coordinates pos(1, 0);
+        size_t cell = 0;
+        for (size_t i = 0; i < CHUNK_CELLS; ++i) {
+            cell = (cell + 7919) % CHUNK_CELLS;
+            pos[0] = cell;
+            it->setPosition(pos);
+            value.setInt64(cellValue(cell));
+            it->writeItem(value);
+        }
+        it->flush();
+    }
+    state.setItemsPerIteration(CHUNK_CELLS);
+}
+MICRO_BENCHMARK("memchunk/random_write", memChunkRandomWrite);
+
+/****************************************************************************/
+
+/// The built-in compressors, by the name used for their cases
+struct CompressorCase
+{
+    char const* name;
+    int         method;
+};
+
+const CompressorCase compressorCases[] =
+{
+    { "none",             CompressorFactory::NO_COMPRESSION      },
+    { "null_filter",      CompressorFactory::NULL_FILTER         },
+    { "rle",              CompressorFactory::RUN_LENGTH_ENCODING },
+    { "bitmap",           CompressorFactory::BITMAP_ENCODING     },
+    { "null_suppression", CompressorFactory::NULL_SUPPRESSION    },
+    { "dictionary",       CompressorFactory::DICTIONARY_ENCODING },
+    { "zlib",             CompressorFactory::ZLIB_COMPRESSOR     },
+    { "bzlib",            CompressorFactory::BZLIB_COMPRESSOR    },
+};
+
+void compress(State& state, int method)
+{
+    Compressor* compressor = CompressorFactory::getInstance().getCompressors()[method];
+    MemChunk chunk;
+    initChunk(chunk, method);
+    writeChunk(chunk);
+    vector<char> buf(chunk.getSize());
+
+    size_t compressed = 0;
+    while (state.keepRunning()) {
+        compressed = compressor->compress(&buf[0], chunk);
+    }
+    state.setItemsPerIteration(CHUNK_CELLS);
+    state.setBytesPerIteration(chunk.getSize());
+    state.setCounter("ratio", double(chunk.getSize()) / double(compressed));
+}
+
+void decompress(State& state, int method)
+{
+    Compressor* compressor = CompressorFactory::getInstance().getCompressors()[method];
+    MemChunk chunk;
+    initChunk(chunk, method);
+    writeChunk(chunk);
+    vector<char> buf(chunk.getSize());
+    size_t const compressed = compressor->compress(&buf[0], chunk);
+
+    MemChunk target;
+    initChunk(target, method);
+    target.allocate(chunk.getSize());
+    while (state.keepRunning()) {
+        if (compressed == chunk.getSize()) {
+            // Stored as is, which is what the storage manager does too
+            memcpy(target.getDataForLoad(), &buf[0], compressed);
+        } else if (compressor->decompress(&buf[0], compressed, target) != chunk.getSize()) {
+            throw SYSTEM_EXCEPTION(SCIDB_SE_STORAGE, SCIDB_LE_CANT_DECOMPRESS_CHUNK);
+        }
+    }
+    state.setItemsPerIteration(CHUNK_CELLS);
+    state.setBytesPerIteration(chunk.getSize());
+}
+
+/// Registers a compress and a decompress case for every built-in compressor
+struct CompressorRegistrar
+{
+    CompressorRegistrar()
+    {
+        for (size_t i = 0; i < sizeof(compressorCases) / sizeof(compressorCases[0]); ++i) {
+            int const method = compressorCases[i].method;
+            string const name(compressorCases[i].name);
+            Registrar("compressor/compress_" + name, bind(compress, placeholders::_1, method));
+            Registrar("compressor/decompress_" + name, bind(decompress, placeholders::_1, method));
+        }
+    }
+} compressorRegistrar;
+
+/****************************************************************************/
+
+/// Step pos to the next cell of a box of the given edge, row-major
+bool nextCell(Coordinates& pos, Coordinate edge)
+{
+    for (size_t i = pos.size(); i-- > 0; ) {
+        if (++pos[i] < edge) {
+            return true;
+        }
+        pos[i] = 0;
+    }
+    return false;
+}
+
+/// The edge of a box of about a million cells of the given rank
+Coordinate boxEdge(size_t nDims)
+{
+    return static_cast<Coordinate>(std::pow(1000000.0, 1.0 / static_cast<double>(nDims)));
+}
+
+/// Build and probe a hash map keyed by every cell of a box
+void coordinatesCellHash(State& state, size_t nDims)
+{
+    Coordinate const edge = boxEdge(nDims);
+    size_t nCells = 0;
+    while (state.keepRunning()) {
+        std::unordered_map<Coordinates, int64_t, CoordinatesHash> cells;
+        Coordinates pos(nDims, 0);
+        nCells = 0;
+        do {
+            cells[pos] += 1;
+            ++nCells;
+        } while (nextCell(pos, edge));
+        int64_t sum = 0;
+        do {
+            sum += cells.find(pos)->second;
+        } while (nextCell(pos, edge));
+        doNotOptimize(sum);
+    }
+    state.setItemsPerIteration(nCells);
+}
+
+/// Probe an ordered chunk map with a freshly built key for each chunk
+void coordinatesChunkLookup(State& state, size_t nDims)
+{
+    Coordinate const edge = std::max<Coordinate>(boxEdge(nDims) / 4, 2);
+    std::map<Coordinates, int64_t> chunks;
+    Coordinates pos(nDims, 0);
+    do {
+        chunks[pos] = 1;
+    } while (nextCell(pos, edge));
+
+    while (state.keepRunning()) {
+        int64_t sum = 0;
+        do {
+            sum += chunks.find(Coordinates(pos))->second;
+        } while (nextCell(pos, edge));
+        doNotOptimize(sum);
+    }
+    state.setItemsPerIteration(chunks.size());
+}
+
+/// Registers the Coordinates cases for 2-D to 6-D points
+struct CoordinatesRegistrar
+{
+    CoordinatesRegistrar()
+    {
+        for (size_t nDims = 2; nDims <= 6; ++nDims) {
+            ostringstream rank;
+            rank << nDims << "d";
+            Registrar("coordinates/cell_hash_" + rank.str(),
+                      bind(coordinatesCellHash, placeholders::_1, nDims));
+            Registrar("coordinates/chunk_lookup_" + rank.str(),
+                      bind(coordinatesChunkLookup, placeholders::_1, nDims));
+        }
+    }
+} coordinatesRegistrar;
+
+/****************************************************************************/
+}}}
+/****************************************************************************/
@@ -0,0 +1,168 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * @file ExportBenchmarks.cpp
+ *
+ * Micro-benchmarks for the export of arrays as text: the formatting of
+ * single values, and ArrayWriter::save() of a whole array in csv+.
+ */
+
+#include <sys/stat.h>
+
+#include <array/ArrayDistributionInterface.h>
+#include <array/Compressor.h>
+#include <array/MemArray.h>
+#include <array/Metadata.h>
+#include <query/TypeSystem.h>
+#include <smgr/io/ArrayWriter.h>
+
+#include "MicroBenchmark.h"
+
+using namespace std;
+
+/****************************************************************************/
+namespace scidb { namespace bench { namespace {
+/****************************************************************************/
+
+/// Values formatted per iteration by the formatter cases
+const size_t N_VALUES = 64 * 1024;
+
+/// Cells per chunk, and chunks, of the array saved by the save case
+const size_t CHUNK_CELLS = 64 * 1024;
+const size_t N_CHUNKS = 8;
+
+/// A double with a varying number of significant digits and magnitude
+inline double doubleValue(size_t i)
+{
+    return (static_cast<double>(i) * 1.61803398875 - 1000.0) / static_cast<double>(1 + i % 97);
+}
+
+/**
+ * A one dimensional <i:int64, d:double> array of N_CHUNKS chunks, filled
+ * through sequential-write chunk iterators.
+ */
+std::shared_ptr<Array> makeExportArray()
+{
+    Attributes attributes(3);
+    attributes[0] = AttributeDesc(0, "i", TID_INT64, 0, CompressorFactory::NO_COMPRESSION);
+    attributes[1] = AttributeDesc(1, "d", TID_DOUBLE, 0, CompressorFactory::NO_COMPRESSION);
+    attributes[2] = AttributeDesc(2, DEFAULT_EMPTY_TAG_ATTRIBUTE_NAME, TID_INDICATOR,
+                                  AttributeDesc::IS_EMPTY_INDICATOR, CompressorFactory::NO_COMPRESSION);
+    Dimensions dimensions(1);
+    dimensions[0] = DimensionDesc("x", 0, CHUNK_CELLS * N_CHUNKS - 1, CHUNK_CELLS, 0);
+    InstanceID instances[] = { 0 };
+    ArrayDesc schema("micro_benchmark_export", attributes, dimensions,
+                     defaultPartitioning(),
+                     createDefaultResidency(PointerRange<InstanceID>(1, instances)));
+
+    std::shared_ptr<Query> noQuery;
+    std::shared_ptr<MemArray> array = std::make_shared<MemArray>(schema, noQuery);
+    Value iValue(TypeLibrary::getType(TID_INT64));
+    Value dValue(TypeLibrary::getType(TID_DOUBLE));
+    for (size_t c = 0; c < N_CHUNKS; ++c) {
+        Coordinates pos(1, static_cast<Coordinate>(c * CHUNK_CELLS));
+        std::shared_ptr<ArrayIterator> iArray = array->getIterator(0);
+        std::shared_ptr<ArrayIterator> dArray = array->getIterator(1);
+        std::shared_ptr<ChunkIterator> iChunk =
+            iArray->newChunk(pos).getIterator(noQuery, ChunkIterator::SEQUENTIAL_WRITE);
+        std::shared_ptr<ChunkIterator> dChunk =
+            dArray->newChunk(pos).getIterator(noQuery, ChunkIterator::SEQUENTIAL_WRITE |
+                                              ChunkIterator::NO_EMPTY_CHECK);
+        for (size_t i = 0; i < CHUNK_CELLS; ++i) {
+            pos[0] = static_cast<Coordinate>(c * CHUNK_CELLS + i);
+            iChunk->setPosition(pos);
+            dChunk->setPosition(pos);
+            iValue.setInt64(static_cast<int64_t>(pos[0] * 7919 - 1000000));
+            dValue.setDouble(doubleValue(i));
+            iChunk->writeItem(iValue);
+            dChunk->writeItem(dValue);
+        }
+        iChunk->flush();
+        dChunk->flush();
+    }
+    return array;
+}
+
+/****************************************************************************/
+
+void formatDouble(State& state)
+{
+    Value::Formatter formatter;
+    Value value(TypeLibrary::getType(TID_DOUBLE));
+    string out;
+    while (state.keepRunning()) {
+        out.clear();
+        for (size_t i = 0; i < N_VALUES; ++i) {
+            value.setDouble(doubleValue(i));
+            formatter.format(TID_DOUBLE, value, out);
+            out += ',';
+        }
+        doNotOptimize(out.size());
+    }
+    state.setItemsPerIteration(N_VALUES);
+    state.setBytesPerIteration(out.size());
+}
+MICRO_BENCHMARK("export/format_double", formatDouble);
+
+void formatInt64(State& state)
+{
+    Value::Formatter formatter;
+    Value value(TypeLibrary::getType(TID_INT64));
+    string out;
+    while (state.keepRunning()) {
+        out.clear();
+        for (size_t i = 0; i < N_VALUES; ++i) {
+            value.setInt64(static_cast<int64_t>(i * 7919) - 1000000);
+            formatter.format(TID_INT64, value, out);
+            out += ',';
+        }
+        doNotOptimize(out.size());
+    }
+    state.setItemsPerIteration(N_VALUES);
+    state.setBytesPerIteration(out.size());
+}
+MICRO_BENCHMARK("export/format_int64", formatInt64);
+
+void saveCsv(State& state)
+{
+    std::shared_ptr<Array> array = makeExportArray();
+    std::shared_ptr<Query> noQuery;
+    string const file = getScratchDirectory() + "/export.csv";
+
+    uint64_t cells = 0;
+    while (state.keepRunning()) {
+        cells = ArrayWriter::save(*array, file, noQuery, "csv+");
+    }
+
+    struct stat st;
+    if (::stat(file.c_str(), &st) == 0) {
+        state.setBytesPerIteration(st.st_size);
+    }
+    ::unlink(file.c_str());
+    state.setItemsPerIteration(cells);
+}
+MICRO_BENCHMARK("export/save_csv", saveCsv);
+
+/****************************************************************************/
+}}}
+/****************************************************************************/
@@ -0,0 +1,167 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef MICRO_BENCHMARK_H_
+#define MICRO_BENCHMARK_H_
+
+/****************************************************************************/
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/****************************************************************************/
+namespace scidb { namespace bench {
+/****************************************************************************/
+
+/**
+ *  Times one run of a benchmark case.
+ *
+ *  The case does its set-up, then loops on keepRunning(), performing one
+ *  iteration of the measured work each time round, until enough time has
+ *  passed for a stable figure. Work that should not be timed can be fenced
+ *  off with pauseTiming() and resumeTiming().
+ */
+class State
+{
+ public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit State(double minSeconds)
+        : _minNanos(minSeconds * 1e9),
+          _iterations(0),
+          _elapsed(Clock::duration::zero()),
+          _items(0),
+          _bytes(0),
+          _running(false)
+    {}
+
+    /// @return true if the case should perform another iteration
+    bool keepRunning()
+    {
+        Clock::time_point const now = Clock::now();
+        if (!_running) {
+            _running = true;
+        } else {
+            _elapsed += now - _start;
+            ++_iterations;
+        }
+        if (std::chrono::duration<double, std::nano>(_elapsed).count() >= _minNanos) {
+            _running = false;
+            return false;
+        }
+        _start = Clock::now();
+        return true;
+    }
+
+    void pauseTiming()  { _elapsed += Clock::now() - _start; }
+    void resumeTiming() { _start = Clock::now(); }
+
+    /// Record how many items (cells, values, tuples, ...) one iteration processes
+    void setItemsPerIteration(uint64_t n)   { _items = n; }
+
+    /// Record how many bytes one iteration processes
+    void setBytesPerIteration(uint64_t n)   { _bytes = n; }
+
+    /// Record a case-specific figure, such as a compression ratio
+    void setCounter(std::string const& name, double value) { _counters[name] = value; }
+
+    uint64_t getIterations() const          { return _iterations; }
+    uint64_t getItemsPerIteration() const   { return _items; }
+    uint64_t getBytesPerIteration() const   { return _bytes; }
+    std::map<std::string, double> const& getCounters() const { return _counters; }
+
+    /// @return the mean time of one iteration, in nanoseconds
+    double getNanosPerIteration() const
+    {
+        return _iterations == 0 ? 0 :
+            std::chrono::duration<double, std::nano>(_elapsed).count() / static_cast<double>(_iterations);
+    }
+
+ private:
+    double const                    _minNanos;
+    uint64_t                        _iterations;
+    Clock::duration                 _elapsed;
+    Clock::time_point               _start;
+    uint64_t                        _items;
+    uint64_t                        _bytes;
+    std::map<std::string, double>   _counters;
+    bool                            _running;
+};
+
+typedef std::function<void (State&)> Function;
+
+/**
+ *  A named benchmark case. Names are of the form "<area>/<case>", so that
+ *  a whole area can be selected with a single filter.
+ */
+struct Case
+{
+    std::string name;
+    Function    function;
+};
+
+/// @return the cases registered so far, in registration order
+std::vector<Case>& getCases();
+
+/// @return the directory in which cases may create files
+std::string const& getScratchDirectory();
+
+/**
+ *  Registers a case at static initialization time; see MICRO_BENCHMARK().
+ */
+struct Registrar
+{
+    Registrar(std::string const& name, Function const& function)
+    {
+        Case c;
+        c.name = name;
+        c.function = function;
+        getCases().push_back(c);
+    }
+};
+
+/**
+ *  Keep the compiler from discarding a value whose computation is the point
+ *  of the benchmark.
+ */
+template<class T>
+inline void doNotOptimize(T const& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+/****************************************************************************/
+}}
+/****************************************************************************/
+
+/**
+ *  Register the function 'fn', of type void(State&), under the given name.
+ */
+#define MICRO_BENCHMARK(name, fn) \
+    static ::scidb::bench::Registrar _registrar_##fn(name, fn)
+
+/****************************************************************************/
+#endif
+/****************************************************************************/
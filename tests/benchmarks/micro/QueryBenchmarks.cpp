@@ -0,0 +1,293 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * @file QueryBenchmarks.cpp
+ *
+ * Micro-benchmarks for the per-cell work of the query processor: scalar
+ * expression evaluation, aggregate accumulation and merging, and the tuple
+ * sort at the heart of SortArray.
+ */
+
+#include <array/ArrayDistributionInterface.h>
+#include <array/Compressor.h>
+#include <array/TupleArray.h>
+#include <query/Aggregate.h>
+#include <query/Expression.h>
+#include <query/TypeSystem.h>
+#include <util/arena/Managed.h>
+
+#include "MicroBenchmark.h"
+
+using namespace std;
+
+/****************************************************************************/
+namespace scidb { namespace bench { namespace {
+/****************************************************************************/
+
+/// Values processed per iteration by the expression and aggregate cases
+const size_t N_VALUES = 64 * 1024;
+
+/// Tuples sorted per iteration by the sort cases
+const size_t N_TUPLES = 64 * 1024;
+
+/****************************************************************************/
+
+void expressionInt64(State& state)
+{
+    vector<string> names;
+    names.push_back("a");
+    names.push_back("b");
+    names.push_back("c");
+    names.push_back("x");
+    vector<TypeId> types(names.size(), TID_INT64);
+
+    Expression e;
+    e.compile("a*x*x+b*x+c", names, types);
+    ExpressionContext ec(e);
+    ec[0].setInt64(5);
+    ec[1].setInt64(10);
+    ec[2].setInt64(15);
+
+    while (state.keepRunning()) {
+        int64_t sum = 0;
+        for (size_t i = 0; i < N_VALUES; ++i) {
+            ec[3].setInt64(i);
+            sum += e.evaluate(ec).getInt64();
+        }
+        doNotOptimize(sum);
+    }
+    state.setItemsPerIteration(N_VALUES);
+}
+MICRO_BENCHMARK("expression/int64_polynomial", expressionInt64);
+
+void expressionDoubleFunctions(State& state)
+{
+    vector<string> names;
+    names.push_back("x");
+    names.push_back("y");
+    vector<TypeId> types(names.size(), TID_DOUBLE);
+
+    Expression e;
+    e.compile("iif(x > y, sqrt(x) * 2.0, sin(y) + x)", names, types);
+    ExpressionContext ec(e);
+
+    while (state.keepRunning()) {
+        double sum = 0;
+        for (size_t i = 0; i < N_VALUES; ++i) {
+            ec[0].setDouble(static_cast<double>(i));
+            ec[1].setDouble(static_cast<double>(i % 1000) * 100.0);
+            sum += e.evaluate(ec).getDouble();
+        }
+        doNotOptimize(sum);
+    }
+    state.setItemsPerIteration(N_VALUES);
+}
+MICRO_BENCHMARK("expression/double_functions", expressionDoubleFunctions);
+
+/****************************************************************************/
+
+/// @return a new aggregate of the given name over doubles
+AggregatePtr createDoubleAggregate(char const* name)
+{
+    return AggregateLibrary::getInstance()->createAggregate(name, TypeLibrary::getType(TID_DOUBLE));
+}
+
+void aggregateAccumulate(State& state, char const* name)
+{
+    AggregatePtr aggregate = createDoubleAggregate(name);
+    Value input(aggregate->getAggregateType());
+    Value aggState(aggregate->getStateType());
+    Value result(aggregate->getResultType());
+
+    while (state.keepRunning()) {
+        aggregate->initializeState(aggState);
+        for (size_t i = 0; i < N_VALUES; ++i) {
+            input.setDouble(static_cast<double>(i % 1000));
+            aggregate->accumulateIfNeeded(aggState, input);
+        }
+        aggregate->finalResult(result, aggState);
+        doNotOptimize(result);
+    }
+    state.setItemsPerIteration(N_VALUES);
+}
+
+void aggregateAccumulateTile(State& state, char const* name)
+{
+    AggregatePtr aggregate = createDoubleAggregate(name);
+    Value aggState(aggregate->getStateType());
+    Value result(aggregate->getResultType());
+
+    RLEPayload tile(aggregate->getAggregateType());
+    {
+        Value input(aggregate->getAggregateType());
+        RLEPayload::append_iterator appender(&tile);
+        for (size_t i = 0; i < N_VALUES; ++i) {
+            input.setDouble(static_cast<double>(i % 1000));
+            appender.add(input);
+        }
+        appender.flush();
+    }
+
+    while (state.keepRunning()) {
+        aggregate->initializeState(aggState);
+        aggregate->accumulateIfNeeded(aggState, &tile);
+        aggregate->finalResult(result, aggState);
+        doNotOptimize(result);
+    }
+    state.setItemsPerIteration(N_VALUES);
+}
+
+void aggregateMerge(State& state, char const* name)
+{
+    AggregatePtr aggregate = createDoubleAggregate(name);
+    Value input(aggregate->getAggregateType());
+    Value result(aggregate->getResultType());
+
+    // One partial state per value, as when merging many small groups
+    vector<Value> partials(N_VALUES / 16, Value(aggregate->getStateType()));
+    for (size_t i = 0; i < partials.size(); ++i) {
+        aggregate->initializeState(partials[i]);
+        input.setDouble(static_cast<double>(i));
+        aggregate->accumulateIfNeeded(partials[i], input);
+    }
+
+    Value aggState(aggregate->getStateType());
+    while (state.keepRunning()) {
+        aggregate->initializeState(aggState);
+        for (size_t i = 0; i < partials.size(); ++i) {
+            aggregate->mergeIfNeeded(aggState, partials[i]);
+        }
+        aggregate->finalResult(result, aggState);
+        doNotOptimize(result);
+    }
+    state.setItemsPerIteration(partials.size());
+}
+
+/// Registers the accumulate and merge cases for a few representative aggregates
+struct AggregateRegistrar
+{
+    AggregateRegistrar()
+    {
+        char const* const names[] = { "sum", "avg", "max", "stdev" };
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+            string const name(names[i]);
+            Registrar("aggregate/" + name + "_accumulate", bind(aggregateAccumulate, placeholders::_1, names[i]));
+            Registrar("aggregate/" + name + "_accumulate_tile", bind(aggregateAccumulateTile, placeholders::_1, names[i]));
+            Registrar("aggregate/" + name + "_merge", bind(aggregateMerge, placeholders::_1, names[i]));
+        }
+    }
+} aggregateRegistrar;
+
+/****************************************************************************/
+
+/**
+ * The schema of the tuples sorted below: an int64 key with many duplicates,
+ * a double secondary key and a string payload.
+ */
+ArrayDesc const& getTupleSchema()
+{
+    static ArrayDesc* schema = NULL;
+    if (schema == NULL) {
+        Attributes attributes(3);
+        attributes[0] = AttributeDesc(0, "k", TID_INT64, 0, CompressorFactory::NO_COMPRESSION);
+        attributes[1] = AttributeDesc(1, "d", TID_DOUBLE, AttributeDesc::IS_NULLABLE, CompressorFactory::NO_COMPRESSION);
+        attributes[2] = AttributeDesc(2, "s", TID_STRING, 0, CompressorFactory::NO_COMPRESSION);
+        Dimensions dimensions(1);
+        dimensions[0] = DimensionDesc("n", 0, N_TUPLES - 1, N_TUPLES, 0);
+        InstanceID instances[] = { 0 };
+        schema = new ArrayDesc("micro_benchmark_tuples", attributes, dimensions,
+                               defaultPartitioning(),
+                               createDefaultResidency(PointerRange<InstanceID>(1, instances)));
+    }
+    return *schema;
+}
+
+/// @return N_TUPLES pseudo-random tuples of getTupleSchema()
+vector< vector<Value> > makeTuples()
+{
+    vector< vector<Value> > tuples(N_TUPLES, vector<Value>(3));
+    uint64_t seed = 88172645463325252ULL;
+    for (size_t i = 0; i < N_TUPLES; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        tuples[i][0].setInt64(static_cast<int64_t>(seed % 1024));
+        if (seed % 97 == 0) {
+            tuples[i][1].setNull();
+        } else {
+            tuples[i][1].setDouble(static_cast<double>(seed % 100003) / 7.0);
+        }
+        tuples[i][2].setString("payload");
+    }
+    return tuples;
+}
+
+std::shared_ptr<TupleComparator> createComparator()
+{
+    SortingAttributeInfos keys(2);
+    keys[0].columnNo = 0;
+    keys[0].ascent = true;
+    keys[1].columnNo = 1;
+    keys[1].ascent = false;
+    return std::make_shared<TupleComparator>(keys, getTupleSchema());
+}
+
+void tupleCompare(State& state)
+{
+    vector< vector<Value> > const tuples(makeTuples());
+    std::shared_ptr<TupleComparator> comparator = createComparator();
+
+    while (state.keepRunning()) {
+        int64_t order = 0;
+        for (size_t i = 1; i < N_TUPLES; ++i) {
+            order += comparator->compare(&tuples[i - 1][0], &tuples[i][0]);
+        }
+        doNotOptimize(order);
+    }
+    state.setItemsPerIteration(N_TUPLES - 1);
+}
+MICRO_BENCHMARK("sort/tuple_compare", tupleCompare);
+
+void tupleSort(State& state)
+{
+    vector< vector<Value> > const input(makeTuples());
+    std::shared_ptr<TupleComparator> comparator = createComparator();
+
+    while (state.keepRunning()) {
+        state.pauseTiming();
+        TupleArray tuples(getTupleSchema(), arena::getArena());
+        tuples.reserve(N_TUPLES);
+        for (size_t i = 0; i < N_TUPLES; ++i) {
+            tuples.appendTuple(input[i]);
+        }
+        state.resumeTiming();
+
+        tuples.sort(comparator);
+    }
+    state.setItemsPerIteration(N_TUPLES);
+}
+MICRO_BENCHMARK("sort/tuple_array_sort", tupleSort);
+
+/****************************************************************************/
+}}}
+/****************************************************************************/
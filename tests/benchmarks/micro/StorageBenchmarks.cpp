@@ -0,0 +1,223 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * @file StorageBenchmarks.cpp
+ *
+ * Micro-benchmarks for the local storage manager: DataStore space
+ * management and I/O, and the pinning of chunks in the CachedStorage cache.
+ * The storage manager is opened over the scratch directory on first use.
+ */
+
+#include <array/ArrayDistributionInterface.h>
+#include <array/Compressor.h>
+#include <query/Query.h>
+#include <smgr/io/PersistentChunk.h>
+#include <smgr/io/ReplicationManager.h>
+#include <smgr/io/Storage.h>
+#include <util/DataStore.h>
+#include <util/JobQueue.h>
+
+#include "MicroBenchmark.h"
+
+using namespace std;
+
+/****************************************************************************/
+namespace scidb { namespace bench { namespace {
+/****************************************************************************/
+
+/// Extents allocated, written or read per iteration by the DataStore cases
+const size_t N_EXTENTS = 256;
+
+/// Bytes written to or read from each extent by the DataStore I/O cases
+const size_t EXTENT_BYTES = 64 * KiB;
+
+/// Chunks pinned and unpinned per iteration by the CachedStorage case
+const size_t N_CHUNKS = 1024;
+
+/// Data stores used by the cases here, well clear of any real array id
+const DataStore::Guid FIRST_GUID = 0x7fff0000;
+
+/**
+ * Open the storage manager over the scratch directory, the first time it is
+ * called, and return it.
+ */
+Storage& getStorage()
+{
+    static bool opened = false;
+    if (!opened) {
+        ReplicationManager::getInstance()->start(std::make_shared<JobQueue>());
+        StorageManager::getInstance().open(getScratchDirectory() + "/storage.cfg", 256 * MiB);
+        opened = true;
+    }
+    return StorageManager::getInstance();
+}
+
+/**
+ * A data store that is removed, file and all, when the case is done with it.
+ */
+class ScratchDataStore
+{
+ public:
+    explicit ScratchDataStore(DataStore::Guid guid)
+        : _guid(guid),
+          _ds(getStorage().getDataStores().getDataStore(guid))
+    {}
+
+    ~ScratchDataStore()
+    {
+        _ds.reset();
+        getStorage().getDataStores().closeDataStore(_guid, true);
+    }
+
+    DataStore* operator->() const { return _ds.get(); }
+
+ private:
+    DataStore::Guid const      _guid;
+    std::shared_ptr<DataStore> _ds;
+};
+
+/// @return the size of the i'th extent of the allocation case: 4KiB to 1MiB
+inline size_t extentSize(size_t i)
+{
+    return (4 * KiB) << ((i * 7) % 9);
+}
+
+/****************************************************************************/
+
+void dataStoreAllocateFree(State& state)
+{
+    ScratchDataStore ds(FIRST_GUID);
+    vector<off_t> offsets(N_EXTENTS);
+    vector<size_t> allocated(N_EXTENTS);
+
+    while (state.keepRunning()) {
+        for (size_t i = 0; i < N_EXTENTS; ++i) {
+            offsets[i] = ds->allocateSpace(extentSize(i), allocated[i]);
+        }
+        // Free every other extent first, so that the free list has to merge
+        for (size_t i = 0; i < N_EXTENTS; i += 2) {
+            ds->freeChunk(offsets[i], allocated[i]);
+        }
+        for (size_t i = 1; i < N_EXTENTS; i += 2) {
+            ds->freeChunk(offsets[i], allocated[i]);
+        }
+    }
+    state.setItemsPerIteration(N_EXTENTS);
+}
+MICRO_BENCHMARK("datastore/allocate_free", dataStoreAllocateFree);
+
+/// Allocate N_EXTENTS extents of EXTENT_BYTES in 'ds'
+void allocateExtents(ScratchDataStore& ds, vector<off_t>& offsets, vector<size_t>& allocated)
+{
+    offsets.resize(N_EXTENTS);
+    allocated.resize(N_EXTENTS);
+    for (size_t i = 0; i < N_EXTENTS; ++i) {
+        offsets[i] = ds->allocateSpace(EXTENT_BYTES, allocated[i]);
+    }
+}
+
+void dataStoreWrite(State& state)
+{
+    ScratchDataStore ds(FIRST_GUID + 1);
+    vector<off_t> offsets;
+    vector<size_t> allocated;
+    allocateExtents(ds, offsets, allocated);
+    vector<char> buf(EXTENT_BYTES, 'x');
+
+    while (state.keepRunning()) {
+        for (size_t i = 0; i < N_EXTENTS; ++i) {
+            ds->writeData(offsets[i], &buf[0], buf.size(), allocated[i]);
+        }
+    }
+    state.setItemsPerIteration(N_EXTENTS);
+    state.setBytesPerIteration(N_EXTENTS * EXTENT_BYTES);
+}
+MICRO_BENCHMARK("datastore/write_64k", dataStoreWrite);
+
+void dataStoreRead(State& state)
+{
+    ScratchDataStore ds(FIRST_GUID + 2);
+    vector<off_t> offsets;
+    vector<size_t> allocated;
+    allocateExtents(ds, offsets, allocated);
+    vector<char> buf(EXTENT_BYTES, 'x');
+    for (size_t i = 0; i < N_EXTENTS; ++i) {
+        ds->writeData(offsets[i], &buf[0], buf.size(), allocated[i]);
+    }
+
+    while (state.keepRunning()) {
+        for (size_t i = 0; i < N_EXTENTS; ++i) {
+            ds->readData(offsets[i], &buf[0], buf.size());
+        }
+    }
+    state.setItemsPerIteration(N_EXTENTS);
+    state.setBytesPerIteration(N_EXTENTS * EXTENT_BYTES);
+}
+MICRO_BENCHMARK("datastore/read_64k", dataStoreRead);
+
+/****************************************************************************/
+
+void cachedStoragePinUnpin(State& state)
+{
+    Storage& storage = getStorage();
+
+    Attributes attributes(1);
+    attributes[0] = AttributeDesc(0, "v", TID_INT64, 0, CompressorFactory::NO_COMPRESSION);
+    Dimensions dimensions(2);
+    dimensions[0] = DimensionDesc("i", 0, 32 * 1000 - 1, 1000, 0);
+    dimensions[1] = DimensionDesc("j", 0, 32 * 1000 - 1, 1000, 0);
+    InstanceID instances[] = { 0 };
+    ArrayDesc desc(FIRST_GUID, FIRST_GUID, 1, "micro_benchmark@1", attributes, dimensions,
+                   defaultPartitioning(),
+                   createDefaultResidency(PointerRange<InstanceID>(1, instances)));
+
+    // The chunks are created pinned, and live in the cache for the run
+    static vector< std::shared_ptr<PersistentChunk> > chunks;
+    if (chunks.empty()) {
+        // A detached query: enough for the cache, which only checks it for errors
+        std::shared_ptr<Query> query = std::make_shared<Query>(QueryID::getFakeQueryId());
+        Coordinates pos(2);
+        for (size_t i = 0; i < N_CHUNKS; ++i) {
+            pos[0] = (i / 32) * 1000;
+            pos[1] = (i % 32) * 1000;
+            StorageAddress addr(desc.getId(), 0, pos);
+            chunks.push_back(storage.createChunk(desc, addr, CompressorFactory::NO_COMPRESSION, query));
+            chunks.back()->unPin();
+        }
+    }
+
+    while (state.keepRunning()) {
+        for (size_t i = 0; i < N_CHUNKS; ++i) {
+            chunks[i]->pin();
+        }
+        for (size_t i = 0; i < N_CHUNKS; ++i) {
+            chunks[i]->unPin();
+        }
+    }
+    state.setItemsPerIteration(N_CHUNKS);
+}
+MICRO_BENCHMARK("cachedstorage/pin_unpin", cachedStoragePinUnpin);
+
+/****************************************************************************/
+}}}
+/****************************************************************************/
@@ -0,0 +1,123 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+
+/*
+ * @file UtilBenchmarks.cpp
+ *
+ * Micro-benchmarks for the threading utilities: the throughput of the
+ * work-stealing JobQueue under a fan-out of small jobs.
+ */
+
+#include <atomic>
+#include <sstream>
+
+#include <util/Job.h>
+#include <util/JobQueue.h>
+#include <util/Semaphore.h>
+#include <util/ThreadPool.h>
+
+#include "MicroBenchmark.h"
+
+using namespace std;
+
+/****************************************************************************/
+namespace scidb { namespace bench { namespace {
+/****************************************************************************/
+
+/// Depth of the fan-out of each root job, and the number of roots
+const size_t FAN_OUT_DEPTH = 14;
+const size_t FAN_OUT_ROOTS = 4;
+
+/**
+ * A job that pushes two children onto its queue until depth reaches zero,
+ * so that most of the jobs are pushed by the pool threads.
+ */
+class FanOutJob : public Job
+{
+ public:
+    FanOutJob(JobQueue& queue, size_t depth, Semaphore& done)
+    : Job(std::shared_ptr<Query>()),
+      _queue(queue), _depth(depth), _done(done)
+    {}
+
+    virtual void run()
+    {
+        if (_depth > 0) {
+            _queue.pushJob(std::make_shared<FanOutJob>(_queue, _depth - 1, _done));
+            _queue.pushJob(std::make_shared<FanOutJob>(_queue, _depth - 1, _done));
+        }
+        _done.release();
+    }
+
+ private:
+    JobQueue& _queue;
+    size_t const _depth;
+    Semaphore& _done;
+};
+
+void jobQueueFanOut(State& state, size_t nThreads)
+{
+    std::shared_ptr<JobQueue> queue = std::make_shared<JobQueue>();
+    ThreadPool pool(nThreads, queue);
+    pool.start();
+
+    size_t const nJobs = FAN_OUT_ROOTS * ((size_t(2) << FAN_OUT_DEPTH) - 1);
+    Semaphore done;
+    while (state.keepRunning()) {
+        for (size_t i = 0; i < FAN_OUT_ROOTS; ++i) {
+            queue->pushJob(std::make_shared<FanOutJob>(*queue, FAN_OUT_DEPTH, done));
+        }
+        done.enter(nJobs);
+    }
+
+    vector<JobQueue::WorkerStats> stats;
+    queue->getWorkerStats(stats);
+    pool.stop();
+
+    uint64_t stolen = 0, idle = 0;
+    for (size_t i = 0; i < stats.size(); ++i) {
+        stolen += stats[i].stolen;
+        idle += stats[i].idle;
+    }
+    double const iterations = static_cast<double>(max<uint64_t>(state.getIterations(), 1));
+    state.setItemsPerIteration(nJobs);
+    state.setCounter("stolen_per_iteration", static_cast<double>(stolen) / iterations);
+    state.setCounter("idle_per_iteration", static_cast<double>(idle) / iterations);
+}
+
+/// Registers a fan-out case for 1 to 64 threads
+struct JobQueueRegistrar
+{
+    JobQueueRegistrar()
+    {
+        for (size_t nThreads = 1; nThreads <= 64; nThreads *= 2) {
+            ostringstream name;
+            name << "jobqueue/fan_out_" << nThreads << "_threads";
+            Registrar(name.str(), bind(jobQueueFanOut, placeholders::_1, nThreads));
+        }
+    }
+} jobQueueRegistrar;
+
+/****************************************************************************/
+}}}
+/****************************************************************************/
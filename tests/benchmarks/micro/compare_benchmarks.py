@@ -0,0 +1,114 @@
+#!/usr/bin/python
+
+# BEGIN_COPYRIGHT
+#
+# Copyright (C) 2008-2015 SciDB, Inc.
+# All Rights Reserved.
+#
+# SciDB is free software: you can redistribute it and/or modify
+# it under the terms of the AFFERO GNU General Public License as published by
+# the Free Software Foundation.
+#
+# SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+# INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+# NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+# the AFFERO GNU General Public License for the complete license terms.
+#
+# You should have received a copy of the AFFERO GNU General Public License
+# along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+#
+# END_COPYRIGHT
+
+"""
+Compare two runs of micro_benchmarks.
+
+Each input is the JSON-lines output of micro_benchmarks: a header record
+followed by one record per case.  For every case present in both runs the
+median time per iteration of the candidate is compared with that of the
+baseline.  A case is reported as a regression when it is slower by more
+than the threshold, and as an improvement when it is faster by more than
+the threshold.  The exit status is 1 if there are any regressions, so the
+script can gate a build.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    """Return (header, {benchmark name: record}) for a results file."""
+    header = {}
+    records = {}
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            rec = json.loads(line)
+            if 'benchmark' in rec:
+                records[rec['benchmark']] = rec
+            else:
+                header = rec
+    return header, records
+
+
+def describe(header):
+    return '{0} {1} {2}'.format(header.get('version', '?'),
+                                header.get('commit', '?'),
+                                header.get('label', '')).strip()
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Compare two micro_benchmarks result files.')
+    parser.add_argument('baseline', help='results of the reference build')
+    parser.add_argument('candidate', help='results of the build under test')
+    parser.add_argument('-t', '--threshold', type=float, default=5.0,
+                        help='percentage change to report (default 5)')
+    parser.add_argument('-a', '--all', action='store_true',
+                        help='print every case, not just the changed ones')
+    args = parser.parse_args()
+
+    base_header, base = load(args.baseline)
+    cand_header, cand = load(args.candidate)
+
+    print('baseline:  ' + describe(base_header))
+    print('candidate: ' + describe(cand_header))
+    print('')
+    print('{0:<44} {1:>14} {2:>14} {3:>9}'.format(
+        'benchmark', 'base ns/iter', 'cand ns/iter', 'change'))
+
+    regressions = 0
+    improvements = 0
+    for name in sorted(set(base) | set(cand)):
+        if name not in base or name not in cand:
+            print('{0:<44} {1}'.format(
+                name, 'only in ' + ('baseline' if name in base else 'candidate')))
+            continue
+        b = float(base[name]['ns_per_iter'])
+        c = float(cand[name]['ns_per_iter'])
+        if b <= 0:
+            continue
+        change = (c - b) * 100.0 / b
+        # Changes within the noise of either run are not worth reporting
+        noise = 100.0 * max(base[name].get('spread', 0), cand[name].get('spread', 0))
+        mark = ''
+        if change > args.threshold and change > noise:
+            mark = '  REGRESSION'
+            regressions += 1
+        elif -change > args.threshold and -change > noise:
+            mark = '  improved'
+            improvements += 1
+        if mark or args.all:
+            print('{0:<44} {1:>14.1f} {2:>14.1f} {3:>+8.1f}%{4}'.format(
+                name, b, c, change, mark))
+
+    print('')
+    print('{0} regression(s), {1} improvement(s) beyond {2}%'.format(
+        regressions, improvements, args.threshold))
+    return 1 if regressions else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
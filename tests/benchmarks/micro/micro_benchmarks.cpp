@@ -0,0 +1,261 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+/*
+ * @file micro_benchmarks.cpp
+ *
+ * Driver for the engine micro-benchmarks. Runs offline, without a catalog
+ * or a cluster, and writes one JSON object per line to stdout (or to the
+ * --output file): first a header describing the build, then one record per
+ * case. compare_benchmarks.py diffs two such files.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/parsers.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include <log4cxx/basicconfigurator.h>
+#include <log4cxx/logger.h>
+
+#include <query/FunctionLibrary.h>
+#include <query/TypeSystem.h>
+#include <system/Config.h>
+#include <system/Constants.h>
+#include <system/Exceptions.h>
+#include <system/SciDBConfigOptions.h>
+
+#include "MicroBenchmark.h"
+
+using namespace std;
+using namespace scidb;
+namespace po = boost::program_options;
+
+/****************************************************************************/
+namespace scidb { namespace bench {
+/****************************************************************************/
+
+namespace { string scratchDirectory; }
+
+vector<Case>& getCases()
+{
+    static vector<Case> cases;
+    return cases;
+}
+
+string const& getScratchDirectory()
+{
+    return scratchDirectory;
+}
+
+/****************************************************************************/
+}}
+/****************************************************************************/
+
+namespace {
+
+/// Quote a string for JSON; case and build names need no more than this
+string quote(string const& s)
+{
+    string r("\"");
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\') {
+            r += '\\';
+        }
+        r += s[i];
+    }
+    return r + "\"";
+}
+
+/// @return the median of the given values, which are reordered
+double median(vector<double>& v)
+{
+    sort(v.begin(), v.end());
+    size_t const n = v.size();
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+/**
+ * Run the case 'repetitions' times and write its record. The median time
+ * per iteration is the figure to compare; the minimum and the spread show
+ * how noisy the machine was.
+ */
+void runCase(bench::Case const& c, double minSeconds, size_t repetitions, ostream& out)
+{
+    vector<double> nanos;
+    uint64_t iterations = 0;
+    std::shared_ptr<bench::State> last;
+
+    for (size_t r = 0; r < repetitions; ++r) {
+        last = std::make_shared<bench::State>(minSeconds);
+        c.function(*last);
+        nanos.push_back(last->getNanosPerIteration());
+        iterations += last->getIterations();
+    }
+
+    double const lo = *min_element(nanos.begin(), nanos.end());
+    double const hi = *max_element(nanos.begin(), nanos.end());
+    double const med = median(nanos);
+
+    ostringstream rec;
+    rec << setprecision(6)
+        << "{\"benchmark\": " << quote(c.name)
+        << ", \"repetitions\": " << repetitions
+        << ", \"iterations\": " << iterations
+        << ", \"ns_per_iter\": " << med
+        << ", \"ns_per_iter_min\": " << lo
+        << ", \"spread\": " << (lo > 0 ? (hi - lo) / lo : 0);
+    if (last->getItemsPerIteration() && med > 0) {
+        rec << ", \"ns_per_item\": " << med / double(last->getItemsPerIteration())
+            << ", \"items_per_sec\": " << double(last->getItemsPerIteration()) * 1e9 / med;
+    }
+    if (last->getBytesPerIteration() && med > 0) {
+        rec << ", \"bytes_per_sec\": " << double(last->getBytesPerIteration()) * 1e9 / med;
+    }
+    for (map<string, double>::const_iterator i = last->getCounters().begin();
+         i != last->getCounters().end(); ++i) {
+        rec << ", " << quote(i->first) << ": " << i->second;
+    }
+    rec << "}";
+
+    out << rec.str() << endl;
+    cerr << c.name << ": " << med << " ns/iter" << endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    po::options_description desc(
+        "Runs micro-benchmarks of the core engine primitives and prints the results as JSON lines.\n"
+        "Usage: micro_benchmarks [options]\nOptions");
+    desc.add_options()
+        ("help,h",                                             "Print this help.")
+        ("list,l",                                             "List the cases and exit.")
+        ("filter,f",      po::value<string>()->default_value(""),  "Run only the cases whose names match this regular expression.")
+        ("min-time,t",    po::value<double>()->default_value(0.5), "Minimum seconds to spend on each repetition of a case.")
+        ("repetitions,r", po::value<size_t>()->default_value(5),   "Repetitions of each case; the median is reported.")
+        ("output,o",      po::value<string>(),                      "Write the results to this file rather than to stdout.")
+        ("scratch-dir,d", po::value<string>(),                      "Directory for the storage cases; a temporary one is used and removed by default.")
+        ("label",         po::value<string>()->default_value(""),  "Free-form label for this run, such as a branch name, copied into the header.");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (const std::exception& e) {
+        cerr << e.what() << endl << desc << endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 0;
+    }
+
+    vector<bench::Case> const& cases = bench::getCases();
+    regex const filter(vm["filter"].as<string>());
+    vector<bench::Case const*> selected;
+    for (size_t i = 0; i < cases.size(); ++i) {
+        if (regex_search(cases[i].name, filter)) {
+            selected.push_back(&cases[i]);
+        }
+    }
+    if (vm.count("list")) {
+        for (size_t i = 0; i < selected.size(); ++i) {
+            cout << selected[i]->name << endl;
+        }
+        return 0;
+    }
+
+    bool const removeScratch = !vm.count("scratch-dir");
+    if (removeScratch) {
+        char dir[] = "/tmp/scidb_micro_benchmarks.XXXXXX";
+        if (::mkdtemp(dir) == NULL) {
+            cerr << "Cannot create a scratch directory: " << ::strerror(errno) << endl;
+            return 1;
+        }
+        bench::scratchDirectory = dir;
+    } else {
+        bench::scratchDirectory = vm["scratch-dir"].as<string>();
+        boost::filesystem::create_directories(bench::scratchDirectory);
+    }
+
+    int rc = 0;
+    try
+    {
+        log4cxx::BasicConfigurator::configure();
+        log4cxx::Logger::getRootLogger()->setLevel(log4cxx::Level::toLevel("WARN"));
+
+        // The defaults of the configuration options, without reading the command line
+        char* noArgs[] = { argv[0], NULL };
+        initConfig(1, noArgs);
+
+        TypeLibrary::registerBuiltInTypes();
+        FunctionLibrary::getInstance()->registerBuiltInFunctions();
+
+        ofstream file;
+        if (vm.count("output")) {
+            file.open(vm["output"].as<string>().c_str());
+            if (!file) {
+                throw SYSTEM_EXCEPTION(SCIDB_SE_IO, SCIDB_LE_CANT_OPEN_FILE)
+                    << vm["output"].as<string>() << ::strerror(errno) << errno;
+            }
+        }
+        ostream& out = file.is_open() ? file : cout;
+
+        out << "{\"suite\": \"scidb_micro_benchmarks\""
+            << ", \"version\": " << quote(SCIDB_VERSION())
+            << ", \"build_type\": " << quote(SCIDB_BUILD_TYPE())
+            << ", \"commit\": " << quote(SCIDB_COMMIT())
+            << ", \"label\": " << quote(vm["label"].as<string>())
+            << ", \"min_time\": " << vm["min-time"].as<double>()
+            << "}" << endl;
+
+        for (size_t i = 0; i < selected.size(); ++i) {
+            runCase(*selected[i], vm["min-time"].as<double>(), vm["repetitions"].as<size_t>(), out);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        cerr << "Benchmark failed: " << e.what() << endl;
+        rc = 2;
+    }
+
+    if (removeScratch) {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(bench::scratchDirectory, ec);
+    }
+
+    // Skip static destructors: the storage manager is left open on purpose
+    cout.flush();
+    ::_exit(rc);
+}
@@ -34,6 +34,8 @@
 #include <util/arena/UnorderedSet.h>
 #include <util/arena/UnorderedMap.h>
 #include <util/arena/ArenaMonitor.h>
+#include <util/arena/LimitedArena.h>
+#include <util/arena/PoolArena.h>
 
 /****************************************************************************/
 namespace scidb { namespace arena {
@@ -64,9 +66,11 @@ struct ArenaTests : CppUnit::TestFixture
                     void      testLeaArena();
                     void      testSharedPtr();
                     void      testLimiting();
+                    void      testSetLimit();
                     void      testStringConcat();
                     void      testManualAuto();
                     void      testMemoryLimit();
+                    void      testPoolArena();
                     void      anExample();
 
                     void      arena     (Arena&);
@@ -98,9 +102,11 @@ struct ArenaTests : CppUnit::TestFixture
     CPPUNIT_TEST(testLeaArena);
     CPPUNIT_TEST(testSharedPtr);
     CPPUNIT_TEST(testLimiting);
+    CPPUNIT_TEST(testSetLimit);
     CPPUNIT_TEST(testStringConcat);
     CPPUNIT_TEST(testManualAuto);
     CPPUNIT_TEST(testMemoryLimit);
+    CPPUNIT_TEST(testPoolArena);
     CPPUNIT_TEST(anExample);
     CPPUNIT_TEST_SUITE_END();
 };
@@ -582,6 +588,30 @@ void ArenaTests::testLimiting()
     a->recycle(a->allocate(10));                         // This succeeds too
 }
 
+/**
+ *  Check that the limit of a LimitedArena can be changed after the fact, the
+ *  way a query's reservation is applied to its arena on admission.
+ */
+void ArenaTests::testSetLimit()
+{
+    std::shared_ptr<LimitedArena> a(std::make_shared<LimitedArena>(Options("set").limited(getArena(),unlimited)));
+
+    void* p = a->allocate(64);                           // No limit as yet
+    CPPUNIT_ASSERT(a->available() == unlimited);         // ...so no account
+
+    a->setLimit(100);                                    // Now impose one
+    CPPUNIT_ASSERT(a->available() == std::max<size_t>(100,a->allocated()) - a->allocated());
+    CPPUNIT_ASSERT_THROW(a->allocate(64),arena::Exhausted);
+
+    a->setLimit(10);                                     // Below the peak?
+    CPPUNIT_ASSERT(a->available() == 0);                 // ...then clamped
+
+    a->recycle(p);                                       // Give it back and
+    a->setLimit(unlimited);                              // ...lift the limit
+    a->recycle(a->allocate(1000));                       // This succeeds
+    CPPUNIT_ASSERT(a->available() == unlimited);
+}
+
 /**
  *  Check that managed string concatenation is working correctly.
  *
@@ -686,6 +716,45 @@ void ArenaTests::testMemoryLimit()
     CPPUNIT_ASSERT(setMemoryLimit(l));                   // Restore the limit
 }
 
+/**
+ *  Test that the pool arena recycles the blocks it is given back, and within
+ *  its cache limit only, whose share for each of its 16 stripes is 1 KiB.
+ */
+void ArenaTests::testPoolArena()
+{
+    PoolArena p(Options("pool").pagesize(1*KiB),16*KiB); // Pool of small ones
+
+    void* a = p.malloc(100);                             // A miss
+    CPPUNIT_ASSERT(p.misses()==1 && p.hits()==0);
+    p.free(a,100);                                       // Cached for reuse
+    CPPUNIT_ASSERT(p.cached()!=0 && p.allocated()==0);
+    CPPUNIT_ASSERT(p.malloc(110) == a);                  // Same class: a hit
+    CPPUNIT_ASSERT(p.hits()==1 && p.cached()==0);
+    CPPUNIT_ASSERT(p.reallocate(a,110,112) == a);        // Still fits
+    void* b = p.reallocate(a,112,1000);                  // Moves to new class
+    CPPUNIT_ASSERT(b != a && p.cached()!=0);             // ...caching old one
+    p.free(b,1000);                                      // Over the limit
+    CPPUNIT_ASSERT(p.released()==1 && p.cached()<=p.cacheLimit());
+
+    void* c = p.malloc(4*KiB);                           // Bypasses the pool
+    c = p.reallocate(c,4*KiB,64*KiB);                    // ...and its lists
+    CPPUNIT_ASSERT(p.allocated()==64*KiB && p.allocations()==1);
+    CPPUNIT_ASSERT(p.peakusage() >= 64*KiB);
+    c = p.reallocate(c,64*KiB,8*KiB);                    // Shrinks it
+    CPPUNIT_ASSERT(p.allocated() == 8*KiB);
+    p.free(c,8*KiB);
+    CPPUNIT_ASSERT(p.released()==1 && p.allocated()==0);
+    CPPUNIT_ASSERT(p.allocations() == 0);
+
+    p.reset();                                           // Release the cache
+    CPPUNIT_ASSERT(p.cached() == 0);
+    void* d = p.malloc(100);                             // ...so a miss again
+    CPPUNIT_ASSERT(p.hits() == 1);
+    p.setCacheLimit(0);                                  // Cache nothing more
+    p.free(d,100);
+    CPPUNIT_ASSERT(p.cached()==0 && p.released()==2);
+}
+
 /**
  *  An example of how one might use Arenas within a SciDB operator.
  */
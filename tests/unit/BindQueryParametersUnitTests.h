@@ -0,0 +1,97 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef BIND_QUERY_PARAMETERS_UNIT_TESTS
+#define BIND_QUERY_PARAMETERS_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <map>
+#include <string>
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <query/PreparedPlanCache.h>
+#include <system/Exceptions.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks the substitution of the $name parameters of a prepared query.
+ */
+class BindQueryParametersTests : public CppUnit::TestFixture
+{
+ private:
+    std::map<std::string, std::string> _params;
+
+ public:
+    void setUp()
+    {
+        _params.clear();
+        _params["x"] = "10";
+        _params["y"] = "-2.5e3";
+        _params["s"] = "'it\\'s'";
+    }
+
+    void testSubstitution()
+    {
+        CPPUNIT_ASSERT_EQUAL(std::string("between(A, 10, -2.5e3, 10, -2.5e3)"),
+                             bindQueryParameters("between(A, $x, $y, $x, $y)", _params));
+        CPPUNIT_ASSERT_EQUAL(std::string("filter(A, s = 'it\\'s')"),
+                             bindQueryParameters("filter(A, s = $s)", _params));
+
+        // Unbound names, longer names, and names in literals and comments stay
+        CPPUNIT_ASSERT_EQUAL(std::string("apply(A, $z, $xx + 10)"),
+                             bindQueryParameters("apply(A, $z, $xx + $x)", _params));
+        CPPUNIT_ASSERT_EQUAL(std::string("filter(A, s = '$x') -- $x\n and \"$x\" /* $x */ 10"),
+                             bindQueryParameters("filter(A, s = '$x') -- $x\n and \"$x\" /* $x */ $x", _params));
+    }
+
+    void testNotLiteral()
+    {
+        std::map<std::string, std::string> params;
+        const char* bad[] = { "", "1; remove(A)", "'a' + 'b'", "1e", "--1", "x" };
+        for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i) {
+            params["x"] = bad[i];
+            CPPUNIT_ASSERT_THROW(bindQueryParameters("scan(A) $x", params), UserException);
+        }
+        params["x"] = "NULL";
+        CPPUNIT_ASSERT_EQUAL(std::string("scan(A) NULL"), bindQueryParameters("scan(A) $x", params));
+    }
+
+    CPPUNIT_TEST_SUITE(BindQueryParametersTests);
+    CPPUNIT_TEST(testSubstitution);
+    CPPUNIT_TEST(testNotLiteral);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BindQueryParametersTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
@@ -0,0 +1,145 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef DELTA_CHUNK_UNIT_TESTS
+#define DELTA_CHUNK_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <vector>
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <smgr/io/DeltaChunk.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks the encoding of a chunk version as a block delta against its base.
+ */
+class DeltaChunkTests : public CppUnit::TestFixture
+{
+ private:
+    /// A chunk body of the given size with some recognizable content
+    static std::vector<char> makeData(size_t size)
+    {
+        std::vector<char> data(size);
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = static_cast<char>(i * 7 + i / 251);
+        }
+        return data;
+    }
+
+    /// Encode data against base, reconstruct it, and check the result
+    static size_t roundTrip(std::vector<char> const& base, std::vector<char> const& data)
+    {
+        std::vector<char> delta;
+        CPPUNIT_ASSERT(DeltaChunk::encode(&base[0], base.size(), &data[0], data.size(),
+                                          42, data.size(), delta));
+        CPPUNIT_ASSERT_EQUAL(ArrayID(42), DeltaChunk::getHeader(&delta[0], delta.size()).baseArrId);
+
+        std::vector<char> out(data.size());
+        DeltaChunk::apply(&base[0], base.size(), &delta[0], delta.size(), &out[0], out.size());
+        CPPUNIT_ASSERT(out == data);
+        return delta.size();
+    }
+
+ public:
+    void testSmallUpdate()
+    {
+        std::vector<char> const base = makeData(64 * 1024);
+        std::vector<char> data = base;
+        data[1000] ^= 1;
+        data[40000] ^= 1;
+        size_t const size = roundTrip(base, data);
+
+        // Two changed blocks, the bitmap and the header
+        size_t const bitmap = (base.size() / DeltaChunk::BLOCK_SIZE + 63) / 64 * 8;
+        CPPUNIT_ASSERT_EQUAL(sizeof(DeltaChunkHeader) + bitmap + 2 * DeltaChunk::BLOCK_SIZE, size);
+    }
+
+    void testResize()
+    {
+        std::vector<char> const base = makeData(10000);
+
+        // Grown: the new tail, and the ragged last block, are changed
+        std::vector<char> grown = base;
+        grown.resize(10100, 'x');
+        roundTrip(base, grown);
+
+        // Shrunk to a ragged last block
+        std::vector<char> shrunk(base.begin(), base.begin() + 9990);
+        roundTrip(base, shrunk);
+    }
+
+    void testNotWorthIt()
+    {
+        std::vector<char> const base = makeData(4096);
+        std::vector<char> data(base.rbegin(), base.rend());
+        std::vector<char> delta;
+        CPPUNIT_ASSERT(!DeltaChunk::encode(&base[0], base.size(), &data[0], data.size(),
+                                           42, data.size() / 2, delta));
+        CPPUNIT_ASSERT(delta.empty());
+    }
+
+    void testCorrupt()
+    {
+        std::vector<char> const base = makeData(4096);
+        std::vector<char> data = base;
+        data[0] ^= 1;
+        std::vector<char> delta;
+        CPPUNIT_ASSERT(DeltaChunk::encode(&base[0], base.size(), &data[0], data.size(),
+                                          42, data.size(), delta));
+        std::vector<char> out(data.size());
+
+        // Base of the wrong size
+        CPPUNIT_ASSERT_THROW(DeltaChunk::apply(&base[0], base.size() - 1, &delta[0], delta.size(),
+                                               &out[0], out.size()),
+                             SystemException);
+        // Truncated delta
+        CPPUNIT_ASSERT_THROW(DeltaChunk::apply(&base[0], base.size(), &delta[0], delta.size() - 1,
+                                               &out[0], out.size()),
+                             SystemException);
+        // Bad magic
+        delta[0] ^= 1;
+        CPPUNIT_ASSERT_THROW(DeltaChunk::getHeader(&delta[0], delta.size()), SystemException);
+    }
+
+    CPPUNIT_TEST_SUITE(DeltaChunkTests);
+    CPPUNIT_TEST(testSmallUpdate);
+    CPPUNIT_TEST(testResize);
+    CPPUNIT_TEST(testNotWorthIt);
+    CPPUNIT_TEST(testCorrupt);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(DeltaChunkTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
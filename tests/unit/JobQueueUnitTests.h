@@ -0,0 +1,149 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef JOB_QUEUE_UNIT_TESTS
+#define JOB_QUEUE_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <atomic>
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <util/Job.h>
+#include <util/JobQueue.h>
+#include <util/Semaphore.h>
+#include <util/ThreadPool.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks that the work-stealing JobQueue runs every job exactly once. Its
+ *  throughput is measured by the jobqueue/ cases of the micro-benchmarks.
+ */
+class JobQueueTests : public CppUnit::TestFixture
+{
+ private:
+    /**
+     * A job that pushes two children onto its queue until depth reaches
+     * zero, so that most of the jobs are pushed by the pool threads.
+     */
+    class FanOutJob : public Job
+    {
+     public:
+        FanOutJob(JobQueue& queue, size_t depth, std::atomic<size_t>& counter, Semaphore& done)
+        : Job(std::shared_ptr<Query>()),
+          _queue(queue), _depth(depth), _counter(counter), _done(done)
+        {}
+
+        virtual void run()
+        {
+            if (_depth > 0) {
+                _queue.pushJob(std::make_shared<FanOutJob>(_queue, _depth - 1, _counter, _done));
+                _queue.pushJob(std::make_shared<FanOutJob>(_queue, _depth - 1, _counter, _done));
+            }
+            ++_counter;
+            _done.release();
+        }
+
+     private:
+        JobQueue& _queue;
+        size_t const _depth;
+        std::atomic<size_t>& _counter;
+        Semaphore& _done;
+    };
+
+    /// @return the number of jobs spawned by a FanOutJob of the given depth
+    static size_t fanOutSize(size_t depth)
+    {
+        return (size_t(2) << depth) - 1;
+    }
+
+    /// Run a fan-out of the given depth on a new pool
+    static void runFanOut(size_t nThreads, size_t depth, size_t nRoots,
+                            std::vector<JobQueue::WorkerStats>& stats)
+    {
+        std::shared_ptr<JobQueue> queue = std::make_shared<JobQueue>();
+        ThreadPool pool(nThreads, queue);
+        pool.start();
+
+        std::atomic<size_t> counter(0);
+        Semaphore done;
+        size_t const nJobs = nRoots * fanOutSize(depth);
+
+        for (size_t i = 0; i < nRoots; ++i) {
+            queue->pushJob(std::make_shared<FanOutJob>(*queue, depth, counter, done));
+        }
+        done.enter(nJobs);
+
+        CPPUNIT_ASSERT_EQUAL(nJobs, counter.load());
+        queue->getWorkerStats(stats);
+        pool.stop();
+    }
+
+ public:
+    void testFanOut()
+    {
+        std::vector<JobQueue::WorkerStats> stats;
+        runFanOut(4, 10, 8, stats);
+
+        CPPUNIT_ASSERT_EQUAL(size_t(4), stats.size());
+        uint64_t popped = 0;
+        for (size_t i = 0; i < stats.size(); ++i) {
+            popped += stats[i].popped;
+        }
+        CPPUNIT_ASSERT(popped >= 8 * fanOutSize(10));
+    }
+
+    void testHighPriority()
+    {
+        std::shared_ptr<JobQueue> queue = std::make_shared<JobQueue>();
+        std::atomic<size_t> counter(0);
+        Semaphore done;
+
+        std::shared_ptr<Job> normal = std::make_shared<FanOutJob>(*queue, 0, counter, done);
+        std::shared_ptr<Job> urgent = std::make_shared<FanOutJob>(*queue, 0, counter, done);
+        queue->pushJob(normal);
+        queue->pushHighPriorityJob(urgent);
+
+        CPPUNIT_ASSERT_EQUAL(size_t(2), queue->getSize());
+        CPPUNIT_ASSERT(queue->popJob() == urgent);
+        CPPUNIT_ASSERT(queue->popJob() == normal);
+        CPPUNIT_ASSERT_EQUAL(size_t(0), queue->getSize());
+    }
+
+    CPPUNIT_TEST_SUITE(JobQueueTests);
+    CPPUNIT_TEST(testFanOut);
+    CPPUNIT_TEST(testHighPriority);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(JobQueueTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
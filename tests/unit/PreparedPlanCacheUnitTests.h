@@ -0,0 +1,187 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef PREPARED_PLAN_CACHE_UNIT_TESTS
+#define PREPARED_PLAN_CACHE_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <query/PreparedPlanCache.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks the keys of the PreparedPlanCache, which must change with the
+ *  catalog version of every array locked, and its LRU order, invalidation
+ *  and hits.
+ */
+class PreparedPlanCacheTests : public CppUnit::TestFixture
+{
+ private:
+    typedef std::vector<std::pair<std::string, ArrayID> > Versions;
+    typedef PreparedPlanCache::Entry Entry;
+
+    /// The key of an AFL query on membership 1 at liveness 1, in tile mode
+    static std::string key(Versions const& versions, std::string const& query)
+    {
+        return PreparedPlanCache::makeKey(true, 1, 1, true, versions, query);
+    }
+
+    /// A plan under 'key' that locks the array 'array'
+    static std::shared_ptr<Entry> entry(std::string const& key, std::string const& array)
+    {
+        std::shared_ptr<Entry> e = std::make_shared<Entry>();
+        e->key = key;
+        e->plan = "plan of " + key;
+        e->reservation = 1024;
+        e->arrays.push_back(array);
+        return e;
+    }
+
+ public:
+    void setUp()
+    {
+        PreparedPlanCache::getInstance()->resize(3);
+    }
+
+    void tearDown()
+    {
+        PreparedPlanCache::getInstance()->resize(0);
+    }
+
+    void testKey()
+    {
+        Versions versions;
+        versions.push_back(std::make_pair(std::string("public.A"), ArrayID(7)));
+        std::string const base = key(versions, "scan(A)");
+        CPPUNIT_ASSERT_EQUAL(base, key(versions, "scan(A)"));
+
+        // A new catalog version of an array, as any update or change of
+        // schema makes, gives a new key
+        Versions updated(versions);
+        updated[0].second = 8;
+        CPPUNIT_ASSERT(base != key(updated, "scan(A)"));
+
+        // An array of the same name in another namespace is another array
+        Versions other(versions);
+        other[0].first = "other.A";
+        CPPUNIT_ASSERT(base != key(other, "scan(A)"));
+
+        // So are the language, the cluster, the tile mode, and the arrays locked
+        CPPUNIT_ASSERT(base != PreparedPlanCache::makeKey(false, 1, 1, true, versions, "scan(A)"));
+        CPPUNIT_ASSERT(base != PreparedPlanCache::makeKey(true, 2, 1, true, versions, "scan(A)"));
+        CPPUNIT_ASSERT(base != PreparedPlanCache::makeKey(true, 1, 2, true, versions, "scan(A)"));
+        CPPUNIT_ASSERT(base != PreparedPlanCache::makeKey(true, 1, 1, false, versions, "scan(A)"));
+        Versions more(versions);
+        more.push_back(std::make_pair(std::string("public.B"), ArrayID(3)));
+        CPPUNIT_ASSERT(base != key(more, "scan(A)"));
+
+        // The query text is bound before it is keyed
+        std::map<std::string, std::string> params;
+        params["x"] = "5";
+        std::string const bound = key(versions, bindQueryParameters("between(A, $x, $x)", params));
+        CPPUNIT_ASSERT_EQUAL(key(versions, "between(A, 5, 5)"), bound);
+        params["x"] = "6";
+        CPPUNIT_ASSERT(bound != key(versions, bindQueryParameters("between(A, $x, $x)", params)));
+    }
+
+    void testHitAndEviction()
+    {
+        PreparedPlanCache* cache = PreparedPlanCache::getInstance();
+        CPPUNIT_ASSERT(cache->insert(entry("a", "public.A")));
+        CPPUNIT_ASSERT(cache->insert(entry("b", "public.B")));
+        CPPUNIT_ASSERT(cache->insert(entry("c", "public.C")));
+        CPPUNIT_ASSERT(!cache->insert(entry("c", "public.C")));
+
+        // A hit returns the plan as serialized and its reservation
+        PreparedPlanCache::EntryPtr const hit = cache->lookup("a");
+        CPPUNIT_ASSERT(hit);
+        CPPUNIT_ASSERT_EQUAL(std::string("plan of a"), hit->plan);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(1024), hit->reservation);
+        CPPUNIT_ASSERT(!cache->lookup("d"));
+
+        // Using "a" leaves "b" the least recently used
+        CPPUNIT_ASSERT(cache->insert(entry("d", "public.D")));
+        CPPUNIT_ASSERT(cache->lookup("a"));
+        CPPUNIT_ASSERT(!cache->lookup("b"));
+        CPPUNIT_ASSERT(cache->lookup("c"));
+        CPPUNIT_ASSERT(cache->lookup("d"));
+
+        cache->resize(1);
+        CPPUNIT_ASSERT(cache->lookup("d"));
+        CPPUNIT_ASSERT(!cache->lookup("a"));
+        cache->resize(0);
+        CPPUNIT_ASSERT(!cache->isEnabled());
+        CPPUNIT_ASSERT(!cache->lookup("d"));
+        CPPUNIT_ASSERT(!cache->insert(entry("e", "public.E")));
+    }
+
+    void testInvalidation()
+    {
+        PreparedPlanCache* cache = PreparedPlanCache::getInstance();
+        std::shared_ptr<Entry> both = entry("join", "public.A");
+        both->arrays.push_back("public.B");
+        cache->insert(both);
+        cache->insert(entry("scanA", "public.A"));
+        cache->insert(entry("scanOtherA", "other.A"));
+
+        cache->invalidate("public.A");
+        CPPUNIT_ASSERT(!cache->lookup("join"));
+        CPPUNIT_ASSERT(!cache->lookup("scanA"));
+        CPPUNIT_ASSERT(cache->lookup("scanOtherA"));
+        cache->invalidate("public.B");
+        CPPUNIT_ASSERT(cache->lookup("scanOtherA"));
+
+        // A change of configuration drops every plan
+        cache->insert(entry("scanB", "public.B"));
+        cache->clear();
+        CPPUNIT_ASSERT(!cache->lookup("scanOtherA"));
+        CPPUNIT_ASSERT(!cache->lookup("scanB"));
+        CPPUNIT_ASSERT(cache->insert(entry("scanB", "public.B")));
+    }
+
+    CPPUNIT_TEST_SUITE(PreparedPlanCacheTests);
+    CPPUNIT_TEST(testKey);
+    CPPUNIT_TEST(testHitAndEviction);
+    CPPUNIT_TEST(testInvalidation);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PreparedPlanCacheTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
@@ -0,0 +1,159 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef QUANTILE_SKETCH_UNIT_TESTS
+#define QUANTILE_SKETCH_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <vector>
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <util/QuantileSketch.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks the accuracy of the quantile sketch, alone and merged.
+ */
+class QuantileSketchTests : public CppUnit::TestFixture
+{
+ private:
+    /// A growable sketch, as the aggregates keep it
+    struct Buffer
+    {
+        std::vector<char> bytes;
+
+        Buffer() : bytes(QuantileSketch::getBytes(QuantileSketch::INITIAL_CAPACITY))
+        {
+            QuantileSketch::init(&bytes[0], bytes.size());
+        }
+
+        QuantileSketch sketch()
+        {
+            return QuantileSketch(&bytes[0]);
+        }
+
+        void reserve(size_t capacity)
+        {
+            if (sketch().getCapacity() < capacity) {
+                bytes.resize(QuantileSketch::getBytes(capacity * 2));
+                sketch().setBytes(bytes.size());
+            }
+        }
+
+        void update(double v)
+        {
+            reserve(sketch().getSize() + 1);
+            sketch().update(v);
+        }
+
+        void merge(Buffer& other)
+        {
+            reserve(sketch().getSize() + other.sketch().getSize());
+            sketch().merge(other.sketch());
+        }
+    };
+
+    /// The values 0 .. n-1, in a scrambled order
+    static double scrambled(size_t i, size_t n)
+    {
+        return static_cast<double>((i * 7919) % n);
+    }
+
+    /// Check the ranks of the sketch of the values 0 .. n-1 against the bound
+    static void checkRanks(QuantileSketch const& sketch, size_t n)
+    {
+        CPPUNIT_ASSERT_EQUAL(uint64_t(n), sketch.getCount());
+        double const bound = 0.02 * static_cast<double>(n);
+        for (size_t i = 1; i < 10; ++i) {
+            double const v = static_cast<double>(n * i / 10);
+            double const error = static_cast<double>(sketch.getRank(v)) - (v + 1);
+            CPPUNIT_ASSERT(error <= bound && error >= -bound);
+
+            double const q = sketch.getQuantile(i / 10.0);
+            CPPUNIT_ASSERT(q - v <= bound && q - v >= -bound);
+        }
+        CPPUNIT_ASSERT_EQUAL(0.0, sketch.getQuantile(0));
+        CPPUNIT_ASSERT_EQUAL(static_cast<double>(n - 1), sketch.getQuantile(1));
+    }
+
+ public:
+    void testExactWhenSmall()
+    {
+        Buffer b;
+        for (size_t i = 0; i < 100; ++i) {
+            b.update(scrambled(i, 100));
+        }
+        CPPUNIT_ASSERT_EQUAL(uint64_t(50), b.sketch().getRank(49));
+        CPPUNIT_ASSERT_EQUAL(49.0, b.sketch().getQuantile(0.5));
+        CPPUNIT_ASSERT_EQUAL(uint64_t(0), b.sketch().getRank(-1));
+        CPPUNIT_ASSERT_EQUAL(uint64_t(100), b.sketch().getRank(1000));
+    }
+
+    void testLargeStream()
+    {
+        size_t const n = 1000000;
+        Buffer b;
+        for (size_t i = 0; i < n; ++i) {
+            b.update(scrambled(i, n));
+        }
+        checkRanks(b.sketch(), n);
+
+        // The sketch stays small however long the stream
+        CPPUNIT_ASSERT(b.sketch().getSize() < 4 * QuantileSketch::DEFAULT_K);
+    }
+
+    void testMerge()
+    {
+        size_t const n = 200000;
+        size_t const nParts = 7;
+        std::vector<Buffer> parts(nParts);
+        for (size_t i = 0; i < n; ++i) {
+            parts[i % nParts].update(scrambled(i, n));
+        }
+        Buffer all;
+        for (size_t p = 0; p < nParts; ++p) {
+            all.merge(parts[p]);
+        }
+        checkRanks(all.sketch(), n);
+    }
+
+    CPPUNIT_TEST_SUITE(QuantileSketchTests);
+    CPPUNIT_TEST(testExactWhenSmall);
+    CPPUNIT_TEST(testLargeStream);
+    CPPUNIT_TEST(testMerge);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QuantileSketchTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
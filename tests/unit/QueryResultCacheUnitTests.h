@@ -0,0 +1,236 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef QUERY_RESULT_CACHE_UNIT_TESTS
+#define QUERY_RESULT_CACHE_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <array/ArrayDistributionInterface.h>
+#include <array/Compressor.h>
+#include <query/QueryResultCache.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks the LRU order and the invalidation of the QueryResultCache, the
+ *  versioned keys of the arrays that results read, and the capture of a
+ *  result as the client fetches it.
+ */
+class QueryResultCacheTests : public CppUnit::TestFixture
+{
+ private:
+    typedef QueryResultCache::Entry Entry;
+
+    /// A one-attribute emptyable schema, with the given ids
+    static ArrayDesc schema(ArrayID id, ArrayUAID uaId, VersionID version)
+    {
+        std::vector<InstanceID> instances(1, 0);
+        Attributes attributes;
+        attributes.push_back(AttributeDesc(0, "a", TID_INT64, 0, (uint16_t) CompressorFactory::NO_COMPRESSION));
+        Dimensions dimensions;
+        dimensions.push_back(DimensionDesc("x", 0, 0, 99, 99, 10, 0));
+        ArrayDesc desc(id, uaId, version, "public", "A",
+                       addEmptyTagAttribute(attributes), dimensions,
+                       defaultPartitioning(),
+                       createDefaultResidency(PointerRange<InstanceID>(instances)));
+        return desc;
+    }
+
+    /// An entry of 'bytes' bytes under 'key' that read the array 'array'
+    static std::shared_ptr<Entry> entry(std::string const& key, size_t bytes, std::string const& array)
+    {
+        std::shared_ptr<Entry> e = std::make_shared<Entry>(schema(2, 1, 1));
+        e->key = key;
+        e->bytes = bytes;
+        e->arrays.push_back(array);
+        return e;
+    }
+
+    /// A compressed buffer of 'size' bytes
+    static std::shared_ptr<CompressedBuffer> buffer(size_t size)
+    {
+        std::shared_ptr<CompressedBuffer> b = std::make_shared<CompressedBuffer>();
+        b->allocate(size);
+        b->setDecompressedSize(size);
+        return b;
+    }
+
+    /// Send every chunk of 'nChunks' and the end of attribute 'attId' to 'capture'
+    static void drain(QueryResultCapture& capture, AttributeID attId, size_t nChunks)
+    {
+        for (size_t i = 0; i < nChunks; ++i) {
+            capture.add(attId, Coordinates(1, i * 10), 10, buffer(100));
+        }
+        capture.add(attId, Coordinates(), 0, std::shared_ptr<CompressedBuffer>());
+    }
+
+ public:
+    void setUp()
+    {
+        QueryResultCache::getInstance()->resize(1000);
+    }
+
+    void tearDown()
+    {
+        QueryResultCache::getInstance()->resize(0);
+    }
+
+    void testLruEviction()
+    {
+        QueryResultCache* cache = QueryResultCache::getInstance();
+        CPPUNIT_ASSERT(cache->insert(entry("a", 400, "public.A")));
+        CPPUNIT_ASSERT(cache->insert(entry("b", 400, "public.B")));
+        CPPUNIT_ASSERT(!cache->insert(entry("b", 10, "public.B")));
+        CPPUNIT_ASSERT(!cache->insert(entry("huge", 1001, "public.A")));
+
+        // Using "a" leaves "b" the least recently used, which makes room for "c"
+        CPPUNIT_ASSERT(cache->lookup("a"));
+        CPPUNIT_ASSERT(cache->insert(entry("c", 400, "public.C")));
+        CPPUNIT_ASSERT(cache->lookup("a"));
+        CPPUNIT_ASSERT(!cache->lookup("b"));
+        CPPUNIT_ASSERT(cache->lookup("c"));
+
+        // Shrinking the cache evicts in the same order
+        cache->resize(500);
+        CPPUNIT_ASSERT(!cache->lookup("a"));
+        CPPUNIT_ASSERT(cache->lookup("c"));
+        cache->resize(0);
+        CPPUNIT_ASSERT(!cache->isEnabled());
+        CPPUNIT_ASSERT(!cache->lookup("c"));
+    }
+
+    void testInvalidation()
+    {
+        QueryResultCache* cache = QueryResultCache::getInstance();
+        std::shared_ptr<Entry> both = entry("join", 100, "public.A");
+        both->arrays.push_back("public.B");
+        cache->insert(both);
+        cache->insert(entry("scanA", 100, "public.A"));
+        cache->insert(entry("scanB", 100, "public.B"));
+        cache->insert(entry("scanOtherA", 100, "other.A"));
+
+        cache->invalidate("public.A");
+        CPPUNIT_ASSERT(!cache->lookup("join"));
+        CPPUNIT_ASSERT(!cache->lookup("scanA"));
+        CPPUNIT_ASSERT(cache->lookup("scanB"));
+        CPPUNIT_ASSERT(cache->lookup("scanOtherA"));
+
+        // The freed space is available again
+        CPPUNIT_ASSERT(cache->insert(entry("big", 800, "public.C")));
+        CPPUNIT_ASSERT(cache->lookup("scanB"));
+    }
+
+    void testVersionedKeys()
+    {
+        // Each version of an array has its own versioned id, and so its own key
+        std::ostringstream v1, v1again, v2, other;
+        CPPUNIT_ASSERT(QueryResultCache::appendScannedArray(schema(2, 1, 1), v1));
+        CPPUNIT_ASSERT(QueryResultCache::appendScannedArray(schema(2, 1, 1), v1again));
+        CPPUNIT_ASSERT(QueryResultCache::appendScannedArray(schema(3, 1, 2), v2));
+        CPPUNIT_ASSERT(QueryResultCache::appendScannedArray(schema(5, 4, 1), other));
+        CPPUNIT_ASSERT_EQUAL(v1.str(), v1again.str());
+        CPPUNIT_ASSERT(v1.str() != v2.str());
+        CPPUNIT_ASSERT(v1.str() != other.str());
+
+        // Temporary arrays are updated in place, without a new version
+        ArrayDesc temp = schema(2, 1, 0);
+        temp.setTransient(true);
+        std::ostringstream key;
+        CPPUNIT_ASSERT(!QueryResultCache::appendScannedArray(temp, key));
+    }
+
+    void testCapture()
+    {
+        QueryResultCache* cache = QueryResultCache::getInstance();
+        cache->resize(10000);
+        ArrayDesc const desc = schema(2, 1, 1);
+        AttributeID const emptyTag = desc.getEmptyBitmapAttribute()->getId();
+
+        // A result is cached when the client completes the query after
+        // fetching every attribute to its end
+        std::shared_ptr<Entry> e = std::make_shared<Entry>(desc);
+        e->key = "drained";
+        QueryResultCapture drained(e, cache->getMaxEntryBytes());
+        drained.addWarning(Warning(__FILE__, __FUNCTION__, __LINE__, "scidb", 0, "w", "W"));
+        drain(drained, 0, 2);
+        CPPUNIT_ASSERT(!drained.isDrained());
+        drain(drained, emptyTag, 2);
+        CPPUNIT_ASSERT(drained.isDrained());
+        CPPUNIT_ASSERT(!cache->lookup("drained"));
+        CPPUNIT_ASSERT(drained.finish());
+
+        QueryResultCache::EntryPtr const hit = cache->lookup("drained");
+        CPPUNIT_ASSERT(hit);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), hit->warnings.size());
+        CPPUNIT_ASSERT_EQUAL(size_t(2), hit->chunks[0].size());
+        CachedResultArray replay(hit);
+        CPPUNIT_ASSERT(replay.nextCachedChunk(0));
+        CPPUNIT_ASSERT(replay.nextCachedChunk(0));
+        CPPUNIT_ASSERT(!replay.nextCachedChunk(0));
+
+        // One attribute not fetched to its end leaves nothing in the cache,
+        // even with as many chunks as the others
+        e = std::make_shared<Entry>(desc);
+        e->key = "partial";
+        QueryResultCapture partial(e, cache->getMaxEntryBytes());
+        drain(partial, 0, 2);
+        partial.add(emptyTag, Coordinates(1, 0), 10, buffer(100));
+        partial.add(emptyTag, Coordinates(1, 10), 10, buffer(100));
+        CPPUNIT_ASSERT(!partial.finish());
+        CPPUNIT_ASSERT(!cache->lookup("partial"));
+
+        // A result larger than a quarter of the cache is abandoned
+        e = std::make_shared<Entry>(desc);
+        e->key = "large";
+        QueryResultCapture large(e, cache->getMaxEntryBytes());
+        drain(large, 0, 20);
+        drain(large, emptyTag, 20);
+        CPPUNIT_ASSERT(!large.finish());
+        CPPUNIT_ASSERT(!cache->lookup("large"));
+    }
+
+    CPPUNIT_TEST_SUITE(QueryResultCacheTests);
+    CPPUNIT_TEST(testLruEviction);
+    CPPUNIT_TEST(testInvalidation);
+    CPPUNIT_TEST(testVersionedKeys);
+    CPPUNIT_TEST(testCapture);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QueryResultCacheTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
@@ -0,0 +1,207 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef RLE_EMPTY_BITMAP_UNIT_TESTS
+#define RLE_EMPTY_BITMAP_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <memory>
+#include <vector>
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <array/RLE.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks the two packed forms of the empty bitmap, the galloping search
+ *  behind in-order setPosition() probes, and the set operations.
+ */
+class RLEEmptyBitmapTests : public CppUnit::TestFixture
+{
+ private:
+    typedef ConstRLEEmptyBitmap::Segment Segment;
+
+    /// Pack bm into buf and return the magic it was packed with
+    static uint64_t pack(ConstRLEEmptyBitmap const& bm, std::vector<char>& buf)
+    {
+        buf.assign(bm.packedSize(), 0);
+        bm.pack(&buf[0]);
+        return reinterpret_cast<ConstRLEEmptyBitmap::Header const*>(&buf[0])->_magic;
+    }
+
+    /// Check that two bitmaps have the same segments
+    static void assertSame(ConstRLEEmptyBitmap const& a, ConstRLEEmptyBitmap const& b)
+    {
+        CPPUNIT_ASSERT_EQUAL(a.nSegments(), b.nSegments());
+        CPPUNIT_ASSERT_EQUAL(a.count(), b.count());
+        for (size_t i = 0; i < a.nSegments(); ++i) {
+            CPPUNIT_ASSERT_EQUAL(a.getSegment(i)._lPosition, b.getSegment(i)._lPosition);
+            CPPUNIT_ASSERT_EQUAL(a.getSegment(i)._length, b.getSegment(i)._length);
+            CPPUNIT_ASSERT_EQUAL(a.getSegment(i)._pPosition, b.getSegment(i)._pPosition);
+        }
+    }
+
+    /// A bitmap with one cell in every 'stride', spread over 'nCells' cells
+    static void scattered(RLEEmptyBitmap& bm, position_t nCells, position_t stride)
+    {
+        position_t ppos = 0;
+        for (position_t lpos = 0; lpos < nCells; lpos += stride + (lpos & 3)) {
+            bm.addPositionPair(lpos, ppos++);
+        }
+    }
+
+ public:
+    void testSparseRoundTrip()
+    {
+        RLEEmptyBitmap bm;
+        scattered(bm, 1000000, 37);
+        std::vector<char> buf;
+
+        CPPUNIT_ASSERT_EQUAL(RLE_EMPTY_BITMAP_SPARSE_MAGIC, pack(bm, buf));
+        CPPUNIT_ASSERT(bm.packedSize() * ConstRLEEmptyBitmap::SPARSE_PACKING_RATIO <=
+                       bm.nSegments() * sizeof(Segment));
+
+        ConstRLEEmptyBitmap unpacked(&buf[0]);
+        assertSame(bm, unpacked);
+        CPPUNIT_ASSERT_EQUAL(buf.size(), unpacked.packedSize());
+
+        // Copying out and repacking gives back the same bytes
+        RLEEmptyBitmap copy(unpacked);
+        std::vector<char> buf2;
+        pack(copy, buf2);
+        CPPUNIT_ASSERT(buf == buf2);
+
+        // A copy of an unpacked bitmap keeps its own segments
+        std::unique_ptr<ConstRLEEmptyBitmap> source(new ConstRLEEmptyBitmap(&buf[0]));
+        ConstRLEEmptyBitmap copied(*source);
+        ConstRLEEmptyBitmap assigned(&buf2[0]);
+        assigned = *source;
+        CPPUNIT_ASSERT(&copied.getSegment(0) != &source->getSegment(0));
+        source.reset();
+        assertSame(bm, copied);
+        assertSame(bm, assigned);
+    }
+
+    void testRunsAndSegments()
+    {
+        // Long runs pack well either way, and come back unchanged
+        RLEEmptyBitmap runs;
+        for (position_t i = 0; i < 100; ++i) {
+            Segment s;
+            s._lPosition = i * 1000;
+            s._length = 500;
+            s._pPosition = i * 500;
+            runs.addSegment(s);
+        }
+        std::vector<char> buf;
+        pack(runs, buf);
+        CPPUNIT_ASSERT(buf.size() <= sizeof(ConstRLEEmptyBitmap::Header) + runs.nSegments() * sizeof(Segment));
+        assertSame(runs, ConstRLEEmptyBitmap(&buf[0]));
+
+        // Payload positions that are not the running count need the segments,
+        // which are then used in place
+        RLEEmptyBitmap gaps;
+        for (position_t i = 0; i < 1000; ++i) {
+            gaps.addPositionPair(i * 10, i * 2);
+        }
+        CPPUNIT_ASSERT_EQUAL(RLE_EMPTY_BITMAP_MAGIC, pack(gaps, buf));
+        ConstRLEEmptyBitmap view(&buf[0]);
+        assertSame(gaps, view);
+        CPPUNIT_ASSERT(reinterpret_cast<char const*>(&view.getSegment(0)) ==
+                       &buf[0] + sizeof(ConstRLEEmptyBitmap::Header));
+    }
+
+    void testOrderedProbes()
+    {
+        RLEEmptyBitmap bm;
+        scattered(bm, 200000, 5);
+
+        ConstRLEEmptyBitmap::iterator it = bm.getIterator();
+        for (position_t pos = 0; pos < 200000; pos += 3) {
+            bool const found = it.setPosition(pos);
+            CPPUNIT_ASSERT_EQUAL(!bm.isEmpty(pos), found);
+            if (found) {
+                CPPUNIT_ASSERT_EQUAL(bm.getValueIndex(pos), size_t(it.getPPos()));
+            }
+            size_t const from = bm.findSegment(pos / 2);
+            CPPUNIT_ASSERT_EQUAL(bm.findSegment(pos), bm.findSegment(pos, from));
+        }
+    }
+
+    void testIntersectAndUnite()
+    {
+        // Every other cell, and every third cell with the payload of a longer run
+        RLEEmptyBitmap evens, thirds;
+        for (position_t lpos = 0; lpos < 3000; lpos += 2) {
+            evens.addPositionPair(lpos, lpos / 2);
+        }
+        for (position_t lpos = 0; lpos < 3000; lpos += 3) {
+            thirds.addPositionPair(lpos, lpos + 7);
+        }
+
+        std::shared_ptr<RLEEmptyBitmap> both = evens.intersect(thirds);
+        CPPUNIT_ASSERT_EQUAL(uint64_t(500), both->count());
+        for (position_t lpos = 0; lpos < 3000; ++lpos) {
+            CPPUNIT_ASSERT_EQUAL(lpos % 6 != 0, both->isEmpty(lpos));
+            if (lpos % 6 == 0) {
+                CPPUNIT_ASSERT_EQUAL(size_t(lpos / 2), both->getValueIndex(lpos));
+            }
+        }
+        assertSame(*both, *evens.intersect(*thirds.intersect(evens)));
+
+        // Two overlapping runs of one bitmap unite into one segment
+        RLEEmptyBitmap all(position_t(100));
+        Coordinates origin(1, 0), last(1, 99), low(1, 10), high(1, 59);
+        std::shared_ptr<RLEEmptyBitmap> left = all.cut(origin, last, low, high);
+        low[0] = 40;
+        high[0] = 89;
+        std::shared_ptr<RLEEmptyBitmap> right = all.cut(origin, last, low, high);
+        std::shared_ptr<RLEEmptyBitmap> either = left->unite(*right);
+        CPPUNIT_ASSERT_EQUAL(size_t(1), either->nSegments());
+        CPPUNIT_ASSERT_EQUAL(position_t(10), either->getSegment(0)._lPosition);
+        CPPUNIT_ASSERT_EQUAL(position_t(10), either->getSegment(0)._pPosition);
+        CPPUNIT_ASSERT_EQUAL(position_t(80), either->getSegment(0)._length);
+        assertSame(*either, *right->unite(*left));
+        assertSame(evens, *evens.unite(*evens.intersect(thirds)));
+    }
+
+    CPPUNIT_TEST_SUITE(RLEEmptyBitmapTests);
+    CPPUNIT_TEST(testSparseRoundTrip);
+    CPPUNIT_TEST(testRunsAndSegments);
+    CPPUNIT_TEST(testOrderedProbes);
+    CPPUNIT_TEST(testIntersectAndUnite);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(RLEEmptyBitmapTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
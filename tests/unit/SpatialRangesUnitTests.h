@@ -0,0 +1,170 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef SPATIAL_RANGES_UNIT_TESTS
+#define SPATIAL_RANGES_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <vector>
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <util/SpatialType.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks the R-tree of SpatialRanges against a linear scan of the ranges.
+ */
+class SpatialRangesTests : public CppUnit::TestFixture
+{
+ private:
+    /// A scrambled coordinate in [0, n)
+    static Coordinate scrambled(size_t i, size_t n)
+    {
+        return static_cast<Coordinate>((i * 7919 + 13) % n);
+    }
+
+    /// Small boxes scattered over a square of the given edge
+    static void fill(SpatialRanges& ranges, size_t nRanges, size_t edge)
+    {
+        for (size_t i = 0; i < nRanges; ++i) {
+            SpatialRange& r = ranges.addOne();
+            for (size_t d = 0; d < ranges._numDims; ++d) {
+                r._low[d] = scrambled(i * ranges._numDims + d, edge);
+                r._high[d] = r._low[d] + static_cast<Coordinate>(i % 5);
+            }
+        }
+    }
+
+    static bool linearContains(SpatialRanges const& ranges, Coordinates const& point)
+    {
+        for (size_t i = 0; i < ranges._ranges.size(); ++i) {
+            if (ranges._ranges[i].contains(point)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static size_t linearIntersecting(SpatialRanges const& ranges, SpatialRange const& query)
+    {
+        size_t count = 0;
+        for (size_t i = 0; i < ranges._ranges.size(); ++i) {
+            if (ranges._ranges[i].intersects(query)) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    void check(size_t nDims, size_t nRanges, size_t edge)
+    {
+        SpatialRanges ranges(nDims);
+        fill(ranges, nRanges, edge);
+        ranges.buildIndex();
+        CPPUNIT_ASSERT_EQUAL(nRanges, ranges._ranges.size());
+
+        // Every cell of a corner of the space
+        Coordinates point(nDims, 0);
+        size_t hint = 0;
+        for (size_t i = 0; i < 4096; ++i) {
+            size_t rest = i;
+            for (size_t d = 0; d < nDims; ++d) {
+                point[d] = static_cast<Coordinate>(rest % 16);
+                rest /= 16;
+            }
+            CPPUNIT_ASSERT_EQUAL(linearContains(ranges, point), ranges.findOneThatContains(point, hint));
+        }
+
+        // Chunk-like boxes: the ranges they overlap, and whether one holds them whole
+        for (size_t i = 0; i < 100; ++i) {
+            SpatialRange query(nDims);
+            for (size_t d = 0; d < nDims; ++d) {
+                query._low[d] = scrambled(i * 31 + d, edge);
+                query._high[d] = query._low[d] + static_cast<Coordinate>(i % 3);
+            }
+            SpatialRanges found(nDims);
+            ranges.findAllThatIntersect(query, found);
+            CPPUNIT_ASSERT_EQUAL(linearIntersecting(ranges, query), found._ranges.size());
+            CPPUNIT_ASSERT_EQUAL(!found._ranges.empty(), ranges.findOneThatIntersects(query, hint));
+
+            bool contained = false;
+            for (size_t j = 0; j < found._ranges.size(); ++j) {
+                contained = contained || found._ranges[j].contains(query);
+            }
+            CPPUNIT_ASSERT_EQUAL(contained, ranges.findOneThatContains(query, hint));
+        }
+    }
+
+ public:
+    void testOneDimension()
+    {
+        check(1, 5000, 20000);
+    }
+
+    void testTwoDimensions()
+    {
+        check(2, 20000, 1000);
+    }
+
+    void testThreeDimensions()
+    {
+        check(3, 10000, 60);
+    }
+
+    /// Ranges added after buildIndex() are still found
+    void testStaleIndex()
+    {
+        SpatialRanges ranges(2);
+        fill(ranges, 1000, 500);
+        ranges.buildIndex();
+        SpatialRange& r = ranges.addOne();
+        r._low[0] = r._high[0] = 1000;
+        r._low[1] = r._high[1] = 1000;
+
+        Coordinates point(2, 1000);
+        size_t hint = 0;
+        CPPUNIT_ASSERT(ranges.findOneThatContains(point, hint));
+        CPPUNIT_ASSERT_EQUAL(size_t(1000), hint);
+    }
+
+    CPPUNIT_TEST_SUITE(SpatialRangesTests);
+    CPPUNIT_TEST(testOneDimension);
+    CPPUNIT_TEST(testTwoDimensions);
+    CPPUNIT_TEST(testThreeDimensions);
+    CPPUNIT_TEST(testStaleIndex);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SpatialRangesTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
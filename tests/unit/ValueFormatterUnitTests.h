@@ -0,0 +1,179 @@
+/*
+**
+* BEGIN_COPYRIGHT
+*
+* Copyright (C) 2008-2015 SciDB, Inc.
+* All Rights Reserved.
+*
+* SciDB is free software: you can redistribute it and/or modify
+* it under the terms of the AFFERO GNU General Public License as published by
+* the Free Software Foundation.
+*
+* SciDB is distributed "AS-IS" AND WITHOUT ANY WARRANTY OF ANY KIND,
+* INCLUDING ANY IMPLIED WARRANTY OF MERCHANTABILITY,
+* NON-INFRINGEMENT, OR FITNESS FOR A PARTICULAR PURPOSE. See
+* the AFFERO GNU General Public License for the complete license terms.
+*
+* You should have received a copy of the AFFERO GNU General Public License
+* along with SciDB.  If not, see <http://www.gnu.org/licenses/agpl-3.0.html>
+*
+* END_COPYRIGHT
+*/
+
+#ifndef VALUE_FORMATTER_UNIT_TESTS
+#define VALUE_FORMATTER_UNIT_TESTS
+
+/****************************************************************************/
+
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include <cppunit/TestAssert.h>
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <query/TypeSystem.h>
+#include <query/Value.h>
+
+/****************************************************************************/
+namespace scidb {
+/****************************************************************************/
+
+/**
+ *  Checks that Value::Formatter writes numbers, booleans, nulls and special
+ *  reals exactly as the ostream-based formatter it replaced did.
+ */
+class ValueFormatterTests : public CppUnit::TestFixture
+{
+ private:
+    /// A number as the old formatter streamed it, at 'precision'
+    template<typename T>
+    static std::string streamed(T v, int precision = Value::Formatter::DEFAULT_PRECISION)
+    {
+        std::stringstream ss;
+        ss.precision(precision);
+        ss << v;
+        return ss.str();
+    }
+
+    /// Check both forms of format() against 'expected'
+    static void check(Value::Formatter const& f, TypeId const& type, Value const& v,
+                      std::string const& expected)
+    {
+        CPPUNIT_ASSERT_EQUAL(expected, f.format(type, v));
+        std::string out("x,");
+        f.format(type, v, out);
+        CPPUNIT_ASSERT_EQUAL("x," + expected, out);
+    }
+
+    /// Check every value of 'values' of the integral type T
+    template<typename T, typename Streamed, size_t N>
+    static void checkIntegers(TypeId const& type, T const (&values)[N])
+    {
+        Value::Formatter f;
+        for (size_t i = 0; i < N; ++i) {
+            check(f, type, Value(values[i], Value::asData), streamed(static_cast<Streamed>(values[i])));
+        }
+    }
+
+ public:
+    void testIntegers()
+    {
+        int8_t const i8[] = { 0, 1, -1, 34, std::numeric_limits<int8_t>::min(), std::numeric_limits<int8_t>::max() };
+        int16_t const i16[] = { 0, -7, std::numeric_limits<int16_t>::min(), std::numeric_limits<int16_t>::max() };
+        int32_t const i32[] = { 0, 10, -100000, std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max() };
+        int64_t const i64[] = { 0, 9, -10, 1234567890123LL,
+                                std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max() };
+        uint8_t const u8[] = { 0, 34, std::numeric_limits<uint8_t>::max() };
+        uint16_t const u16[] = { 0, 100, std::numeric_limits<uint16_t>::max() };
+        uint32_t const u32[] = { 0, 4000000000U, std::numeric_limits<uint32_t>::max() };
+        uint64_t const u64[] = { 0, 10, std::numeric_limits<uint64_t>::max() };
+
+        // The old formatter widened the one-byte types so as not to print characters
+        checkIntegers<int8_t, int>(TID_INT8, i8);
+        checkIntegers<int16_t, int16_t>(TID_INT16, i16);
+        checkIntegers<int32_t, int32_t>(TID_INT32, i32);
+        checkIntegers<int64_t, int64_t>(TID_INT64, i64);
+        checkIntegers<uint8_t, int>(TID_UINT8, u8);
+        checkIntegers<uint16_t, uint16_t>(TID_UINT16, u16);
+        checkIntegers<uint32_t, uint32_t>(TID_UINT32, u32);
+        checkIntegers<uint64_t, uint64_t>(TID_UINT64, u64);
+
+        Value::Formatter f;
+        check(f, TID_BOOL, Value(true, Value::asData), "true");
+        check(f, TID_BOOL, Value(false, Value::asData), "false");
+    }
+
+    void testReals()
+    {
+        double const d[] = { 0.0, -0.0, 1.0, -2.5, 1.0 / 3.0, 123456789.0, 1e-5, 1e300, -1e-300,
+                             std::numeric_limits<double>::denorm_min(),
+                             std::numeric_limits<double>::max(),
+                             std::numeric_limits<double>::infinity(),
+                             -std::numeric_limits<double>::infinity() };
+        int const precisions[] = { 6, 1, 10, 17, 40 };
+        for (size_t p = 0; p < sizeof(precisions) / sizeof(precisions[0]); ++p) {
+            Value::Formatter f;
+            f.setPrecision(precisions[p]);
+            for (size_t i = 0; i < sizeof(d) / sizeof(d[0]); ++i) {
+                check(f, TID_DOUBLE, Value(d[i], Value::asData), streamed(d[i], precisions[p]));
+                float const v = static_cast<float>(d[i]);
+                check(f, TID_FLOAT, Value(v, Value::asData), streamed(v, precisions[p]));
+            }
+        }
+
+        // Not-a-number has its own representation
+        Value::Formatter f;
+        check(f, TID_DOUBLE, Value(std::numeric_limits<double>::quiet_NaN(), Value::asData), "nan");
+        check(f, TID_FLOAT, Value(std::numeric_limits<float>::quiet_NaN(), Value::asData), "nan");
+    }
+
+    void testNulls()
+    {
+        Value null(sizeof(int64_t));
+        null.setNull();
+        Value missing(sizeof(int64_t));
+        missing.setNull(34);
+
+        Value::Formatter dcsv;
+        check(dcsv, TID_INT64, null, "null");
+        check(dcsv, TID_DOUBLE, null, "null");
+        check(dcsv, TID_STRING, null, "null");
+        // ?34, not the character of code 34
+        check(dcsv, TID_INT64, missing, "?34");
+        check(dcsv, TID_UINT8, missing, "?34");
+
+        check(Value::Formatter("tsv"), TID_INT64, null, "\\N");
+        check(Value::Formatter("csv:E"), TID_DOUBLE, null, "");
+        check(Value::Formatter("csv:?"), TID_INT32, null, "?0");
+        check(Value::Formatter("tsv"), TID_INT64, missing, "?34");
+    }
+
+    void testStrings()
+    {
+        Value s;
+        s.setString("it's a\tb\\c");
+        check(Value::Formatter(), TID_STRING, s, "'it\\'s a\tb\\\\c'");
+        check(Value::Formatter("csv:d"), TID_STRING, s, "\"it's a\tb\\\\c\"");
+        check(Value::Formatter("tsv"), TID_STRING, s, "it's a\\tb\\\\c");
+        check(Value::Formatter(), TID_CHAR, Value('\'', Value::asData), "'\\''");
+        check(Value::Formatter(), TID_CHAR, Value('\n', Value::asData), "'\\n'");
+    }
+
+    CPPUNIT_TEST_SUITE(ValueFormatterTests);
+    CPPUNIT_TEST(testIntegers);
+    CPPUNIT_TEST(testReals);
+    CPPUNIT_TEST(testNulls);
+    CPPUNIT_TEST(testStrings);
+    CPPUNIT_TEST_SUITE_END();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ValueFormatterTests);
+
+/****************************************************************************/
+}
+/****************************************************************************/
+#endif
+/****************************************************************************/
@@ -64,6 +64,15 @@
 #include "PointerRangeUnitTests.h"
 #include "ArenaUnitTests.h"
 #include "NewUsageOfArena.h"
+#include "JobQueueUnitTests.h"
+#include "RLEEmptyBitmapUnitTests.h"
+#include "DeltaChunkUnitTests.h"
+#include "QuantileSketchUnitTests.h"
+#include "SpatialRangesUnitTests.h"
+#include "BindQueryParametersUnitTests.h"
+#include "PreparedPlanCacheUnitTests.h"
+#include "QueryResultCacheUnitTests.h"
+#include "ValueFormatterUnitTests.h"
 
 // The variable_window() unit test should be enabled after fixing #5018.
 // #include <query/ops/variable_window/VariableWindowUnitTests.h>
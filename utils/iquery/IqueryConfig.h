@@ -54,7 +54,8 @@ enum
     CONFIG_HELP,
     CONFIG_VERSION,
     CONFIG_IGNORE_ERRORS,
-    CONFIG_AUTHENTICATION_FILE
+    CONFIG_AUTHENTICATION_FILE,
+    CONFIG_MEMORY_RESERVATION
 };
 
 }
@@ -117,6 +117,8 @@ public:
 
     bool ignoreErrors;
 
+    uint64_t memoryReservation; // MiB asked of the admission controller, 0 for its default
+
     std::string format;
     std::string authenticationFile;
     friend std::ostream &operator<<(
@@ -178,6 +180,7 @@ void executePreparedSciDBQuery(const string &queryString, scidb::QueryResult& qu
         cout << "Query ID: " << queryResult.queryID << endl;
     }
 
+    queryResult.memoryReservation = iqueryState.memoryReservation;
     sciDB.executeQuery(queryString, !iqueryState.aql, queryResult, iqueryState.connection);
 
     if (queryResult.selective && !iqueryState.nofetch)
@@ -593,6 +596,9 @@ int main(int argc, char* argv[])
                 "Ignore execution errors in batch mode", false, false)
             (CONFIG_AUTHENTICATION_FILE, 'A', "auth-file", "auth-file", "",
                 scidb::Config::STRING, "User authentication file", string(""), false)
+            (CONFIG_MEMORY_RESERVATION, 'm', "memory-reservation", "memory-reservation", "", scidb::Config::INTEGER,
+                "Memory each query needs on every instance (MiB), for admission control."
+                " Default is 0: the server estimates it", 0, false)
             ;
 
         cfg->addHook(configHook);
@@ -613,6 +619,7 @@ int main(int argc, char* argv[])
         iqueryState.timer        = cfg->getOption<bool>(CONFIG_TIMER);
         iqueryState.ignoreErrors = cfg->getOption<bool>(CONFIG_IGNORE_ERRORS);
         iqueryState.format       = cfg->getOption<string>(CONFIG_RESULT_FORMAT);
+        iqueryState.memoryReservation = std::max(cfg->getOption<int>(CONFIG_MEMORY_RESERVATION), 0);
         iqueryState.authenticationFile = cfg->getOption<string>(CONFIG_AUTHENTICATION_FILE);
 
         if(iqueryState.authenticationFile.length() == 0)